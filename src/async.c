@@ -0,0 +1,479 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "async.h"
+#include "rule.h"
+#include "thread.h"
+#include "buf.h"
+#include "zc_defs.h"
+
+/* one message in the ring, followed by path('\0' ended) and msg */
+typedef struct {
+	zlog_rule_t *rule;  /* NULL means skip to the ring start */
+	size_t len;         /* whole record, aligned */
+	size_t path_len;
+	size_t msg_len;
+
+	char *category_name;
+	size_t category_name_len;
+	int level;
+	struct timespec time_stamp;
+} zlog_async_msg_t;
+
+#define ZLOG_ASYNC_ALIGN(n) (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#define ZLOG_ASYNC_BUF_SIZE_MIN 4096
+#define ZLOG_ASYNC_IDLE_WAIT_MS 100
+
+void zlog_async_profile(zlog_async_t * a_async, int flag)
+{
+	size_t dropped;
+	zlog_async_ring_t *a_ring;
+
+	zc_assert(a_async,);
+
+	pthread_mutex_lock(&a_async->lock);
+	dropped = a_async->dropped;
+	for (a_ring = a_async->rings; a_ring; a_ring = a_ring->next) {
+		dropped += a_ring->dropped;
+	}
+	pthread_mutex_unlock(&a_async->lock);
+
+	zc_profile(flag, "---async[%p][%ld,%d][passes:%ld][dropped:%ld]---",
+		a_async,
+		(long)a_async->buf_size,
+		a_async->overflow,
+		(long)a_async->passes,
+		(long)dropped);
+	return;
+}
+
+/*******************************************************************************/
+static size_t zlog_async_round_size(size_t buf_size)
+{
+	size_t size = ZLOG_ASYNC_BUF_SIZE_MIN;
+	while (size < buf_size) size <<= 1;
+	return size;
+}
+
+static zlog_async_ring_t *zlog_async_ring_new(size_t size)
+{
+	zlog_async_ring_t *a_ring;
+
+	a_ring = calloc(1, sizeof(zlog_async_ring_t));
+	if (!a_ring) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_ring->size = size;
+	a_ring->buf = malloc(size);
+	if (!a_ring->buf) {
+		zc_error("malloc fail, errno[%d]", errno);
+		free(a_ring);
+		return NULL;
+	}
+	return a_ring;
+}
+
+void zlog_async_ring_del(zlog_async_ring_t * a_ring)
+{
+	zc_assert(a_ring,);
+	if (a_ring->buf) free(a_ring->buf);
+	zc_debug("zlog_async_ring_del[%p]", a_ring);
+	free(a_ring);
+	return;
+}
+
+/*******************************************************************************/
+/* write every record the producer published, only called by the writer */
+static size_t zlog_async_ring_drain(zlog_async_t * a_async, zlog_async_ring_t * a_ring)
+{
+	size_t n = 0;
+	size_t head;
+	size_t tail;
+	size_t pos;
+	zlog_async_msg_t *a_msg;
+	zlog_event_t *a_event = a_async->writer->event;
+
+	head = zc_atomic_load(&a_ring->head);
+	tail = a_ring->tail;
+	while (tail != head) {
+		pos = tail & (a_ring->size - 1);
+		if (a_ring->size - pos < sizeof(zlog_async_msg_t)) {
+			/* too short for a record, producer skipped it */
+			tail += a_ring->size - pos;
+			continue;
+		}
+
+		a_msg = (zlog_async_msg_t *) (a_ring->buf + pos);
+		if (a_msg->rule) {
+			char *path = a_msg->path_len ? (char *)(a_msg + 1) : NULL;
+
+			/* archive path specs may look at time, level and category */
+			a_event->category_name = a_msg->category_name;
+			a_event->category_name_len = a_msg->category_name_len;
+			a_event->level = a_msg->level;
+			a_event->time_stamp = a_msg->time_stamp;
+
+			if (zlog_rule_write(a_msg->rule, a_async->writer, path,
+				(char *)(a_msg + 1) + a_msg->path_len, a_msg->msg_len)) {
+				zc_error("async write fail");
+			}
+			n++;
+		}
+		tail += a_msg->len;
+		zc_atomic_store(&a_ring->tail, tail);
+	}
+
+	return n;
+}
+
+static int zlog_async_pending(zlog_async_t * a_async)
+{
+	zlog_async_ring_t *a_ring;
+
+	for (a_ring = a_async->rings; a_ring; a_ring = a_ring->next) {
+		if (zc_atomic_load(&a_ring->head) != a_ring->tail) return 1;
+	}
+	return 0;
+}
+
+static void *zlog_async_work(void *arg)
+{
+	size_t n;
+	struct timeval now;
+	struct timespec deadline;
+	zlog_async_ring_t *a_ring;
+	zlog_async_t *a_async = arg;
+
+	pthread_mutex_lock(&a_async->lock);
+	while (1) {
+		n = 0;
+		for (a_ring = a_async->rings; a_ring; a_ring = a_ring->next) {
+			n += zlog_async_ring_drain(a_async, a_ring);
+		}
+		a_async->passes++;
+		pthread_cond_broadcast(&a_async->pass_cond);
+
+		if (n) {
+			/* let attach, detach and flush get in between two passes */
+			pthread_mutex_unlock(&a_async->lock);
+			pthread_mutex_lock(&a_async->lock);
+			continue;
+		}
+		if (a_async->stop) break;
+
+		/* pairs with the fence in zlog_async_push(),
+		 * either producer sees idle or we see its record
+		 */
+		zc_atomic_store(&a_async->idle, 1);
+		zc_atomic_fence();
+		if (!zlog_async_pending(a_async)) {
+			gettimeofday(&now, NULL);
+			now.tv_usec += ZLOG_ASYNC_IDLE_WAIT_MS * 1000;
+			deadline.tv_sec = now.tv_sec + now.tv_usec / 1000000;
+			deadline.tv_nsec = (now.tv_usec % 1000000) * 1000;
+			pthread_cond_timedwait(&a_async->cond, &a_async->lock, &deadline);
+		}
+		zc_atomic_store(&a_async->idle, 0);
+	}
+	pthread_mutex_unlock(&a_async->lock);
+
+	return NULL;
+}
+
+/*******************************************************************************/
+zlog_async_t *zlog_async_new(size_t buf_size, int overflow)
+{
+	int rc;
+	int lock_inited = 0;
+	int cond_inited = 0;
+	int pass_cond_inited = 0;
+	zlog_async_t *a_async;
+
+	a_async = calloc(1, sizeof(zlog_async_t));
+	if (!a_async) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_async->buf_size = zlog_async_round_size(buf_size);
+	a_async->overflow = overflow;
+
+	/* the writer never formats a message, only archive paths */
+	a_async->writer = zlog_thread_new(0, MAXLEN_PATH + 1, MAXLEN_PATH + 1);
+	if (!a_async->writer) {
+		zc_error("zlog_thread_new fail");
+		goto err;
+	}
+
+	if (pthread_mutex_init(&a_async->lock, NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		goto err;
+	}
+	lock_inited = 1;
+
+	if (pthread_cond_init(&a_async->cond, NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		goto err;
+	}
+	cond_inited = 1;
+
+	if (pthread_cond_init(&a_async->pass_cond, NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		goto err;
+	}
+	pass_cond_inited = 1;
+
+	rc = pthread_create(&a_async->tid, NULL, zlog_async_work, a_async);
+	if (rc) {
+		zc_error("pthread_create fail, rc[%d]", rc);
+		goto err;
+	}
+
+	zlog_async_profile(a_async, ZC_DEBUG);
+	return a_async;
+err:
+	if (pass_cond_inited) pthread_cond_destroy(&a_async->pass_cond);
+	if (cond_inited) pthread_cond_destroy(&a_async->cond);
+	if (lock_inited) pthread_mutex_destroy(&a_async->lock);
+	if (a_async->writer) zlog_thread_del(a_async->writer);
+	free(a_async);
+	return NULL;
+}
+
+void zlog_async_del(zlog_async_t * a_async)
+{
+	zlog_async_ring_t *a_ring;
+
+	zc_assert(a_async,);
+
+	/* the writer drains all rings before it quits */
+	pthread_mutex_lock(&a_async->lock);
+	a_async->stop = 1;
+	pthread_cond_signal(&a_async->cond);
+	pthread_mutex_unlock(&a_async->lock);
+	pthread_join(a_async->tid, NULL);
+
+	/* rings belong to their threads, just forget them */
+	for (a_ring = a_async->rings; a_ring; a_ring = a_ring->next) {
+		a_async->dropped += a_ring->dropped;
+		a_ring->async = NULL;
+	}
+	if (a_async->dropped) {
+		zc_warn("async overflow dropped [%ld] msg in total", (long)a_async->dropped);
+	}
+
+	pthread_cond_destroy(&a_async->pass_cond);
+	pthread_cond_destroy(&a_async->cond);
+	pthread_mutex_destroy(&a_async->lock);
+	zlog_thread_del(a_async->writer);
+	zc_debug("zlog_async_del[%p]", a_async);
+	free(a_async);
+	return;
+}
+
+/*******************************************************************************/
+/* caller must hold a_async->lock */
+static void zlog_async_wait_pass(zlog_async_t * a_async)
+{
+	size_t target = a_async->passes + 1;
+
+	while ((long)(a_async->passes - target) < 0) {
+		pthread_cond_signal(&a_async->cond);
+		pthread_cond_wait(&a_async->pass_cond, &a_async->lock);
+	}
+	return;
+}
+
+void zlog_async_flush(zlog_async_t * a_async)
+{
+	zc_assert(a_async,);
+
+	/* the pass running now may have passed some ring,
+	 * so wait one more pass, which drains whatever is pushed before
+	 */
+	pthread_mutex_lock(&a_async->lock);
+	zlog_async_wait_pass(a_async);
+	zlog_async_wait_pass(a_async);
+	pthread_mutex_unlock(&a_async->lock);
+	return;
+}
+
+int zlog_async_update(zlog_async_t * a_async, size_t buf_size, int overflow)
+{
+	zc_assert(a_async, -1);
+
+	/* rings already in use keep their size */
+	pthread_mutex_lock(&a_async->lock);
+	a_async->buf_size = zlog_async_round_size(buf_size);
+	a_async->overflow = overflow;
+	pthread_mutex_unlock(&a_async->lock);
+	return 0;
+}
+
+/*******************************************************************************/
+int zlog_async_attach(zlog_async_t * a_async, zlog_thread_t * a_thread)
+{
+	zlog_async_ring_t *a_ring;
+
+	zc_assert(a_async, -1);
+	zc_assert(a_thread, -1);
+
+	/* a ring left by a writer which is already gone */
+	if (a_thread->async_ring) {
+		zlog_async_ring_del(a_thread->async_ring);
+		a_thread->async_ring = NULL;
+	}
+
+	pthread_mutex_lock(&a_async->lock);
+	a_ring = zlog_async_ring_new(a_async->buf_size);
+	if (!a_ring) {
+		pthread_mutex_unlock(&a_async->lock);
+		zc_error("zlog_async_ring_new fail");
+		return -1;
+	}
+	a_ring->async = a_async;
+	a_ring->next = a_async->rings;
+	if (a_async->rings) a_async->rings->prev = a_ring;
+	a_async->rings = a_ring;
+	pthread_mutex_unlock(&a_async->lock);
+
+	a_thread->async_ring = a_ring;
+	return 0;
+}
+
+void zlog_async_detach(zlog_async_t * a_async, zlog_thread_t * a_thread)
+{
+	zlog_async_ring_t *a_ring;
+
+	zc_assert(a_async,);
+	zc_assert(a_thread,);
+
+	a_ring = a_thread->async_ring;
+	if (!a_ring) return;
+
+	pthread_mutex_lock(&a_async->lock);
+	while (a_ring->tail != a_ring->head) {
+		zlog_async_wait_pass(a_async);
+	}
+	if (a_ring->prev) a_ring->prev->next = a_ring->next;
+	else a_async->rings = a_ring->next;
+	if (a_ring->next) a_ring->next->prev = a_ring->prev;
+	a_async->dropped += a_ring->dropped;
+	pthread_mutex_unlock(&a_async->lock);
+
+	zlog_async_ring_del(a_ring);
+	a_thread->async_ring = NULL;
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_async_wake(zlog_async_t * a_async)
+{
+	if (!zc_atomic_load(&a_async->idle)) return;
+
+	pthread_mutex_lock(&a_async->lock);
+	pthread_cond_signal(&a_async->cond);
+	pthread_mutex_unlock(&a_async->lock);
+	return;
+}
+
+int zlog_async_push(zlog_async_ring_t * a_ring, zlog_rule_t * a_rule,
+		zlog_thread_t * a_thread, char *path)
+{
+	size_t head;
+	size_t tail;
+	size_t pos;
+	size_t pad;
+	size_t need;
+	size_t path_len;
+	size_t msg_len;
+	zlog_async_msg_t *a_msg;
+	zlog_async_t *a_async = a_ring->async;
+
+	path_len = path ? strlen(path) + 1 : 0;
+	msg_len = zlog_buf_len(a_thread->msg_buf);
+	need = ZLOG_ASYNC_ALIGN(sizeof(zlog_async_msg_t) + path_len + msg_len);
+
+	/* a huge msg would stall the ring, write it in place */
+	if (need > a_ring->size / 2) goto sync;
+
+	while (1) {
+		head = a_ring->head;
+		tail = zc_atomic_load(&a_ring->tail);
+		pos = head & (a_ring->size - 1);
+		pad = (a_ring->size - pos < need) ? a_ring->size - pos : 0;
+		if (a_ring->size - (head - tail) >= pad + need) break;
+
+		switch (a_async->overflow) {
+		case ZLOG_ASYNC_OVERFLOW_DROP:
+			a_ring->dropped++;
+			return 0;
+		case ZLOG_ASYNC_OVERFLOW_SYNC:
+			goto sync;
+		default:
+			pthread_mutex_lock(&a_async->lock);
+			zlog_async_wait_pass(a_async);
+			pthread_mutex_unlock(&a_async->lock);
+			break;
+		}
+	}
+
+	if (pad) {
+		if (pad >= sizeof(zlog_async_msg_t)) {
+			a_msg = (zlog_async_msg_t *) (a_ring->buf + pos);
+			a_msg->rule = NULL;
+			a_msg->len = pad;
+		}
+		head += pad;
+		pos = 0;
+	}
+
+	a_msg = (zlog_async_msg_t *) (a_ring->buf + pos);
+	a_msg->rule = a_rule;
+	a_msg->len = need;
+	a_msg->path_len = path_len;
+	a_msg->msg_len = msg_len;
+	a_msg->category_name = a_thread->event->category_name;
+	a_msg->category_name_len = a_thread->event->category_name_len;
+	a_msg->level = a_thread->event->level;
+	a_msg->time_stamp = a_thread->event->time_stamp;
+	if (path_len) memcpy(a_msg + 1, path, path_len);
+	memcpy((char *)(a_msg + 1) + path_len, zlog_buf_str(a_thread->msg_buf), msg_len);
+
+	zc_atomic_store(&a_ring->head, head + need);
+	zc_atomic_fence();
+	zlog_async_wake(a_async);
+	return 0;
+
+sync:
+	/* keep the order, everything before must be written first */
+	pthread_mutex_lock(&a_async->lock);
+	while (a_ring->tail != a_ring->head) {
+		zlog_async_wait_pass(a_async);
+	}
+	pthread_mutex_unlock(&a_async->lock);
+	return zlog_rule_write(a_rule, a_thread, path, zlog_buf_str(a_thread->msg_buf), msg_len);
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file async.h
+ * @brief hand formatted messages to a writer thread
+ *
+ * Every logging thread owns one single-producer/single-consumer ring.
+ * The thread formats as before and pushes the result into its ring,
+ * one writer thread drains all rings and does the real write(),
+ * so per-thread ordering is kept and no lock is taken to push.
+ */
+
+#ifndef __zlog_async_h
+#define __zlog_async_h
+
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "rule.h"
+#include "thread.h"
+
+#define ZLOG_ASYNC_OVERFLOW_BLOCK 0
+#define ZLOG_ASYNC_OVERFLOW_DROP 1
+#define ZLOG_ASYNC_OVERFLOW_SYNC 2
+
+typedef struct zlog_async_s zlog_async_t;
+
+struct zlog_async_ring_s {
+	char *buf;
+	size_t size;    /* power of 2 */
+	size_t head;    /* only moved by the producer */
+	size_t tail;    /* only moved by the writer */
+	size_t dropped; /* only moved by the producer */
+
+	zlog_async_t *async;
+	struct zlog_async_ring_s *prev;
+	struct zlog_async_ring_s *next;
+};
+
+struct zlog_async_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;       /* wake up the writer */
+	pthread_cond_t pass_cond;  /* writer finished one pass */
+	pthread_t tid;
+	int stop;
+	int idle;
+	size_t passes;
+
+	size_t buf_size;
+	int overflow;
+	size_t dropped;  /* from rings already detached */
+
+	zlog_async_ring_t *rings;
+	zlog_thread_t *writer;  /* used by the writer thread only */
+};
+
+zlog_async_t *zlog_async_new(size_t buf_size, int overflow);
+void zlog_async_del(zlog_async_t * a_async);
+void zlog_async_profile(zlog_async_t * a_async, int flag);
+
+int zlog_async_update(zlog_async_t * a_async, size_t buf_size, int overflow);
+void zlog_async_flush(zlog_async_t * a_async);
+
+int zlog_async_attach(zlog_async_t * a_async, zlog_thread_t * a_thread);
+void zlog_async_detach(zlog_async_t * a_async, zlog_thread_t * a_thread);
+void zlog_async_ring_del(zlog_async_ring_t * a_ring);
+
+int zlog_async_push(zlog_async_ring_t * a_ring, zlog_rule_t * a_rule,
+		zlog_thread_t * a_thread, char *path);
+
+#endif
@@ -0,0 +1,280 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "zc_defs.h"
+
+void zlog_batch_profile(zlog_batch_t * a_batch, int flag)
+{
+	zc_assert(a_batch,);
+	zc_profile(flag, "---batch[%p][%ld/%ld][%ld/%ld][level:%d][msgs:%ld][writes:%ld][saved:%ld]---",
+		a_batch,
+		(long)a_batch->len,
+		(long)a_batch->size,
+		(long)a_batch->count,
+		(long)a_batch->max_count,
+		a_batch->level,
+		(long)a_batch->msgs,
+		(long)a_batch->writes,
+		(long)(a_batch->msgs - a_batch->writes));
+	return;
+}
+
+/*******************************************************************************/
+zlog_batch_t *zlog_batch_new(size_t size, size_t max_count, int level,
+		zlog_batch_write_fn write, void *arg)
+{
+	zlog_batch_t *a_batch;
+
+	zc_assert(size, NULL);
+	zc_assert(write, NULL);
+
+	a_batch = calloc(1, sizeof(zlog_batch_t));
+	if (!a_batch) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_batch->buf = malloc(size);
+	if (!a_batch->buf) {
+		zc_error("malloc fail, errno[%d]", errno);
+		free(a_batch);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&a_batch->lock, NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		free(a_batch->buf);
+		free(a_batch);
+		return NULL;
+	}
+
+	a_batch->size = size;
+	a_batch->max_count = max_count;
+	a_batch->level = level;
+	a_batch->write = write;
+	a_batch->arg = arg;
+
+	zlog_batch_profile(a_batch, ZC_DEBUG);
+	return a_batch;
+}
+
+void zlog_batch_del(zlog_batch_t * a_batch)
+{
+	zc_assert(a_batch,);
+
+	/* the fd behind write is still open here */
+	zlog_batch_flush(a_batch);
+	zlog_batch_profile(a_batch, ZC_DEBUG);
+
+	pthread_mutex_destroy(&a_batch->lock);
+	free(a_batch->buf);
+	zc_debug("zlog_batch_del[%p]", a_batch);
+	free(a_batch);
+	return;
+}
+
+/*******************************************************************************/
+/* caller holds a_batch->lock */
+static int zlog_batch_flush_locked(zlog_batch_t * a_batch)
+{
+	int rc;
+
+	if (!a_batch->len) return 0;
+
+	rc = a_batch->write(a_batch->arg, a_batch->buf, a_batch->len);
+	a_batch->writes++;
+	a_batch->len = 0;
+	a_batch->count = 0;
+	return rc;
+}
+
+int zlog_batch_flush(zlog_batch_t * a_batch)
+{
+	int rc;
+
+	zc_assert(a_batch, -1);
+
+	pthread_mutex_lock(&a_batch->lock);
+	rc = zlog_batch_flush_locked(a_batch);
+	pthread_mutex_unlock(&a_batch->lock);
+	return rc;
+}
+
+int zlog_batch_write(zlog_batch_t * a_batch, char *msg, size_t msg_len, int level)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&a_batch->lock);
+	a_batch->msgs++;
+
+	if (a_batch->len + msg_len > a_batch->size) {
+		rc = zlog_batch_flush_locked(a_batch);
+	}
+
+	/* too big to be kept, write it alone */
+	if (msg_len >= a_batch->size) {
+		if (a_batch->write(a_batch->arg, msg, msg_len)) rc = -1;
+		a_batch->writes++;
+		pthread_mutex_unlock(&a_batch->lock);
+		return rc;
+	}
+
+	if (!a_batch->count) gettimeofday(&a_batch->first, NULL);
+	memcpy(a_batch->buf + a_batch->len, msg, msg_len);
+	a_batch->len += msg_len;
+	a_batch->count++;
+
+	if (a_batch->len >= a_batch->size
+		|| (a_batch->max_count && a_batch->count >= a_batch->max_count)
+		|| (a_batch->level > 0 && level >= a_batch->level)) {
+		if (zlog_batch_flush_locked(a_batch)) rc = -1;
+	}
+
+	pthread_mutex_unlock(&a_batch->lock);
+	return rc;
+}
+
+/*******************************************************************************/
+void zlog_batch_flusher_profile(zlog_batch_flusher_t * a_flusher, int flag)
+{
+	zc_assert(a_flusher,);
+	zc_profile(flag, "---batch flusher[%p][delay:%ld][batches:%d]---",
+		a_flusher,
+		a_flusher->delay,
+		zc_arraylist_len(a_flusher->batches));
+	return;
+}
+
+static void zlog_batch_flush_idle(zlog_batch_t * a_batch, long delay, struct timeval *now)
+{
+	long waited;
+
+	pthread_mutex_lock(&a_batch->lock);
+	if (a_batch->count) {
+		waited = (now->tv_sec - a_batch->first.tv_sec) * 1000
+			+ (now->tv_usec - a_batch->first.tv_usec) / 1000;
+		if (waited >= delay && zlog_batch_flush_locked(a_batch)) {
+			zc_error("zlog_batch_flush fail");
+		}
+	}
+	pthread_mutex_unlock(&a_batch->lock);
+	return;
+}
+
+static void *zlog_batch_flusher_work(void *arg)
+{
+	int i;
+	long tick;
+	struct timeval now;
+	struct timespec deadline;
+	zlog_batch_t *a_batch;
+	zlog_batch_flusher_t *a_flusher = arg;
+
+	/* look twice a delay, so no msg waits much more than delay */
+	tick = a_flusher->delay / 2 > 0 ? a_flusher->delay / 2 : 1;
+
+	pthread_mutex_lock(&a_flusher->lock);
+	while (!a_flusher->stop) {
+		gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + tick / 1000;
+		deadline.tv_nsec = now.tv_usec * 1000 + (tick % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&a_flusher->cond, &a_flusher->lock, &deadline);
+		if (a_flusher->stop) break;
+
+		gettimeofday(&now, NULL);
+		zc_arraylist_foreach(a_flusher->batches, i, a_batch) {
+			zlog_batch_flush_idle(a_batch, a_flusher->delay, &now);
+		}
+	}
+	pthread_mutex_unlock(&a_flusher->lock);
+
+	return NULL;
+}
+
+zlog_batch_flusher_t *zlog_batch_flusher_new(long delay, zc_arraylist_t * a_batches)
+{
+	int rc;
+	zlog_batch_flusher_t *a_flusher;
+
+	zc_assert(a_batches, NULL);
+
+	a_flusher = calloc(1, sizeof(zlog_batch_flusher_t));
+	if (!a_flusher) {
+		zc_error("calloc fail, errno[%d]", errno);
+		zc_arraylist_del(a_batches);
+		return NULL;
+	}
+	a_flusher->delay = delay;
+	a_flusher->batches = a_batches;
+
+	if (pthread_mutex_init(&a_flusher->lock, NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		goto err;
+	}
+
+	if (pthread_cond_init(&a_flusher->cond, NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		pthread_mutex_destroy(&a_flusher->lock);
+		goto err;
+	}
+
+	rc = pthread_create(&a_flusher->tid, NULL, zlog_batch_flusher_work, a_flusher);
+	if (rc) {
+		zc_error("pthread_create fail, rc[%d]", rc);
+		pthread_cond_destroy(&a_flusher->cond);
+		pthread_mutex_destroy(&a_flusher->lock);
+		goto err;
+	}
+
+	zlog_batch_flusher_profile(a_flusher, ZC_DEBUG);
+	return a_flusher;
+err:
+	zc_arraylist_del(a_flusher->batches);
+	free(a_flusher);
+	return NULL;
+}
+
+void zlog_batch_flusher_del(zlog_batch_flusher_t * a_flusher)
+{
+	zc_assert(a_flusher,);
+
+	pthread_mutex_lock(&a_flusher->lock);
+	a_flusher->stop = 1;
+	pthread_cond_signal(&a_flusher->cond);
+	pthread_mutex_unlock(&a_flusher->lock);
+	pthread_join(a_flusher->tid, NULL);
+
+	/* batches belong to their rules */
+	zc_arraylist_del(a_flusher->batches);
+	pthread_cond_destroy(&a_flusher->cond);
+	pthread_mutex_destroy(&a_flusher->lock);
+	zc_debug("zlog_batch_flusher_del[%p]", a_flusher);
+	free(a_flusher);
+	return;
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file batch.h
+ * @brief coalesce msgs of one rule into fewer write()s
+ *
+ * Msgs are copied into the batch and written out with one write()
+ * when it holds size bytes or max_count msgs, when a msg of level or
+ * above comes, or when the oldest msg waited delay ms, which is
+ * watched by one flusher thread per conf.
+ * Whatever is left is written when the batch is deleted.
+ */
+
+#ifndef __zlog_batch_h
+#define __zlog_batch_h
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "zc_defs.h"
+
+typedef int (*zlog_batch_write_fn) (void *arg, char *buf, size_t len);
+
+typedef struct zlog_batch_s {
+	pthread_mutex_t lock;
+	char *buf;
+	size_t len;
+	size_t size;
+	size_t count;
+	size_t max_count;  /* 0 for no limit */
+	int level;
+	struct timeval first; /* when the oldest msg in buf came */
+
+	zlog_batch_write_fn write;
+	void *arg;
+
+	size_t msgs;   /* msgs written through the batch */
+	size_t writes; /* write()s done for them */
+} zlog_batch_t;
+
+zlog_batch_t *zlog_batch_new(size_t size, size_t max_count, int level,
+		zlog_batch_write_fn write, void *arg);
+void zlog_batch_del(zlog_batch_t * a_batch);
+void zlog_batch_profile(zlog_batch_t * a_batch, int flag);
+
+int zlog_batch_write(zlog_batch_t * a_batch, char *msg, size_t msg_len, int level);
+int zlog_batch_flush(zlog_batch_t * a_batch);
+
+typedef struct zlog_batch_flusher_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t tid;
+	int stop;
+	long delay; /* ms */
+	zc_arraylist_t *batches;
+} zlog_batch_flusher_t;
+
+/* flush batches whose oldest msg waited delay ms, a_batches is taken over */
+zlog_batch_flusher_t *zlog_batch_flusher_new(long delay, zc_arraylist_t * a_batches);
+void zlog_batch_flusher_del(zlog_batch_flusher_t * a_flusher);
+void zlog_batch_flusher_profile(zlog_batch_flusher_t * a_flusher, int flag);
+
+#endif
@@ -0,0 +1,617 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "binlog.h"
+#include "clock.h"
+#include "zc_defs.h"
+
+#define ZLOG_BINLOG_FMT_COUNT 256
+#define ZLOG_BINLOG_FMT_PROBE 16
+
+#define ZLOG_BINLOG_ARG_STAR 1    /* * of width or precision, an int */
+#define ZLOG_BINLOG_ARG_INT 2     /* d i */
+#define ZLOG_BINLOG_ARG_UINT 3    /* u o x X */
+#define ZLOG_BINLOG_ARG_CHAR 4    /* c */
+#define ZLOG_BINLOG_ARG_DOUBLE 5  /* f F e E g G a A */
+#define ZLOG_BINLOG_ARG_LDOUBLE 6 /* the same with L */
+#define ZLOG_BINLOG_ARG_STR 7     /* s */
+#define ZLOG_BINLOG_ARG_PTR 8     /* p */
+#define ZLOG_BINLOG_ARG_COUNT 9   /* n, fetched and dropped */
+#define ZLOG_BINLOG_ARG_ERRNO 10  /* m, no arg, strerror(errno) is kept */
+
+#define ZLOG_BINLOG_LEN_NONE 0
+#define ZLOG_BINLOG_LEN_HH 1
+#define ZLOG_BINLOG_LEN_H 2
+#define ZLOG_BINLOG_LEN_L 3
+#define ZLOG_BINLOG_LEN_LL 4
+#define ZLOG_BINLOG_LEN_J 5
+#define ZLOG_BINLOG_LEN_Z 6
+#define ZLOG_BINLOG_LEN_T 7
+
+void zlog_binlog_profile(zlog_binlog_t * a_binlog, int flag)
+{
+	zc_assert(a_binlog,);
+	zc_profile(flag, "---binlog[%p][seq:%ld][fmts:%ld/%ld][miss:%ld]---",
+		a_binlog,
+		(long)a_binlog->fmt_seq,
+		(long)a_binlog->fmt_used,
+		(long)a_binlog->fmt_count,
+		(long)a_binlog->fmt_miss);
+	return;
+}
+
+/*******************************************************************************/
+zlog_binlog_t *zlog_binlog_new(void)
+{
+	zlog_binlog_t *a_binlog;
+
+	a_binlog = calloc(1, sizeof(zlog_binlog_t));
+	if (!a_binlog) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	pthread_mutex_init(&a_binlog->lock, NULL);
+	a_binlog->fmt_seq = 1;
+
+	a_binlog->fmt_count = ZLOG_BINLOG_FMT_COUNT;
+	a_binlog->fmts = calloc(a_binlog->fmt_count, sizeof(zlog_binlog_fmt_t));
+	if (!a_binlog->fmts) {
+		zc_error("calloc fail, errno[%d]", errno);
+		goto err;
+	}
+
+	a_binlog->head = zlog_buf_new(1024, 0, NULL);
+	if (!a_binlog->head) {
+		zc_error("zlog_buf_new fail");
+		goto err;
+	}
+
+	zlog_binlog_profile(a_binlog, ZC_DEBUG);
+	return a_binlog;
+err:
+	zlog_binlog_del(a_binlog);
+	return NULL;
+}
+
+void zlog_binlog_del(zlog_binlog_t * a_binlog)
+{
+	size_t i;
+
+	zc_assert(a_binlog,);
+	zlog_binlog_profile(a_binlog, ZC_DEBUG);
+	if (a_binlog->fmts) {
+		for (i = 0; i < a_binlog->fmt_count; i++) {
+			free(a_binlog->fmts[i].text);
+		}
+		free(a_binlog->fmts);
+	}
+	if (a_binlog->head) zlog_buf_del(a_binlog->head);
+	pthread_mutex_destroy(&a_binlog->lock);
+	zc_debug("zlog_binlog_del[%p]", a_binlog);
+	free(a_binlog);
+	return;
+}
+
+/*******************************************************************************/
+/* walk the conversions of fmt as printf does,
+ * return the count of args, or -1 if it has something not kept in binary,
+ * as %1$d, %ls, %lc, or more than ZLOG_BINLOG_MAX_ARGS
+ */
+static int zlog_binlog_parse_fmt(const char *fmt, zlog_binlog_arg_t *args)
+{
+	const char *p;
+	int nargs = 0;
+	int length;
+	int prec;
+
+#define zlog_binlog_parse_add(a_type, a_length, a_prec) do { \
+	if (nargs >= ZLOG_BINLOG_MAX_ARGS) return -1; \
+	args[nargs].type = a_type; \
+	args[nargs].length = a_length; \
+	args[nargs].prec = a_prec; \
+	nargs++; \
+} while (0)
+
+	for (p = fmt; *p; p++) {
+		if (*p != '%') continue;
+		p++;
+		if (*p == '%') continue;
+
+		while (*p && strchr("-+ #0'", *p)) p++;
+
+		if (*p == '*') {
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_STAR, 0, -1);
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9') p++;
+			if (*p == '$') return -1;
+		}
+
+		prec = -1;
+		if (*p == '.') {
+			p++;
+			if (*p == '*') {
+				zlog_binlog_parse_add(ZLOG_BINLOG_ARG_STAR, 0, -1);
+				prec = -2;
+				p++;
+			} else {
+				prec = 0;
+				while (*p >= '0' && *p <= '9') prec = prec * 10 + (*p++ - '0');
+			}
+		}
+
+		length = ZLOG_BINLOG_LEN_NONE;
+		switch (*p) {
+		case 'h':
+			length = ZLOG_BINLOG_LEN_H;
+			if (*++p == 'h') { length = ZLOG_BINLOG_LEN_HH; p++; }
+			break;
+		case 'l':
+			length = ZLOG_BINLOG_LEN_L;
+			if (*++p == 'l') { length = ZLOG_BINLOG_LEN_LL; p++; }
+			break;
+		case 'q':
+			length = ZLOG_BINLOG_LEN_LL; p++;
+			break;
+		case 'L':
+			length = ZLOG_BINLOG_LEN_LL; p++;
+			break;
+		case 'j':
+			length = ZLOG_BINLOG_LEN_J; p++;
+			break;
+		case 'z':
+		case 'Z':
+			length = ZLOG_BINLOG_LEN_Z; p++;
+			break;
+		case 't':
+			length = ZLOG_BINLOG_LEN_T; p++;
+			break;
+		}
+
+		switch (*p) {
+		case 'd':
+		case 'i':
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_INT, length, -1);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_UINT, length, -1);
+			break;
+		case 'c':
+			if (length != ZLOG_BINLOG_LEN_NONE) return -1;
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_CHAR, length, -1);
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			/* L and ll are the same to us */
+			zlog_binlog_parse_add(length == ZLOG_BINLOG_LEN_LL ?
+				ZLOG_BINLOG_ARG_LDOUBLE : ZLOG_BINLOG_ARG_DOUBLE, length, -1);
+			break;
+		case 's':
+			if (length != ZLOG_BINLOG_LEN_NONE) return -1;
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_STR, length, prec);
+			break;
+		case 'p':
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_PTR, length, -1);
+			break;
+		case 'n':
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_COUNT, length, -1);
+			break;
+		case 'm':
+			zlog_binlog_parse_add(ZLOG_BINLOG_ARG_ERRNO, length, -1);
+			break;
+		default:
+			return -1;
+		}
+	}
+#undef zlog_binlog_parse_add
+
+	return nargs;
+}
+
+/* find or take the slot of fmt, NULL when the table has no room */
+static zlog_binlog_fmt_t *zlog_binlog_get_fmt(zlog_binlog_t * a_binlog, const char *fmt)
+{
+	size_t i;
+	size_t n;
+	const char *old;
+	zlog_binlog_fmt_t *a_fmt;
+
+	i = ((uintptr_t)fmt >> 3) * 2654435761u;
+	for (n = 0; n < ZLOG_BINLOG_FMT_PROBE; n++, i++) {
+		a_fmt = a_binlog->fmts + (i & (a_binlog->fmt_count - 1));
+
+		old = zc_atomic_load(&a_fmt->fmt);
+		if (old == fmt) return a_fmt;
+		if (old) continue;
+
+		if (zc_atomic_cas(&a_fmt->fmt, &old, fmt)) {
+			a_fmt->text = strdup(fmt);
+			a_fmt->nargs = zlog_binlog_parse_fmt(fmt, a_fmt->args);
+			/* its F goes to each file before msgs of it */
+			pthread_mutex_lock(&a_binlog->lock);
+			a_fmt->seq = a_binlog->fmt_seq + 1;
+			zc_atomic_store(&a_binlog->fmt_seq, a_fmt->seq);
+			zc_atomic_store(&a_fmt->ready, 1);
+			pthread_mutex_unlock(&a_binlog->lock);
+			zc_atomic_add(&a_binlog->fmt_used, 1);
+			return a_fmt;
+		}
+		/* lost the slot, old is who got it */
+		if (old == fmt) return a_fmt;
+	}
+
+	return NULL;
+}
+
+/*******************************************************************************/
+#define zlog_binlog_put(a_buf, a_ptr, a_len) do { \
+	if (zlog_buf_append(a_buf, (const char *)(a_ptr), a_len)) goto err; \
+} while (0)
+
+#define zlog_binlog_put_tag(a_buf, a_tag, a_value) do { \
+	char tag = a_tag; \
+	zlog_binlog_put(a_buf, &tag, 1); \
+	zlog_binlog_put(a_buf, &(a_value), sizeof(a_value)); \
+} while (0)
+
+/* type and room for the length, patched by zlog_binlog_end() */
+static int zlog_binlog_begin(zlog_buf_t * a_buf, char type)
+{
+	char head[ZLOG_BINLOG_HEAD_LEN];
+
+	memset(head, 0, sizeof(head));
+	head[0] = type;
+	return zlog_buf_append(a_buf, head, sizeof(head)) ? -1 : 0;
+}
+
+/* a_buf may be moved by resize, so the record is known by offset */
+static void zlog_binlog_end(zlog_buf_t * a_buf, size_t offset)
+{
+	uint32_t len;
+
+	len = zlog_buf_len(a_buf) - offset;
+	memcpy(a_buf->start + offset + 1, &len, sizeof(len));
+	return;
+}
+
+static int zlog_binlog_put_start(zlog_buf_t * a_buf)
+{
+	size_t offset = zlog_buf_len(a_buf);
+	uint32_t version = ZLOG_BINLOG_VERSION;
+	uint32_t pid = (uint32_t)getpid();
+	int64_t sec = (int64_t)time(NULL);
+
+	if (zlog_binlog_begin(a_buf, ZLOG_BINLOG_START)) return -1;
+	zlog_binlog_put(a_buf, ZLOG_BINLOG_MAGIC, 4);
+	zlog_binlog_put(a_buf, &version, sizeof(version));
+	zlog_binlog_put(a_buf, &pid, sizeof(pid));
+	zlog_binlog_put(a_buf, &sec, sizeof(sec));
+	zlog_binlog_end(a_buf, offset);
+	return 0;
+err:
+	return -1;
+}
+
+static int zlog_binlog_put_format(zlog_buf_t * a_buf, uint64_t ptr, const char *fmt)
+{
+	size_t offset = zlog_buf_len(a_buf);
+	uint32_t len = strlen(fmt);
+
+	if (zlog_binlog_begin(a_buf, ZLOG_BINLOG_FORMAT)) return -1;
+	zlog_binlog_put(a_buf, &ptr, sizeof(ptr));
+	zlog_binlog_put(a_buf, &len, sizeof(len));
+	zlog_binlog_put(a_buf, fmt, len);
+	zlog_binlog_end(a_buf, offset);
+	return 0;
+err:
+	return -1;
+}
+
+/* level, time and category, the same in L and H */
+static int zlog_binlog_put_event(zlog_buf_t * a_buf, zlog_event_t * a_event)
+{
+	int32_t level = a_event->level;
+	int64_t sec;
+	int32_t usec;
+	uint16_t len;
+
+	if (!a_event->time_stamp.tv_sec) zlog_clock_now(&a_event->time_stamp);
+	sec = a_event->time_stamp.tv_sec;
+	usec = a_event->time_stamp.tv_nsec / 1000;
+	len = a_event->category_name_len > 0xffff ? 0xffff : a_event->category_name_len;
+
+	zlog_binlog_put(a_buf, &level, sizeof(level));
+	zlog_binlog_put(a_buf, &sec, sizeof(sec));
+	zlog_binlog_put(a_buf, &usec, sizeof(usec));
+	zlog_binlog_put(a_buf, &len, sizeof(len));
+	zlog_binlog_put(a_buf, a_event->category_name, len);
+	return 0;
+err:
+	return -1;
+}
+
+static int zlog_binlog_put_str(zlog_buf_t * a_buf, const char *str, int prec)
+{
+	const char *q;
+	uint32_t len;
+
+	if (!str) str = "(null)";
+	if (prec >= 0) {
+		q = memchr(str, '\0', prec);
+		len = q ? (uint32_t)(q - str) : (uint32_t)prec;
+	} else {
+		len = strlen(str);
+	}
+
+	zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_STR, len);
+	zlog_binlog_put(a_buf, str, len);
+	return 0;
+err:
+	return -1;
+}
+
+static int zlog_binlog_put_args(zlog_buf_t * a_buf, zlog_binlog_fmt_t * a_fmt, va_list args)
+{
+	int i;
+	int star = -1;
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	zlog_binlog_arg_t *a_arg;
+
+	for (i = 0; i < a_fmt->nargs; i++) {
+		a_arg = a_fmt->args + i;
+		switch (a_arg->type) {
+		case ZLOG_BINLOG_ARG_STAR:
+			star = va_arg(args, int);
+			i64 = star;
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_INT, i64);
+			break;
+		case ZLOG_BINLOG_ARG_CHAR:
+			i64 = va_arg(args, int);
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_INT, i64);
+			break;
+		case ZLOG_BINLOG_ARG_INT:
+			switch (a_arg->length) {
+			case ZLOG_BINLOG_LEN_HH: i64 = (signed char)va_arg(args, int); break;
+			case ZLOG_BINLOG_LEN_H: i64 = (short)va_arg(args, int); break;
+			case ZLOG_BINLOG_LEN_L: i64 = va_arg(args, long); break;
+			case ZLOG_BINLOG_LEN_LL: i64 = va_arg(args, long long); break;
+			case ZLOG_BINLOG_LEN_J: i64 = va_arg(args, intmax_t); break;
+			case ZLOG_BINLOG_LEN_Z: i64 = (ptrdiff_t)va_arg(args, size_t); break;
+			case ZLOG_BINLOG_LEN_T: i64 = va_arg(args, ptrdiff_t); break;
+			default: i64 = va_arg(args, int); break;
+			}
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_INT, i64);
+			break;
+		case ZLOG_BINLOG_ARG_UINT:
+			switch (a_arg->length) {
+			case ZLOG_BINLOG_LEN_HH: u64 = (unsigned char)va_arg(args, unsigned int); break;
+			case ZLOG_BINLOG_LEN_H: u64 = (unsigned short)va_arg(args, unsigned int); break;
+			case ZLOG_BINLOG_LEN_L: u64 = va_arg(args, unsigned long); break;
+			case ZLOG_BINLOG_LEN_LL: u64 = va_arg(args, unsigned long long); break;
+			case ZLOG_BINLOG_LEN_J: u64 = va_arg(args, uintmax_t); break;
+			case ZLOG_BINLOG_LEN_Z: u64 = va_arg(args, size_t); break;
+			case ZLOG_BINLOG_LEN_T: u64 = (size_t)va_arg(args, ptrdiff_t); break;
+			default: u64 = va_arg(args, unsigned int); break;
+			}
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_UINT, u64);
+			break;
+		case ZLOG_BINLOG_ARG_DOUBLE:
+			d = va_arg(args, double);
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_DOUBLE, d);
+			break;
+		case ZLOG_BINLOG_ARG_LDOUBLE:
+			/* kept as double, precision beyond it is lost */
+			d = (double)va_arg(args, long double);
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_DOUBLE, d);
+			break;
+		case ZLOG_BINLOG_ARG_STR:
+			if (zlog_binlog_put_str(a_buf, va_arg(args, const char *),
+					a_arg->prec == -2 ? star : a_arg->prec)) goto err;
+			break;
+		case ZLOG_BINLOG_ARG_PTR:
+			u64 = (uintptr_t)va_arg(args, void *);
+			zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_PTR, u64);
+			break;
+		case ZLOG_BINLOG_ARG_COUNT:
+			(void)va_arg(args, void *);
+			break;
+		case ZLOG_BINLOG_ARG_ERRNO:
+			if (zlog_binlog_put_str(a_buf, strerror(errno), -1)) goto err;
+			break;
+		}
+	}
+
+	return 0;
+err:
+	return -1;
+}
+
+static int zlog_binlog_put_log(zlog_binlog_t * a_binlog, zlog_thread_t * a_thread,
+		zlog_buf_t * a_buf)
+{
+	int rc;
+	size_t offset;
+	uint64_t ptr;
+	uint32_t len;
+	va_list args;
+	zlog_binlog_fmt_t local;
+	zlog_binlog_fmt_t *a_fmt;
+	zlog_event_t *a_event = a_thread->event;
+
+	a_fmt = zlog_binlog_get_fmt(a_binlog, a_event->str_format);
+	if (!a_fmt) {
+		zc_atomic_add(&a_binlog->fmt_miss, 1);
+	} else if (!zc_atomic_load(&a_fmt->ready)) {
+		/* someone else is walking it right now */
+		a_fmt = NULL;
+	} else if (!a_fmt->text || STRCMP(a_fmt->text, !=, a_event->str_format)) {
+		/* a buffer reused for another format */
+		a_fmt = NULL;
+	}
+
+	if (a_fmt) {
+		ptr = (uintptr_t)a_event->str_format;
+	} else {
+		local.fmt = a_event->str_format;
+		local.nargs = zlog_binlog_parse_fmt(local.fmt, local.args);
+		a_fmt = &local;
+		/* its own F, not to be taken for what the pointer had */
+		ptr = ZLOG_BINLOG_FMT_LOCAL
+			| ((uint64_t)(getpid() & 0x7fffffff) << 32)
+			| zc_atomic_add(&a_binlog->local_ids, 1);
+	}
+
+	if (a_fmt->nargs < 0) {
+		/* can't be kept in binary, format it now as "%s" */
+		zlog_buf_restart(a_thread->pre_msg_buf);
+		if (zlog_buf_vprintf(a_thread->pre_msg_buf, a_event->str_format, a_event->str_args) < 0) {
+			zc_error("zlog_buf_vprintf fail");
+			return -1;
+		}
+
+		offset = zlog_buf_len(a_buf);
+		ptr = 0;
+		if (zlog_binlog_begin(a_buf, ZLOG_BINLOG_LOG)) return -1;
+		zlog_binlog_put(a_buf, &ptr, sizeof(ptr));
+		if (zlog_binlog_put_event(a_buf, a_event)) goto err;
+		len = zlog_buf_len(a_thread->pre_msg_buf);
+		zlog_binlog_put_tag(a_buf, ZLOG_BINLOG_TAG_STR, len);
+		zlog_binlog_put(a_buf, zlog_buf_str(a_thread->pre_msg_buf), len);
+		zlog_binlog_end(a_buf, offset);
+		return 0;
+	}
+
+	if (a_fmt == &local && zlog_binlog_put_format(a_buf, ptr, a_event->str_format)) return -1;
+
+	offset = zlog_buf_len(a_buf);
+	if (zlog_binlog_begin(a_buf, ZLOG_BINLOG_LOG)) return -1;
+	zlog_binlog_put(a_buf, &ptr, sizeof(ptr));
+	if (zlog_binlog_put_event(a_buf, a_event)) goto err;
+
+	/* str_args may be read again by the next rule */
+	va_copy(args, a_event->str_args);
+	rc = zlog_binlog_put_args(a_buf, a_fmt, args);
+	va_end(args);
+	if (rc) goto err;
+
+	zlog_binlog_end(a_buf, offset);
+	return 0;
+err:
+	return -1;
+}
+
+static int zlog_binlog_put_hex(zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	size_t offset;
+	uint32_t len;
+	zlog_event_t *a_event = a_thread->event;
+
+	offset = zlog_buf_len(a_buf);
+	len = a_event->hex_buf_len;
+	if (zlog_binlog_begin(a_buf, ZLOG_BINLOG_HEX)) return -1;
+	if (zlog_binlog_put_event(a_buf, a_event)) goto err;
+	zlog_binlog_put(a_buf, &len, sizeof(len));
+	zlog_binlog_put(a_buf, a_event->hex_buf, len);
+	zlog_binlog_end(a_buf, offset);
+	return 0;
+err:
+	return -1;
+}
+
+int zlog_binlog_gen_msg(zlog_binlog_t * a_binlog, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	int rc;
+
+	zlog_buf_restart(a_buf);
+
+	if (a_thread->event->generate_cmd == ZLOG_FMT) {
+		rc = zlog_binlog_put_log(a_binlog, a_thread, a_buf);
+	} else {
+		rc = zlog_binlog_put_hex(a_thread, a_buf);
+	}
+
+	if (rc) {
+		/* a cut record can't be read back, drop it whole */
+		zc_error("record longer than buf max, dropped");
+		zlog_buf_restart(a_buf);
+		return -1;
+	}
+	return 0;
+}
+
+long zlog_binlog_put_head(zlog_binlog_t * a_binlog, size_t *a_seq, int fd)
+{
+	size_t i;
+	size_t seq;
+	long len = -1;
+	zlog_binlog_fmt_t *a_fmt;
+
+	if (zc_atomic_load(a_seq) == zc_atomic_load(&a_binlog->fmt_seq)) return 0;
+
+	pthread_mutex_lock(&a_binlog->lock);
+	/* another writer of fd may just have done it */
+	seq = zc_atomic_load(a_seq);
+	if (seq == a_binlog->fmt_seq) {
+		len = 0;
+		goto exit;
+	}
+
+	zlog_buf_restart(a_binlog->head);
+	if (!seq && zlog_binlog_put_start(a_binlog->head)) goto fail;
+	for (i = 0; i < a_binlog->fmt_count; i++) {
+		a_fmt = a_binlog->fmts + i;
+		/* one not walked goes as "%s" text, no F needed */
+		if (a_fmt->seq <= seq || !a_fmt->text || a_fmt->nargs < 0) continue;
+		if (zlog_binlog_put_format(a_binlog->head, (uintptr_t)a_fmt->fmt, a_fmt->text)) goto fail;
+	}
+
+	len = zlog_buf_len(a_binlog->head);
+	if (write(fd, a_binlog->head->start, len) < 0) {
+		zc_error("write fail, errno[%d]", errno);
+		len = -1;
+		goto exit;
+	}
+	/* msgs written after this see their formats in fd */
+	zc_atomic_store(a_seq, a_binlog->fmt_seq);
+exit:
+	pthread_mutex_unlock(&a_binlog->lock);
+	return len;
+fail:
+	zc_error("no memory for the head of binlog");
+	len = -1;
+	goto exit;
+}
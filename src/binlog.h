@@ -0,0 +1,115 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file binlog.h
+ * @brief binary records instead of formatted text, for rules with option binary
+ *
+ * No vsnprintf at log time: the printf format is walked once and
+ * cached per format pointer and text, each msg copies its raw args.
+ * zlog-decode turns the records back into text later.
+ *
+ * Every file stands alone: before msgs go to a file, the writer puts
+ * S there if the file has got nothing of the rule yet, and F of every
+ * cached format the file has not got, see zlog_binlog_put_head().
+ *
+ * Every record starts with a type byte and its whole length (uint32),
+ * numbers are in the native byte order of the writer:
+ *  S  "ZLOG", version(u32), pid(u32), sec(i64)
+ *  F  fmt(u64), len(u32), format string
+ *     fmt of a cached format is its pointer;
+ *     a format walked out of the cache, as one put in a buffer which
+ *     held another before, goes in the msg before its L each time,
+ *     under a new fmt with ZLOG_BINLOG_FMT_LOCAL set;
+ *     fmt 0 is "%s", used for formats which can't be walked
+ *  L  fmt(u64), level(i32), sec(i64), usec(i32), category(u16 + bytes), args
+ *     each arg is a tag byte followed by its value:
+ *     'i' i64, 'u' u64, 'f' double, 'p' u64, 's' u32 + bytes
+ *  H  level(i32), sec(i64), usec(i32), category(u16 + bytes), len(u32), bytes
+ *     for zlog_hex()
+ */
+
+#ifndef __zlog_binlog_h
+#define __zlog_binlog_h
+
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "thread.h"
+#include "buf.h"
+
+#define ZLOG_BINLOG_MAGIC "ZLOG"
+#define ZLOG_BINLOG_VERSION 1
+
+#define ZLOG_BINLOG_START 'S'
+#define ZLOG_BINLOG_FORMAT 'F'
+#define ZLOG_BINLOG_LOG 'L'
+#define ZLOG_BINLOG_HEX 'H'
+
+#define ZLOG_BINLOG_TAG_INT 'i'
+#define ZLOG_BINLOG_TAG_UINT 'u'
+#define ZLOG_BINLOG_TAG_DOUBLE 'f'
+#define ZLOG_BINLOG_TAG_PTR 'p'
+#define ZLOG_BINLOG_TAG_STR 's'
+
+/* no pointer has it, pid << 32 and a count are under it */
+#define ZLOG_BINLOG_FMT_LOCAL (1ULL << 63)
+
+/* type byte + total length */
+#define ZLOG_BINLOG_HEAD_LEN 5
+
+#define ZLOG_BINLOG_MAX_ARGS 32
+
+/* how one va_arg is fetched */
+typedef struct {
+	int type;    /* ZLOG_BINLOG_ARG_* in binlog.c */
+	int length;  /* hh h l ll j z t as ZLOG_BINLOG_LEN_* in binlog.c */
+	int prec;    /* of %.Ns, -1 none, -2 taken from the star arg before */
+} zlog_binlog_arg_t;
+
+typedef struct {
+	const char *fmt;   /* NULL for an empty slot */
+	char *text;        /* of fmt when taken, NULL if no memory */
+	int ready;         /* text and args are filled */
+	size_t seq;        /* when it was made known, 0 before */
+	int nargs;         /* -1 when more than ZLOG_BINLOG_MAX_ARGS */
+	zlog_binlog_arg_t args[ZLOG_BINLOG_MAX_ARGS];
+} zlog_binlog_fmt_t;
+
+typedef struct zlog_binlog_s {
+	pthread_mutex_t lock; /* making formats known, and head */
+	size_t fmt_seq;    /* of the last format made known, 1 for none */
+	zlog_buf_t *head;  /* S and F records for a file */
+	size_t fmt_count;  /* power of 2 */
+	size_t fmt_used;
+	size_t fmt_miss;   /* msgs whose format found no slot */
+	uint32_t local_ids; /* count of ZLOG_BINLOG_FMT_LOCAL */
+	zlog_binlog_fmt_t *fmts;
+} zlog_binlog_t;
+
+zlog_binlog_t *zlog_binlog_new(void);
+void zlog_binlog_del(zlog_binlog_t * a_binlog);
+void zlog_binlog_profile(zlog_binlog_t * a_binlog, int flag);
+
+/* put the records of a_thread->event into a_buf */
+int zlog_binlog_gen_msg(zlog_binlog_t * a_binlog, zlog_thread_t * a_thread, zlog_buf_t * a_buf);
+
+/* write to fd what it lacks before msgs, *a_seq is what it has got,
+ * 0 for nothing, kept by the writer for each file it opens;
+ * return the bytes written, -1 if fail
+ */
+long zlog_binlog_put_head(zlog_binlog_t * a_binlog, size_t *a_seq, int fd);
+
+#endif
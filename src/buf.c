@@ -21,6 +21,7 @@
 
 #include "zc_defs.h"
 #include "buf.h"
+#include "stats.h"
 /*******************************************************************************/
 /* Author's Note
  * This buf.c is base on C99, that is, if buffer size is not enough,
@@ -150,6 +151,7 @@ static void zlog_buf_truncate(zlog_buf_t * a_buf)
 	char *p;
 	size_t len;
 
+	if (a_buf->truncations) zlog_stats_add(a_buf->truncations, 1);
 	if ((a_buf->truncate_str)[0] == '\0') return;
 	p = (a_buf->tail - a_buf->truncate_str_len);
 	if (p < a_buf->start) p = a_buf->start;
@@ -270,6 +272,108 @@ int zlog_buf_vprintf(zlog_buf_t * a_buf, const char *format, va_list args)
 	return 0;
 }
 
+/*******************************************************************************/
+/* two digits per lookup, so half the divisions of one digit a time */
+static const char zlog_buf_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char zlog_buf_hex_digits[] = "0123456789abcdef";
+
+/* write digits of ui32 backward ending at p, return the first one */
+static char *zlog_buf_dec32_backward(char *p, uint32_t ui32)
+{
+	const char *d;
+
+	while (ui32 >= 100) {
+		d = zlog_buf_digit_pairs + (ui32 % 100) * 2;
+		ui32 /= 100;
+		*--p = d[1];
+		*--p = d[0];
+	}
+	if (ui32 >= 10) {
+		d = zlog_buf_digit_pairs + ui32 * 2;
+		*--p = d[1];
+		*--p = d[0];
+	} else {
+		*--p = (char) ('0' + ui32);
+	}
+	return p;
+}
+
+static char *zlog_buf_dec64_backward(char *p, uint64_t ui64)
+{
+	uint32_t low;
+	const char *d;
+	int i;
+
+	/*
+	* To divide 64-bit numbers and to find remainders
+	* on the x86 platform gcc and icc call the libc functions
+	* [u]divdi3() and [u]moddi3(), so cut 8 digits off with one
+	* of them, and do the rest in 32 bits
+	*/
+	while (ui64 > ZLOG_MAX_UINT32_VALUE) {
+		low = (uint32_t) (ui64 % 100000000);
+		ui64 /= 100000000;
+		for (i = 0; i < 4; i++) {
+			d = zlog_buf_digit_pairs + (low % 100) * 2;
+			low /= 100;
+			*--p = d[1];
+			*--p = d[0];
+		}
+	}
+	return zlog_buf_dec32_backward(p, (uint32_t) ui64);
+}
+
+size_t zlog_buf_dec_str(char *str, uint64_t ui64)
+{
+	char tmp[ZLOG_INT64_LEN + 1];
+	char *p;
+	size_t len;
+
+	p = zlog_buf_dec64_backward(tmp + sizeof(tmp), ui64);
+	len = tmp + sizeof(tmp) - p;
+	memcpy(str, p, len);
+	return len;
+}
+
+size_t zlog_buf_hex_str(char *str, uint64_t ui64)
+{
+	char tmp[sizeof(uint64_t) * 2];
+	char *p = tmp + sizeof(tmp);
+	size_t len;
+
+	do {
+		*--p = zlog_buf_hex_digits[ui64 & 0xf];
+	} while (ui64 >>= 4);
+	len = tmp + sizeof(tmp) - p;
+	memcpy(str, p, len);
+	return len;
+}
+
+void zlog_buf_dec_fixed(char *str, uint32_t ui32, int width)
+{
+	const char *d;
+
+	while (width >= 2) {
+		d = zlog_buf_digit_pairs + (ui32 % 100) * 2;
+		ui32 /= 100;
+		str[--width] = d[1];
+		str[--width] = d[0];
+	}
+	if (width) str[0] = (char) ('0' + ui32 % 10);
+	return;
+}
+
 /*******************************************************************************/
 /* if width > num_len, 0 padding, else output num */
 int zlog_buf_printf_dec32(zlog_buf_t * a_buf, uint32_t ui32, int width)
@@ -284,10 +388,7 @@ int zlog_buf_printf_dec32(zlog_buf_t * a_buf, uint32_t ui32, int width)
 		return -1;
 	}
 
-	p = tmp + ZLOG_INT32_LEN;
-	do {
-		*--p = (unsigned char) (ui32 % 10 + '0');
-	} while (ui32 /= 10);
+	p = (unsigned char *) zlog_buf_dec32_backward((char *) tmp + ZLOG_INT32_LEN, ui32);
 
 	/* zero or space padding */
 	num_len = (tmp + ZLOG_INT32_LEN) - p;
@@ -343,41 +444,13 @@ int zlog_buf_printf_dec64(zlog_buf_t * a_buf, uint64_t ui64, int width)
 	char *q;
 	unsigned char tmp[ZLOG_INT64_LEN + 1];
 	size_t num_len, zero_len, out_len;
-	uint32_t ui32;
 
 	if (!a_buf->start) {
 		zc_error("pre-use of zlog_buf_resize fail, so can't convert");
 		return -1;
 	}
 
-	p = tmp + ZLOG_INT64_LEN;
-	if (ui64 <= ZLOG_MAX_UINT32_VALUE) {
-		/*
-		* To divide 64-bit numbers and to find remainders
-		* on the x86 platform gcc and icc call the libc functions
-		* [u]divdi3() and [u]moddi3(), they call another function
-		* in its turn.  On FreeBSD it is the qdivrem() function,
-		* its source code is about 170 lines of the code.
-		* The glibc counterpart is about 150 lines of the code.
-		*
-		* For 32-bit numbers and some divisors gcc and icc use
-		* a inlined multiplication and shifts.  For example,
-		* unsigned "i32 / 10" is compiled to
-		*
-		*     (i32 * 0xCCCCCCCD) >> 35
-		*/
-
-		ui32 = (uint32_t) ui64;
-
-		do {
-			*--p = (unsigned char) (ui32 % 10 + '0');
-		} while (ui32 /= 10);
-
-	} else {
-		do {
-			*--p = (unsigned char) (ui64 % 10 + '0');
-		} while (ui64 /= 10);
-	}
+	p = (unsigned char *) zlog_buf_dec64_backward((char *) tmp + ZLOG_INT64_LEN, ui64);
 
 
 	/* zero or space padding */
@@ -508,6 +581,23 @@ int zlog_buf_printf_hex(zlog_buf_t * a_buf, uint32_t ui32, int width)
 	return 0;
 }
 
+/*******************************************************************************/
+/* make room for len more bytes, so they can be written at tail directly
+ * return 0:	success
+ * return <0:	fail
+ * return >0:	by conf limit, can't extend size that much
+ */
+int zlog_buf_reserve(zlog_buf_t * a_buf, size_t len)
+{
+	if (!a_buf->start) {
+		zc_error("pre-use of zlog_buf_resize fail, so can't convert");
+		return -1;
+	}
+
+	if (a_buf->tail + len <= a_buf->end) return 0;
+	return zlog_buf_resize(a_buf, len - (a_buf->end - a_buf->tail));
+}
+
 /*******************************************************************************/
 int zlog_buf_append(zlog_buf_t * a_buf, const char *str, size_t str_len)
 {
@@ -37,6 +37,7 @@ typedef struct zlog_buf_s {
 
 	char truncate_str[MAXLEN_PATH + 1];
 	size_t truncate_str_len;
+	unsigned long long *truncations; /* counted there if set */
 } zlog_buf_t;
 
 
@@ -51,6 +52,13 @@ int zlog_buf_adjust_append(zlog_buf_t * a_buf, const char *str, size_t str_len,
 int zlog_buf_printf_dec32(zlog_buf_t * a_buf, uint32_t ui32, int width);
 int zlog_buf_printf_dec64(zlog_buf_t * a_buf, uint64_t ui64, int width);
 int zlog_buf_printf_hex(zlog_buf_t * a_buf, uint32_t ui32, int width);
+int zlog_buf_reserve(zlog_buf_t * a_buf, size_t len);
+
+/* digits at str without '\0', return how many, str needs ZLOG_INT64_LEN */
+size_t zlog_buf_dec_str(char *str, uint64_t ui64);
+size_t zlog_buf_hex_str(char *str, uint64_t ui64);
+/* width digits, zero padded, higher digits dropped */
+void zlog_buf_dec_fixed(char *str, uint32_t ui32, int width);
 
 #define zlog_buf_restart(a_buf) do { \
 	a_buf->tail = a_buf->start; \
@@ -19,6 +19,7 @@
 
 #include "category.h"
 #include "rule.h"
+#include "trace.h"
 #include "zc_defs.h"
 
 void zlog_category_profile(zlog_category_t *a_category, int flag)
@@ -44,6 +45,7 @@ void zlog_category_del(zlog_category_t * a_category)
 {
 	zc_assert(a_category,);
 	if (a_category->fit_rules) zc_arraylist_del(a_category->fit_rules);
+	zlog_stats_id_del(&a_category->stats_id, ZLOG_STATS_CATEGORY);
 	zc_debug("zlog_category_del[%p]", a_category);
     free(a_category);
 	return;
@@ -53,78 +55,57 @@ void zlog_category_del(zlog_category_t * a_category)
  * so category can judge whether a log level will be output by itself
  * It is safe when configure is reloaded, when rule will be released an recreated
  */
-static void zlog_cateogry_overlap_bitmap(zlog_category_t * a_category, zlog_rule_t *a_rule)
+static void zlog_cateogry_overlap_bitmap(unsigned char *level_bitmap, zlog_rule_t *a_rule)
 {
 	int i;
 	for(i = 0; i < sizeof(a_rule->level_bitmap); i++) {
-		a_category->level_bitmap[i] |= a_rule->level_bitmap[i];
+		level_bitmap[i] |= a_rule->level_bitmap[i];
 	}
 }
 
-static int zlog_category_obtain_rules(zlog_category_t * a_category, zc_arraylist_t * rules)
+/* readers never take a lock, so build the list aside and publish it at once,
+ * the list it replaces is left to the caller
+ */
+static int zlog_category_obtain_rules(zlog_category_t * a_category, zlog_rule_trie_t * rule_trie)
 {
 	int i;
-	int count = 0;
-	int fit = 0;
 	zlog_rule_t *a_rule;
-	zlog_rule_t *wastebin_rule = NULL;
-
-	/* before set, clean last fit rules first */
-	if (a_category->fit_rules) zc_arraylist_del(a_category->fit_rules);
+	zc_arraylist_t *fit_rules;
+	unsigned char level_bitmap[sizeof(a_category->level_bitmap)];
 
-	memset(a_category->level_bitmap, 0x00, sizeof(a_category->level_bitmap));
+	memset(level_bitmap, 0x00, sizeof(level_bitmap));
 
-	a_category->fit_rules = zc_arraylist_new(NULL);
-	if (!(a_category->fit_rules)) {
+	fit_rules = zc_arraylist_new(NULL);
+	if (!fit_rules) {
 		zc_error("zc_arraylist_new fail");
 		return -1;
 	}
 
-	/* get match rules from all rules */
-	zc_arraylist_foreach(rules, i, a_rule) {
-		fit = zlog_rule_match_category(a_rule, a_category->name);
-		if (fit) {
-			if (zc_arraylist_add(a_category->fit_rules, a_rule)) {
-				zc_error("zc_arrylist_add fail");
-				goto err;
-			}
-			zlog_cateogry_overlap_bitmap(a_category, a_rule);
-			count++;
-		}
-
-		if (zlog_rule_is_wastebin(a_rule)) {
-			wastebin_rule = a_rule;
-		}
+	/* get match rules, or the wastebin rule, by the category name */
+	if (zlog_rule_trie_match(rule_trie, a_category->name, fit_rules)) {
+		zc_error("zlog_rule_trie_match fail");
+		goto err;
 	}
 
-	if (count == 0) {
-		if (wastebin_rule) {
-			zc_debug("category[%s], no match rules, use wastebin_rule", a_category->name);
-			if (zc_arraylist_add(a_category->fit_rules, wastebin_rule)) {
-				zc_error("zc_arrylist_add fail");
-				goto err;
-			}
-			zlog_cateogry_overlap_bitmap(a_category, wastebin_rule);
-			count++;
-		} else {
-			zc_debug("category[%s], no match rules & no wastebin_rule", a_category->name);
-		}
+	zc_arraylist_foreach(fit_rules, i, a_rule) {
+		zlog_cateogry_overlap_bitmap(level_bitmap, a_rule);
 	}
 
+	memcpy(a_category->level_bitmap, level_bitmap, sizeof(a_category->level_bitmap));
+	zc_atomic_store(&a_category->fit_rules, fit_rules);
 	return 0;
 err:
-	zc_arraylist_del(a_category->fit_rules);
-	a_category->fit_rules = NULL;
+	zc_arraylist_del(fit_rules);
 	return -1;
 }
 
-zlog_category_t *zlog_category_new(const char *name, zc_arraylist_t * rules)
+zlog_category_t *zlog_category_new(const char *name, zlog_rule_trie_t * rule_trie)
 {
 	size_t len;
 	zlog_category_t *a_category;
 
 	zc_assert(name, NULL);
-	zc_assert(rules, NULL);
+	zc_assert(rule_trie, NULL);
 
 	len = strlen(name);
 	if (len > sizeof(a_category->name) - 1) {
@@ -138,7 +119,8 @@ zlog_category_t *zlog_category_new(const char *name, zc_arraylist_t * rules)
 	}
 	strcpy(a_category->name, name);
 	a_category->name_len = len;
-	if (zlog_category_obtain_rules(a_category, rules)) {
+	zlog_stats_id_new(&a_category->stats_id, ZLOG_STATS_CATEGORY);
+	if (zlog_category_obtain_rules(a_category, rule_trie)) {
 		zc_error("zlog_category_fit_rules fail");
 		goto err;
 	}
@@ -150,25 +132,23 @@ err:
 	return NULL;
 }
 /*******************************************************************************/
-/* update success: fit_rules 1, fit_rules_backup 1 */
-/* update fail: fit_rules 0, fit_rules_backup 1 */
-int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules)
+/* update success: fit_rules new, fit_rules_backup old */
+/* update fail: fit_rules old, fit_rules_backup old */
+int zlog_category_update_rules(zlog_category_t * a_category, zlog_rule_trie_t * new_rule_trie)
 {
 	zc_assert(a_category, -1);
-	zc_assert(new_rules, -1);
+	zc_assert(new_rule_trie, -1);
 
-	/* 1st, mv fit_rules fit_rules_backup */
+	/* 1st, keep fit_rules in fit_rules_backup, readers may still use it */
 	if (a_category->fit_rules_backup) zc_arraylist_del(a_category->fit_rules_backup);
 	a_category->fit_rules_backup = a_category->fit_rules;
-	a_category->fit_rules = NULL;
 
 	memcpy(a_category->level_bitmap_backup, a_category->level_bitmap,
 			sizeof(a_category->level_bitmap));
 	
-	/* 2nd, obtain new_rules to fit_rules */
-	if (zlog_category_obtain_rules(a_category, new_rules)) {
+	/* 2nd, obtain new rules to fit_rules */
+	if (zlog_category_obtain_rules(a_category, new_rule_trie)) {
 		zc_error("zlog_category_obtain_rules fail");
-		a_category->fit_rules = NULL;
 		return -1;
 	}
 
@@ -176,6 +156,7 @@ int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * ne
 	return 0;
 }
 
+/* the caller must make sure no reader still uses fit_rules_backup */
 /* commit fail: fit_rules_backup != 0 */
 /* commit success: fit_rules 1, fit_rules_backup 0 */
 void zlog_category_commit_rules(zlog_category_t * a_category)
@@ -194,31 +175,32 @@ void zlog_category_commit_rules(zlog_category_t * a_category)
 }
 
 /* rollback fail: fit_rules_backup != 0 */
-/* rollback success: fit_rules 1, fit_rules_backup 0 */
-/* so whether update succes or not, make things back to old */
+/* rollback success: fit_rules old, fit_rules_backup new or 0 */
+/* so whether update succes or not, make things back to old,
+ * the new rules are left in fit_rules_backup for commit to free
+ */
 void zlog_category_rollback_rules(zlog_category_t * a_category)
 {
+	zc_arraylist_t *fit_rules;
+
 	zc_assert(a_category,);
 	if (!a_category->fit_rules_backup) {
 		zc_warn("a_category->fit_rules_backup in NULL, never update before");
 		return;
 	}
 
-	if (a_category->fit_rules) {
-		/* update success, rm new and backup */
-		zc_arraylist_del(a_category->fit_rules);
-		a_category->fit_rules = a_category->fit_rules_backup;
-		a_category->fit_rules_backup = NULL;
+	if (a_category->fit_rules != a_category->fit_rules_backup) {
+		/* update success, swap new and backup */
+		fit_rules = a_category->fit_rules;
+		zc_atomic_store(&a_category->fit_rules, a_category->fit_rules_backup);
+		a_category->fit_rules_backup = fit_rules;
 	} else {
-		/* update fail, just backup */
-		a_category->fit_rules = a_category->fit_rules_backup;
+		/* update fail, fit_rules is still the old one */
 		a_category->fit_rules_backup = NULL;
 	}
 
 	memcpy(a_category->level_bitmap, a_category->level_bitmap_backup,
 			sizeof(a_category->level_bitmap));
-	memset(a_category->level_bitmap_backup, 0x00,
-			sizeof(a_category->level_bitmap_backup));
 	
 	return; /* always success */
 }
@@ -230,10 +212,32 @@ int zlog_category_output(zlog_category_t * a_category, zlog_thread_t * a_thread)
 	int i;
 	int rc = 0;
 	zlog_rule_t *a_rule;
+	zc_arraylist_t *fit_rules;
+	unsigned long long start = 0;
+	unsigned long long ns;
+	zlog_stats_category_counter_t *a_counter;
+
+	if (zlog_stats_enabled) start = zlog_stats_now();
+
+	/* zlog_reload() may publish new fit_rules meanwhile, stay on one list */
+	fit_rules = zc_atomic_load(&a_category->fit_rules);
 
 	/* go through all match rules to output */
-	zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
+	zc_arraylist_foreach(fit_rules, i, a_rule) {
+		ZLOG_TRACE2(rule_entry, a_rule->category, a_rule->file_path);
 		rc = zlog_rule_output(a_rule, a_thread);
+		ZLOG_TRACE1(rule_return, rc);
+	}
+
+	if (start) {
+		ns = zlog_stats_now() - start;
+		zlog_stats_add(&a_thread->stats.emitted[a_thread->event->level & 0xff], 1);
+		zlog_stats_add(&a_thread->stats.output_ns, ns);
+		a_counter = zlog_stats_category(&a_thread->stats, &a_category->stats_id);
+		if (a_counter) {
+			zlog_stats_add(&a_counter->msgs, 1);
+			zlog_stats_add(&a_counter->output_ns, ns);
+		}
 	}
 
 	return rc;
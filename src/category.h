@@ -18,6 +18,8 @@
 
 #include "zc_defs.h"
 #include "thread.h"
+#include "rule_trie.h"
+#include "stats.h"
 
 typedef struct zlog_category_s {
 	char name[MAXLEN_PATH + 1];
@@ -26,13 +28,14 @@ typedef struct zlog_category_s {
 	unsigned char level_bitmap_backup[32];
 	zc_arraylist_t *fit_rules;
 	zc_arraylist_t *fit_rules_backup;
+	zlog_stats_id_t stats_id;
 } zlog_category_t;
 
-zlog_category_t *zlog_category_new(const char *name, zc_arraylist_t * rules);
+zlog_category_t *zlog_category_new(const char *name, zlog_rule_trie_t * rule_trie);
 void zlog_category_del(zlog_category_t * a_category);
 void zlog_category_profile(zlog_category_t *a_category, int flag);
 
-int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules);
+int zlog_category_update_rules(zlog_category_t * a_category, zlog_rule_trie_t * new_rule_trie);
 void zlog_category_commit_rules(zlog_category_t * a_category);
 void zlog_category_rollback_rules(zlog_category_t * a_category);
 
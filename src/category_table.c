@@ -20,56 +20,94 @@
 #include "zc_defs.h"
 #include "category_table.h"
 
-void zlog_category_table_profile(zc_hashtable_t * categories, int flag)
+/* start with 64 slots, grow at half full */
+#define ZLOG_CATEGORY_TABLE_SLOTS 64
+
+/* called by writers only, who see the newest slots */
+#define zlog_category_table_foreach(categories, i, a_category) \
+	for (i = 0; i <= (categories)->slots->mask; i++) \
+		if (((a_category) = (categories)->slots->slot[i].category) != NULL)
+
+void zlog_category_table_profile(zlog_category_table_t * categories, int flag)
 {
-	zc_hashtable_entry_t *a_entry;
+	size_t i;
 	zlog_category_t *a_category;
 
 	zc_assert(categories,);
-	zc_profile(flag, "-category_table[%p]-", categories);
-	zc_hashtable_foreach(categories, a_entry) {
-		a_category = (zlog_category_t *) a_entry->value;
+	zc_profile(flag, "-category_table[%p][%ld/%ld]-", categories,
+		(long)categories->count, (long)categories->slots->mask + 1);
+	zlog_category_table_foreach(categories, i, a_category) {
 		zlog_category_profile(a_category, flag);
 	}
 	return;
 }
 
 /*******************************************************************************/
+static zlog_category_slots_t *zlog_category_slots_new(size_t count)
+{
+	zlog_category_slots_t *a_slots;
 
-void zlog_category_table_del(zc_hashtable_t * categories)
+	a_slots = calloc(1, sizeof(zlog_category_slots_t)
+			+ (count - 1) * sizeof(zlog_category_slot_t));
+	if (!a_slots) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_slots->mask = count - 1;
+	return a_slots;
+}
+
+void zlog_category_table_del(zlog_category_table_t * categories)
 {
+	size_t i;
+	zlog_category_t *a_category;
+	zlog_category_slots_t *a_slots;
+	zlog_category_slots_t *next;
+
 	zc_assert(categories,);
-	zc_hashtable_del(categories);
+	if (categories->slots) {
+		zlog_category_table_foreach(categories, i, a_category) {
+			zlog_category_del(a_category);
+		}
+	}
+	for (a_slots = categories->slots; a_slots; a_slots = next) {
+		next = a_slots->retired;
+		free(a_slots);
+	}
 	zc_debug("zlog_category_table_del[%p]", categories);
+	free(categories);
 	return;
 }
 
-zc_hashtable_t *zlog_category_table_new(void)
+zlog_category_table_t *zlog_category_table_new(void)
 {
-	zc_hashtable_t *categories;
+	zlog_category_table_t *categories;
 
-	categories = zc_hashtable_new(20,
-			 (zc_hashtable_hash_fn) zc_hashtable_str_hash,
-			 (zc_hashtable_equal_fn) zc_hashtable_str_equal,
-			 NULL, (zc_hashtable_del_fn) zlog_category_del);
+	categories = calloc(1, sizeof(zlog_category_table_t));
 	if (!categories) {
-		zc_error("zc_hashtable_new fail");
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	categories->slots = zlog_category_slots_new(ZLOG_CATEGORY_TABLE_SLOTS);
+	if (!categories->slots) {
+		zc_error("zlog_category_slots_new fail");
+		zlog_category_table_del(categories);
 		return NULL;
-	} else {
-		zlog_category_table_profile(categories, ZC_DEBUG);
-		return categories;
 	}
+
+	zlog_category_table_profile(categories, ZC_DEBUG);
+	return categories;
 }
 /*******************************************************************************/
-int zlog_category_table_update_rules(zc_hashtable_t * categories, zc_arraylist_t * new_rules)
+int zlog_category_table_update_rules(zlog_category_table_t * categories, zlog_rule_trie_t * new_rule_trie)
 {
-	zc_hashtable_entry_t *a_entry;
+	size_t i;
 	zlog_category_t *a_category;
 
 	zc_assert(categories, -1);
-	zc_hashtable_foreach(categories, a_entry) {
-		a_category = (zlog_category_t *) a_entry->value;
-		if (zlog_category_update_rules(a_category, new_rules)) {
+	zlog_category_table_foreach(categories, i, a_category) {
+		if (zlog_category_update_rules(a_category, new_rule_trie)) {
 			zc_error("zlog_category_update_rules fail, try rollback");
 			return -1;
 		}
@@ -77,60 +115,120 @@ int zlog_category_table_update_rules(zc_hashtable_t * categories, zc_arraylist_t
 	return 0;
 }
 
-void zlog_category_table_commit_rules(zc_hashtable_t * categories)
+void zlog_category_table_commit_rules(zlog_category_table_t * categories)
 {
-	zc_hashtable_entry_t *a_entry;
+	size_t i;
 	zlog_category_t *a_category;
 
 	zc_assert(categories,);
-	zc_hashtable_foreach(categories, a_entry) {
-		a_category = (zlog_category_t *) a_entry->value;
+	zlog_category_table_foreach(categories, i, a_category) {
 		zlog_category_commit_rules(a_category);
 	}
 	return;
 }
 
-void zlog_category_table_rollback_rules(zc_hashtable_t * categories)
+void zlog_category_table_rollback_rules(zlog_category_table_t * categories)
 {
-	zc_hashtable_entry_t *a_entry;
+	size_t i;
 	zlog_category_t *a_category;
 
 	zc_assert(categories,);
-	zc_hashtable_foreach(categories, a_entry) {
-		a_category = (zlog_category_t *) a_entry->value;
+	zlog_category_table_foreach(categories, i, a_category) {
 		zlog_category_rollback_rules(a_category);
 	}
 	return;
 }
 
 /*******************************************************************************/
-zlog_category_t *zlog_category_table_fetch_category(zc_hashtable_t * categories,
-			const char *category_name, zc_arraylist_t * rules)
+static zlog_category_t *zlog_category_slots_find(zlog_category_slots_t * a_slots,
+			const char *category_name, unsigned int hash)
+{
+	size_t i;
+	zlog_category_t *a_category;
+
+	for (i = hash & a_slots->mask; ; i = (i + 1) & a_slots->mask) {
+		a_category = zc_atomic_load(&a_slots->slot[i].category);
+		if (!a_category) return NULL;
+		if (a_slots->slot[i].hash == hash && STRCMP(a_category->name, ==, category_name)) {
+			return a_category;
+		}
+	}
+}
+
+/* hash is stored before the category is published */
+static void zlog_category_slots_put(zlog_category_slots_t * a_slots,
+			zlog_category_t * a_category, unsigned int hash)
+{
+	size_t i;
+
+	for (i = hash & a_slots->mask; a_slots->slot[i].category; i = (i + 1) & a_slots->mask);
+	a_slots->slot[i].hash = hash;
+	zc_atomic_store(&a_slots->slot[i].category, a_category);
+	return;
+}
+
+zlog_category_t *zlog_category_table_get(zlog_category_table_t * categories,
+			const char *category_name)
+{
+	zlog_category_slots_t *a_slots;
+
+	a_slots = zc_atomic_load(&categories->slots);
+	return zlog_category_slots_find(a_slots, category_name,
+			zc_hashtable_str_hash(category_name));
+}
+
+/* copy into twice the slots, the old ones stay for readers on them */
+static int zlog_category_table_grow(zlog_category_table_t * categories)
+{
+	size_t i;
+	zlog_category_slots_t *old_slots = categories->slots;
+	zlog_category_slots_t *new_slots;
+
+	new_slots = zlog_category_slots_new((old_slots->mask + 1) * 2);
+	if (!new_slots) {
+		zc_error("zlog_category_slots_new fail");
+		return -1;
+	}
+
+	for (i = 0; i <= old_slots->mask; i++) {
+		if (!old_slots->slot[i].category) continue;
+		zlog_category_slots_put(new_slots, old_slots->slot[i].category,
+				old_slots->slot[i].hash);
+	}
+	new_slots->retired = old_slots;
+	zc_atomic_store(&categories->slots, new_slots);
+	return 0;
+}
+
+zlog_category_t *zlog_category_table_fetch_category(zlog_category_table_t * categories,
+			const char *category_name, zlog_rule_trie_t * rule_trie)
 {
 	zlog_category_t *a_category;
+	unsigned int hash;
 
 	zc_assert(categories, NULL);
 
 	/* 1st find category in global category map */
-	a_category = zc_hashtable_get(categories, category_name);
+	hash = zc_hashtable_str_hash(category_name);
+	a_category = zlog_category_slots_find(categories->slots, category_name, hash);
 	if (a_category) return a_category;
 
 	/* else not found, create one */
-	a_category = zlog_category_new(category_name, rules);
-	if (!a_category) {
-		zc_error("zc_category_new fail");
+	if ((categories->count + 1) * 2 > categories->slots->mask + 1
+		&& zlog_category_table_grow(categories)) {
+		zc_error("zlog_category_table_grow fail");
 		return NULL;
 	}
 
-	if(zc_hashtable_put(categories, a_category->name, a_category)) {
-		zc_error("zc_hashtable_put fail");
-		goto err;
+	a_category = zlog_category_new(category_name, rule_trie);
+	if (!a_category) {
+		zc_error("zc_category_new fail");
+		return NULL;
 	}
 
+	zlog_category_slots_put(categories->slots, a_category, hash);
+	categories->count++;
 	return a_category;
-err:
-	zlog_category_del(a_category);
-	return NULL;
 }
 
 /*******************************************************************************/
@@ -13,23 +13,56 @@
  * limitations under the License.
  */
 
+/**
+ * @file category_table.h
+ * @brief all categories got by zlog_get_category, by name
+ *
+ * Open addressing, each slot keeps the hash of the name beside the
+ * category. Slots are filled, and the slot array is swapped for a
+ * bigger one, only by a writer holding zlog_env_lock, and a category
+ * is published last with an atomic store. So zlog_category_table_get()
+ * needs no lock, a reader may miss a category being added and then
+ * goes the locked way. Replaced slot arrays are kept until the table
+ * is deleted, as a reader may still be on one.
+ */
+
 #ifndef __zlog_category_table_h
 #define __zlog_category_table_h
 
 #include "zc_defs.h"
 #include "category.h"
 
-zc_hashtable_t *zlog_category_table_new(void);
-void zlog_category_table_del(zc_hashtable_t * categories);
-void zlog_category_table_profile(zc_hashtable_t * categories, int flag);
+typedef struct {
+	unsigned int hash;
+	zlog_category_t *category;
+} zlog_category_slot_t;
+
+typedef struct zlog_category_slots_s {
+	size_t mask;  /* slot count - 1 */
+	struct zlog_category_slots_s *retired;
+	zlog_category_slot_t slot[1];
+} zlog_category_slots_t;
+
+typedef struct {
+	zlog_category_slots_t *slots;
+	size_t count;
+} zlog_category_table_t;
+
+zlog_category_table_t *zlog_category_table_new(void);
+void zlog_category_table_del(zlog_category_table_t * categories);
+void zlog_category_table_profile(zlog_category_table_t * categories, int flag);
+
+/* lock free, NULL if not there (yet) */
+zlog_category_t *zlog_category_table_get(zlog_category_table_t * categories,
+			const char *category_name);
 
-/* if none, create new and return */
+/* if none, create new and return, under the wrlock */
 zlog_category_t *zlog_category_table_fetch_category(
-			zc_hashtable_t * categories,
-		 	const char *category_name, zc_arraylist_t * rules);
+			zlog_category_table_t * categories,
+		 	const char *category_name, zlog_rule_trie_t * rule_trie);
 
-int zlog_category_table_update_rules(zc_hashtable_t * categories, zc_arraylist_t * new_rules);
-void zlog_category_table_commit_rules(zc_hashtable_t * categories);
-void zlog_category_table_rollback_rules(zc_hashtable_t * categories);
+int zlog_category_table_update_rules(zlog_category_table_t * categories, zlog_rule_trie_t * new_rule_trie);
+void zlog_category_table_commit_rules(zlog_category_table_t * categories);
+void zlog_category_table_rollback_rules(zlog_category_table_t * categories);
 
 #endif
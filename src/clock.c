@@ -0,0 +1,190 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "clock.h"
+#include "zc_defs.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ZLOG_CLOCK_HAS_TSC
+#endif
+
+#define ZLOG_CLOCK_NS 1000000000LL
+#define ZLOG_CLOCK_CALIBRATE_MS 10
+
+static int zlog_clock_source = ZLOG_CLOCK_REALTIME;
+
+#ifdef ZLOG_CLOCK_HAS_TSC
+/* realtime ns at tsc, rewritten under seq once a second */
+static struct {
+	size_t seq;
+	uint64_t tsc;
+	int64_t ns;
+	double ns_per_tick;
+	uint64_t ticks_per_sec;
+} zlog_clock_anchor;
+
+static int64_t zlog_clock_realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * ZLOG_CLOCK_NS + ts.tv_nsec;
+}
+
+/* cpuid 0x80000007 edx bit 8, tsc ticks at the same rate in all states */
+static int zlog_clock_tsc_invariant(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return 0;
+	return (edx >> 8) & 1;
+}
+
+static int zlog_clock_tsc_calibrate(void)
+{
+	uint64_t tsc0, tsc1;
+	int64_t ns0, ns1;
+	struct timespec wait;
+
+	if (!zlog_clock_tsc_invariant()) {
+		zc_warn("tsc is not invariant here, use realtime clock");
+		return -1;
+	}
+
+	ns0 = zlog_clock_realtime_ns();
+	tsc0 = __builtin_ia32_rdtsc();
+	wait.tv_sec = 0;
+	wait.tv_nsec = ZLOG_CLOCK_CALIBRATE_MS * 1000000L;
+	while (nanosleep(&wait, &wait) && errno == EINTR);
+	ns1 = zlog_clock_realtime_ns();
+	tsc1 = __builtin_ia32_rdtsc();
+
+	if (tsc1 <= tsc0 || ns1 <= ns0) {
+		zc_warn("tsc calibration fail, use realtime clock");
+		return -1;
+	}
+
+	zlog_clock_anchor.ns_per_tick = (double)(ns1 - ns0) / (double)(tsc1 - tsc0);
+	zlog_clock_anchor.ticks_per_sec = (uint64_t)(ZLOG_CLOCK_NS / zlog_clock_anchor.ns_per_tick);
+	zlog_clock_anchor.tsc = tsc1;
+	zlog_clock_anchor.ns = ns1;
+	zc_debug("tsc ns_per_tick[%f]", zlog_clock_anchor.ns_per_tick);
+	return 0;
+}
+
+/* take realtime again, and the rate over the whole second since */
+static void zlog_clock_tsc_reanchor(size_t seq)
+{
+	uint64_t tsc;
+	int64_t ns;
+
+	if (!zc_atomic_cas(&zlog_clock_anchor.seq, &seq, seq + 1)) return;
+
+	ns = zlog_clock_realtime_ns();
+	tsc = __builtin_ia32_rdtsc();
+	if (tsc > zlog_clock_anchor.tsc && ns > zlog_clock_anchor.ns) {
+		zlog_clock_anchor.ns_per_tick = (double)(ns - zlog_clock_anchor.ns)
+			/ (double)(tsc - zlog_clock_anchor.tsc);
+	}
+	zlog_clock_anchor.tsc = tsc;
+	zlog_clock_anchor.ns = ns;
+	zc_atomic_store(&zlog_clock_anchor.seq, seq + 2);
+	return;
+}
+
+static int zlog_clock_tsc_now(struct timespec *ts)
+{
+	size_t seq;
+	uint64_t delta;
+	int64_t ns;
+
+	seq = zc_atomic_load(&zlog_clock_anchor.seq);
+	if (seq & 1) return -1;
+
+	delta = __builtin_ia32_rdtsc() - zlog_clock_anchor.tsc;
+	ns = zlog_clock_anchor.ns + (int64_t)((double)delta * zlog_clock_anchor.ns_per_tick);
+	zc_atomic_fence();
+	if (zc_atomic_load(&zlog_clock_anchor.seq) != seq) return -1;
+
+	/* also catches a tsc behind the anchor, as delta is unsigned */
+	if (delta > zlog_clock_anchor.ticks_per_sec) {
+		zlog_clock_tsc_reanchor(seq);
+		return -1;
+	}
+
+	ts->tv_sec = ns / ZLOG_CLOCK_NS;
+	ts->tv_nsec = ns % ZLOG_CLOCK_NS;
+	return 0;
+}
+#endif
+
+int zlog_clock_set(int source)
+{
+	if (source == zlog_clock_source) return source;
+
+	switch (source) {
+	case ZLOG_CLOCK_COARSE:
+#ifndef CLOCK_REALTIME_COARSE
+		zc_warn("no CLOCK_REALTIME_COARSE here, use realtime clock");
+		source = ZLOG_CLOCK_REALTIME;
+#endif
+		break;
+	case ZLOG_CLOCK_TSC:
+#ifdef ZLOG_CLOCK_HAS_TSC
+		/* anchor is ready before anyone sees the source */
+		if (!zlog_clock_anchor.ns_per_tick && zlog_clock_tsc_calibrate()) {
+			source = ZLOG_CLOCK_REALTIME;
+		}
+#else
+		zc_warn("no tsc here, use realtime clock");
+		source = ZLOG_CLOCK_REALTIME;
+#endif
+		break;
+	default:
+		source = ZLOG_CLOCK_REALTIME;
+		break;
+	}
+
+	zc_atomic_store(&zlog_clock_source, source);
+	return source;
+}
+
+void zlog_clock_now(struct timespec *ts)
+{
+	switch (zc_atomic_load(&zlog_clock_source)) {
+#ifdef CLOCK_REALTIME_COARSE
+	case ZLOG_CLOCK_COARSE:
+		clock_gettime(CLOCK_REALTIME_COARSE, ts);
+		return;
+#endif
+#ifdef ZLOG_CLOCK_HAS_TSC
+	case ZLOG_CLOCK_TSC:
+		if (!zlog_clock_tsc_now(ts)) return;
+		break;
+#endif
+	}
+
+	clock_gettime(CLOCK_REALTIME, ts);
+	return;
+}
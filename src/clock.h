@@ -0,0 +1,41 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file clock.h
+ * @brief where the time stamp of events comes from
+ *
+ * realtime is clock_gettime(CLOCK_REALTIME), as gettimeofday was.
+ * coarse is CLOCK_REALTIME_COARSE, a few ms behind but much cheaper.
+ * tsc reads the cpu time stamp counter, scaled by a rate measured
+ * against CLOCK_REALTIME at init and re-anchored to it every second,
+ * only on x86 with an invariant tsc, others fall back to realtime.
+ * The source is one for the whole process, set from the conf.
+ */
+
+#ifndef __zlog_clock_h
+#define __zlog_clock_h
+
+#include <time.h>
+
+#define ZLOG_CLOCK_REALTIME 0
+#define ZLOG_CLOCK_COARSE 1
+#define ZLOG_CLOCK_TSC 2
+
+/* return the source really used */
+int zlog_clock_set(int source);
+void zlog_clock_now(struct timespec *ts);
+
+#endif
@@ -35,6 +35,7 @@
 #include "format.h"
 #include "level_list.h"
 #include "rotater.h"
+#include "async.h"
 #include "zc_defs.h"
 
 #ifdef _WIN32
@@ -48,9 +49,27 @@
 #define ZLOG_CONF_DEFAULT_RULE "*.*        >stdout"
 #define ZLOG_CONF_DEFAULT_BUF_SIZE_MIN 1024
 #define ZLOG_CONF_DEFAULT_BUF_SIZE_MAX (2 * 1024 * 1024)
+#define ZLOG_CONF_DEFAULT_FLUSH_SIZE 0
+#define ZLOG_CONF_DEFAULT_FLUSH_COUNT 0
+#define ZLOG_CONF_DEFAULT_FLUSH_DELAY 100
+#define ZLOG_CONF_DEFAULT_FLUSH_LEVEL "ERROR"
 #define ZLOG_CONF_DEFAULT_FILE_PERMS 0600
-#define ZLOG_CONF_DEFAULT_RELOAD_CONF_PERIOD 0
+#define ZLOG_CONF_DEFAULT_RELOAD_CHECK ZLOG_RELOAD_CHECK_OFF
+#define ZLOG_CONF_DEFAULT_RELOAD_CHECK_PERIOD 1000
+#define ZLOG_CONF_DEFAULT_RELOAD_DELAY 200
+#define ZLOG_CONF_DEFAULT_STATS 0
+#define ZLOG_CONF_DEFAULT_STATS_PERIOD 1000
 #define ZLOG_CONF_DEFAULT_FSYNC_PERIOD 0
+#define ZLOG_CONF_DEFAULT_FILE_CACHE_SIZE 16
+#define ZLOG_CONF_DEFAULT_FILE_CACHE_TIMEOUT 60
+#define ZLOG_CONF_DEFAULT_FILE_CHECK ZLOG_FILE_CHECK_STRICT
+#define ZLOG_CONF_DEFAULT_FILE_CHECK_PERIOD 1000
+#define ZLOG_CONF_DEFAULT_CLOCK ZLOG_CLOCK_REALTIME
+#define ZLOG_CONF_DEFAULT_HEX_WIDTH 16
+#define ZLOG_CONF_DEFAULT_HEX_GROUP 0
+#define ZLOG_CONF_DEFAULT_ASYNC 0
+#define ZLOG_CONF_DEFAULT_ASYNC_BUF_SIZE (1024 * 1024)
+#define ZLOG_CONF_DEFAULT_ASYNC_OVERFLOW ZLOG_ASYNC_OVERFLOW_BLOCK
 #define ZLOG_CONF_BACKUP_ROTATE_LOCK_FILE "/tmp/zlog.lock"
 /*******************************************************************************/
 
@@ -68,15 +87,32 @@ void zlog_conf_profile(zlog_conf_t * a_conf, int flag)
 	zc_profile(flag, "---strict init[%d]---", a_conf->strict_init);
 	zc_profile(flag, "---buffer min[%ld]---", a_conf->buf_size_min);
 	zc_profile(flag, "---buffer max[%ld]---", a_conf->buf_size_max);
+	zc_profile(flag, "---buffer flush size[%ld],count[%ld],delay[%ld],level[%s]---",
+		a_conf->flush_size, a_conf->flush_count,
+		a_conf->flush_delay, a_conf->flush_level);
+	if (a_conf->flusher) zlog_batch_flusher_profile(a_conf->flusher, flag);
 	if (a_conf->default_format) {
 		zc_profile(flag, "---default_format---");
 		zlog_format_profile(a_conf->default_format, flag);
 	}
 	zc_profile(flag, "---file perms[0%o]---", a_conf->file_perms);
-	zc_profile(flag, "---reload conf period[%ld]---", a_conf->reload_conf_period);
+	zc_profile(flag, "---reload check[%d],period[%ld],delay[%ld]---",
+		a_conf->reload_check, a_conf->reload_check_period, a_conf->reload_delay);
+	zc_profile(flag, "---stats[%d],shm[%s],period[%ld]---",
+		a_conf->stats, a_conf->stats_shm, a_conf->stats_period);
 	zc_profile(flag, "---fsync period[%ld]---", a_conf->fsync_period);
-
-	zc_profile(flag, "---rotate lock file[%s]---", a_conf->rotate_lock_file);
+	zc_profile(flag, "---file cache size[%ld],timeout[%ld]---",
+		a_conf->file_cache_size, a_conf->file_cache_timeout);
+	zc_profile(flag, "---file check[%d],period[%ld]---",
+		a_conf->file_check, a_conf->file_check_period);
+	if (a_conf->watcher) zlog_watcher_profile(a_conf->watcher, flag);
+	zc_profile(flag, "---clock[%d]---", a_conf->clock);
+	zc_profile(flag, "---hex width[%d],group[%d]---", a_conf->hex_width, a_conf->hex_group);
+	zc_profile(flag, "---async[%d],buffer[%ld],overflow[%d]---",
+		a_conf->async, a_conf->async_buf_size, a_conf->async_overflow);
+
+	zc_profile(flag, "---rotate lock file[%s],compress[%d]---",
+		a_conf->rotate_lock_file, a_conf->rotate_compress);
 	if (a_conf->rotater) zlog_rotater_profile(a_conf->rotater, flag);
 
 	if (a_conf->levels) zlog_level_list_profile(a_conf->levels, flag);
@@ -95,16 +131,22 @@ void zlog_conf_profile(zlog_conf_t * a_conf, int flag)
 		}
 	}
 
+	if (a_conf->rule_trie) zlog_rule_trie_profile(a_conf->rule_trie, flag);
+
 	return;
 }
 /*******************************************************************************/
 void zlog_conf_del(zlog_conf_t * a_conf)
 {
 	zc_assert(a_conf,);
+	/* watcher, flusher and rotater look into rules, stop them first */
+	if (a_conf->watcher) zlog_watcher_del(a_conf->watcher);
+	if (a_conf->flusher) zlog_batch_flusher_del(a_conf->flusher);
 	if (a_conf->rotater) zlog_rotater_del(a_conf->rotater);
 	if (a_conf->levels) zlog_level_list_del(a_conf->levels);
 	if (a_conf->default_format) zlog_format_del(a_conf->default_format);
 	if (a_conf->formats) zc_arraylist_del(a_conf->formats);
+	if (a_conf->rule_trie) zlog_rule_trie_del(a_conf->rule_trie);
 	if (a_conf->rules) zc_arraylist_del(a_conf->rules);
 	free(a_conf);
 	zc_debug("zlog_conf_del[%p]");
@@ -116,6 +158,9 @@ static int zlog_conf_build_with_file(zlog_conf_t * a_conf);
 static int zlog_conf_build_with_string(zlog_conf_t *a_conf,
 	const char *conf_string);
 static int zlog_conf_build_with_in_memory(zlog_conf_t * a_conf);
+static int zlog_conf_build_watcher(zlog_conf_t * a_conf);
+static int zlog_conf_build_batch(zlog_conf_t * a_conf);
+static int zlog_conf_build_rule_trie(zlog_conf_t * a_conf);
 
 enum{
 	NO_CFG,
@@ -123,7 +168,7 @@ enum{
 	IN_MEMORY_CFG
 };
 /*******************************************************************************/
-zlog_conf_t *zlog_conf_new(const char *config)
+zlog_conf_t *zlog_conf_new(const char *config, zlog_conf_t * last_conf)
 {
 	int nwrite = 0;
 	int cfg_source = 0;
@@ -134,6 +179,7 @@ zlog_conf_t *zlog_conf_new(const char *config)
 		zc_error("calloc fail, errno[%d]", errno);
 		return NULL;
 	}
+	a_conf->last_conf = last_conf;
 
 	// Find content of pointer. If it starts with '[' then content are configurations.
 	if (config && config[0] != '\0' && config[0] != '[') {
@@ -163,6 +209,10 @@ zlog_conf_t *zlog_conf_new(const char *config)
 	a_conf->strict_init = 1;
 	a_conf->buf_size_min = ZLOG_CONF_DEFAULT_BUF_SIZE_MIN;
 	a_conf->buf_size_max = ZLOG_CONF_DEFAULT_BUF_SIZE_MAX;
+	a_conf->flush_size = ZLOG_CONF_DEFAULT_FLUSH_SIZE;
+	a_conf->flush_count = ZLOG_CONF_DEFAULT_FLUSH_COUNT;
+	a_conf->flush_delay = ZLOG_CONF_DEFAULT_FLUSH_DELAY;
+	strcpy(a_conf->flush_level, ZLOG_CONF_DEFAULT_FLUSH_LEVEL);
 	if (cfg_source == FILE_CFG) {
 		/* configure file as default lock file */
 		strcpy(a_conf->rotate_lock_file, a_conf->file);
@@ -171,8 +221,22 @@ zlog_conf_t *zlog_conf_new(const char *config)
 	}
 	strcpy(a_conf->default_format_line, ZLOG_CONF_DEFAULT_FORMAT);
 	a_conf->file_perms = ZLOG_CONF_DEFAULT_FILE_PERMS;
-	a_conf->reload_conf_period = ZLOG_CONF_DEFAULT_RELOAD_CONF_PERIOD;
+	a_conf->reload_check = ZLOG_CONF_DEFAULT_RELOAD_CHECK;
+	a_conf->reload_check_period = ZLOG_CONF_DEFAULT_RELOAD_CHECK_PERIOD;
+	a_conf->reload_delay = ZLOG_CONF_DEFAULT_RELOAD_DELAY;
+	a_conf->stats = ZLOG_CONF_DEFAULT_STATS;
+	a_conf->stats_period = ZLOG_CONF_DEFAULT_STATS_PERIOD;
 	a_conf->fsync_period = ZLOG_CONF_DEFAULT_FSYNC_PERIOD;
+	a_conf->file_cache_size = ZLOG_CONF_DEFAULT_FILE_CACHE_SIZE;
+	a_conf->file_cache_timeout = ZLOG_CONF_DEFAULT_FILE_CACHE_TIMEOUT;
+	a_conf->file_check = ZLOG_CONF_DEFAULT_FILE_CHECK;
+	a_conf->file_check_period = ZLOG_CONF_DEFAULT_FILE_CHECK_PERIOD;
+	a_conf->clock = ZLOG_CONF_DEFAULT_CLOCK;
+	a_conf->hex_width = ZLOG_CONF_DEFAULT_HEX_WIDTH;
+	a_conf->hex_group = ZLOG_CONF_DEFAULT_HEX_GROUP;
+	a_conf->async = ZLOG_CONF_DEFAULT_ASYNC;
+	a_conf->async_buf_size = ZLOG_CONF_DEFAULT_ASYNC_BUF_SIZE;
+	a_conf->async_overflow = ZLOG_CONF_DEFAULT_ASYNC_OVERFLOW;
 	/* set default configuration end */
 
 	a_conf->levels = zlog_level_list_new();
@@ -210,6 +274,22 @@ zlog_conf_t *zlog_conf_new(const char *config)
 		}
 	}
 
+	if (zlog_conf_build_watcher(a_conf)) {
+		zc_error("zlog_conf_build_watcher fail");
+		goto err;
+	}
+
+	if (zlog_conf_build_batch(a_conf)) {
+		zc_error("zlog_conf_build_batch fail");
+		goto err;
+	}
+
+	if (zlog_conf_build_rule_trie(a_conf)) {
+		zc_error("zlog_conf_build_rule_trie fail");
+		goto err;
+	}
+
+	a_conf->last_conf = NULL;
 	zlog_conf_profile(a_conf, ZC_DEBUG);
 	return a_conf;
 err:
@@ -217,7 +297,7 @@ err:
 	return NULL;
 }
 /*******************************************************************************/
-zlog_conf_t *zlog_conf_new_from_string(const char *config_string)
+zlog_conf_t *zlog_conf_new_from_string(const char *config_string, zlog_conf_t * last_conf)
 {
     zlog_conf_t *a_conf = NULL;
 
@@ -226,6 +306,7 @@ zlog_conf_t *zlog_conf_new_from_string(const char *config_string)
         zc_error("calloc fail, errno[%d]", errno);
         return NULL;
     }
+    a_conf->last_conf = last_conf;
 
     // no configuration file
     memset(a_conf->file, 0x00, sizeof(a_conf->file));
@@ -252,19 +333,36 @@ zlog_conf_t *zlog_conf_new_from_string(const char *config_string)
     a_conf->strict_init = 1;
     a_conf->buf_size_min = ZLOG_CONF_DEFAULT_BUF_SIZE_MIN;
     a_conf->buf_size_max = ZLOG_CONF_DEFAULT_BUF_SIZE_MAX;
+    a_conf->flush_size = ZLOG_CONF_DEFAULT_FLUSH_SIZE;
+    a_conf->flush_count = ZLOG_CONF_DEFAULT_FLUSH_COUNT;
+    a_conf->flush_delay = ZLOG_CONF_DEFAULT_FLUSH_DELAY;
+    strcpy(a_conf->flush_level, ZLOG_CONF_DEFAULT_FLUSH_LEVEL);
     strcpy(a_conf->default_format_line, ZLOG_CONF_DEFAULT_FORMAT);
     a_conf->file_perms = ZLOG_CONF_DEFAULT_FILE_PERMS;
-    a_conf->reload_conf_period = ZLOG_CONF_DEFAULT_RELOAD_CONF_PERIOD;
+    a_conf->reload_check = ZLOG_CONF_DEFAULT_RELOAD_CHECK;
+    a_conf->reload_check_period = ZLOG_CONF_DEFAULT_RELOAD_CHECK_PERIOD;
+    a_conf->reload_delay = ZLOG_CONF_DEFAULT_RELOAD_DELAY;
+    a_conf->stats = ZLOG_CONF_DEFAULT_STATS;
+    a_conf->stats_period = ZLOG_CONF_DEFAULT_STATS_PERIOD;
     a_conf->fsync_period = ZLOG_CONF_DEFAULT_FSYNC_PERIOD;
-
-    a_conf->default_format = zlog_format_new(a_conf->default_format_line,
-            &(a_conf->time_cache_count));
+    a_conf->file_cache_size = ZLOG_CONF_DEFAULT_FILE_CACHE_SIZE;
+    a_conf->file_cache_timeout = ZLOG_CONF_DEFAULT_FILE_CACHE_TIMEOUT;
+    a_conf->file_check = ZLOG_CONF_DEFAULT_FILE_CHECK;
+    a_conf->file_check_period = ZLOG_CONF_DEFAULT_FILE_CHECK_PERIOD;
+    a_conf->clock = ZLOG_CONF_DEFAULT_CLOCK;
+    a_conf->hex_width = ZLOG_CONF_DEFAULT_HEX_WIDTH;
+    a_conf->hex_group = ZLOG_CONF_DEFAULT_HEX_GROUP;
+    a_conf->async = ZLOG_CONF_DEFAULT_ASYNC;
+    a_conf->async_buf_size = ZLOG_CONF_DEFAULT_ASYNC_BUF_SIZE;
+    a_conf->async_overflow = ZLOG_CONF_DEFAULT_ASYNC_OVERFLOW;
+
+    a_conf->default_format = zlog_format_new(a_conf->default_format_line);
     if (!a_conf->default_format) {
         zc_error("zlog_format_new fail");
         goto err;
     }
 
-    a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file);
+    a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file, a_conf->rotate_compress);
     if (!a_conf->rotater) {
         zc_error("zlog_rotater_new fail");
         goto err;
@@ -275,6 +373,22 @@ zlog_conf_t *zlog_conf_new_from_string(const char *config_string)
         goto err;
     }
 
+    if (zlog_conf_build_watcher(a_conf)) {
+        zc_error("zlog_conf_build_watcher fail");
+        goto err;
+    }
+
+    if (zlog_conf_build_batch(a_conf)) {
+        zc_error("zlog_conf_build_batch fail");
+        goto err;
+    }
+
+    if (zlog_conf_build_rule_trie(a_conf)) {
+        zc_error("zlog_conf_build_rule_trie fail");
+        goto err;
+    }
+
+    a_conf->last_conf = NULL;
     zlog_conf_profile(a_conf, ZC_DEBUG);
     return a_conf;
 err:
@@ -282,17 +396,92 @@ err:
     return NULL;
 }
 /*******************************************************************************/
+/* strict mode stat()s in the write path, no thread needed */
+static int zlog_conf_build_watcher(zlog_conf_t * a_conf)
+{
+	if (a_conf->file_check == ZLOG_FILE_CHECK_STRICT) return 0;
+
+	a_conf->watcher = zlog_watcher_new(a_conf->file_check,
+				a_conf->file_check_period, a_conf->rules);
+	if (!a_conf->watcher) {
+		zc_error("zlog_watcher_new fail");
+		return -1;
+	}
+	return 0;
+}
+/*******************************************************************************/
+/* categories find their rules through it, on get and on reload */
+static int zlog_conf_build_rule_trie(zlog_conf_t * a_conf)
+{
+	a_conf->rule_trie = zlog_rule_trie_new(a_conf->rules);
+	if (!a_conf->rule_trie) {
+		zc_error("zlog_rule_trie_new fail");
+		return -1;
+	}
+	return 0;
+}
+/*******************************************************************************/
+/* zero flush size writes every msg at once, as before */
+static int zlog_conf_build_batch(zlog_conf_t * a_conf)
+{
+	int i;
+	int level = 0;
+	zlog_rule_t *a_rule;
+	zc_arraylist_t *batches;
+
+	if (a_conf->flush_size == 0) return 0;
+
+	if (a_conf->flush_level[0] != '\0') {
+		level = zlog_level_list_atoi(a_conf->levels, a_conf->flush_level);
+		if (level < 0) {
+			zc_error("buffer flush level[%s] is not a level", a_conf->flush_level);
+			return -1;
+		}
+	}
+
+	batches = zc_arraylist_new(NULL);
+	if (!batches) {
+		zc_error("zc_arraylist_new fail");
+		return -1;
+	}
+
+	zc_arraylist_foreach(a_conf->rules, i, a_rule) {
+		if (zlog_rule_set_batch(a_rule, a_conf->flush_size, a_conf->flush_count, level)) {
+			zc_error("zlog_rule_set_batch fail");
+			zc_arraylist_del(batches);
+			return -1;
+		}
+		if (a_rule->batch && zc_arraylist_add(batches, a_rule->batch)) {
+			zc_error("zc_arraylist_add fail");
+			zc_arraylist_del(batches);
+			return -1;
+		}
+	}
+
+	if (a_conf->flush_delay <= 0 || zc_arraylist_len(batches) == 0) {
+		zc_arraylist_del(batches);
+		return 0;
+	}
+
+	a_conf->flusher = zlog_batch_flusher_new(a_conf->flush_delay, batches);
+	if (!a_conf->flusher) {
+		zc_error("zlog_batch_flusher_new fail");
+		return -1;
+	}
+	return 0;
+}
+/*******************************************************************************/
 static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 {
 	zlog_rule_t *default_rule;
 
-	a_conf->default_format = zlog_format_new(a_conf->default_format_line, &(a_conf->time_cache_count));
+	a_conf->default_format = zlog_format_new(a_conf->default_format_line);
 	if (!a_conf->default_format) {
 		zc_error("zlog_format_new fail");
 		return -1;
 	}
 
-	a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file);
+	a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file, a_conf->rotate_compress);
 	if (!a_conf->rotater) {
 		zc_error("zlog_rotater_new fail");
 		return -1;
@@ -305,7 +494,10 @@ static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 			a_conf->formats,
 			a_conf->file_perms,
 			a_conf->fsync_period,
-			&(a_conf->time_cache_count));
+			a_conf->file_cache_size,
+			a_conf->file_cache_timeout,
+			a_conf->async,
+			NULL);
 	if (!default_rule) {
 		zc_error("zlog_rule_new fail");
 		return -1;
@@ -599,6 +791,82 @@ static int zlog_conf_build_with_in_memory(zlog_conf_t * a_conf)
 	}
 	return rc;
 }
+/* the format of last conf with the same name and pattern, or a new one */
+static zlog_format_t *zlog_conf_renew_format(zlog_conf_t * a_conf, char *line)
+{
+	if (!a_conf->last_conf) return zlog_format_new(line);
+	return zlog_format_renew(line, a_conf->last_conf->default_format,
+				a_conf->last_conf->formats);
+}
+
+/* a rule of the same line gives the same rule only if all it is made of
+ * is the same, the format is checked by zlog_conf_keep_rule()
+ */
+static int zlog_conf_same_rule_env(zlog_conf_t * a_conf, zlog_conf_t * last_conf)
+{
+	int i;
+	zlog_level_t *a_level;
+	zlog_level_t *b_level;
+
+	if (!last_conf) return 0;
+
+	if (a_conf->file_perms != last_conf->file_perms
+		|| a_conf->fsync_period != last_conf->fsync_period
+		|| a_conf->file_cache_size != last_conf->file_cache_size
+		|| a_conf->file_cache_timeout != last_conf->file_cache_timeout
+		|| a_conf->file_check != last_conf->file_check
+		|| a_conf->async != last_conf->async
+		|| a_conf->flush_size != last_conf->flush_size
+		|| a_conf->flush_count != last_conf->flush_count
+		|| STRCMP(a_conf->flush_level, !=, last_conf->flush_level)) {
+		return 0;
+	}
+
+	/* levels are turned into numbers in rules */
+	if (zc_arraylist_len(a_conf->levels) != zc_arraylist_len(last_conf->levels)) return 0;
+	zc_arraylist_foreach(a_conf->levels, i, a_level) {
+		b_level = zc_arraylist_get(last_conf->levels, i);
+		if (!a_level && !b_level) continue;
+		if (!a_level || !b_level
+			|| a_level->syslog_level != b_level->syslog_level
+			|| STRCMP(a_level->str_uppercase, !=, b_level->str_uppercase)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* the rule of last conf from the same line, its fds, inodes and
+ * counters go on, NULL if none
+ */
+static zlog_rule_t *zlog_conf_keep_rule(zlog_conf_t * a_conf, char *line)
+{
+	int i;
+	int j;
+	zlog_rule_t *a_rule;
+	zlog_format_t *a_format;
+
+	if (!a_conf->keep_rules) return NULL;
+
+	zc_arraylist_foreach(a_conf->last_conf->rules, i, a_rule) {
+		if (STRCMP(a_rule->line, !=, line)) continue;
+
+		/* its format must be kept in this conf too */
+		if (a_rule->format == a_conf->default_format) {
+			a_rule->refs++;
+			return a_rule;
+		}
+		zc_arraylist_foreach(a_conf->formats, j, a_format) {
+			if (a_rule->format == a_format) {
+				a_rule->refs++;
+				return a_rule;
+			}
+		}
+		return NULL;
+	}
+	return NULL;
+}
+
 /* section [global:1] [levels:2] [formats:3] [rules:4] */
 static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 {
@@ -641,34 +909,23 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		}
 
 		if (*section == 4) {
-			if (a_conf->reload_conf_period != 0
-				&& a_conf->fsync_period >= a_conf->reload_conf_period) {
-				/* as all rule will be rebuilt when conf is reload,
-				 * so fsync_period > reload_conf_period will never
-				 * cause rule to fsync it's file.
-				 * fsync_period will be meaningless and down speed,
-				 * so make it zero.
-				 */
-				zc_warn("fsync_period[%ld] >= reload_conf_period[%ld],"
-					"set fsync_period to zero");
-				a_conf->fsync_period = 0;
-			}
-
 			/* now build rotater and default_format
 			 * from the unchanging global setting,
 			 * for zlog_rule_new() */
-			a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file);
+			a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file, a_conf->rotate_compress);
 			if (!a_conf->rotater) {
 				zc_error("zlog_rotater_new fail");
 				return -1;
 			}
 
-			a_conf->default_format = zlog_format_new(a_conf->default_format_line,
-							&(a_conf->time_cache_count));
+			a_conf->default_format = zlog_conf_renew_format(a_conf,
+						a_conf->default_format_line);
 			if (!a_conf->default_format) {
-				zc_error("zlog_format_new fail");
+				zc_error("zlog_conf_renew_format fail");
 				return -1;
 			}
+
+			a_conf->keep_rules = zlog_conf_same_rule_env(a_conf, a_conf->last_conf);
 		}
 		return 0;
 	}
@@ -705,6 +962,18 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 			a_conf->buf_size_min = zc_parse_byte_size(value);
 		} else if (STRCMP(word_1, ==, "buffer") && STRCMP(word_2, ==, "max")) {
 			a_conf->buf_size_max = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "buffer") &&
+				STRCMP(word_2, ==, "flush") && STRCMP(word_3, ==, "size")) {
+			a_conf->flush_size = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "buffer") &&
+				STRCMP(word_2, ==, "flush") && STRCMP(word_3, ==, "count")) {
+			a_conf->flush_count = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "buffer") &&
+				STRCMP(word_2, ==, "flush") && STRCMP(word_3, ==, "delay")) {
+			a_conf->flush_delay = atol(value);
+		} else if (STRCMP(word_1, ==, "buffer") &&
+				STRCMP(word_2, ==, "flush") && STRCMP(word_3, ==, "level")) {
+			strcpy(a_conf->flush_level, value);
 		} else if (STRCMP(word_1, ==, "file") && STRCMP(word_2, ==, "perms")) {
 			sscanf(value, "%o", &(a_conf->file_perms));
 		} else if (STRCMP(word_1, ==, "rotate") &&
@@ -715,14 +984,126 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 			} else {
 				strcpy(a_conf->rotate_lock_file, value);
 			}
+		} else if (STRCMP(word_1, ==, "rotate") &&
+				STRCMP(word_2, ==, "compress") && STRCMP(word_3, ==, "")) {
+			if (STRICMP(value, ==, "none")) {
+				a_conf->rotate_compress = ZLOG_ROTATE_COMPRESS_NONE;
+			} else if (STRICMP(value, ==, "gzip")) {
+#ifdef ZLOG_ZLIB
+				a_conf->rotate_compress = ZLOG_ROTATE_COMPRESS_GZIP;
+#else
+				zc_error("rotate compress[gzip] needs zlog built with zlib, make ZLIB=1");
+				if (a_conf->strict_init) return -1;
+#endif
+			} else {
+				zc_error("rotate compress[%s] must be none or gzip", value);
+				if (a_conf->strict_init) return -1;
+			}
 		} else if (STRCMP(word_1, ==, "default") && STRCMP(word_2, ==, "format")) {
 			/* so the input now is [format = "xxyy"], fit format's style */
 			strcpy(a_conf->default_format_line, line + nread);
 		} else if (STRCMP(word_1, ==, "reload") &&
 				STRCMP(word_2, ==, "conf") && STRCMP(word_3, ==, "period")) {
-			a_conf->reload_conf_period = zc_parse_byte_size(value);
+			/* loggers counted msgs for it, now the file is watched */
+			if (zc_parse_byte_size(value) && a_conf->reload_check == ZLOG_RELOAD_CHECK_OFF) {
+				zc_warn("reload conf period is replaced by reload check, use inotify");
+				a_conf->reload_check = ZLOG_RELOAD_CHECK_INOTIFY;
+			}
+		} else if (STRCMP(word_1, ==, "reload") &&
+				STRCMP(word_2, ==, "check") && STRCMP(word_3, ==, "")) {
+			if (STRICMP(value, ==, "off")) {
+				a_conf->reload_check = ZLOG_RELOAD_CHECK_OFF;
+			} else if (STRICMP(value, ==, "period")) {
+				a_conf->reload_check = ZLOG_RELOAD_CHECK_PERIOD;
+			} else if (STRICMP(value, ==, "inotify")) {
+				a_conf->reload_check = ZLOG_RELOAD_CHECK_INOTIFY;
+			} else {
+				zc_error("reload check[%s] must be off, period or inotify", value);
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "reload") &&
+				STRCMP(word_2, ==, "check") && STRCMP(word_3, ==, "period")) {
+			a_conf->reload_check_period = atol(value);
+		} else if (STRCMP(word_1, ==, "reload") &&
+				STRCMP(word_2, ==, "delay") && STRCMP(word_3, ==, "")) {
+			a_conf->reload_delay = atol(value);
+		} else if (STRCMP(word_1, ==, "stats") && STRCMP(word_2, ==, "")) {
+			a_conf->stats = STRICMP(value, ==, "true");
+		} else if (STRCMP(word_1, ==, "stats") &&
+				STRCMP(word_2, ==, "shm") && STRCMP(word_3, ==, "")) {
+			/* a shm name, like /zlog-myapp */
+			if (strlen(value) > sizeof(a_conf->stats_shm) - 1) {
+				zc_error("stats shm[%s] too long", value);
+				if (a_conf->strict_init) return -1;
+			} else {
+				strcpy(a_conf->stats_shm, value);
+			}
+		} else if (STRCMP(word_1, ==, "stats") &&
+				STRCMP(word_2, ==, "period") && STRCMP(word_3, ==, "")) {
+			a_conf->stats_period = atol(value);
 		} else if (STRCMP(word_1, ==, "fsync") && STRCMP(word_2, ==, "period")) {
 			a_conf->fsync_period = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "file") &&
+				STRCMP(word_2, ==, "cache") && STRCMP(word_3, ==, "size")) {
+			a_conf->file_cache_size = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "file") &&
+				STRCMP(word_2, ==, "cache") && STRCMP(word_3, ==, "timeout")) {
+			a_conf->file_cache_timeout = atol(value);
+		} else if (STRCMP(word_1, ==, "file") &&
+				STRCMP(word_2, ==, "check") && STRCMP(word_3, ==, "")) {
+			if (STRICMP(value, ==, "strict")) {
+				a_conf->file_check = ZLOG_FILE_CHECK_STRICT;
+			} else if (STRICMP(value, ==, "period")) {
+				a_conf->file_check = ZLOG_FILE_CHECK_PERIOD;
+			} else if (STRICMP(value, ==, "inotify")) {
+				a_conf->file_check = ZLOG_FILE_CHECK_INOTIFY;
+			} else {
+				zc_error("file check[%s] must be strict, period or inotify", value);
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "file") &&
+				STRCMP(word_2, ==, "check") && STRCMP(word_3, ==, "period")) {
+			a_conf->file_check_period = atol(value);
+		} else if (STRCMP(word_1, ==, "clock") && STRCMP(word_2, ==, "")) {
+			if (STRICMP(value, ==, "realtime")) {
+				a_conf->clock = ZLOG_CLOCK_REALTIME;
+			} else if (STRICMP(value, ==, "coarse")) {
+				a_conf->clock = ZLOG_CLOCK_COARSE;
+			} else if (STRICMP(value, ==, "tsc")) {
+				a_conf->clock = ZLOG_CLOCK_TSC;
+			} else {
+				zc_error("clock[%s] must be realtime, coarse or tsc", value);
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "hex") && STRCMP(word_2, ==, "width")) {
+			a_conf->hex_width = atoi(value);
+			if (a_conf->hex_width < 1 || a_conf->hex_width > ZLOG_HEX_WIDTH_MAX) {
+				zc_error("hex width[%s] must be 1 to %d", value, ZLOG_HEX_WIDTH_MAX);
+				a_conf->hex_width = ZLOG_CONF_DEFAULT_HEX_WIDTH;
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "hex") && STRCMP(word_2, ==, "group")) {
+			a_conf->hex_group = atoi(value);
+			if (a_conf->hex_group < 0) {
+				zc_error("hex group[%s] must not be negative", value);
+				a_conf->hex_group = ZLOG_CONF_DEFAULT_HEX_GROUP;
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "async") && STRCMP(word_2, ==, "")) {
+			a_conf->async = STRICMP(value, ==, "true");
+		} else if (STRCMP(word_1, ==, "async") && STRCMP(word_2, ==, "buffer")) {
+			a_conf->async_buf_size = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "async") && STRCMP(word_2, ==, "overflow")) {
+			if (STRICMP(value, ==, "block")) {
+				a_conf->async_overflow = ZLOG_ASYNC_OVERFLOW_BLOCK;
+			} else if (STRICMP(value, ==, "drop")) {
+				a_conf->async_overflow = ZLOG_ASYNC_OVERFLOW_DROP;
+			} else if (STRICMP(value, ==, "sync")) {
+				a_conf->async_overflow = ZLOG_ASYNC_OVERFLOW_SYNC;
+			} else {
+				zc_error("async overflow[%s] must be block, drop or sync", value);
+				if (a_conf->strict_init) return -1;
+			}
 		} else {
 			zc_error("name[%s] is not any one of global options", name);
 			if (a_conf->strict_init) return -1;
@@ -735,9 +1116,9 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		}
 		break;
 	case 3:
-		a_format = zlog_format_new(line, &(a_conf->time_cache_count));
+		a_format = zlog_conf_renew_format(a_conf, line);
 		if (!a_format) {
-			zc_error("zlog_format_new fail [%s]", line);
+			zc_error("zlog_conf_renew_format fail [%s]", line);
 			if (a_conf->strict_init) return -1;
 			else break;
 		}
@@ -748,13 +1129,21 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		}
 		break;
 	case 4:
-		a_rule = zlog_rule_new(line,
-			a_conf->levels,
-			a_conf->default_format,
-			a_conf->formats,
-			a_conf->file_perms,
-			a_conf->fsync_period,
-			&(a_conf->time_cache_count));
+		a_rule = zlog_conf_keep_rule(a_conf, line);
+		if (a_rule) {
+			zc_debug("rule[%s] kept from last conf", line);
+		} else {
+			a_rule = zlog_rule_new(line,
+				a_conf->levels,
+				a_conf->default_format,
+				a_conf->formats,
+				a_conf->file_perms,
+				a_conf->fsync_period,
+				a_conf->file_cache_size,
+				a_conf->file_cache_timeout,
+				a_conf->async,
+				a_conf->rules);
+		}
 
 		if (!a_rule) {
 			zc_error("zlog_rule_new fail [%s]", line);
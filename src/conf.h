@@ -19,6 +19,12 @@
 #include "zc_defs.h"
 #include "format.h"
 #include "rotater.h"
+#include "watcher.h"
+#include "batch.h"
+#include "clock.h"
+#include "hex.h"
+#include "rule_trie.h"
+#include "reloader.h"
 
 typedef struct zlog_conf_s {
 	char file[MAXLEN_PATH + 1];
@@ -28,8 +34,14 @@ typedef struct zlog_conf_s {
 	int strict_init;
 	size_t buf_size_min;
 	size_t buf_size_max;
+	size_t flush_size;
+	size_t flush_count;
+	long flush_delay;
+	char flush_level[MAXLEN_CFG_LINE + 1];
+	zlog_batch_flusher_t *flusher;
 
 	char rotate_lock_file[MAXLEN_CFG_LINE + 1];
+	int rotate_compress;
 	zlog_rotater_t *rotater;
 
 	char default_format_line[MAXLEN_CFG_LINE + 1];
@@ -37,20 +49,40 @@ typedef struct zlog_conf_s {
 
 	unsigned int file_perms;
 	size_t fsync_period;
-	size_t reload_conf_period;
+	int reload_check;
+	long reload_check_period;
+	long reload_delay;
+	int stats;
+	char stats_shm[MAXLEN_PATH + 1];
+	long stats_period;
+	size_t file_cache_size;
+	long file_cache_timeout;
+	int file_check;
+	long file_check_period;
+	zlog_watcher_t *watcher;
+	int clock;
+	int hex_width;
+	int hex_group; /* 0 for no gap */
+
+	int async;
+	size_t async_buf_size;
+	int async_overflow;
 
 	zc_arraylist_t *levels;
 	zc_arraylist_t *formats;
 	zc_arraylist_t *rules;
-	int time_cache_count;
+	zlog_rule_trie_t *rule_trie;
+	struct zlog_conf_s *last_conf; /* only while being built */
+	int keep_rules; /* rules of last_conf may be kept */
 	char log_level[MAXLEN_CFG_LINE + 1];
 	int level;
 } zlog_conf_t;
 
 extern zlog_conf_t * zlog_env_conf;
 
-zlog_conf_t *zlog_conf_new(const char *config);
-zlog_conf_t *zlog_conf_new_from_string(const char *config_string);
+/* last_conf, if any, gives the formats and rules that stay the same */
+zlog_conf_t *zlog_conf_new(const char *config, zlog_conf_t * last_conf);
+zlog_conf_t *zlog_conf_new_from_string(const char *config_string, zlog_conf_t * last_conf);
 void zlog_conf_del(zlog_conf_t * a_conf);
 void zlog_conf_profile(zlog_conf_t * a_conf, int flag);
 
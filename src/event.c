@@ -31,6 +31,7 @@
 
 #include "zc_defs.h"
 #include "event.h"
+#include "buf.h"
 #ifdef _WIN32
 #include <Winsock2.h>
 #endif
@@ -38,16 +39,42 @@
 void zlog_event_profile(zlog_event_t * a_event, int flag)
 {
 	zc_assert(a_event,);
-	zc_profile(flag, "---event[%p][%s,%s][%s(%ld),%s(%ld),%ld,%d][%p,%s][%ld,%ld][%ld,%ld][%d]---",
+	zc_profile(flag, "---event[%p][%s,%s][%s(%ld),%s(%ld),%ld,%d][%p,%s][%ld,%ld][%ld,%ld]---",
 			a_event,
 			a_event->category_name, a_event->host_name,
 			a_event->file, a_event->file_len,
 			a_event->func, a_event->func_len,
 			a_event->line, a_event->level,
 			a_event->hex_buf, a_event->str_format,
-			a_event->time_stamp.tv_sec, a_event->time_stamp.tv_usec,
-			(long)a_event->pid, (long)a_event->tid,
-			a_event->time_cache_count);
+			a_event->time_stamp.tv_sec, a_event->time_stamp.tv_nsec,
+			(long)zlog_event_pid, (long)a_event->tid);
+	return;
+}
+
+/*******************************************************************************/
+pid_t zlog_event_pid;
+char zlog_event_pid_str[ZLOG_INT64_LEN + 1];
+size_t zlog_event_pid_str_len;
+
+static pthread_once_t zlog_event_pid_once = PTHREAD_ONCE_INIT;
+
+static void zlog_event_pid_refresh(void)
+{
+	zlog_event_pid = getpid();
+	zlog_event_pid_str_len = zlog_buf_dec_str(zlog_event_pid_str, (uint64_t)zlog_event_pid);
+	zlog_event_pid_str[zlog_event_pid_str_len] = '\0';
+	return;
+}
+
+static void zlog_event_pid_init(void)
+{
+	zlog_event_pid_refresh();
+#ifndef _WIN32
+	/* a child forked by the user logs its own pid */
+	if (pthread_atfork(NULL, NULL, zlog_event_pid_refresh)) {
+		zc_error("pthread_atfork fail, %%p will show the parent pid after fork");
+	}
+#endif
 	return;
 }
 
@@ -56,30 +83,23 @@ void zlog_event_profile(zlog_event_t * a_event, int flag)
 void zlog_event_del(zlog_event_t * a_event)
 {
 	zc_assert(a_event,);
-	if (a_event->time_caches) free(a_event->time_caches);
 	zc_debug("zlog_event_del[%p]", a_event);
     free(a_event);
 	return;
 }
 
-zlog_event_t *zlog_event_new(int time_cache_count)
+zlog_event_t *zlog_event_new(void)
 {
 	zlog_event_t *a_event;
 
+	pthread_once(&zlog_event_pid_once, zlog_event_pid_init);
+
 	a_event = calloc(1, sizeof(zlog_event_t));
 	if (!a_event) {
 		zc_error("calloc fail, errno[%d]", errno);
 		return NULL;
 	}
 
-	a_event->time_caches = calloc(time_cache_count, sizeof(zlog_time_cache_t));
-	if (!a_event->time_caches) {
-		zc_error("calloc fail, errno[%d]", errno);
-		free(a_event);
-		return NULL;
-	}
-	a_event->time_cache_count = time_cache_count;
-
 	/*
 	 * at the zlog_init we gethostname,
 	 * u don't always change your hostname, eh?
@@ -97,8 +117,8 @@ zlog_event_t *zlog_event_new(int time_cache_count)
 	 */
 	a_event->tid = pthread_self();
 
-	a_event->tid_str_len = sprintf(a_event->tid_str, "%lu", (unsigned long)a_event->tid);
-	a_event->tid_hex_str_len = sprintf(a_event->tid_hex_str, "%x", (unsigned int)a_event->tid);
+	a_event->tid_str_len = zlog_buf_dec_str(a_event->tid_str, (unsigned long)a_event->tid);
+	a_event->tid_hex_str_len = zlog_buf_hex_str(a_event->tid_hex_str, (unsigned int)a_event->tid);
 
 #ifdef __linux__
 	a_event->ktid = syscall(SYS_gettid);
@@ -109,7 +129,7 @@ zlog_event_t *zlog_event_new(int time_cache_count)
 #endif
 
 #if defined __linux__ || __APPLE__
-	a_event->ktid_str_len = sprintf(a_event->ktid_str, "%u", (unsigned int)a_event->ktid);
+	a_event->ktid_str_len = zlog_buf_dec_str(a_event->ktid_str, (unsigned int)a_event->ktid);
 #endif
 
 	//zlog_event_profile(a_event, ZC_DEBUG);
@@ -142,15 +162,9 @@ void zlog_event_set_fmt(zlog_event_t * a_event,
 	a_event->str_format = str_format;
 	va_copy(a_event->str_args, str_args);
 
-	/* pid should fetch eveytime, as no one knows,
-	 * when does user fork his process
-	 * so clean here, and fetch at spec.c
-	 */
-	a_event->pid = (pid_t) 0;
-
 	/* in a event's life cycle, time will be get when spec need,
 	 * and keep unchange though all event's life cycle
-	 * zlog_spec_write_time gettimeofday
+	 * zlog_spec_write_time zlog_clock_now
 	 */
 	a_event->time_stamp.tv_sec = 0;
 	return;
@@ -178,12 +192,6 @@ void zlog_event_set_hex(zlog_event_t * a_event,
 	a_event->hex_buf = hex_buf;
 	a_event->hex_buf_len = hex_buf_len;
 
-	/* pid should fetch eveytime, as no one knows,
-	 * when does user fork his process
-	 * so clean here, and fetch at spec.c
-	 */
-	a_event->pid = (pid_t) 0;
-
 	/* in a event's life cycle, time will be get when spec need,
 	 * and keep unchange though all event's life cycle
 	 */
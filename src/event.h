@@ -17,7 +17,7 @@
 #define __zlog_event_h
 
 #include <sys/types.h>  /* for pid_t */
-#include <sys/time.h>   /* for struct timeval */
+#include <time.h>       /* for struct timespec */
 #include <pthread.h>    /* for pthread_t */
 #include <stdarg.h>     /* for va_list */
 #include "zc_defs.h"
@@ -27,12 +27,6 @@ typedef enum {
 	ZLOG_HEX = 1,
 } zlog_event_cmd;
 
-typedef struct zlog_time_cache_s {
-	char str[MAXLEN_CFG_LINE + 1];
-	size_t len;
-	time_t sec;
-} zlog_time_cache_t;
-
 typedef struct {
 	char *category_name;
 	size_t category_name_len;
@@ -52,20 +46,13 @@ typedef struct {
 	va_list str_args;
 	zlog_event_cmd generate_cmd;
 
-	struct timeval time_stamp;
+	struct timespec time_stamp;
 
 	time_t time_utc_sec;
 	struct tm time_utc;
 	time_t time_local_sec;
 	struct tm time_local;
 
-	zlog_time_cache_t *time_caches;
-	int time_cache_count;
-
-	pid_t pid;
-	pid_t last_pid;
-	char pid_str[30 + 1];
-	size_t pid_str_len;
 
 	pthread_t tid;
 	char tid_str[30 + 1];
@@ -82,7 +69,15 @@ typedef struct {
 } zlog_event_t;
 
 
-zlog_event_t *zlog_event_new(int time_cache_count);
+/* pid of the process as a string, set by the first zlog_event_new,
+ * and again in the child by a pthread_atfork handler, so %p does not
+ * call getpid() per msg
+ */
+extern pid_t zlog_event_pid;
+extern char zlog_event_pid_str[];
+extern size_t zlog_event_pid_str_len;
+
+zlog_event_t *zlog_event_new(void);
 void zlog_event_del(zlog_event_t * a_event);
 void zlog_event_profile(zlog_event_t * a_event, int flag);
 
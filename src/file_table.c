@@ -0,0 +1,306 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_table.h"
+#include "trace.h"
+#include "zc_defs.h"
+
+void zlog_file_table_profile(zlog_file_table_t * a_table, int flag)
+{
+	zlog_file_entry_t *a_entry;
+
+	zc_assert(a_table,);
+	zc_profile(flag, "---file_table[%p][%ld/%ld,%lds][hits:%ld][opens:%ld]---",
+		a_table,
+		(long)a_table->count,
+		(long)a_table->max_count,
+		a_table->timeout,
+		(long)a_table->hits,
+		(long)a_table->opens);
+	for (a_entry = a_table->head; a_entry; a_entry = a_entry->next) {
+		zc_profile(flag, "----file[%s][%d][%d]----",
+			a_entry->path, a_entry->fd, a_entry->refs);
+	}
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_file_entry_del(zlog_file_entry_t * a_entry)
+{
+	if (a_entry->fd >= 0 && close(a_entry->fd)) {
+		zc_error("close fail, maybe cause by write, errno[%d]", errno);
+	}
+	zc_debug("zlog_file_entry_del[%s]", a_entry->path);
+	free(a_entry);
+	return;
+}
+
+static zlog_file_entry_t *zlog_file_entry_new(zlog_file_table_t * a_table, const char *path)
+{
+	struct stat stb;
+	zlog_file_entry_t *a_entry;
+
+	if (strlen(path) > sizeof(a_entry->path) - 1) {
+		zc_error("path[%s] too long", path);
+		return NULL;
+	}
+
+	a_entry = calloc(1, sizeof(zlog_file_entry_t));
+	if (!a_entry) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_entry->fd = -1;
+	strcpy(a_entry->path, path);
+
+	a_entry->fd = open(path, a_table->open_flags | O_WRONLY | O_APPEND | O_CREAT, a_table->perms);
+	ZLOG_TRACE2(file_open, path, a_entry->fd);
+	if (a_entry->fd < 0) {
+		zc_error("open file[%s] fail, errno[%d]", path, errno);
+		goto err;
+	}
+
+	if (fstat(a_entry->fd, &stb)) {
+		zc_error("fstat [%s] fail, errno[%d]", path, errno);
+		goto err;
+	}
+	a_entry->dev = stb.st_dev;
+	a_entry->ino = stb.st_ino;
+	a_entry->size = stb.st_size;
+
+	return a_entry;
+err:
+	zlog_file_entry_del(a_entry);
+	return NULL;
+}
+
+/* moved or removed by logrotate, or by our own rotater,
+ * if not, take the chance to catch up with other writers of the file
+ */
+static int zlog_file_entry_is_stale(zlog_file_entry_t * a_entry)
+{
+	struct stat stb;
+
+	if (stat(a_entry->path, &stb)) return 1;
+	if (stb.st_ino != a_entry->ino || stb.st_dev != a_entry->dev) return 1;
+	zc_atomic_store(&a_entry->size, stb.st_size);
+	return 0;
+}
+
+/*******************************************************************************/
+zlog_file_table_t *zlog_file_table_new(size_t max_count, long timeout,
+		int open_flags, unsigned int perms)
+{
+	zlog_file_table_t *a_table;
+
+	a_table = calloc(1, sizeof(zlog_file_table_t));
+	if (!a_table) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_table->max_count = max_count;
+	a_table->timeout = timeout;
+	a_table->open_flags = open_flags;
+	a_table->perms = perms;
+
+	/* key is the path inside entry, entries are freed by table */
+	a_table->entries = zc_hashtable_new(max_count * 2,
+				zc_hashtable_str_hash,
+				zc_hashtable_str_equal,
+				NULL, NULL);
+	if (!a_table->entries) {
+		zc_error("zc_hashtable_new fail");
+		free(a_table);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&a_table->lock, NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		zc_hashtable_del(a_table->entries);
+		free(a_table);
+		return NULL;
+	}
+
+	zlog_file_table_profile(a_table, ZC_DEBUG);
+	return a_table;
+}
+
+void zlog_file_table_del(zlog_file_table_t * a_table)
+{
+	zlog_file_entry_t *a_entry;
+	zlog_file_entry_t *next;
+
+	zc_assert(a_table,);
+
+	/* rule goes away only after every writer left */
+	for (a_entry = a_table->head; a_entry; a_entry = next) {
+		next = a_entry->next;
+		zlog_file_entry_del(a_entry);
+	}
+	zc_hashtable_del(a_table->entries);
+	pthread_mutex_destroy(&a_table->lock);
+	zc_debug("zlog_file_table_del[%p]", a_table);
+	free(a_table);
+	return;
+}
+
+/*******************************************************************************/
+/* caller holds a_table->lock */
+static void zlog_file_table_unlink(zlog_file_table_t * a_table, zlog_file_entry_t * a_entry)
+{
+	zc_hashtable_remove(a_table->entries, a_entry->path);
+
+	if (a_entry->prev) a_entry->prev->next = a_entry->next;
+	else a_table->head = a_entry->next;
+	if (a_entry->next) a_entry->next->prev = a_entry->prev;
+	else a_table->tail = a_entry->prev;
+	a_entry->prev = a_entry->next = NULL;
+	a_table->count--;
+
+	/* someone is still writing, the last put closes it */
+	if (a_entry->refs) {
+		a_entry->unlinked = 1;
+		return;
+	}
+	zlog_file_entry_del(a_entry);
+	return;
+}
+
+static void zlog_file_table_link(zlog_file_table_t * a_table, zlog_file_entry_t * a_entry)
+{
+	a_entry->prev = NULL;
+	a_entry->next = a_table->head;
+	if (a_table->head) a_table->head->prev = a_entry;
+	else a_table->tail = a_entry;
+	a_table->head = a_entry;
+	a_table->count++;
+	return;
+}
+
+/* least used at tail, stop at the 1st one still alive */
+static void zlog_file_table_sweep(zlog_file_table_t * a_table, time_t now)
+{
+	zlog_file_entry_t *a_entry;
+	zlog_file_entry_t *prev;
+
+	for (a_entry = a_table->tail; a_entry; a_entry = prev) {
+		prev = a_entry->prev;
+		if (now - a_entry->last_used <= a_table->timeout) break;
+		zlog_file_table_unlink(a_table, a_entry);
+	}
+	a_table->last_sweep = now;
+	return;
+}
+
+zlog_file_entry_t *zlog_file_table_get(zlog_file_table_t * a_table, const char *path)
+{
+	time_t now;
+	zlog_file_entry_t *a_entry;
+
+	zc_assert(a_table, NULL);
+	zc_assert(path, NULL);
+
+	now = time(NULL);
+
+	pthread_mutex_lock(&a_table->lock);
+	if (a_table->timeout > 0 && now != a_table->last_sweep) {
+		zlog_file_table_sweep(a_table, now);
+	}
+
+	a_entry = zc_hashtable_get(a_table->entries, path);
+	if (a_entry && a_entry->last_check != now) {
+		/* at most one stat() a second for each path */
+		a_entry->last_check = now;
+		if (zlog_file_entry_is_stale(a_entry)) {
+			zlog_file_table_unlink(a_table, a_entry);
+			a_entry = NULL;
+		}
+	}
+
+	if (a_entry) {
+		a_table->hits++;
+		if (a_entry != a_table->head) {
+			/* move to head */
+			a_entry->prev->next = a_entry->next;
+			if (a_entry->next) a_entry->next->prev = a_entry->prev;
+			else a_table->tail = a_entry->prev;
+			a_table->count--;
+			zlog_file_table_link(a_table, a_entry);
+		}
+	} else {
+		if (a_table->count >= a_table->max_count && a_table->tail) {
+			zlog_file_table_unlink(a_table, a_table->tail);
+		}
+
+		a_entry = zlog_file_entry_new(a_table, path);
+		if (!a_entry) {
+			pthread_mutex_unlock(&a_table->lock);
+			zc_error("zlog_file_entry_new fail");
+			return NULL;
+		}
+		if (zc_hashtable_put(a_table->entries, a_entry->path, a_entry)) {
+			pthread_mutex_unlock(&a_table->lock);
+			zc_error("zc_hashtable_put fail");
+			zlog_file_entry_del(a_entry);
+			return NULL;
+		}
+		a_entry->last_check = now;
+		zlog_file_table_link(a_table, a_entry);
+		a_table->opens++;
+	}
+
+	a_entry->refs++;
+	a_entry->last_used = now;
+	pthread_mutex_unlock(&a_table->lock);
+	return a_entry;
+}
+
+void zlog_file_table_put(zlog_file_table_t * a_table, zlog_file_entry_t * a_entry)
+{
+	zc_assert(a_table,);
+	zc_assert(a_entry,);
+
+	pthread_mutex_lock(&a_table->lock);
+	if (--a_entry->refs == 0 && a_entry->unlinked) {
+		zlog_file_entry_del(a_entry);
+	}
+	pthread_mutex_unlock(&a_table->lock);
+	return;
+}
+
+void zlog_file_table_invalidate(zlog_file_table_t * a_table, const char *path)
+{
+	zlog_file_entry_t *a_entry;
+
+	zc_assert(a_table,);
+	zc_assert(path,);
+
+	pthread_mutex_lock(&a_table->lock);
+	a_entry = zc_hashtable_get(a_table->entries, path);
+	if (a_entry) zlog_file_table_unlink(a_table, a_entry);
+	pthread_mutex_unlock(&a_table->lock);
+	return;
+}
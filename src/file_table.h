@@ -0,0 +1,85 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file file_table.h
+ * @brief keep fds of file paths open between messages
+ *
+ * One table per dynamic file rule or rotating static file rule,
+ * shared by all threads.
+ * Entries are found by the generated path and kept in LRU order,
+ * the least used one is closed when the table is full,
+ * idle ones are closed after timeout seconds.
+ * Once a second an entry is stat()ed again, so a file moved or
+ * removed by others is reopened, and its size is synced for rotation.
+ */
+
+#ifndef __zlog_file_table_h
+#define __zlog_file_table_h
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "zc_defs.h"
+
+typedef struct zlog_file_entry_s {
+	char path[MAXLEN_PATH + 1];
+	int fd;
+	dev_t dev;
+	ino_t ino;
+	size_t size;    /* bytes written, seeded by fstat at open */
+	size_t binlog_seq; /* what a binary rule has put in, see binlog.h */
+
+	int rotating;   /* a rotation is asked, writers stay on fd till done */
+	int refs;       /* writers using fd now */
+	int unlinked;   /* out of the table, close at last put */
+	time_t last_used;
+	time_t last_check;
+
+	struct zlog_file_entry_s *prev; /* more recently used */
+	struct zlog_file_entry_s *next; /* less recently used */
+} zlog_file_entry_t;
+
+typedef struct zlog_file_table_s {
+	pthread_mutex_t lock;
+	zc_hashtable_t *entries;
+	zlog_file_entry_t *head;
+	zlog_file_entry_t *tail;
+	size_t count;
+	size_t max_count;
+	long timeout;
+	time_t last_sweep;
+
+	int open_flags;
+	unsigned int perms;
+
+	size_t hits;
+	size_t opens;
+} zlog_file_table_t;
+
+zlog_file_table_t *zlog_file_table_new(size_t max_count, long timeout,
+		int open_flags, unsigned int perms);
+void zlog_file_table_del(zlog_file_table_t * a_table);
+void zlog_file_table_profile(zlog_file_table_t * a_table, int flag);
+
+/* return an entry whose fd stays open till zlog_file_table_put() */
+zlog_file_entry_t *zlog_file_table_get(zlog_file_table_t * a_table, const char *path);
+void zlog_file_table_put(zlog_file_table_t * a_table, zlog_file_entry_t * a_entry);
+
+/* path is rotated, next get opens it again */
+void zlog_file_table_invalidate(zlog_file_table_t * a_table, const char *path);
+
+#endif
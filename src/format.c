@@ -24,16 +24,20 @@
 #include "thread.h"
 #include "spec.h"
 #include "format.h"
+#include "conf.h"
+#include "level_list.h"
+#include "trace.h"
 
 void zlog_format_profile(zlog_format_t * a_format, int flag)
 {
 
 	zc_assert(a_format,);
-	zc_profile(flag, "---format[%p][%s = %s(%p)]---",
+	zc_profile(flag, "---format[%p][%s = %s(%p)][ops:%d]---",
 		a_format,
 		a_format->name,
 		a_format->pattern,
-		a_format->pattern_specs);
+		a_format->pattern_specs,
+		a_format->op_count);
 
 #if 0
 	int i;
@@ -50,54 +54,131 @@ void zlog_format_profile(zlog_format_t * a_format, int flag)
 void zlog_format_del(zlog_format_t * a_format)
 {
 	zc_assert(a_format,);
+	/* still used by another conf */
+	if (--a_format->refs > 0) return;
 	if (a_format->pattern_specs) {
 		zc_arraylist_del(a_format->pattern_specs);
 	}
+	if (a_format->ops) free(a_format->ops);
+	if (a_format->literals) free(a_format->literals);
 	zc_debug("zlog_format_del[%p]", a_format);
     free(a_format);
 	return;
 }
 
-zlog_format_t *zlog_format_new(char *line, int * time_cache_count)
+/* const specs, including %n %r %%, become one run of literals,
+ * plain ones are written in gen_msg itself without any indirect call
+ */
+static int zlog_format_compile(zlog_format_t * a_format)
 {
-	int nscan = 0;
-	zlog_format_t *a_format = NULL;
-	int nread = 0;
-	const char *p_start;
-	const char *p_end;
-	char *p;
-	char *q;
+	int i;
 	zlog_spec_t *a_spec;
+	zlog_format_op_t *a_op = NULL;
+	const char *str;
+	size_t len = 0;
+	size_t size = 1;
+	char *p;
 
-	zc_assert(line, NULL);
+	zc_arraylist_foreach(a_format->pattern_specs, i, a_spec) {
+		size += (a_spec->type == ZLOG_SPEC_STR) ? a_spec->len : FILE_NEWLINE_LEN + 1;
+	}
 
-	a_format = calloc(1, sizeof(zlog_format_t));
-	if (!a_format) {
+	a_format->ops = calloc(zc_arraylist_len(a_format->pattern_specs) + 1, sizeof(zlog_format_op_t));
+	if (!a_format->ops) {
 		zc_error("calloc fail, errno[%d]", errno);
-		return NULL;
+		return -1;
+	}
+
+	a_format->literals = p = malloc(size);
+	if (!a_format->literals) {
+		zc_error("malloc fail, errno[%d]", errno);
+		return -1;
+	}
+
+	zc_arraylist_foreach(a_format->pattern_specs, i, a_spec) {
+		int reformat = (a_spec->print_fmt[0] != '\0');
+
+		switch (a_spec->type) {
+		case ZLOG_SPEC_STR:
+			str = a_spec->str;
+			len = a_spec->len;
+			break;
+		case ZLOG_SPEC_NEWLINE:
+			str = FILE_NEWLINE;
+			len = FILE_NEWLINE_LEN;
+			break;
+		case ZLOG_SPEC_CR:
+			str = "\r";
+			len = 1;
+			break;
+		case ZLOG_SPEC_PERCENT:
+			str = "%";
+			len = 1;
+			break;
+		default:
+			str = NULL;
+			break;
+		}
+
+		if (str) {
+			memcpy(p, str, len);
+			if (!reformat && a_op && a_op->type == ZLOG_SPEC_STR && !a_op->reformat) {
+				/* merge into last run */
+				a_op->len += len;
+				p += len;
+				continue;
+			}
+			a_op = a_format->ops + a_format->op_count++;
+			a_op->type = ZLOG_SPEC_STR;
+			a_op->str = p;
+			a_op->len = len;
+			p += len;
+		} else {
+			a_op = a_format->ops + a_format->op_count++;
+			a_op->type = a_spec->type;
+		}
+
+		a_op->reformat = reformat;
+		a_op->left_adjust = a_spec->left_adjust;
+		a_op->left_fill_zeros = a_spec->left_fill_zeros;
+		a_op->min_width = a_spec->min_width;
+		a_op->max_width = a_spec->max_width;
+		a_op->spec = a_spec;
 	}
+	*p = '\0';
+
+	return 0;
+}
+
+/* line         default = "%d(%F %X.%l) %-6V (%c:%F:%L) - %m%n"
+ * name         default
+ * pattern      %d(%F %X.%l) %-6V (%c:%F:%L) - %m%n
+ * name and pattern are MAXLEN_CFG_LINE + 1 long
+ */
+static int zlog_format_parse_line(char *line, char *name, char *pattern)
+{
+	int nscan = 0;
+	int nread = 0;
+	const char *p_start;
+	const char *p_end;
+	char *p;
 
-	/* line         default = "%d(%F %X.%l) %-6V (%c:%F:%L) - %m%n"
-	 * name         default
-	 * pattern      %d(%F %X.%l) %-6V (%c:%F:%L) - %m%n
-	 */
-	memset(a_format->name, 0x00, sizeof(a_format->name));
-	nread = 0;
-	nscan = sscanf(line, " %[^= \t] = %n", a_format->name, &nread);
+	memset(name, 0x00, MAXLEN_CFG_LINE + 1);
+	nscan = sscanf(line, " %[^= \t] = %n", name, &nread);
 	if (nscan != 1) {
 		zc_error("format[%s], syntax wrong", line);
-		goto err;
+		return -1;
 	}
 
 	if (*(line + nread) != '"') {
 		zc_error("the 1st char of pattern is not \", line+nread[%s]", line+nread);
-		goto err;
+		return -1;
 	}
 
-	for (p = a_format->name; *p != '\0'; p++) {
+	for (p = name; *p != '\0'; p++) {
 		if ((!isalnum(*p)) && (*p != '_')) {
-			zc_error("a_format->name[%s] character is not in [a-Z][0-9][_]", a_format->name);
-			goto err;
+			zc_error("a_format->name[%s] character is not in [a-Z][0-9][_]", name);
+			return -1;
 		}
 	}
 
@@ -105,18 +186,41 @@ zlog_format_t *zlog_format_new(char *line, int * time_cache_count)
 	p_end = strrchr(p_start, '"');
 	if (!p_end) {
 		zc_error("there is no \" at end of pattern, line[%s]", line);
-		goto err;
+		return -1;
 	}
 
-	if (p_end - p_start > sizeof(a_format->pattern) - 1) {
+	if (p_end - p_start > MAXLEN_CFG_LINE) {
 		zc_error("pattern is too long");
-		goto err;
+		return -1;
 	}
-	memset(a_format->pattern, 0x00, sizeof(a_format->pattern));
-	memcpy(a_format->pattern, p_start, p_end - p_start);
+	memset(pattern, 0x00, MAXLEN_CFG_LINE + 1);
+	memcpy(pattern, p_start, p_end - p_start);
 
-	if (zc_str_replace_env(a_format->pattern, sizeof(a_format->pattern))) {
+	if (zc_str_replace_env(pattern, MAXLEN_CFG_LINE + 1)) {
 		zc_error("zc_str_replace_env fail");
+		return -1;
+	}
+	return 0;
+}
+
+zlog_format_t *zlog_format_new(char *line)
+{
+	zlog_format_t *a_format = NULL;
+	char *p;
+	char *q;
+	zlog_spec_t *a_spec;
+
+	zc_assert(line, NULL);
+
+	a_format = calloc(1, sizeof(zlog_format_t));
+	if (!a_format) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_format->refs = 1;
+
+	if (zlog_format_parse_line(line, a_format->name, a_format->pattern)) {
+		zc_error("zlog_format_parse_line fail");
 		goto err;
 	}
 
@@ -128,7 +232,7 @@ zlog_format_t *zlog_format_new(char *line, int * time_cache_count)
 	}
 
 	for (p = a_format->pattern; *p != '\0'; p = q) {
-		a_spec = zlog_spec_new(p, &q, time_cache_count);
+		a_spec = zlog_spec_new(p, &q);
 		if (!a_spec) {
 			zc_error("zlog_spec_new fail");
 			goto err;
@@ -141,6 +245,11 @@ zlog_format_t *zlog_format_new(char *line, int * time_cache_count)
 		}
 	}
 
+	if (zlog_format_compile(a_format)) {
+		zc_error("zlog_format_compile fail");
+		goto err;
+	}
+
 	zlog_format_profile(a_format, ZC_DEBUG);
 	return a_format;
 err:
@@ -148,24 +257,132 @@ err:
 	return NULL;
 }
 
+/* a format of the last conf is kept if its name and pattern are the same,
+ * so are the rules using it
+ */
+zlog_format_t *zlog_format_renew(char *line, zlog_format_t * old_default,
+		zc_arraylist_t * old_formats)
+{
+	int i;
+	char name[MAXLEN_CFG_LINE + 1];
+	char pattern[MAXLEN_CFG_LINE + 1];
+	zlog_format_t *a_format;
+
+	zc_assert(line, NULL);
+
+	if (!old_default && !old_formats) return zlog_format_new(line);
+	if (zlog_format_parse_line(line, name, pattern)) {
+		zc_error("zlog_format_parse_line fail");
+		return NULL;
+	}
+
+	if (old_default && STRCMP(old_default->name, ==, name)
+		&& STRCMP(old_default->pattern, ==, pattern)) {
+		old_default->refs++;
+		return old_default;
+	}
+	if (old_formats) {
+		zc_arraylist_foreach(old_formats, i, a_format) {
+			if (STRCMP(a_format->name, ==, name)
+				&& STRCMP(a_format->pattern, ==, pattern)) {
+				a_format->refs++;
+				return a_format;
+			}
+		}
+	}
+	return zlog_format_new(line);
+}
+
 /*******************************************************************************/
-/* return 0	success, or buf is full
- * return -1	fail
+/* fast path of zlog_buf_append, most pieces fit in buf */
+#define zlog_format_append(a_buf, str, len) \
+	(((a_buf)->end - (a_buf)->tail >= (long)(len)) \
+	? (memcpy((a_buf)->tail, str, len), (a_buf)->tail += (len), 0) \
+	: zlog_buf_append(a_buf, str, len))
+
+static int zlog_format_write_op(zlog_format_op_t * a_op, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	zlog_event_t *a_event = a_thread->event;
+	zlog_level_t *a_level;
+
+	switch (a_op->type) {
+	case ZLOG_SPEC_STR:
+		return zlog_format_append(a_buf, a_op->str, a_op->len);
+	case ZLOG_SPEC_CATEGORY:
+		return zlog_format_append(a_buf, a_event->category_name, a_event->category_name_len);
+	case ZLOG_SPEC_SRCFILE:
+		if (!a_event->file) {
+			return zlog_format_append(a_buf, "(file=null)", sizeof("(file=null)") - 1);
+		}
+		return zlog_format_append(a_buf, a_event->file, a_event->file_len);
+	case ZLOG_SPEC_SRCLINE:
+		return zlog_buf_printf_dec64(a_buf, a_event->line, 0);
+	case ZLOG_SPEC_SRCFUNC:
+		if (!a_event->func) {
+			return zlog_format_append(a_buf, "(func=null)", sizeof("(func=null)") - 1);
+		}
+		return zlog_format_append(a_buf, a_event->func, a_event->func_len);
+	case ZLOG_SPEC_HOSTNAME:
+		return zlog_format_append(a_buf, a_event->host_name, a_event->host_name_len);
+	case ZLOG_SPEC_LEVEL_LOWERCASE:
+		a_level = zlog_level_list_get(zlog_env_conf->levels, a_event->level);
+		return zlog_format_append(a_buf, a_level->str_lowercase, a_level->str_len);
+	case ZLOG_SPEC_LEVEL_UPPERCASE:
+		a_level = zlog_level_list_get(zlog_env_conf->levels, a_event->level);
+		return zlog_format_append(a_buf, a_level->str_uppercase, a_level->str_len);
+	case ZLOG_SPEC_TID_HEX:
+		return zlog_format_append(a_buf, a_event->tid_hex_str, a_event->tid_hex_str_len);
+	case ZLOG_SPEC_TID_LONG:
+		return zlog_format_append(a_buf, a_event->tid_str, a_event->tid_str_len);
+	case ZLOG_SPEC_KTID:
+		return zlog_format_append(a_buf, a_event->ktid_str, a_event->ktid_str_len);
+	case ZLOG_SPEC_PID:
+		return zlog_format_append(a_buf, zlog_event_pid_str, zlog_event_pid_str_len);
+	case ZLOG_SPEC_USRMSG:
+		if (a_event->generate_cmd == ZLOG_FMT && a_event->str_format) {
+			return zlog_buf_vprintf(a_buf, a_event->str_format, a_event->str_args);
+		}
+		/* hex dump and null format */
+		return a_op->spec->write_buf(a_op->spec, a_thread, a_buf);
+	default:
+		/* time, mdc, pid... */
+		return a_op->spec->write_buf(a_op->spec, a_thread, a_buf);
+	}
+}
+
+/* return 0	success
+ * return -1	fail, or buf is full
  */
 int zlog_format_gen_msg(zlog_format_t * a_format, zlog_thread_t * a_thread)
 {
-	int i;
-	zlog_spec_t *a_spec;
+	zlog_format_op_t *a_op;
+	zlog_format_op_t *end = a_format->ops + a_format->op_count;
 
+	ZLOG_TRACE1(format_entry, a_format->name);
 	zlog_buf_restart(a_thread->msg_buf);
 
-	zc_arraylist_foreach(a_format->pattern_specs, i, a_spec) {
-		if (zlog_spec_gen_msg(a_spec, a_thread) == 0) {
+	for (a_op = a_format->ops; a_op < end; a_op++) {
+		if (!a_op->reformat) {
+			if (zlog_format_write_op(a_op, a_thread, a_thread->msg_buf)) goto err;
 			continue;
-		} else {
-			return -1;
+		}
+
+		/* %-12.35 needs the whole output first */
+		zlog_buf_restart(a_thread->pre_msg_buf);
+		if (zlog_format_write_op(a_op, a_thread, a_thread->pre_msg_buf) < 0) {
+			zc_error("zlog_format_write_op fail");
+			goto err;
+		}
+		if (zlog_buf_adjust_append(a_thread->msg_buf,
+			zlog_buf_str(a_thread->pre_msg_buf), zlog_buf_len(a_thread->pre_msg_buf),
+			a_op->left_adjust, a_op->left_fill_zeros, a_op->min_width, a_op->max_width)) {
+			goto err;
 		}
 	}
 
+	ZLOG_TRACE1(format_return, 0);
 	return 0;
+err:
+	ZLOG_TRACE1(format_return, -1);
+	return -1;
 }
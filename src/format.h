@@ -21,13 +21,34 @@
 
 typedef struct zlog_format_s zlog_format_t;
 
+/* one step of gen_msg, compiled from one spec or a run of const ones */
+typedef struct zlog_format_op_s {
+	int type;               /* ZLOG_SPEC_* */
+	int reformat;
+	const char *str;        /* ZLOG_SPEC_STR, in literals */
+	size_t len;
+	int left_adjust;
+	int left_fill_zeros;
+	size_t min_width;
+	size_t max_width;
+	struct zlog_spec_s *spec;
+} zlog_format_op_t;
+
 struct zlog_format_s {
 	char name[MAXLEN_CFG_LINE + 1];	
 	char pattern[MAXLEN_CFG_LINE + 1];
 	zc_arraylist_t *pattern_specs;
+
+	zlog_format_op_t *ops;
+	int op_count;
+	char *literals;
+
+	int refs; /* confs sharing it, see zlog_format_renew */
 };
 
-zlog_format_t *zlog_format_new(char *line, int * time_cache_count);
+zlog_format_t *zlog_format_new(char *line);
+zlog_format_t *zlog_format_renew(char *line, zlog_format_t * old_default,
+		zc_arraylist_t * old_formats);
 void zlog_format_del(zlog_format_t * a_format);
 void zlog_format_profile(zlog_format_t * a_format, int flag);
 
@@ -0,0 +1,296 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ZLOG_HEX_HAS_SIMD
+#include <immintrin.h>
+#endif
+
+#include "hex.h"
+#include "zc_defs.h"
+
+/* bytes turned into hex and ascii at once, a multiple of the width */
+#define ZLOG_HEX_STAGE 1024
+#define ZLOG_HEX_LINENO_LEN 10
+/* \n, row number, 3 spaces, 2 spaces before ascii */
+#define ZLOG_HEX_ROW_FIXED (1 + ZLOG_HEX_LINENO_LEN + 3 + 2)
+#define ZLOG_HEX_ROW_MAX (ZLOG_HEX_ROW_FIXED + 5 * ZLOG_HEX_WIDTH_MAX)
+
+typedef void (*zlog_hex_conv_fn) (const unsigned char *in, size_t n, char *hex, char *asc);
+
+static const char zlog_hex_digits[] = "0123456789abcdef";
+static const char zlog_hex_head_digits[] = "0123456789ABCDEF";
+
+/*******************************************************************************/
+static void zlog_hex_conv_scalar(const unsigned char *in, size_t n, char *hex, char *asc)
+{
+	size_t i;
+	unsigned char c;
+
+	for (i = 0; i < n; i++) {
+		c = in[i];
+		hex[2 * i] = zlog_hex_digits[c >> 4];
+		hex[2 * i + 1] = zlog_hex_digits[c & 0xf];
+		asc[i] = (c >= 32 && c <= 126) ? c : '.';
+	}
+	return;
+}
+
+#ifdef ZLOG_HEX_HAS_SIMD
+/* nibble n to '0' + n, and 'a' - 10 + n above 9 */
+#define ZLOG_HEX_NIBBLE_SSE2(n) \
+	_mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), \
+		_mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10)))
+
+__attribute__((target("sse2")))
+static void zlog_hex_conv_sse2(const unsigned char *in, size_t n, char *hex, char *asc)
+{
+	size_t i;
+	__m128i v, hi, lo, ok;
+	__m128i mask = _mm_set1_epi8(0x0f);
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(in + i));
+		hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		lo = _mm_and_si128(v, mask);
+		hi = ZLOG_HEX_NIBBLE_SSE2(hi);
+		lo = ZLOG_HEX_NIBBLE_SSE2(lo);
+		_mm_storeu_si128((__m128i *)(hex + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(hex + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+		/* bytes above 127 are negative, so not greater than 31 */
+		ok = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(31)),
+			_mm_cmplt_epi8(v, _mm_set1_epi8(127)));
+		_mm_storeu_si128((__m128i *)(asc + i), _mm_or_si128(_mm_and_si128(ok, v),
+			_mm_andnot_si128(ok, _mm_set1_epi8('.'))));
+	}
+	zlog_hex_conv_scalar(in + i, n - i, hex + 2 * i, asc + i);
+	return;
+}
+
+#define ZLOG_HEX_NIBBLE_AVX2(n) \
+	_mm256_add_epi8(_mm256_add_epi8(n, _mm256_set1_epi8('0')), \
+		_mm256_and_si256(_mm256_cmpgt_epi8(n, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10)))
+
+__attribute__((target("avx2")))
+static void zlog_hex_conv_avx2(const unsigned char *in, size_t n, char *hex, char *asc)
+{
+	size_t i;
+	__m256i v, hi, lo, ok, a, b;
+	__m256i mask = _mm256_set1_epi8(0x0f);
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(in + i));
+		hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+		lo = _mm256_and_si256(v, mask);
+		hi = ZLOG_HEX_NIBBLE_AVX2(hi);
+		lo = ZLOG_HEX_NIBBLE_AVX2(lo);
+		/* unpack works in each 128 bit lane, put the lanes back in order */
+		a = _mm256_unpacklo_epi8(hi, lo);
+		b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *)(hex + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(hex + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+		ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(31)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(127), v));
+		_mm256_storeu_si256((__m256i *)(asc + i), _mm256_or_si256(_mm256_and_si256(ok, v),
+			_mm256_andnot_si256(ok, _mm256_set1_epi8('.'))));
+	}
+	zlog_hex_conv_sse2(in + i, n - i, hex + 2 * i, asc + i);
+	return;
+}
+#endif
+
+static zlog_hex_conv_fn zlog_hex_conv;
+
+int zlog_hex_set_impl(int impl)
+{
+	zlog_hex_conv_fn conv = zlog_hex_conv_scalar;
+
+#ifdef ZLOG_HEX_HAS_SIMD
+	__builtin_cpu_init();
+	if (impl == ZLOG_HEX_AUTO) {
+		impl = ZLOG_HEX_AVX2;
+	}
+	if (impl == ZLOG_HEX_AVX2 && !__builtin_cpu_supports("avx2")) {
+		impl = ZLOG_HEX_SSE2;
+	}
+	if (impl == ZLOG_HEX_SSE2 && !__builtin_cpu_supports("sse2")) {
+		impl = ZLOG_HEX_SCALAR;
+	}
+	if (impl == ZLOG_HEX_AVX2) {
+		conv = zlog_hex_conv_avx2;
+	} else if (impl == ZLOG_HEX_SSE2) {
+		conv = zlog_hex_conv_sse2;
+	} else {
+		impl = ZLOG_HEX_SCALAR;
+	}
+#else
+	impl = ZLOG_HEX_SCALAR;
+#endif
+
+	zc_atomic_store(&zlog_hex_conv, conv);
+	return impl;
+}
+
+/*******************************************************************************/
+static char *zlog_hex_head(char *p, int width, int group)
+{
+	int i;
+	int left;
+
+	*p++ = '\n';
+	memset(p, ' ', ZLOG_HEX_LINENO_LEN + 3);
+	p += ZLOG_HEX_LINENO_LEN + 3;
+	for (i = 0, left = group; i < width; i++, left--) {
+		if (group && !left) {
+			*p++ = ' ';
+			left = group;
+		}
+		p[0] = zlog_hex_head_digits[i & 0xf];
+		p[1] = ' ';
+		p[2] = ' ';
+		p += 3;
+	}
+	p[0] = ' ';
+	p[1] = ' ';
+	p += 2;
+	for (i = 0; i < width; i++) {
+		*p++ = zlog_hex_head_digits[i & 0xf];
+	}
+	return p;
+}
+
+static char *zlog_hex_row(char *p, char *lineno, const char *hex, const char *asc,
+		int n, int width, int group)
+{
+	int i;
+	int left;
+
+	*p++ = '\n';
+	memcpy(p, lineno, ZLOG_HEX_LINENO_LEN);
+	p += ZLOG_HEX_LINENO_LEN;
+	p[0] = ' ';
+	p[1] = ' ';
+	p[2] = ' ';
+	p += 3;
+	for (i = 0, left = group; i < width; i++, left--) {
+		if (group && !left) {
+			*p++ = ' ';
+			left = group;
+		}
+		if (i < n) {
+			p[0] = hex[2 * i];
+			p[1] = hex[2 * i + 1];
+		} else {
+			p[0] = ' ';
+			p[1] = ' ';
+		}
+		p[2] = ' ';
+		p += 3;
+	}
+	p[0] = ' ';
+	p[1] = ' ';
+	p += 2;
+	memcpy(p, asc, n);
+	if (n < width) memset(p + n, ' ', width - n);
+	p += width;
+
+	/* next row number */
+	for (i = ZLOG_HEX_LINENO_LEN - 1; i >= 0; i--) {
+		if (lineno[i] != '9') {
+			lineno[i]++;
+			break;
+		}
+		lineno[i] = '0';
+	}
+	return p;
+}
+
+int zlog_hex_write(zlog_buf_t * a_buf, const void *data, size_t len,
+		int width, int group)
+{
+	int rc;
+	int direct;
+	size_t row_len;
+	size_t rows;
+	size_t stage;
+	size_t done;
+	size_t chunk;
+	size_t i;
+	int n;
+	char *p;
+	zlog_hex_conv_fn conv;
+	const unsigned char *in = data;
+	char lineno[ZLOG_HEX_LINENO_LEN + 1] = "0000000001";
+	char hex[2 * ZLOG_HEX_STAGE];
+	char asc[ZLOG_HEX_STAGE];
+	char row[ZLOG_HEX_ROW_MAX];
+
+	if (width < 1 || width > ZLOG_HEX_WIDTH_MAX) width = 16;
+	if (group < 0 || group >= width) group = 0;
+
+	conv = zc_atomic_load(&zlog_hex_conv);
+	if (!conv) {
+		zlog_hex_set_impl(ZLOG_HEX_AUTO);
+		conv = zc_atomic_load(&zlog_hex_conv);
+	}
+
+	/* head and every row are the same length */
+	row_len = ZLOG_HEX_ROW_FIXED + 4 * width + (group ? (width - 1) / group : 0);
+	rows = len ? (len + width - 1) / width : 1;
+
+	rc = zlog_buf_reserve(a_buf, row_len * (rows + 1));
+	if (rc < 0) {
+		zc_error("zlog_buf_reserve fail");
+		return -1;
+	}
+	/* by conf limit it does not fit, go row by row and let append truncate */
+	direct = (rc == 0);
+
+	p = zlog_hex_head(direct ? a_buf->tail : row, width, group);
+	if (direct) {
+		a_buf->tail = p;
+	} else if ((rc = zlog_buf_append(a_buf, row, p - row))) {
+		return rc;
+	}
+
+	stage = ZLOG_HEX_STAGE / width * width;
+	done = 0;
+	do {
+		chunk = (len - done < stage) ? len - done : stage;
+		conv(in + done, chunk, hex, asc);
+
+		/* one blank row for an empty buf, as before */
+		i = 0;
+		do {
+			n = (chunk - i < width) ? chunk - i : width;
+			p = zlog_hex_row(direct ? a_buf->tail : row, lineno,
+				hex + 2 * i, asc + i, n, width, group);
+			if (direct) {
+				a_buf->tail = p;
+			} else if ((rc = zlog_buf_append(a_buf, row, p - row))) {
+				return rc;
+			}
+			i += n;
+		} while (i < chunk);
+
+		done += chunk;
+	} while (done < len);
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file hex.h
+ * @brief hex + ascii dump of hzlog msgs, od like
+ *
+ * Each row is the row number, width bytes in hex with one more space
+ * every group bytes, and the same bytes as ascii.
+ * The whole dump is reserved in buf once and rows are written straight
+ * into it. Bytes are turned into hex and ascii a row at a time, by sse2
+ * or avx2 when the cpu has it, picked at the first dump.
+ */
+
+#ifndef __zlog_hex_h
+#define __zlog_hex_h
+
+#include <stddef.h>
+
+#include "zc_defs.h"
+#include "buf.h"
+
+#define ZLOG_HEX_WIDTH_MAX 64
+
+#define ZLOG_HEX_AUTO 0
+#define ZLOG_HEX_SCALAR 1
+#define ZLOG_HEX_SSE2 2
+#define ZLOG_HEX_AVX2 3
+
+/* return the impl really used, for tests */
+int zlog_hex_set_impl(int impl);
+
+/* return 0: ok, >0: buf is full and truncated, <0: fail */
+int zlog_hex_write(zlog_buf_t * a_buf, const void *data, size_t len,
+		int width, int group);
+
+#endif
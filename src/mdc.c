@@ -13,58 +13,138 @@
  * limitations under the License.
  */
 
+#include "fmacros.h"
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "mdc.h"
 #include "zc_defs.h"
 
-void zlog_mdc_profile(zlog_mdc_t *a_mdc, int flag)
+/*******************************************************************************/
+/* Keys are only added, under the lock, and only removed all at once by
+ * zlog_mdc_keys_fini(), which makes slots of every mdc stale by the epoch.
+ * Readers probe without lock, an entry is seen only after its key is stored.
+ */
+#define ZLOG_MDC_KEYS_BUCKETS (ZLOG_MDC_KEYS_MAX * 2)
+
+typedef struct {
+	char *key;
+	int index;
+} zlog_mdc_key_entry_t;
+
+static pthread_mutex_t zlog_mdc_keys_lock = PTHREAD_MUTEX_INITIALIZER;
+static zlog_mdc_key_entry_t zlog_mdc_keys[ZLOG_MDC_KEYS_BUCKETS];
+static char *zlog_mdc_key_names[ZLOG_MDC_KEYS_MAX];
+static int zlog_mdc_nkeys;
+static unsigned int zlog_mdc_keys_epoch;
+
+static int zlog_mdc_key_find(const char *key, unsigned int *bucket)
 {
-	zc_hashtable_entry_t *a_entry;
-	zlog_mdc_kv_t *a_mdc_kv;
+	unsigned int i;
+	char *a_key;
 
-	zc_assert(a_mdc,);
-	zc_profile(flag, "---mdc[%p]---", a_mdc);
+	i = zc_hashtable_str_hash(key) % ZLOG_MDC_KEYS_BUCKETS;
+	while (1) {
+		a_key = zc_atomic_load(&zlog_mdc_keys[i].key);
+		if (!a_key) break;
+		if (STRCMP(a_key, ==, key)) return zlog_mdc_keys[i].index;
+		i = (i + 1) % ZLOG_MDC_KEYS_BUCKETS;
+	}
+	if (bucket) *bucket = i;
+	return -1;
+}
+
+int zlog_mdc_key_index(const char *key)
+{
+	int index;
+	unsigned int i;
+	char *a_key;
 
-	zc_hashtable_foreach(a_mdc->tab, a_entry) {
-		a_mdc_kv = a_entry->value;
-		zc_profile(flag, "----mdc_kv[%p][%s]-[%s]----",
-				a_mdc_kv,
-				a_mdc_kv->key, a_mdc_kv->value);
+	index = zlog_mdc_key_find(key, NULL);
+	if (index >= 0) return index;
+
+	pthread_mutex_lock(&zlog_mdc_keys_lock);
+	/* some other thread may just add it */
+	index = zlog_mdc_key_find(key, &i);
+	if (index >= 0) goto exit;
+
+	if (zlog_mdc_nkeys >= ZLOG_MDC_KEYS_MAX) {
+		zc_error("more than %d mdc keys, no room for [%s]", ZLOG_MDC_KEYS_MAX, key);
+		goto exit;
 	}
-	return;
+	a_key = strdup(key);
+	if (!a_key) {
+		zc_error("strdup fail, errno[%d]", errno);
+		goto exit;
+	}
+	index = zlog_mdc_nkeys;
+	zlog_mdc_key_names[index] = a_key;
+	zlog_mdc_keys[i].index = index;
+	zc_atomic_store(&zlog_mdc_keys[i].key, a_key);
+	zc_atomic_store(&zlog_mdc_nkeys, index + 1);
+exit:
+	pthread_mutex_unlock(&zlog_mdc_keys_lock);
+	return index;
 }
-/*******************************************************************************/
-void zlog_mdc_del(zlog_mdc_t * a_mdc)
+
+void zlog_mdc_keys_fini(void)
 {
-	zc_assert(a_mdc,);
-	if (a_mdc->tab) zc_hashtable_del(a_mdc->tab);
-	zc_debug("zlog_mdc_del[%p]", a_mdc);
-    free(a_mdc);
+	int i;
+
+	pthread_mutex_lock(&zlog_mdc_keys_lock);
+	for (i = 0; i < zlog_mdc_nkeys; i++) {
+		free(zlog_mdc_key_names[i]);
+		zlog_mdc_key_names[i] = NULL;
+	}
+	memset(zlog_mdc_keys, 0x00, sizeof(zlog_mdc_keys));
+	zc_atomic_store(&zlog_mdc_nkeys, 0);
+	zc_atomic_add(&zlog_mdc_keys_epoch, 1);
+	pthread_mutex_unlock(&zlog_mdc_keys_lock);
 	return;
 }
 
-static void zlog_mdc_kv_del(zlog_mdc_kv_t * a_mdc_kv)
+/* values put before the keys were forgotten are gone with them */
+static int zlog_mdc_stale(zlog_mdc_t * a_mdc)
 {
-	zc_debug("zlog_mdc_kv_del[%p]", a_mdc_kv);
-    free(a_mdc_kv);
+	return a_mdc->epoch != zc_atomic_load(&zlog_mdc_keys_epoch);
 }
 
-static zlog_mdc_kv_t *zlog_mdc_kv_new(const char *key, const char *value)
+/*******************************************************************************/
+void zlog_mdc_profile(zlog_mdc_t *a_mdc, int flag)
 {
-	zlog_mdc_kv_t *a_mdc_kv;
+	int i;
+	zlog_mdc_slot_t *a_slot;
 
-	a_mdc_kv = calloc(1, sizeof(zlog_mdc_kv_t));
-	if (!a_mdc_kv) {
-		zc_error("calloc fail, errno[%d]", errno);
-		return NULL;
+	zc_assert(a_mdc,);
+	zc_profile(flag, "---mdc[%p][%d]---", a_mdc, a_mdc->nslots);
+	if (zlog_mdc_stale(a_mdc)) return;
+
+	for (i = 0; i < a_mdc->nslots; i++) {
+		a_slot = &a_mdc->slots[i];
+		if (!a_slot->set) continue;
+		zc_profile(flag, "----mdc_slot[%d][%s]-[%s]----",
+				i, zlog_mdc_key_names[i], a_slot->value);
 	}
+	return;
+}
 
-	snprintf(a_mdc_kv->key, sizeof(a_mdc_kv->key), "%s", key);
-	a_mdc_kv->value_len = snprintf(a_mdc_kv->value, sizeof(a_mdc_kv->value), "%s", value);
-	return a_mdc_kv;
+void zlog_mdc_del(zlog_mdc_t * a_mdc)
+{
+	zlog_mdc_chunk_t *a_chunk;
+
+	zc_assert(a_mdc,);
+	while ((a_chunk = a_mdc->chunks)) {
+		a_mdc->chunks = a_chunk->next;
+		free(a_chunk);
+	}
+	if (a_mdc->slots) free(a_mdc->slots);
+	zc_debug("zlog_mdc_del[%p]", a_mdc);
+	free(a_mdc);
+	return;
 }
 
 zlog_mdc_t *zlog_mdc_new(void)
@@ -77,14 +157,13 @@ zlog_mdc_t *zlog_mdc_new(void)
 		return NULL;
 	}
 
-	a_mdc->tab = zc_hashtable_new(20,
-			      zc_hashtable_str_hash,
-			      zc_hashtable_str_equal, NULL,
-			      (zc_hashtable_del_fn) zlog_mdc_kv_del);
-	if (!a_mdc->tab) {
-		zc_error("zc_hashtable_new fail");
+	a_mdc->chunks = calloc(1, sizeof(zlog_mdc_chunk_t));
+	if (!a_mdc->chunks) {
+		zc_error("calloc fail, errno[%d]", errno);
 		goto err;
 	}
+	a_mdc->cur_chunk = a_mdc->chunks;
+	a_mdc->epoch = zc_atomic_load(&zlog_mdc_keys_epoch);
 
 	//zlog_mdc_profile(a_mdc, ZC_DEBUG);
 	return a_mdc;
@@ -94,59 +173,131 @@ err:
 }
 
 /*******************************************************************************/
-int zlog_mdc_put(zlog_mdc_t * a_mdc, const char *key, const char *value)
+/* slots for every key known by now, so growing is rare */
+static int zlog_mdc_expand(zlog_mdc_t * a_mdc, int index)
 {
-	zlog_mdc_kv_t *a_mdc_kv;
+	int nslots;
+	zlog_mdc_slot_t *slots;
 
-	a_mdc_kv = zlog_mdc_kv_new(key, value);
-	if (!a_mdc_kv) {
-		zc_error("zlog_mdc_kv_new failed");
+	nslots = zc_atomic_load(&zlog_mdc_nkeys);
+	if (nslots <= index) nslots = index + 1;
+	slots = realloc(a_mdc->slots, sizeof(zlog_mdc_slot_t) * nslots);
+	if (!slots) {
+		zc_error("realloc fail, errno[%d]", errno);
 		return -1;
 	}
+	memset(slots + a_mdc->nslots, 0x00, sizeof(zlog_mdc_slot_t) * (nslots - a_mdc->nslots));
+	a_mdc->slots = slots;
+	a_mdc->nslots = nslots;
+	return 0;
+}
+
+/* cap in power of 2, so a value growing by and by takes few steps */
+static char *zlog_mdc_alloc(zlog_mdc_t * a_mdc, size_t *cap)
+{
+	size_t size = 32;
+	zlog_mdc_chunk_t *a_chunk = a_mdc->cur_chunk;
+
+	while (size < *cap) size <<= 1;
+	if (a_chunk->used + size > sizeof(a_chunk->data)) {
+		/* chunks after the current one are free */
+		if (!a_chunk->next) {
+			a_chunk->next = calloc(1, sizeof(zlog_mdc_chunk_t));
+			if (!a_chunk->next) {
+				zc_error("calloc fail, errno[%d]", errno);
+				return NULL;
+			}
+		}
+		a_chunk = a_mdc->cur_chunk = a_chunk->next;
+		a_chunk->used = 0;
+	}
 
-	if (zc_hashtable_put(a_mdc->tab, a_mdc_kv->key, a_mdc_kv)) {
-		zc_error("zc_hashtable_put fail");
-		zlog_mdc_kv_del(a_mdc_kv);
+	a_chunk->used += size;
+	*cap = size;
+	return a_chunk->data + a_chunk->used - size;
+}
+
+int zlog_mdc_put(zlog_mdc_t * a_mdc, const char *key, const char *value)
+{
+	int index;
+	size_t len;
+	size_t cap;
+	zlog_mdc_slot_t *a_slot;
+
+	if (zlog_mdc_stale(a_mdc)) {
+		zlog_mdc_clean(a_mdc);
+		a_mdc->epoch = zc_atomic_load(&zlog_mdc_keys_epoch);
+	}
+
+	index = zlog_mdc_key_index(key);
+	if (index < 0) {
+		zc_error("zlog_mdc_key_index[%s] fail", key);
 		return -1;
 	}
+	if (index >= a_mdc->nslots && zlog_mdc_expand(a_mdc, index)) {
+		zc_error("zlog_mdc_expand fail");
+		return -1;
+	}
+	a_slot = &a_mdc->slots[index];
 
+	len = strlen(value);
+	if (len > MAXLEN_PATH) len = MAXLEN_PATH;
+	if (len + 1 > a_slot->cap) {
+		/* old space is left till clean */
+		cap = len + 1;
+		a_slot->value = zlog_mdc_alloc(a_mdc, &cap);
+		if (!a_slot->value) {
+			zc_error("zlog_mdc_alloc fail");
+			a_slot->cap = 0;
+			a_slot->set = 0;
+			return -1;
+		}
+		a_slot->cap = cap;
+	}
+	memcpy(a_slot->value, value, len);
+	a_slot->value[len] = '\0';
+	a_slot->len = len;
+	a_slot->set = 1;
 	return 0;
 }
 
 void zlog_mdc_clean(zlog_mdc_t * a_mdc)
 {
-	zc_hashtable_clean(a_mdc->tab);
+	if (a_mdc->nslots) memset(a_mdc->slots, 0x00, sizeof(zlog_mdc_slot_t) * a_mdc->nslots);
+	a_mdc->cur_chunk = a_mdc->chunks;
+	a_mdc->cur_chunk->used = 0;
 	return;
 }
 
-char *zlog_mdc_get(zlog_mdc_t * a_mdc, const char *key)
+char *zlog_mdc_get_at(zlog_mdc_t * a_mdc, int index, size_t *len)
 {
-	zlog_mdc_kv_t *a_mdc_kv;
+	zlog_mdc_slot_t *a_slot;
 
-	a_mdc_kv = zc_hashtable_get(a_mdc->tab, key);
-	if (!a_mdc_kv) {
-		zc_error("zc_hashtable_get fail");
-		return NULL;
-	} else {
-		return a_mdc_kv->value;
-	}
+	if (index < 0 || index >= a_mdc->nslots || zlog_mdc_stale(a_mdc)) return NULL;
+	a_slot = &a_mdc->slots[index];
+	if (!a_slot->set) return NULL;
+	if (len) *len = a_slot->len;
+	return a_slot->value;
 }
 
-zlog_mdc_kv_t *zlog_mdc_get_kv(zlog_mdc_t * a_mdc, const char *key)
+char *zlog_mdc_get(zlog_mdc_t * a_mdc, const char *key)
 {
-	zlog_mdc_kv_t *a_mdc_kv;
+	char *value;
 
-	a_mdc_kv = zc_hashtable_get(a_mdc->tab, key);
-	if (!a_mdc_kv) {
-		zc_error("zc_hashtable_get fail");
+	value = zlog_mdc_get_at(a_mdc, zlog_mdc_key_find(key, NULL), NULL);
+	if (!value) {
+		zc_error("key[%s] not put", key);
 		return NULL;
-	} else {
-		return a_mdc_kv;
 	}
+	return value;
 }
 
 void zlog_mdc_remove(zlog_mdc_t * a_mdc, const char *key)
 {
-	zc_hashtable_remove(a_mdc->tab, key);
+	int index;
+
+	index = zlog_mdc_key_find(key, NULL);
+	/* keep the space for the next put */
+	if (index >= 0 && index < a_mdc->nslots && !zlog_mdc_stale(a_mdc)) a_mdc->slots[index].set = 0;
 	return;
 }
@@ -18,9 +18,39 @@
 
 #include "zc_defs.h"
 
+/* keys ever put or used by %M(key) in the process, each gets a slot */
+#define ZLOG_MDC_KEYS_MAX 1024
+/* values of a thread live in chunks of this size, never moved */
+#define ZLOG_MDC_CHUNK_SIZE 4096
+
+/* the index of key, register it if not yet, -1 if no room */
+int zlog_mdc_key_index(const char *key);
+/* forget all keys, no one may look keys up meanwhile */
+void zlog_mdc_keys_fini(void);
+
+typedef struct zlog_mdc_slot_s {
+	char *value;
+	size_t len;
+	size_t cap; /* value can grow in place up to cap */
+	int set;
+} zlog_mdc_slot_t;
+
+typedef struct zlog_mdc_chunk_s {
+	struct zlog_mdc_chunk_s *next;
+	size_t used;
+	char data[ZLOG_MDC_CHUNK_SIZE];
+} zlog_mdc_chunk_t;
+
+/* per thread, a put copies the value into the slot of its key,
+ * space for it comes from chunks, which a clean hands back at once
+ */
 typedef struct zlog_mdc_s zlog_mdc_t;
 struct zlog_mdc_s {
-	zc_hashtable_t *tab;
+	zlog_mdc_slot_t *slots;
+	int nslots;
+	zlog_mdc_chunk_t *chunks;
+	zlog_mdc_chunk_t *cur_chunk;
+	unsigned int epoch; /* of keys the slots are indexed by */
 };
 
 zlog_mdc_t *zlog_mdc_new(void);
@@ -32,12 +62,7 @@ int zlog_mdc_put(zlog_mdc_t * a_mdc, const char *key, const char *value);
 char *zlog_mdc_get(zlog_mdc_t * a_mdc, const char *key);
 void zlog_mdc_remove(zlog_mdc_t * a_mdc, const char *key);
 
-typedef struct zlog_mdc_kv_s {
-	char key[MAXLEN_PATH + 1];
-	char value[MAXLEN_PATH + 1];
-	size_t value_len;
-} zlog_mdc_kv_t;
-
-zlog_mdc_kv_t *zlog_mdc_get_kv(zlog_mdc_t * a_mdc, const char *key);
+/* for %M(key), index from zlog_mdc_key_index(), NULL if not put */
+char *zlog_mdc_get_at(zlog_mdc_t * a_mdc, int index, size_t *len);
 
 #endif
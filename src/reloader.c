@@ -0,0 +1,373 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "reloader.h"
+#include "zc_defs.h"
+
+void zlog_reloader_profile(zlog_reloader_t * a_reloader, int flag)
+{
+	zc_assert(a_reloader,);
+	zc_profile(flag, "---reloader[%p][%s][mode:%d][period:%ld][delay:%ld][reloads:%ld]---",
+		a_reloader,
+		a_reloader->file,
+		a_reloader->mode,
+		a_reloader->period,
+		a_reloader->delay,
+		(long)a_reloader->reloads);
+	return;
+}
+
+/*******************************************************************************/
+static long zlog_reloader_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void zlog_reloader_stat(const char *file, zlog_reloader_stat_t * a_stat)
+{
+	struct stat stb;
+
+	memset(a_stat, 0x00, sizeof(*a_stat));
+	if (stat(file, &stb)) return;
+
+	a_stat->exist = 1;
+	a_stat->dev = stb.st_dev;
+	a_stat->ino = stb.st_ino;
+	a_stat->size = stb.st_size;
+#if defined(__APPLE__)
+	a_stat->mtime = stb.st_mtimespec;
+#else
+	a_stat->mtime = stb.st_mtim;
+#endif
+	return;
+}
+
+static int zlog_reloader_stat_same(zlog_reloader_stat_t * a, zlog_reloader_stat_t * b)
+{
+	return a->exist == b->exist
+		&& a->dev == b->dev
+		&& a->ino == b->ino
+		&& a->size == b->size
+		&& a->mtime.tv_sec == b->mtime.tv_sec
+		&& a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+#ifdef __linux__
+/* editors write a new file and rename it over, so watch the name in its directory */
+static int zlog_reloader_watch(const char *file, char *name)
+{
+	int fd;
+	char dir[MAXLEN_PATH + 1];
+	char *p;
+
+	strcpy(dir, file);
+	p = strrchr(dir, '/');
+	if (!p) {
+		strcpy(name, dir);
+		strcpy(dir, ".");
+	} else {
+		strcpy(name, p + 1);
+		if (p == dir) p++;
+		*p = '\0';
+	}
+
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		zc_error("inotify_init1 fail, errno[%d]", errno);
+		return -1;
+	}
+	if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+			| IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) < 0) {
+		zc_error("inotify_add_watch[%s] fail, errno[%d]", dir, errno);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 1 if any event is about the conf file */
+static int zlog_reloader_read_inotify(int fd, const char *name)
+{
+	int hit = 0;
+	ssize_t len;
+	char *p;
+	struct inotify_event *event;
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *) p;
+			if ((event->mask & IN_Q_OVERFLOW)
+				|| (event->len && STRCMP(event->name, ==, name))) {
+				hit = 1;
+			}
+		}
+	}
+	return hit;
+}
+#endif
+
+static void *zlog_reloader_work(void *arg)
+{
+	zlog_reloader_t *a_reloader = arg;
+	char file[MAXLEN_PATH + 1];
+	char name[MAXLEN_PATH + 1];
+	int mode;
+	long period;
+	long delay;
+	int inotify_fd = -1;
+	struct pollfd fds[2];
+	int nfds;
+	int rc;
+	char c;
+	int pending = 0;
+	long deadline = 0;
+	long timeout;
+	zlog_reloader_stat_t last;
+	zlog_reloader_stat_t seen;
+	zlog_reloader_stat_t now;
+
+	while (1) {
+		/* (re)start watching by the latest settings */
+		pthread_mutex_lock(&a_reloader->lock);
+		if (a_reloader->stop) {
+			pthread_mutex_unlock(&a_reloader->lock);
+			break;
+		}
+		strcpy(file, a_reloader->file);
+		mode = a_reloader->mode;
+		period = a_reloader->period > 0 ? a_reloader->period : 1;
+		delay = a_reloader->delay > 0 ? a_reloader->delay : 0;
+		last = a_reloader->loaded;
+		pthread_mutex_unlock(&a_reloader->lock);
+
+		if (inotify_fd >= 0) {
+			close(inotify_fd);
+			inotify_fd = -1;
+		}
+		if (file[0] == '\0') mode = ZLOG_RELOAD_CHECK_OFF;
+#ifdef __linux__
+		if (mode == ZLOG_RELOAD_CHECK_INOTIFY) {
+			inotify_fd = zlog_reloader_watch(file, name);
+			if (inotify_fd < 0) {
+				zc_warn("no inotify on [%s], stat it every [%ld] ms instead", file, period);
+				mode = ZLOG_RELOAD_CHECK_PERIOD;
+			}
+		}
+#else
+		if (mode == ZLOG_RELOAD_CHECK_INOTIFY) mode = ZLOG_RELOAD_CHECK_PERIOD;
+#endif
+		/* changed before being watched */
+		zlog_reloader_stat(file, &seen);
+		pending = (mode != ZLOG_RELOAD_CHECK_OFF && !zlog_reloader_stat_same(&seen, &last));
+		deadline = zlog_reloader_now() + delay;
+
+		fds[0].fd = a_reloader->pipe_fd[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = inotify_fd;
+		fds[1].events = POLLIN;
+		nfds = (inotify_fd >= 0) ? 2 : 1;
+
+		while (1) {
+			if (pending) {
+				timeout = deadline - zlog_reloader_now();
+				if (timeout < 0) timeout = 0;
+			} else if (mode == ZLOG_RELOAD_CHECK_PERIOD) {
+				timeout = period;
+			} else {
+				timeout = -1;
+			}
+
+			rc = poll(fds, nfds, (int)timeout);
+			if (rc < 0) {
+				if (errno == EINTR) continue;
+				zc_error("poll fail, errno[%d]", errno);
+				break;
+			}
+
+			if (fds[0].revents) {
+				if (read(a_reloader->pipe_fd[0], &c, 1) < 0) {
+					zc_error("read fail, errno[%d]", errno);
+				}
+				break;
+			}
+
+#ifdef __linux__
+			if (nfds == 2 && fds[1].revents) {
+				if (zlog_reloader_read_inotify(inotify_fd, name)) {
+					/* quiet for delay ms from the last event */
+					pending = 1;
+					deadline = zlog_reloader_now() + delay;
+				}
+				continue;
+			}
+#endif
+			if (rc > 0) continue;
+
+			zlog_reloader_stat(file, &now);
+			if (!pending) {
+				/* period tick */
+				if (zlog_reloader_stat_same(&now, &last)) continue;
+				pending = 1;
+				seen = now;
+				deadline = zlog_reloader_now() + delay;
+				continue;
+			}
+
+			if (mode == ZLOG_RELOAD_CHECK_PERIOD && !zlog_reloader_stat_same(&now, &seen)) {
+				/* still being written */
+				seen = now;
+				deadline = zlog_reloader_now() + delay;
+				continue;
+			}
+
+			pending = 0;
+			/* gone for a moment while being replaced, wait for it to come back */
+			if (!now.exist || zlog_reloader_stat_same(&now, &last)) continue;
+			last = now;
+			seen = now;
+
+			zc_debug("conf[%s] changed, reload", file);
+			a_reloader->reloads++;
+			if (a_reloader->reload()) {
+				zc_error("conf[%s] changed but reload fail, zlog-chk-conf [file] see detail", file);
+			}
+		}
+		if (rc < 0) break;
+	}
+
+	if (inotify_fd >= 0) close(inotify_fd);
+	return NULL;
+}
+
+/*******************************************************************************/
+static int zlog_reloader_wake(zlog_reloader_t * a_reloader)
+{
+	if (write(a_reloader->pipe_fd[1], "r", 1) < 0) {
+		zc_error("write fail, errno[%d]", errno);
+		return -1;
+	}
+	return 0;
+}
+
+int zlog_reloader_set(zlog_reloader_t * a_reloader, const char *file,
+		int mode, long period, long delay)
+{
+	zlog_reloader_stat_t loaded;
+
+	zc_assert(a_reloader, -1);
+	zc_assert(file, -1);
+
+	if (strlen(file) > sizeof(a_reloader->file) - 1) {
+		zc_error("file[%s] too long", file);
+		return -1;
+	}
+
+	/* a change after loading but before the thread looks is not missed */
+	zlog_reloader_stat(file, &loaded);
+	pthread_mutex_lock(&a_reloader->lock);
+	a_reloader->loaded = loaded;
+	if (STRCMP(a_reloader->file, ==, file) && a_reloader->mode == mode
+		&& a_reloader->period == period && a_reloader->delay == delay) {
+		pthread_mutex_unlock(&a_reloader->lock);
+		return 0;
+	}
+	strcpy(a_reloader->file, file);
+	a_reloader->mode = mode;
+	a_reloader->period = period;
+	a_reloader->delay = delay;
+	pthread_mutex_unlock(&a_reloader->lock);
+
+	zlog_reloader_profile(a_reloader, ZC_DEBUG);
+	return zlog_reloader_wake(a_reloader);
+}
+
+zlog_reloader_t *zlog_reloader_new(zlog_reloader_fn reload)
+{
+	int rc;
+	zlog_reloader_t *a_reloader;
+
+	zc_assert(reload, NULL);
+
+	a_reloader = calloc(1, sizeof(zlog_reloader_t));
+	if (!a_reloader) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_reloader->reload = reload;
+	a_reloader->mode = ZLOG_RELOAD_CHECK_OFF;
+
+	rc = pthread_mutex_init(&a_reloader->lock, NULL);
+	if (rc) {
+		zc_error("pthread_mutex_init fail, rc[%d]", rc);
+		free(a_reloader);
+		return NULL;
+	}
+
+	if (pipe(a_reloader->pipe_fd)) {
+		zc_error("pipe fail, errno[%d]", errno);
+		goto err;
+	}
+
+	rc = pthread_create(&a_reloader->tid, NULL, zlog_reloader_work, a_reloader);
+	if (rc) {
+		zc_error("pthread_create fail, rc[%d]", rc);
+		close(a_reloader->pipe_fd[0]);
+		close(a_reloader->pipe_fd[1]);
+		goto err;
+	}
+
+	return a_reloader;
+err:
+	pthread_mutex_destroy(&a_reloader->lock);
+	free(a_reloader);
+	return NULL;
+}
+
+void zlog_reloader_del(zlog_reloader_t * a_reloader)
+{
+	zc_assert(a_reloader,);
+
+	pthread_mutex_lock(&a_reloader->lock);
+	a_reloader->stop = 1;
+	pthread_mutex_unlock(&a_reloader->lock);
+	zlog_reloader_wake(a_reloader);
+	pthread_join(a_reloader->tid, NULL);
+
+	close(a_reloader->pipe_fd[0]);
+	close(a_reloader->pipe_fd[1]);
+	pthread_mutex_destroy(&a_reloader->lock);
+	zc_debug("zlog_reloader_del[%p]", a_reloader);
+	free(a_reloader);
+	return;
+}
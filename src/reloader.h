@@ -0,0 +1,75 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reloader.h
+ * @brief reload when the conf file really changes
+ *
+ * One thread per process watches the conf file, by inotify on its
+ * directory or by stat() every period ms, and calls reload once the
+ * file has been quiet for delay ms and its mtime, size or inode is
+ * not what it was. So loggers keep no count and never stat the conf.
+ */
+
+#ifndef __zlog_reloader_h
+#define __zlog_reloader_h
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "zc_defs.h"
+
+#define ZLOG_RELOAD_CHECK_OFF 0
+#define ZLOG_RELOAD_CHECK_PERIOD 1
+#define ZLOG_RELOAD_CHECK_INOTIFY 2
+
+typedef int (*zlog_reloader_fn) (void);
+
+/* what tells a file is changed */
+typedef struct {
+	int exist;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+} zlog_reloader_stat_t;
+
+typedef struct zlog_reloader_s {
+	pthread_mutex_t lock;
+	char file[MAXLEN_PATH + 1];
+	int mode;
+	long period; /* ms */
+	long delay;  /* ms */
+	int stop;
+	zlog_reloader_stat_t loaded; /* the file when set, i.e. just loaded */
+
+	int pipe_fd[2]; /* wake the thread up */
+	pthread_t tid;
+	zlog_reloader_fn reload;
+
+	size_t reloads;
+} zlog_reloader_t;
+
+zlog_reloader_t *zlog_reloader_new(zlog_reloader_fn reload);
+/* wait for the thread, which may be in reload, so not under zlog_env_lock */
+void zlog_reloader_del(zlog_reloader_t * a_reloader);
+void zlog_reloader_profile(zlog_reloader_t * a_reloader, int flag);
+
+/* file is just loaded, watch it or another way from now on */
+int zlog_reloader_set(zlog_reloader_t * a_reloader, const char *file,
+		int mode, long period, long delay);
+
+#endif
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE /* For SCHED_IDLE of the compressor */
 #include <string.h>
 
 #ifdef _WIN32
@@ -28,18 +29,43 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <fnmatch.h>
+#include <sys/inotify.h>
+#endif
+#ifdef ZLOG_ZLIB
+#include <zlib.h>
+#endif
 
 #include "zc_defs.h"
 #include "rotater.h"
+#include "trace.h"
 
 #define ROLLING  1     /* aa.02->aa.03, aa.01->aa.02, aa->aa.01 */
 #define SEQUENCE 2     /* aa->aa.03 */
 
+#define GZ_SUFFIX ".gz"
+
+/* indexes kept at most, rotating dynamic paths could make no end of them */
+#define ZLOG_ROTATER_INDEX_MAX 64
+
 typedef struct {
 	int index;
-	char path[MAXLEN_PATH + 1];
+	int gz;     /* compressed, keeps .gz when moved */
+	char *path;
 } zlog_file_t;
 
+/* the archives of one glob_path, in order of index */
+typedef struct {
+	char glob_path[MAXLEN_PATH + 1];	/* key */
+	char base_path[MAXLEN_PATH + 1];	/* not one of them */
+	size_t name_off;			/* glob_path + name_off is aa.*.log */
+	int wd;					/* on the dir, -1 as never trusted */
+	int valid;
+	zc_arraylist_t *files;			/* zlog_file_t owned here */
+} zlog_archive_index_t;
+
 void zlog_rotater_profile(zlog_rotater_t * a_rotater, int flag)
 {
 	zc_assert(a_rotater,);
@@ -59,6 +85,19 @@ void zlog_rotater_profile(zlog_rotater_t * a_rotater, int flag)
 		a_rotater->mv_type,
 		a_rotater->max_count
 		);
+	zc_profile(flag, "---rotater worker[started:%d][pid:%ld][busy:%d][rotations:%ld]---",
+		a_rotater->started,
+		(long)a_rotater->pid,
+		a_rotater->busy,
+		(long)a_rotater->rotations);
+	zc_profile(flag, "---rotater compressor[compress:%d][started:%d][compressions:%ld]---",
+		a_rotater->compress,
+		a_rotater->gz_started,
+		(long)a_rotater->compressions);
+	zc_profile(flag, "---rotater index[count:%ld][inotify_fd:%d][scans:%ld]---",
+		(long)a_rotater->index_count,
+		a_rotater->inotify_fd,
+		(long)a_rotater->scans);
 	if (a_rotater->files) {
 		int i;
 		zlog_file_t *a_file;
@@ -70,10 +109,15 @@ void zlog_rotater_profile(zlog_rotater_t * a_rotater, int flag)
 }
 
 /*******************************************************************************/
+static void zlog_rotater_stop(zlog_rotater_t *a_rotater);
+static void zlog_archive_index_del(zlog_archive_index_t *a_index);
+
 void zlog_rotater_del(zlog_rotater_t *a_rotater)
 {
 	zc_assert(a_rotater,);
 
+	zlog_rotater_stop(a_rotater);
+
 	if (a_rotater->lock_fd != INVALID_LOCK_FD) {
 		if (!unlock_file(a_rotater->lock_fd)) {
 			zc_error("close fail, errno[%d]", errno);
@@ -84,13 +128,20 @@ void zlog_rotater_del(zlog_rotater_t *a_rotater)
 	if (pthread_mutex_destroy(&(a_rotater->lock_mutex))) {
 		zc_error("pthread_mutex_destroy fail, errno[%d]", errno);
 	}
+	pthread_cond_destroy(&(a_rotater->gz_cond));
+	pthread_cond_destroy(&(a_rotater->idle_cond));
+	pthread_cond_destroy(&(a_rotater->job_cond));
+	pthread_mutex_destroy(&(a_rotater->job_mutex));
+
+	zc_hashtable_del(a_rotater->indexes);
+	if (a_rotater->inotify_fd >= 0) close(a_rotater->inotify_fd);
 
 	zc_debug("zlog_rotater_del[%p]", a_rotater);
     free(a_rotater);
 	return;
 }
 
-zlog_rotater_t *zlog_rotater_new(char *lock_file)
+zlog_rotater_t *zlog_rotater_new(char *lock_file, int compress)
 {
 	zlog_rotater_t *a_rotater;
 
@@ -108,13 +159,53 @@ zlog_rotater_t *zlog_rotater_new(char *lock_file)
 		return NULL;
 	}
 
+	if (pthread_mutex_init(&(a_rotater->job_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		goto err_mutex;
+	}
+	if (pthread_cond_init(&(a_rotater->job_cond), NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		goto err_job_mutex;
+	}
+	if (pthread_cond_init(&(a_rotater->idle_cond), NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		goto err_job_cond;
+	}
+	if (pthread_cond_init(&(a_rotater->gz_cond), NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		goto err_idle_cond;
+	}
+
+	/* key is the glob_path inside index */
+	a_rotater->indexes = zc_hashtable_new(ZLOG_ROTATER_INDEX_MAX * 2,
+				zc_hashtable_str_hash,
+				zc_hashtable_str_equal,
+				NULL, (zc_hashtable_del_fn) zlog_archive_index_del);
+	if (!a_rotater->indexes) {
+		zc_error("zc_hashtable_new fail");
+		goto err_gz_cond;
+	}
+
 	a_rotater->lock_fd = INVALID_LOCK_FD;
 	a_rotater->lock_file = lock_file;
+	a_rotater->compress = compress;
+	a_rotater->pid = getpid();
+	a_rotater->inotify_fd = -1;
 
 	//zlog_rotater_profile(a_rotater, ZC_DEBUG);
 	return a_rotater;
 
-	zlog_rotater_del(a_rotater);
+err_gz_cond:
+	pthread_cond_destroy(&(a_rotater->gz_cond));
+err_idle_cond:
+	pthread_cond_destroy(&(a_rotater->idle_cond));
+err_job_cond:
+	pthread_cond_destroy(&(a_rotater->job_cond));
+err_job_mutex:
+	pthread_mutex_destroy(&(a_rotater->job_mutex));
+err_mutex:
+	pthread_mutex_destroy(&(a_rotater->lock_mutex));
+	free(a_rotater);
 	return NULL;
 }
 
@@ -124,13 +215,52 @@ static void zlog_file_del(zlog_file_t * a_file)
 {
 	zc_debug("del onefile[%p]", a_file);
 	zc_debug("a_file->path[%s]", a_file->path);
+	free(a_file->path);
 	free(a_file);
 }
 
+static zlog_file_t *zlog_file_new(const char *path, int index, int gz)
+{
+	zlog_file_t *a_file;
+
+	a_file = calloc(1, sizeof(zlog_file_t));
+	if (!a_file) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_file->path = strdup(path);
+	if (!a_file->path) {
+		zc_error("strdup fail, errno[%d]", errno);
+		free(a_file);
+		return NULL;
+	}
+	a_file->index = index;
+	a_file->gz = gz;
+	return a_file;
+}
+
+/* a_file is moved to path */
+static int zlog_file_set_path(zlog_file_t * a_file, const char *path, int index)
+{
+	char *p;
+
+	p = strdup(path);
+	if (!p) {
+		zc_error("strdup fail, errno[%d]", errno);
+		return -1;
+	}
+	free(a_file->path);
+	a_file->path = p;
+	a_file->index = index;
+	return 0;
+}
+
 static zlog_file_t *zlog_file_check_new(zlog_rotater_t * a_rotater, const char *path)
 {
-	int nwrite;
 	int nread;
+	char *p;
+	char *suffix;
+	size_t len;
 	zlog_file_t *a_file;
 
 	/* base_path will not be in list */
@@ -143,20 +273,34 @@ static zlog_file_t *zlog_file_check_new(zlog_rotater_t * a_rotater, const char *
 		return NULL;
 	}
 
-	a_file = calloc(1, sizeof(zlog_file_t));
+	a_file = zlog_file_new(path, 0, 0);
 	if (!a_file) {
-		zc_error("calloc fail, errno[%d]", errno);
+		zc_error("zlog_file_new fail");
 		return NULL;
 	}
 
-	nwrite = snprintf(a_file->path, sizeof(a_file->path), "%s", path);
-	if (nwrite < 0 || nwrite >= sizeof(a_file->path)) {
-		zc_error("snprintf fail or overflow, nwrite=[%d], errno[%d]", nwrite, errno);
+	nread = 0;
+	sscanf(a_file->path + a_rotater->num_start_len, "%d%n", &(a_file->index), &(nread));
+	if (nread == 0) {
+		zc_warn("no index in [%s]", path);
 		goto err;
 	}
 
-	nread = 0;
-	sscanf(a_file->path + a_rotater->num_start_len, "%d%n", &(a_file->index), &(nread));
+	/* what follows the index is the pattern's, maybe compressed,
+	 * so temp files of the compressor are not taken */
+	p = a_file->path + a_rotater->num_start_len + nread;
+	suffix = a_rotater->glob_path + a_rotater->num_end_len;
+	len = strlen(suffix);
+	if (STRNCMP(p, !=, suffix, len)) {
+		zc_warn("[%s] not end with [%s]", path, suffix);
+		goto err;
+	}
+	if (STRCMP(p + len, ==, GZ_SUFFIX)) {
+		a_file->gz = 1;
+	} else if (p[len] != '\0') {
+		zc_warn("[%s] not end with [%s] or [%s%s]", path, suffix, suffix, GZ_SUFFIX);
+		goto err;
+	}
 
 	if (a_rotater->num_width != 0) {
 		if (nread < a_rotater->num_width) {
@@ -167,7 +311,7 @@ static zlog_file_t *zlog_file_check_new(zlog_rotater_t * a_rotater, const char *
 
 	return a_file;
 err:
-	free(a_file);
+	zlog_file_del(a_file);
 	return NULL;
 }
 
@@ -177,7 +321,7 @@ static int zlog_file_cmp(zlog_file_t * a_file_1, zlog_file_t * a_file_2)
 	return (a_file_1->index > a_file_2->index);
 }
 
-static int zlog_rotater_add_archive_files(zlog_rotater_t * a_rotater)
+static int zlog_rotater_glob_archive_files(zlog_rotater_t * a_rotater, const char *pattern)
 {
 	int rc = 0;
 	glob_t glob_buf;
@@ -185,14 +329,7 @@ static int zlog_rotater_add_archive_files(zlog_rotater_t * a_rotater)
 	char **pathv;
 	zlog_file_t *a_file;
 
-	a_rotater->files = zc_arraylist_new((zc_arraylist_del_fn)zlog_file_del);
-	if (!a_rotater->files) {
-		zc_error("zc_arraylist_new fail");
-		return -1;
-	}
-
-	/* scan file which is aa.*.log and aa */
-	rc = glob(a_rotater->glob_path, GLOB_ERR | GLOB_MARK | GLOB_NOSORT, NULL, &glob_buf);
+	rc = glob(pattern, GLOB_ERR | GLOB_MARK | GLOB_NOSORT, NULL, &glob_buf);
 	if (rc == GLOB_NOMATCH) {
 		goto exit;
 	} else if (rc) {
@@ -216,6 +353,7 @@ static int zlog_rotater_add_archive_files(zlog_rotater_t * a_rotater)
 					(zc_arraylist_cmp_fn)zlog_file_cmp, a_file);
 		if (rc) {
 			zc_error("zc_arraylist_sortadd fail");
+			zlog_file_del(a_file);
 			goto err;
 		}
 	}
@@ -228,35 +366,70 @@ err:
 	return -1;
 }
 
+/* del NULL if files are owned by an index */
+static int zlog_rotater_add_archive_files(zlog_rotater_t * a_rotater, zc_arraylist_del_fn del)
+{
+	int nwrite;
+	size_t len;
+	char gz_glob_path[MAXLEN_PATH + 1];
+
+	a_rotater->files = zc_arraylist_new(del);
+	if (!a_rotater->files) {
+		zc_error("zc_arraylist_new fail");
+		return -1;
+	}
+
+	/* scan file which is aa.*.log and aa */
+	if (zlog_rotater_glob_archive_files(a_rotater, a_rotater->glob_path)) return -1;
+
+	/* and aa.*.log.gz, already in when the pattern ends with * as aa.log.* */
+	len = strlen(a_rotater->glob_path);
+	if (len && a_rotater->glob_path[len - 1] == '*') return 0;
+	nwrite = snprintf(gz_glob_path, sizeof(gz_glob_path), "%s%s", a_rotater->glob_path, GZ_SUFFIX);
+	if (nwrite < 0 || nwrite >= sizeof(gz_glob_path)) {
+		zc_error("nwirte[%d], overflow or errno[%d]", nwrite, errno);
+		return -1;
+	}
+	return zlog_rotater_glob_archive_files(a_rotater, gz_glob_path);
+}
+
+/*
+ * seq_files and roll_files work on files owned by an index,
+ * and leave in a_rotater->files what is there after
+ */
 static int zlog_rotater_seq_files(zlog_rotater_t * a_rotater)
 {
-	int rc = 0;
 	int nwrite = 0;
 	int i, j;
+	int len;
+	int drop;
 	zlog_file_t *a_file;
+	zlog_file_t *a_new = NULL;
+	zc_arraylist_t *after;
 	char new_path[MAXLEN_PATH + 1];
 
-	zc_arraylist_foreach(a_rotater->files, i, a_file) {
-		if (a_rotater->max_count > 0 
-			&& i < zc_arraylist_len(a_rotater->files) - a_rotater->max_count) {
-			/* unlink aa.0 aa.1 .. aa.(n-c) */
-			rc = unlink(a_file->path);
-			if (rc) {
-				zc_error("unlink[%s] fail, errno[%d]",a_file->path , errno);
-				return -1;
-			}
-			continue;
+	/* unlink aa.0 aa.1 .. aa.(n-c) */
+	len = zc_arraylist_len(a_rotater->files);
+	drop = 0;
+	if (a_rotater->max_count > 0 && len > a_rotater->max_count) {
+		drop = len - a_rotater->max_count;
+	}
+	for (i = 0; i < drop; i++) {
+		a_file = zc_arraylist_get(a_rotater->files, i);
+		if (unlink(a_file->path)) {
+			zc_error("unlink[%s] fail, errno[%d]",a_file->path , errno);
+			return -1;
 		}
 	}
 
-	if (zc_arraylist_len(a_rotater->files) > 0) { /* list is not empty */
-		a_file = zc_arraylist_get(a_rotater->files, zc_arraylist_len(a_rotater->files)-1);
+	if (len > 0) { /* list is not empty */
+		a_file = zc_arraylist_get(a_rotater->files, len - 1);
 		if (!a_file) {
 			zc_error("zc_arraylist_get fail");
 			return -1;
 		}
 
-		j = zc_max(zc_arraylist_len(a_rotater->files)-1, a_file->index) + 1;
+		j = zc_max(len - 1, a_file->index) + 1;
 	} else {
 		j = 0;
 	}
@@ -277,30 +450,60 @@ static int zlog_rotater_seq_files(zlog_rotater_t * a_rotater)
 		return -1;
 	}
 
+	/* aa.(n-c+1) .. aa.n, and aa.(n+1) */
+	after = zc_arraylist_new(NULL);
+	if (!after) {
+		zc_error("zc_arraylist_new fail");
+		return -1;
+	}
+	for (i = drop; i < len; i++) {
+		if (zc_arraylist_add(after, zc_arraylist_get(a_rotater->files, i))) goto err;
+	}
+	a_new = zlog_file_new(new_path, j, 0);
+	if (!a_new || zc_arraylist_add(after, a_new)) goto err;
+
+	for (i = 0; i < drop; i++) {
+		zlog_file_del(zc_arraylist_get(a_rotater->files, i));
+	}
+	zc_arraylist_del(a_rotater->files);
+	a_rotater->files = after;
 	return 0;
+err:
+	zc_error("keep list of [%s] fail", a_rotater->glob_path);
+	if (a_new) zlog_file_del(a_new);
+	zc_arraylist_del(after);
+	return -1;
 }
 
 
 static int zlog_rotater_roll_files(zlog_rotater_t * a_rotater)
 {
 	int i;
-	int rc = 0;
+	int len;
+	int keep;
 	int nwrite;
 	char new_path[MAXLEN_PATH + 1];
 	zlog_file_t *a_file;
+	zlog_file_t *a_new = NULL;
+	zc_arraylist_t *after;
+
+	len = zc_arraylist_len(a_rotater->files);
+	keep = len;
+	if (a_rotater->max_count > 0 && keep > a_rotater->max_count - 1) {
+		keep = a_rotater->max_count - 1;
+	}
 
 	/* now in the list, aa.0 aa.1 aa.2 aa.02... */
-	for (i = zc_arraylist_len(a_rotater->files) - 1; i > -1; i--) {
+	for (i = len - 1; i > -1; i--) {
 		a_file = zc_arraylist_get(a_rotater->files, i);
 		if (!a_file) {
 			zc_error("zc_arraylist_get fail");
 			return -1;
 		}
 
-		if (a_rotater->max_count > 0 && i >= a_rotater->max_count - 1) {
+		if (i >= keep) {
 			/* remove file.3 >= 3*/
-			rc = unlink(a_file->path);
-			if (rc) {
+			if (unlink(a_file->path)) {
 				zc_error("unlink[%s] fail, errno[%d]",a_file->path , errno);
 				return -1;
 			}
@@ -309,10 +512,11 @@ static int zlog_rotater_roll_files(zlog_rotater_t * a_rotater)
 
 		/* begin rename aa.01.log -> aa.02.log , using i, as index in list maybe repeat */
 		memset(new_path, 0x00, sizeof(new_path));
-		nwrite = snprintf(new_path, sizeof(new_path), "%.*s%0*d%s",
+		nwrite = snprintf(new_path, sizeof(new_path), "%.*s%0*d%s%s",
 			(int) a_rotater->num_start_len, a_rotater->glob_path, 
 			a_rotater->num_width, i + 1,
-			a_rotater->glob_path + a_rotater->num_end_len);
+			a_rotater->glob_path + a_rotater->num_end_len,
+			a_file->gz ? GZ_SUFFIX : "");
 		if (nwrite < 0 || nwrite >= sizeof(new_path)) {
 			zc_error("nwirte[%d], overflow or errno[%d]", nwrite, errno);
 			return -1;
@@ -322,6 +526,7 @@ static int zlog_rotater_roll_files(zlog_rotater_t * a_rotater)
 			zc_error("rename[%s]->[%s] fail, errno[%d]", a_file->path, new_path, errno);
 			return -1;
 		}
+		if (zlog_file_set_path(a_file, new_path, i + 1)) return -1;
 	}
 
 	/* do the base_path mv  */
@@ -340,7 +545,29 @@ static int zlog_rotater_roll_files(zlog_rotater_t * a_rotater)
 		return -1;
 	}
 
+	/* aa.0, then aa.1 .. aa.keep */
+	after = zc_arraylist_new(NULL);
+	if (!after) {
+		zc_error("zc_arraylist_new fail");
+		return -1;
+	}
+	a_new = zlog_file_new(new_path, 0, 0);
+	if (!a_new || zc_arraylist_add(after, a_new)) goto err;
+	for (i = 0; i < keep; i++) {
+		if (zc_arraylist_add(after, zc_arraylist_get(a_rotater->files, i))) goto err;
+	}
+
+	for (i = keep; i < len; i++) {
+		zlog_file_del(zc_arraylist_get(a_rotater->files, i));
+	}
+	zc_arraylist_del(a_rotater->files);
+	a_rotater->files = after;
 	return 0;
+err:
+	zc_error("keep list of [%s] fail", a_rotater->glob_path);
+	if (a_new) zlog_file_del(a_new);
+	zc_arraylist_del(after);
+	return -1;
 }
 
 
@@ -423,10 +650,219 @@ static void zlog_rotater_clean(zlog_rotater_t *a_rotater)
 	a_rotater->files = NULL;
 }
 
+/*******************************************************************************/
+/* a forked child has a copy of the rotater but not its threads */
+static int zlog_rotater_is_forked(zlog_rotater_t *a_rotater)
+{
+	return a_rotater->pid != getpid();
+}
+
+static void zlog_archive_index_drop(zlog_archive_index_t *a_index)
+{
+	int i;
+	zlog_file_t *a_file;
+
+	if (!a_index->files) return;
+	zc_arraylist_foreach(a_index->files, i, a_file) {
+		zlog_file_del(a_file);
+	}
+	zc_arraylist_del(a_index->files);
+	a_index->files = NULL;
+	a_index->valid = 0;
+}
+
+static void zlog_archive_index_del(zlog_archive_index_t *a_index)
+{
+	zlog_archive_index_drop(a_index);
+	zc_debug("zlog_archive_index_del[%p]", a_index);
+	free(a_index);
+}
+
+#ifdef __linux__
+/* 1 if name, created or gone in the dir, may be one of the archives */
+static int zlog_archive_index_match(zlog_archive_index_t *a_index, const char *name)
+{
+	int nwrite;
+	size_t len;
+	char path[MAXLEN_PATH + 1];
+
+	/* temp files of the compressor come and go, not archives */
+	len = strlen(name);
+	if (len > sizeof(GZ_SUFFIX ".tmp") - 1
+		&& STRCMP(name + len - (sizeof(GZ_SUFFIX ".tmp") - 1), ==, GZ_SUFFIX ".tmp")) {
+		return 0;
+	}
+
+	/* base_path is opened again by writers after each rotation */
+	nwrite = snprintf(path, sizeof(path), "%.*s%s",
+			(int)a_index->name_off, a_index->glob_path, name);
+	if (nwrite < 0 || nwrite >= sizeof(path)) return 1;
+	if (STRCMP(path, ==, a_index->base_path)) return 0;
+
+	if (fnmatch(a_index->glob_path + a_index->name_off, name, FNM_PERIOD) == 0) return 1;
+	nwrite = snprintf(path, sizeof(path), "%s%s",
+			a_index->glob_path + a_index->name_off, GZ_SUFFIX);
+	if (nwrite < 0 || nwrite >= sizeof(path)) return 1;
+	return fnmatch(path, name, FNM_PERIOD) == 0;
+}
+
+/* what others did since, all indexes but skip are checked */
+static void zlog_rotater_read_inotify(zlog_rotater_t *a_rotater, zlog_archive_index_t *skip)
+{
+	ssize_t len;
+	char *p;
+	struct inotify_event *event;
+	zc_hashtable_entry_t *a_entry;
+	zlog_archive_index_t *a_index;
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	if (a_rotater->inotify_fd < 0) return;
+
+	while ((len = read(a_rotater->inotify_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *) p;
+			zc_hashtable_foreach(a_rotater->indexes, a_entry) {
+				a_index = a_entry->value;
+				if (a_index == skip) continue;
+				if (event->mask & IN_Q_OVERFLOW) {
+					a_index->valid = 0;
+				} else if (event->wd != a_index->wd) {
+					continue;
+				} else if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+					/* the dir itself, watch it again by path */
+					a_index->valid = 0;
+					a_index->wd = -1;
+				} else if (event->len && zlog_archive_index_match(a_index, event->name)) {
+					a_index->valid = 0;
+				}
+			}
+		}
+	}
+	return;
+}
+
+static void zlog_rotater_watch(zlog_rotater_t *a_rotater, zlog_archive_index_t *a_index)
+{
+	char dir[MAXLEN_PATH + 1];
+
+	if (a_index->wd >= 0) return;
+
+	if (a_index->name_off == 0) {
+		strcpy(dir, ".");
+	} else if (a_index->name_off == 1) {
+		strcpy(dir, "/");
+	} else {
+		memcpy(dir, a_index->glob_path, a_index->name_off - 1);
+		dir[a_index->name_off - 1] = '\0';
+	}
+	/* a pattern of dirs, not one to watch */
+	if (strpbrk(dir, "*?[")) return;
+
+	if (a_rotater->inotify_fd < 0) {
+		a_rotater->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (a_rotater->inotify_fd < 0) {
+			zc_warn("inotify_init1 fail, errno[%d], list archives at each rotation", errno);
+			return;
+		}
+	}
+	a_index->wd = inotify_add_watch(a_rotater->inotify_fd, dir,
+			IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+			| IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+	if (a_index->wd < 0) {
+		zc_warn("inotify_add_watch[%s] fail, errno[%d], list archives at each rotation",
+			dir, errno);
+	}
+	return;
+}
+#else
+static void zlog_rotater_read_inotify(zlog_rotater_t *a_rotater, zlog_archive_index_t *skip)
+{
+	return;
+}
+
+static void zlog_rotater_watch(zlog_rotater_t *a_rotater, zlog_archive_index_t *a_index)
+{
+	return;
+}
+#endif
+
+/* the index of glob_path, listed again unless trusted */
+static zlog_archive_index_t *zlog_rotater_index_get(zlog_rotater_t *a_rotater)
+{
+	int nwrite;
+	int forked;
+	char *p;
+	zlog_archive_index_t *a_index;
+
+	a_index = zc_hashtable_get(a_rotater->indexes, a_rotater->glob_path);
+	if (!a_index) {
+		if (a_rotater->index_count >= ZLOG_ROTATER_INDEX_MAX) {
+			/* many dynamic paths maybe, start over, the watches go with the fd */
+			zc_hashtable_clean(a_rotater->indexes);
+			a_rotater->index_count = 0;
+			if (a_rotater->inotify_fd >= 0) {
+				close(a_rotater->inotify_fd);
+				a_rotater->inotify_fd = -1;
+			}
+		}
+
+		a_index = calloc(1, sizeof(zlog_archive_index_t));
+		if (!a_index) {
+			zc_error("calloc fail, errno[%d]", errno);
+			return NULL;
+		}
+		strcpy(a_index->glob_path, a_rotater->glob_path);
+		p = strrchr(a_index->glob_path, '/');
+		a_index->name_off = p ? p - a_index->glob_path + 1 : 0;
+		a_index->wd = -1;
+		if (zc_hashtable_put(a_rotater->indexes, a_index->glob_path, a_index)) {
+			zc_error("zc_hashtable_put fail");
+			zlog_archive_index_del(a_index);
+			return NULL;
+		}
+		a_rotater->index_count++;
+	}
+
+	if (STRCMP(a_index->base_path, !=, a_rotater->base_path)) {
+		nwrite = snprintf(a_index->base_path, sizeof(a_index->base_path),
+				"%s", a_rotater->base_path);
+		if (nwrite < 0 || nwrite >= sizeof(a_index->base_path)) {
+			zc_error("nwirte[%d], overflow or errno[%d]", nwrite, errno);
+			a_index->base_path[0] = '\0';
+			return NULL;
+		}
+		a_index->valid = 0;
+	}
+
+	/* a forked child shares the inotify fd with its parent, keep off it */
+	forked = zlog_rotater_is_forked(a_rotater);
+	if (forked) {
+		a_index->valid = 0;
+	} else {
+		zlog_rotater_read_inotify(a_rotater, NULL);
+	}
+	if (a_index->valid) return a_index;
+
+	/* watch before listing, so a change while listing is not missed */
+	if (!forked) zlog_rotater_watch(a_rotater, a_index);
+	zlog_archive_index_drop(a_index);
+	a_rotater->scans++;
+	if (zlog_rotater_add_archive_files(a_rotater, NULL)) {
+		a_index->files = a_rotater->files;
+		a_rotater->files = NULL;
+		zlog_archive_index_drop(a_index);
+		return NULL;
+	}
+	a_index->files = a_rotater->files;
+	a_rotater->files = NULL;
+	return a_index;
+}
+
 static int zlog_rotater_lsmv(zlog_rotater_t *a_rotater, 
 		char *base_path, char *archive_path, int archive_max_count)
 {
 	int rc = 0;
+	zlog_archive_index_t *a_index = NULL;
 
 	a_rotater->base_path = base_path;
 	a_rotater->archive_path = archive_path;
@@ -437,11 +873,13 @@ static int zlog_rotater_lsmv(zlog_rotater_t *a_rotater,
 		goto err;
 	}
 
-	rc = zlog_rotater_add_archive_files(a_rotater);
-	if (rc) {
-		zc_error("zlog_rotater_add_archive_files fail");
+	a_index = zlog_rotater_index_get(a_rotater);
+	if (!a_index) {
+		zc_error("zlog_rotater_index_get fail");
 		goto err;
 	}
+	/* its files are moved, and kept by the index after */
+	a_rotater->files = a_index->files;
 
 	if (a_rotater->mv_type == ROLLING) {
 		rc = zlog_rotater_roll_files(a_rotater);
@@ -457,29 +895,41 @@ static int zlog_rotater_lsmv(zlog_rotater_t *a_rotater,
 		}
 	}
 
+	a_index->files = a_rotater->files;
+	a_rotater->files = NULL;
+	/* the moves just done are no news */
+	if (!zlog_rotater_is_forked(a_rotater)) {
+		zlog_rotater_read_inotify(a_rotater, a_index);
+		a_index->valid = (a_index->wd >= 0);
+	}
 	zlog_rotater_clean(a_rotater);
 	return 0;
 err:
+	if (a_index) {
+		a_index->files = a_rotater->files;
+		a_rotater->files = NULL;
+		zlog_archive_index_drop(a_index);
+	}
 	zlog_rotater_clean(a_rotater);
 	return -1;
 }
 /*******************************************************************************/
 
-static int zlog_rotater_trylock(zlog_rotater_t *a_rotater)
+/* only the worker and the compressor take it, in the background,
+ * so wait, a rotation at a time boundary must not be skipped */
+static int zlog_rotater_lock(zlog_rotater_t *a_rotater)
 {
 	int rc;
 
-	rc = pthread_mutex_trylock(&(a_rotater->lock_mutex));
-	if (rc == EBUSY) {
-		zc_warn("pthread_mutex_trylock fail, as lock_mutex is locked by other threads");
-		return -1;
-	} else if (rc != 0) {
-		zc_error("pthread_mutex_trylock fail, rc[%d]", rc);
+	rc = pthread_mutex_lock(&(a_rotater->lock_mutex));
+	if (rc) {
+		zc_error("pthread_mutex_lock fail, rc[%d]", rc);
 		return -1;
 	}
 
     a_rotater->lock_fd = lock_file(a_rotater->lock_file);
 	if (a_rotater->lock_fd == INVALID_LOCK_FD) {
+		pthread_mutex_unlock(&(a_rotater->lock_mutex));
 		return -1;
 	}
 
@@ -504,8 +954,374 @@ static int zlog_rotater_unlock(zlog_rotater_t *a_rotater)
 	return rc;
 }
 
+/*******************************************************************************/
+#ifdef ZLOG_ZLIB
+#define GZ_CHUNK (64 * 1024)
+/* writers still on the old fd, or other processes yet to see the move,
+ * are done with an archive after this many seconds of quiet */
+#define GZ_DELAY 2
+#define GZ_ROUNDS 10
+
+static int zlog_rotater_write_all(int fd, unsigned char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* path is gz_path now, keep the index of glob_path right,
+ * caller holds lock_mutex */
+static void zlog_rotater_index_gzipped(zlog_rotater_t *a_rotater,
+		const char *glob_path, const char *path, const char *gz_path)
+{
+	int i;
+	zlog_file_t *a_file;
+	zlog_file_t *a_found = NULL;
+	zlog_archive_index_t *a_index;
+
+	a_index = zc_hashtable_get(a_rotater->indexes, glob_path);
+	if (!a_index || !a_index->files) return;
+
+	zc_arraylist_foreach(a_index->files, i, a_file) {
+		if (STRCMP(a_file->path, ==, path)) {
+			a_found = a_file;
+			break;
+		}
+	}
+	if (!a_found || zlog_file_set_path(a_found, gz_path, a_found->index)) {
+		a_index->valid = 0;
+		return;
+	}
+	a_found->gz = 1;
+
+	/* the rename and unlink just done are no news */
+	if (!zlog_rotater_is_forked(a_rotater)) {
+		zlog_rotater_read_inotify(a_rotater, a_index);
+	}
+	return;
+}
+
+/*
+ * path -> path.gz by way of path.gz.tmp, the original goes only if
+ * it is still at path and has not grown, path is one of glob_path
+ * return
+ * -1	fail
+ * 0	done
+ * 1	not now, try again later
+ */
+static int zlog_rotater_gzip(zlog_rotater_t *a_rotater, const char *glob_path, const char *path)
+{
+	int rc = -1;
+	int nwrite;
+	int src = -1;
+	int dst = -1;
+	int flush;
+	int zs_inited = 0;
+	ssize_t n;
+	off_t total = 0;
+	struct stat stb;
+	struct stat now;
+	z_stream zs;
+	unsigned char *in = NULL;
+	unsigned char *out = NULL;
+	char gz_path[MAXLEN_PATH + 1];
+	char tmp_path[MAXLEN_PATH + 1];
+
+	nwrite = snprintf(gz_path, sizeof(gz_path), "%s%s", path, GZ_SUFFIX);
+	if (nwrite < 0 || nwrite >= sizeof(gz_path)) {
+		zc_error("nwirte[%d], overflow or errno[%d]", nwrite, errno);
+		return -1;
+	}
+	nwrite = snprintf(tmp_path, sizeof(tmp_path), "%s%s.tmp", path, GZ_SUFFIX);
+	if (nwrite < 0 || nwrite >= sizeof(tmp_path)) {
+		zc_error("nwirte[%d], overflow or errno[%d]", nwrite, errno);
+		return -1;
+	}
+
+	src = open(path, O_RDONLY);
+	if (src < 0) {
+		/* moved or removed by a rotation meanwhile */
+		zc_debug("open [%s] fail, errno[%d]", path, errno);
+		return 1;
+	}
+	if (fstat(src, &stb)) {
+		zc_error("fstat [%s] fail, errno[%d]", path, errno);
+		goto exit;
+	}
+	if (time(NULL) - stb.st_mtime < GZ_DELAY) {
+		rc = 1;
+		goto exit;
+	}
+
+	dst = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, stb.st_mode & 0777);
+	if (dst < 0) {
+		zc_error("open [%s] fail, errno[%d]", tmp_path, errno);
+		goto exit;
+	}
+
+	in = malloc(GZ_CHUNK);
+	out = malloc(GZ_CHUNK);
+	if (!in || !out) {
+		zc_error("malloc fail, errno[%d]", errno);
+		goto exit;
+	}
+
+	/* 16 more window bits for a gzip header, so gzip -d and zcat read it */
+	memset(&zs, 0x00, sizeof(zs));
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK) {
+		zc_error("deflateInit2 fail");
+		goto exit;
+	}
+	zs_inited = 1;
+
+	do {
+		if (zc_atomic_load(&(a_rotater->stop))) {
+			rc = 1;
+			goto exit;
+		}
+		n = read(src, in, GZ_CHUNK);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			zc_error("read [%s] fail, errno[%d]", path, errno);
+			goto exit;
+		}
+		total += n;
+		flush = n ? Z_NO_FLUSH : Z_FINISH;
+		zs.next_in = in;
+		zs.avail_in = n;
+		do {
+			zs.next_out = out;
+			zs.avail_out = GZ_CHUNK;
+			if (deflate(&zs, flush) == Z_STREAM_ERROR) {
+				zc_error("deflate [%s] fail", path);
+				goto exit;
+			}
+			if (zlog_rotater_write_all(dst, out, GZ_CHUNK - zs.avail_out)) {
+				zc_error("write [%s] fail, errno[%d]", tmp_path, errno);
+				goto exit;
+			}
+		} while (zs.avail_out == 0);
+	} while (flush != Z_FINISH);
+
+	/* on disk before the original goes */
+	if (fsync(dst)) {
+		zc_error("fsync [%s] fail, errno[%d]", tmp_path, errno);
+		goto exit;
+	}
+
+	if (zlog_rotater_lock(a_rotater)) goto exit;
+	if (stat(path, &now) || now.st_ino != stb.st_ino || now.st_dev != stb.st_dev
+		|| now.st_size != total) {
+		/* rolled to another name, or written to, by now */
+		rc = 1;
+	} else if (rename(tmp_path, gz_path)) {
+		zc_error("rename[%s]->[%s] fail, errno[%d]", tmp_path, gz_path, errno);
+	} else if (unlink(path)) {
+		zc_error("unlink[%s] fail, errno[%d]", path, errno);
+	} else {
+		zlog_rotater_index_gzipped(a_rotater, glob_path, path, gz_path);
+		rc = 0;
+	}
+	if (zlog_rotater_unlock(a_rotater)) {
+		zc_error("zlog_rotater_unlock fail");
+	}
+
+exit:
+	if (zs_inited) deflateEnd(&zs);
+	free(in);
+	free(out);
+	if (dst >= 0) close(dst);
+	if (src >= 0) close(src);
+	if (rc) unlink(tmp_path);
+	return rc;
+}
+
+/* wait for seconds, 1 if stopped */
+static int zlog_rotater_compress_wait(zlog_rotater_t *a_rotater, int seconds)
+{
+	int stop;
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += seconds;
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	while (!a_rotater->stop
+		&& pthread_cond_timedwait(&(a_rotater->gz_cond), &(a_rotater->job_mutex),
+				&deadline) != ETIMEDOUT) {
+		;
+	}
+	stop = a_rotater->stop;
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	return stop;
+}
+
+/* every archive of the job's files not compressed yet,
+ * ones left by an earlier stop or fail are caught here too */
+static void zlog_rotater_compress_all(zlog_rotater_t *a_rotater, zlog_rotate_job_t *a_job)
+{
+	int i;
+	int rc;
+	int round;
+	int again;
+	char *path;
+	zlog_file_t *a_file;
+	zlog_archive_index_t *a_index;
+	zc_arraylist_t *plain;
+	char glob_path[MAXLEN_PATH + 1];
+
+	for (round = 0; round < GZ_ROUNDS; round++) {
+		plain = zc_arraylist_new(free);
+		if (!plain) {
+			zc_error("zc_arraylist_new fail");
+			return;
+		}
+
+		if (zlog_rotater_lock(a_rotater)) {
+			zc_arraylist_del(plain);
+			return;
+		}
+		/* the worker's index, listed again only if others changed it */
+		a_rotater->base_path = a_job->base_path;
+		a_rotater->archive_path = a_job->archive_path;
+		a_index = NULL;
+		if (zlog_rotater_parse_archive_path(a_rotater) == 0) {
+			strcpy(glob_path, a_rotater->glob_path);
+			a_index = zlog_rotater_index_get(a_rotater);
+		}
+		if (a_index) {
+			zc_arraylist_foreach(a_index->files, i, a_file) {
+				if (a_file->gz) continue;
+				path = strdup(a_file->path);
+				if (!path || zc_arraylist_add(plain, path)) {
+					zc_error("strdup or zc_arraylist_add fail");
+					free(path);
+					break;
+				}
+			}
+		}
+		zlog_rotater_clean(a_rotater);
+		if (zlog_rotater_unlock(a_rotater)) {
+			zc_error("zlog_rotater_unlock fail");
+		}
+
+		again = 0;
+		zc_arraylist_foreach(plain, i, path) {
+			rc = zlog_rotater_gzip(a_rotater, glob_path, path);
+			if (rc == 0) {
+				zc_atomic_add(&(a_rotater->compressions), 1);
+			} else if (rc > 0) {
+				again = 1;
+			}
+			if (zc_atomic_load(&(a_rotater->stop))) break;
+		}
+		zc_arraylist_del(plain);
+
+		if (!again || zlog_rotater_compress_wait(a_rotater, GZ_DELAY)) return;
+	}
+	return;
+}
+
+static void *zlog_rotater_compress_work(void *arg)
+{
+	zlog_rotater_t *a_rotater = arg;
+	zlog_rotate_job_t *a_job;
+#ifdef SCHED_IDLE
+	struct sched_param param;
+
+	/* only when nothing else wants the cpu */
+	memset(&param, 0x00, sizeof(param));
+	if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param)) {
+		zc_warn("pthread_setschedparam SCHED_IDLE fail, compress at normal priority");
+	}
+#endif
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	while (1) {
+		while (!a_rotater->gz_jobs && !a_rotater->stop) {
+			pthread_cond_wait(&(a_rotater->gz_cond), &(a_rotater->job_mutex));
+		}
+		/* what is left is found by the scan after the next rotation */
+		if (a_rotater->stop) break;
+
+		a_job = a_rotater->gz_jobs;
+		a_rotater->gz_jobs = a_job->next;
+		if (!a_rotater->gz_jobs) a_rotater->gz_jobs_tail = NULL;
+		pthread_mutex_unlock(&(a_rotater->job_mutex));
+
+		zlog_rotater_compress_all(a_rotater, a_job);
+		free(a_job);
+
+		pthread_mutex_lock(&(a_rotater->job_mutex));
+	}
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	return NULL;
+}
+
+/* caller holds lock_mutex, and so takes job_mutex after it */
+static void zlog_rotater_compress_later(zlog_rotater_t *a_rotater,
+		char *base_path, char *archive_path)
+{
+	int rc;
+	zlog_rotate_job_t *a_job;
+	zlog_rotate_job_t *a_queued;
+
+	if (zlog_rotater_is_forked(a_rotater)) return;
+
+	a_job = calloc(1, sizeof(zlog_rotate_job_t));
+	if (!a_job) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return;
+	}
+	/* both were copied into a job of the worker already, they fit */
+	strcpy(a_job->base_path, base_path);
+	strcpy(a_job->archive_path, archive_path);
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	for (a_queued = a_rotater->gz_jobs; a_queued; a_queued = a_queued->next) {
+		if (STRCMP(a_queued->base_path, ==, base_path)) break;
+	}
+	if (a_queued || a_rotater->stop) goto exit;
+
+	if (!a_rotater->gz_started) {
+		rc = pthread_create(&(a_rotater->gz_tid), NULL, zlog_rotater_compress_work, a_rotater);
+		if (rc) {
+			zc_error("pthread_create fail, rc[%d], archives not compressed", rc);
+			goto exit;
+		}
+		a_rotater->gz_started = 1;
+	}
+
+	if (a_rotater->gz_jobs_tail) a_rotater->gz_jobs_tail->next = a_job;
+	else a_rotater->gz_jobs = a_job;
+	a_rotater->gz_jobs_tail = a_job;
+	a_job = NULL;
+	pthread_cond_signal(&(a_rotater->gz_cond));
+exit:
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	free(a_job);
+	return;
+}
+#else
+static void zlog_rotater_compress_later(zlog_rotater_t *a_rotater,
+		char *base_path, char *archive_path)
+{
+	return;
+}
+#endif
+
 int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
-		char *base_path, size_t msg_len,
+		char *base_path, ino_t base_ino, size_t msg_len,
 		char *archive_path, long archive_max_size, int archive_max_count)
 {
 	int rc = 0;
@@ -513,8 +1329,10 @@ int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 
 	zc_assert(base_path, -1);
 
-	if (zlog_rotater_trylock(a_rotater)) {
-		zc_warn("zlog_rotater_trylock fail, maybe lock by other process or threads");
+	ZLOG_TRACE2(rotate_entry, base_path, msg_len);
+	if (zlog_rotater_lock(a_rotater)) {
+		zc_warn("zlog_rotater_lock fail");
+		ZLOG_TRACE2(rotate_return, base_path, 0);
 		return 0;
 	}
 
@@ -524,7 +1342,7 @@ int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 		goto exit;
 	}
 
-	if (info.st_size + msg_len <= archive_max_size) {
+	if (archive_max_size > 0 && info.st_size + msg_len <= archive_max_size) {
 		/* file not so big,
 		 * may alread rotate by oth process or thread,
 		 * return */
@@ -532,12 +1350,20 @@ int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 		goto exit;
 	}
 
+	if (base_ino && (info.st_ino != base_ino || info.st_size == 0)) {
+		/* a new period, but another process is there first */
+		rc = 0;
+		goto exit;
+	}
+
 	/* begin list and move files */
 	rc = zlog_rotater_lsmv(a_rotater, base_path, archive_path, archive_max_count);
 	if (rc) {
 		zc_error("zlog_rotater_lsmv [%s] fail, return", base_path);
 		rc = -1;
-	} /* else if (rc == 0) */
+	} else if (a_rotater->compress) {
+		zlog_rotater_compress_later(a_rotater, base_path, archive_path);
+	}
 
 	//zc_debug("zlog_rotater_file_ls_mv success");
 
@@ -547,7 +1373,170 @@ exit:
 		zc_error("zlog_rotater_unlock fail");
 	}
 
+	ZLOG_TRACE2(rotate_return, base_path, rc);
+	return rc;
+}
+
+/*******************************************************************************/
+/* same as the 1st rotater while rotating, then let writers open a new fd */
+static int zlog_rotater_do(zlog_rotater_t *a_rotater, zlog_rotate_job_t *a_job)
+{
+	int rc;
+
+	rc = zlog_rotater_rotate(a_rotater, a_job->base_path, a_job->base_ino, a_job->msg_len,
+		a_job->archive_path, a_job->archive_max_size, a_job->archive_max_count);
+	if (rc) zc_error("zlog_rotater_rotate [%s] fail", a_job->base_path);
+
+	/* also after a fail, so the next write past the size asks again */
+	if (a_job->file_table) zlog_file_table_invalidate(a_job->file_table, a_job->base_path);
+	return rc;
+}
+
+static void *zlog_rotater_work(void *arg)
+{
+	zlog_rotater_t *a_rotater = arg;
+	zlog_rotate_job_t *a_job;
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	while (1) {
+		while (!a_rotater->jobs && !a_rotater->stop) {
+			pthread_cond_wait(&(a_rotater->job_cond), &(a_rotater->job_mutex));
+		}
+		/* jobs asked before stop are still done */
+		if (!a_rotater->jobs) break;
+
+		a_job = a_rotater->jobs;
+		a_rotater->jobs = a_job->next;
+		if (!a_rotater->jobs) a_rotater->jobs_tail = NULL;
+		a_rotater->busy = 1;
+		pthread_mutex_unlock(&(a_rotater->job_mutex));
+
+		zlog_rotater_do(a_rotater, a_job);
+		free(a_job);
+
+		pthread_mutex_lock(&(a_rotater->job_mutex));
+		a_rotater->busy = 0;
+		a_rotater->rotations++;
+		if (!a_rotater->jobs) pthread_cond_broadcast(&(a_rotater->idle_cond));
+	}
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	return NULL;
+}
+
+static void zlog_rotater_stop(zlog_rotater_t *a_rotater)
+{
+	zlog_rotate_job_t *a_job;
+
+	if (!zlog_rotater_is_forked(a_rotater)) {
+		pthread_mutex_lock(&(a_rotater->job_mutex));
+		zc_atomic_store(&(a_rotater->stop), 1);
+		pthread_cond_signal(&(a_rotater->job_cond));
+		pthread_cond_broadcast(&(a_rotater->gz_cond));
+		pthread_mutex_unlock(&(a_rotater->job_mutex));
+		if (a_rotater->started) pthread_join(a_rotater->tid, NULL);
+		if (a_rotater->gz_started) pthread_join(a_rotater->gz_tid, NULL);
+	}
+
+	/* left to a thread of the parent */
+	while ((a_job = a_rotater->jobs)) {
+		a_rotater->jobs = a_job->next;
+		free(a_job);
+	}
+	a_rotater->jobs_tail = NULL;
+	while ((a_job = a_rotater->gz_jobs)) {
+		a_rotater->gz_jobs = a_job->next;
+		free(a_job);
+	}
+	a_rotater->gz_jobs_tail = NULL;
+	return;
+}
+
+int zlog_rotater_request(zlog_rotater_t *a_rotater, zlog_file_table_t *a_table,
+		char *base_path, ino_t base_ino, size_t msg_len,
+		char *archive_path, long archive_max_size, int archive_max_count)
+{
+	int rc;
+	zlog_rotate_job_t *a_job;
+	zlog_rotate_job_t *a_queued;
+
+	zc_assert(a_rotater, -1);
+	zc_assert(base_path, -1);
+	zc_assert(archive_path, -1);
+
+	a_job = calloc(1, sizeof(zlog_rotate_job_t));
+	if (!a_job) {
+		zc_error("calloc fail, errno[%d]", errno);
+		goto err;
+	}
+	if (strlen(base_path) > sizeof(a_job->base_path) - 1
+		|| strlen(archive_path) > sizeof(a_job->archive_path) - 1) {
+		zc_error("base_path[%s] or archive_path[%s] too long", base_path, archive_path);
+		goto err;
+	}
+	a_job->file_table = a_table;
+	strcpy(a_job->base_path, base_path);
+	a_job->base_ino = base_ino;
+	strcpy(a_job->archive_path, archive_path);
+	a_job->msg_len = msg_len;
+	a_job->archive_max_size = archive_max_size;
+	a_job->archive_max_count = archive_max_count;
+
+	if (zlog_rotater_is_forked(a_rotater)) goto sync;
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	if (a_rotater->stop) {
+		pthread_mutex_unlock(&(a_rotater->job_mutex));
+		goto sync;
+	}
+	if (!a_rotater->started) {
+		rc = pthread_create(&(a_rotater->tid), NULL, zlog_rotater_work, a_rotater);
+		if (rc) {
+			pthread_mutex_unlock(&(a_rotater->job_mutex));
+			zc_error("pthread_create fail, rc[%d], rotate in this thread", rc);
+			goto sync;
+		}
+		a_rotater->started = 1;
+	}
+
+	/* writers without file_table ask for each msg till it is done */
+	for (a_queued = a_rotater->jobs; a_queued; a_queued = a_queued->next) {
+		if (STRCMP(a_queued->base_path, ==, base_path)) break;
+	}
+	if (a_queued) {
+		pthread_mutex_unlock(&(a_rotater->job_mutex));
+		free(a_job);
+		return 0;
+	}
+
+	if (a_rotater->jobs_tail) a_rotater->jobs_tail->next = a_job;
+	else a_rotater->jobs = a_job;
+	a_rotater->jobs_tail = a_job;
+	pthread_cond_signal(&(a_rotater->job_cond));
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	return 0;
+
+sync:
+	rc = zlog_rotater_do(a_rotater, a_job);
+	free(a_job);
 	return rc;
+err:
+	free(a_job);
+	if (a_table) zlog_file_table_invalidate(a_table, base_path);
+	return -1;
+}
+
+void zlog_rotater_flush(zlog_rotater_t *a_rotater)
+{
+	zc_assert(a_rotater,);
+
+	if (zlog_rotater_is_forked(a_rotater)) return;
+
+	pthread_mutex_lock(&(a_rotater->job_mutex));
+	while (a_rotater->jobs || a_rotater->busy) {
+		pthread_cond_wait(&(a_rotater->idle_cond), &(a_rotater->job_mutex));
+	}
+	pthread_mutex_unlock(&(a_rotater->job_mutex));
+	return;
 }
 
 /*******************************************************************************/
@@ -16,8 +16,27 @@
 #ifndef __zlog_rotater_h
 #define __zlog_rotater_h
 
+#include <pthread.h>
+#include <sys/types.h>
+
 #include "zc_defs.h"
 #include "lockfile.h"
+#include "file_table.h"
+
+#define ZLOG_ROTATE_COMPRESS_NONE 0
+#define ZLOG_ROTATE_COMPRESS_GZIP 1	/* aa.1.log -> aa.1.log.gz, needs ZLOG_ZLIB */
+
+/* one rotation asked of the worker, paths copied as rules may change */
+typedef struct zlog_rotate_job_s {
+	zlog_file_table_t *file_table; /* its entry of base_path is switched after */
+	char base_path[MAXLEN_PATH + 1];
+	ino_t base_ino;
+	char archive_path[MAXLEN_PATH + 1];
+	size_t msg_len;
+	long archive_max_size;
+	int archive_max_count;
+	struct zlog_rotate_job_s *next;
+} zlog_rotate_job_t;
 
 typedef struct zlog_rotater_s {
 	pthread_mutex_t lock_mutex;
@@ -34,20 +53,70 @@ typedef struct zlog_rotater_s {
 	int mv_type;				/* ROLLING or SEQUENCE */
 	int max_count;
 	zc_arraylist_t *files;
+
+	/* archives of each glob_path as last listed, under lock_mutex,
+	 * kept right by each rotation, listed again when inotify tells
+	 * others have changed them, every time without inotify */
+	zc_hashtable_t *indexes;
+	size_t index_count;
+	int inotify_fd;
+	size_t scans;
+
+	/* worker thread, started by the 1st request */
+	pthread_mutex_t job_mutex;
+	pthread_cond_t job_cond;	/* jobs come or stop */
+	pthread_cond_t idle_cond;	/* no job left */
+	zlog_rotate_job_t *jobs;
+	zlog_rotate_job_t *jobs_tail;
+	int busy;			/* a job is being done */
+	int stop;
+	int started;
+	pid_t pid;			/* threads live in this process only */
+	pthread_t tid;
+	size_t rotations;
+
+	/* compressor thread of low priority, started by the 1st rotation,
+	 * its jobs are base_path and archive_path only */
+	int compress;			/* ZLOG_ROTATE_COMPRESS_* */
+	pthread_cond_t gz_cond;
+	zlog_rotate_job_t *gz_jobs;
+	zlog_rotate_job_t *gz_jobs_tail;
+	int gz_started;
+	pthread_t gz_tid;
+	size_t compressions;
 } zlog_rotater_t;
 
-zlog_rotater_t *zlog_rotater_new(char *lock_file);
+zlog_rotater_t *zlog_rotater_new(char *lock_file, int compress);
+/* jobs still queued are done before the worker quits,
+ * archives not compressed yet are left for the next rotation */
 void zlog_rotater_del(zlog_rotater_t *a_rotater);
 
 /*
+ * archive_max_size 0 rotates whatever the size, as at a time boundary,
+ * base_ino not 0 rotates only if base_path is still that file,
+ * not one another process has rotated to already
  * return
  * -1	fail
  * 0	no rotate, or rotate and success
  */
 int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
-		char *base_path, size_t msg_len,
+		char *base_path, ino_t base_ino, size_t msg_len,
 		char *archive_path, long archive_max_size, int archive_max_count);
 
+/*
+ * queue the rotation to the worker and return at once, loggers keep
+ * writing to the old fd till the worker has moved the files and
+ * invalidated base_path in a_table, so the next write opens a new one.
+ * a_table must live till zlog_rotater_flush() or zlog_rotater_del().
+ * same return as zlog_rotater_rotate
+ */
+int zlog_rotater_request(zlog_rotater_t *a_rotater, zlog_file_table_t *a_table,
+		char *base_path, ino_t base_ino, size_t msg_len,
+		char *archive_path, long archive_max_size, int archive_max_count);
+
+/* wait till the worker has done all jobs asked so far */
+void zlog_rotater_flush(zlog_rotater_t *a_rotater);
+
 void zlog_rotater_profile(zlog_rotater_t *a_rotater, int flag);
 
 #endif
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "rule.h"
 #include "format.h"
@@ -38,6 +39,9 @@
 #include "rotater.h"
 #include "spec.h"
 #include "conf.h"
+#include "async.h"
+#include "watcher.h"
+#include "trace.h"
 
 #include "zc_defs.h"
 
@@ -48,8 +52,9 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 	zlog_spec_t *a_spec;
 
 	zc_assert(a_rule,);
-	zc_profile(flag, "---rule:[%p][%s%c%d]-[%d,%d][%s,%p,%d:%ld*%d~%s][%d][%d][%s:%s:%p];[%p]---",
+	zc_profile(flag, "---rule:[%p][refs:%d][%s%c%d]-[%d,%d][%s,%p,%d:%p:%ld,%lds*%d~%s][%d][%d][%s:%s:%p];[%p][async:%d][check:%d]---",
 		a_rule,
+		a_rule->refs,
 
 		a_rule->category,
 		a_rule->compare_char,
@@ -61,8 +66,10 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 		a_rule->file_path,
 		a_rule->dynamic_specs,
 		a_rule->static_fd,
+		a_rule->fd_rule,
 
 		a_rule->archive_max_size,
+		a_rule->archive_interval,
 		a_rule->archive_max_count,
 		a_rule->archive_path,
 
@@ -73,27 +80,38 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 		a_rule->record_name,
 		a_rule->record_path,
 		a_rule->record_func,
-		a_rule->format);
+		a_rule->format,
+		a_rule->async,
+		a_rule->file_check);
 
 	if (a_rule->dynamic_specs) {
 		zc_arraylist_foreach(a_rule->dynamic_specs, i, a_spec) {
 			zlog_spec_profile(a_spec, flag);
 		}
 	}
+	if (a_rule->file_table) zlog_file_table_profile(a_rule->file_table, flag);
+	if (a_rule->batch) zlog_batch_profile(a_rule->batch, flag);
+	if (a_rule->binlog) zlog_binlog_profile(a_rule->binlog, flag);
 	return;
 }
 
 /*******************************************************************************/
+/* a binary rule first writes what fd lacks to be read alone */
+#define zlog_rule_put_binlog_head(a_rule, a_seq, fd) \
+	((a_rule)->binlog ? zlog_binlog_put_head((a_rule)->binlog, a_seq, fd) : 0)
 
-static int zlog_rule_output_static_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+static int zlog_rule_write_static_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
 {
 	struct stat stb;
+	int fd;
 	int do_file_reload = 0;
 	int redo_inode_stat = 0;
 
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_gen_msg fail");
-		return -1;
+	/* in strict mode stat() every time, else only when the watcher says so */
+	if (a_rule->file_check != ZLOG_FILE_CHECK_STRICT) {
+		if (!zc_atomic_load(&a_rule->static_changed)) goto write;
+		zc_atomic_store(&a_rule->static_changed, 0);
 	}
 
 	/* check if the output file was changed by an external tool by comparing the inode to our saved off one */
@@ -110,29 +128,40 @@ static int zlog_rule_output_static_file_single(zlog_rule_t * a_rule, zlog_thread
 	}
 
 	if (do_file_reload) {
-		close(a_rule->static_fd);
-		a_rule->static_fd = open(a_rule->file_path,
+		fd = open(a_rule->file_path,
 			O_WRONLY | O_APPEND | O_CREAT | a_rule->file_open_flags,
 			a_rule->file_perms);
-		if (a_rule->static_fd < 0) {
+		ZLOG_TRACE2(file_reopen, a_rule->file_path, fd);
+		if (fd < 0) {
 			zc_error("open file[%s] fail, errno[%d]", a_rule->file_path, errno);
 			return -1;
 		}
+		/* other threads may be writing to static_fd, replace it in place */
+		if (dup2(fd, a_rule->static_fd) < 0) {
+			zc_error("dup2 [%d] to [%d] fail, errno[%d]", fd, a_rule->static_fd, errno);
+			close(fd);
+			return -1;
+		}
+		close(fd);
 
 		/* save off the new dev/inode info from the stat call we already did */
 		if (redo_inode_stat) {
-			if (stat(a_rule->file_path, &stb)) {
+			if (fstat(a_rule->static_fd, &stb)) {
 				zc_error("stat fail on new file[%s], errno[%d]", a_rule->file_path, errno);
 				return -1;
 			}
 		}
 		a_rule->static_dev = stb.st_dev;
 		a_rule->static_ino = stb.st_ino;
+		zc_atomic_store(&a_rule->binlog_seq, 0);
 	}
 
-	if (write(a_rule->static_fd,
-			zlog_buf_str(a_thread->msg_buf),
-			zlog_buf_len(a_thread->msg_buf)) < 0) {
+write:
+	if (zlog_rule_put_binlog_head(a_rule, &a_rule->binlog_seq, a_rule->static_fd) < 0) {
+		zc_error("zlog_binlog_put_head fail");
+		return -1;
+	}
+	if (write(a_rule->static_fd, msg, msg_len) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		return -1;
 	}
@@ -168,108 +197,134 @@ static char * zlog_rule_gen_archive_path(zlog_rule_t *a_rule, zlog_thread_t *a_t
 	return zlog_buf_str(a_thread->archive_path_buf);
 }
 
-static int zlog_rule_output_static_file_rotate(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+/* fd of path, kept in file_table or opened for this msg only */
+static int zlog_rule_open_file(zlog_rule_t * a_rule, char *path,
+		zlog_file_entry_t **a_entry)
 {
-	size_t len;
-	struct zlog_stat info;
 	int fd;
+	long len;
 
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_gen_msg fail");
-		return -1;
+	if (a_rule->file_table) {
+		*a_entry = zlog_file_table_get(a_rule->file_table, path);
+		if (!*a_entry) {
+			zc_error("zlog_file_table_get fail");
+			return -1;
+		}
+		len = zlog_rule_put_binlog_head(a_rule, &(*a_entry)->binlog_seq, (*a_entry)->fd);
+		if (len < 0) {
+			zc_error("zlog_binlog_put_head fail");
+			zlog_file_table_put(a_rule->file_table, *a_entry);
+			return -1;
+		}
+		if (len) zc_atomic_add(&(*a_entry)->size, len);
+		return (*a_entry)->fd;
 	}
 
-	fd = open(a_rule->file_path, 
-		a_rule->file_open_flags | O_WRONLY | O_APPEND | O_CREAT, a_rule->file_perms);
+	*a_entry = NULL;
+	fd = open(path, a_rule->file_open_flags | O_WRONLY | O_APPEND | O_CREAT, a_rule->file_perms);
+	ZLOG_TRACE2(file_open, path, fd);
 	if (fd < 0) {
-		zc_error("open file[%s] fail, errno[%d]", a_rule->file_path, errno);
-		return -1;
-	}
-
-	len = zlog_buf_len(a_thread->msg_buf);
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
-		zc_error("write fail, errno[%d]", errno);
-		close(fd);
+		zc_error("open file[%s] fail, errno[%d]", path, errno);
 		return -1;
 	}
+	return fd;
+}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
+static int zlog_rule_close_file(zlog_rule_t * a_rule, int fd,
+		zlog_file_entry_t *a_entry)
+{
+	if (a_entry) {
+		zlog_file_table_put(a_rule->file_table, a_entry);
+		return 0;
 	}
 
 	if (close(fd) < 0) {
 		zc_error("close fail, maybe cause by write, errno[%d]", errno);
 		return -1;
 	}
+	return 0;
+}
 
-	if (len > a_rule->archive_max_size) {
-		zc_debug("one msg's len[%ld] > archive_max_size[%ld], no rotate",
-			 (long)len, (long)a_rule->archive_max_size);
-		return 0;
+static int zlog_rule_write_dynamic_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	int fd;
+	zlog_file_entry_t *a_entry;
+
+	fd = zlog_rule_open_file(a_rule, path, &a_entry);
+	if (fd < 0) return -1;
+
+	if (write(fd, msg, msg_len) < 0) {
+		zc_error("write fail, errno[%d]", errno);
+		zlog_rule_close_file(a_rule, fd, a_entry);
+		return -1;
 	}
 
-	if (stat(a_rule->file_path, &info)) {
-		zc_warn("stat [%s] fail, errno[%d], maybe in rotating", a_rule->file_path, errno);
-		return 0;
+	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
+		a_rule->fsync_count = 0;
+		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
 	}
 
-	/* file not so big, return */
-	if (info.st_size + len < a_rule->archive_max_size) return 0;
+	return zlog_rule_close_file(a_rule, fd, a_entry);
+}
 
-	if (zlog_rotater_rotate(zlog_env_conf->rotater, 
-		a_rule->file_path, len,
-		zlog_rule_gen_archive_path(a_rule, a_thread),
-		a_rule->archive_max_size, a_rule->archive_max_count)
-		) {
-		zc_error("zlog_rotater_rotate fail");
-		return -1;
-	} /* success or no rotation do nothing */
+static void zlog_rule_count_rotate_request(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	zlog_stats_rule_counter_t *a_counter;
 
-	return 0;
+	zlog_stats_add(&a_thread->stats.rotate_requests, 1);
+	a_counter = zlog_stats_rule(&a_thread->stats, &a_rule->stats_id);
+	if (a_counter) zlog_stats_add(&a_counter->rotate_requests, 1);
+	return;
 }
 
-/* return path	success
- * return NULL	fail
+/* the next boundary of interval after now, counted from the local midnight,
+ * which is always one for intervals under a day, days go by the calendar
  */
-#define zlog_rule_gen_path(a_rule, a_thread) do {    \
-	int i;    \
-	zlog_spec_t *a_spec;    \
-    \
-	zlog_buf_restart(a_thread->path_buf);    \
-    \
-	zc_arraylist_foreach(a_rule->dynamic_specs, i, a_spec) {    \
-		if (zlog_spec_gen_path(a_spec, a_thread)) {    \
-			zc_error("zlog_spec_gen_path fail");    \
-			return -1;    \
-		}    \
-	}    \
-    \
-	zlog_buf_seal(a_thread->path_buf);    \
-} while(0)
-
-
-static int zlog_rule_output_dynamic_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+static time_t zlog_rule_next_boundary(long interval, time_t now)
 {
-	int fd;
+	struct tm tm;
+	time_t midnight;
+	time_t next;
 
-	zlog_rule_gen_path(a_rule, a_thread);
+	localtime_r(&now, &tm);
+	tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+	midnight = mktime(&tm);
 
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_output fail");
-		return -1;
+	if (interval % 86400 == 0) {
+		tm.tm_mday += interval / 86400;
+		return mktime(&tm);
 	}
 
-	fd = open(zlog_buf_str(a_thread->path_buf),
-		a_rule->file_open_flags | O_WRONLY | O_APPEND | O_CREAT, a_rule->file_perms);
-	if (fd < 0) {
-		zc_error("open file[%s] fail, errno[%d]", zlog_buf_str(a_thread->path_buf), errno);
-		return -1;
-	}
+	next = midnight + ((now - midnight) / interval + 1) * interval;
+	tm.tm_mday++;
+	midnight = mktime(&tm);
+	return next < midnight ? next : midnight;
+}
+
+/* the size kept in file_table saves a stat() for every msg,
+ * and the next time boundary is one compare */
+static int zlog_rule_write_file_rotate(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	int fd;
+	long size = 0;
+	ino_t ino = 0;
+	int rotating = 0;
+	int by_size = 0;
+	int by_time = 0;
+	time_t now;
+	time_t next;
+	zlog_file_entry_t *a_entry;
+	struct zlog_stat info;
+
+	fd = zlog_rule_open_file(a_rule, path, &a_entry);
+	if (fd < 0) return -1;
 
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
+	if (write(fd, msg, msg_len) < 0) {
 		zc_error("write fail, errno[%d]", errno);
-		close(fd);
+		zlog_rule_close_file(a_rule, fd, a_entry);
 		return -1;
 	}
 
@@ -278,93 +333,182 @@ static int zlog_rule_output_dynamic_file_single(zlog_rule_t * a_rule, zlog_threa
 		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
 	}
 
-	if (close(fd) < 0) {
-		zc_error("close fail, maybe cause by write, errno[%d]", errno);
+	if (a_rule->archive_interval) {
+		now = time(NULL);
+		next = zc_atomic_load(&a_rule->archive_next);
+		/* the 1st writer past the boundary moves it on and asks */
+		if (now >= next) {
+			by_time = zc_atomic_cas(&a_rule->archive_next, &next,
+				zlog_rule_next_boundary(a_rule->archive_interval, now));
+		}
+	}
+
+	if (a_entry) {
+		size = zc_atomic_add(&a_entry->size, msg_len);
+		ino = a_entry->ino;
+	}
+	if (a_entry && !by_time && a_rule->archive_max_size > 0
+		&& msg_len <= a_rule->archive_max_size
+		&& size + msg_len >= a_rule->archive_max_size) {
+		/* the 1st writer over the size asks, the others go on with fd */
+		by_size = zc_atomic_cas(&a_entry->rotating, &rotating, 1);
+	}
+
+	if (zlog_rule_close_file(a_rule, fd, a_entry)) return -1;
+
+	if (!a_entry && (by_time || a_rule->archive_max_size > 0)) {
+		if (msg_len > a_rule->archive_max_size && !by_time) {
+			zc_debug("one msg's len[%ld] > archive_max_size[%ld], no rotate",
+				 (long)msg_len, (long) a_rule->archive_max_size);
+			return 0;
+		}
+		if (stat(path, &info)) {
+			zc_warn("stat [%s] fail, errno[%d], maybe in rotating", path, errno);
+			return 0;
+		}
+		ino = info.st_ino;
+		if (!by_time && info.st_size + msg_len >= a_rule->archive_max_size) by_size = 1;
+	}
+
+	if (!by_size && !by_time) return 0;
+
+	/* done by the rotater's thread, which then invalidates the cached fd,
+	 * at a boundary only if nobody else has rotated the file yet */
+	if (zlog_rotater_request(zlog_env_conf->rotater, a_rule->file_table,
+		path, by_time ? ino : 0, msg_len,
+		zlog_rule_gen_archive_path(a_rule, a_thread),
+		by_time ? 0 : a_rule->archive_max_size, a_rule->archive_max_count)
+		) {
+		zc_error("zlog_rotater_request fail");
 		return -1;
 	}
 
+	if (zlog_stats_enabled) {
+		zlog_rule_count_rotate_request(a_rule, a_thread);
+	}
+
 	return 0;
 }
 
-static int zlog_rule_output_dynamic_file_rotate(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+static int zlog_rule_write_static_file_rotate(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
 {
-	int fd;
-	char *path;
-	size_t len;
-	struct zlog_stat info;
+	return zlog_rule_write_file_rotate(a_rule, a_thread, a_rule->file_path, msg, msg_len);
+}
 
-	zlog_rule_gen_path(a_rule, a_thread);
+static int zlog_rule_write_dynamic_file_rotate(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	return zlog_rule_write_file_rotate(a_rule, a_thread, path, msg, msg_len);
+}
 
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_output fail");
+static int zlog_rule_write_pipe(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	if (zlog_rule_put_binlog_head(a_rule, &a_rule->binlog_seq, a_rule->pipe_fd) < 0) {
+		zc_error("zlog_binlog_put_head fail");
 		return -1;
 	}
-
-	path = zlog_buf_str(a_thread->path_buf);
-	fd = open(path, a_rule->file_open_flags | O_WRONLY | O_APPEND | O_CREAT, a_rule->file_perms);
-	if (fd < 0) {
-		zc_error("open file[%s] fail, errno[%d]", zlog_buf_str(a_thread->path_buf), errno);
+	if (write(a_rule->pipe_fd, msg, msg_len) < 0) {
+		zc_error("write fail, errno[%d]", errno);
 		return -1;
 	}
 
-	len = zlog_buf_len(a_thread->msg_buf);
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
+	return 0;
+}
+
+static int zlog_rule_write_stdout(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	if (zlog_rule_put_binlog_head(a_rule, &a_rule->binlog_seq, STDOUT_FILENO) < 0) {
+		zc_error("zlog_binlog_put_head fail");
+		return -1;
+	}
+	if (write(STDOUT_FILENO, msg, msg_len) < 0) {
 		zc_error("write fail, errno[%d]", errno);
-		close(fd);
 		return -1;
 	}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
-	}
+	return 0;
+}
 
-	if (close(fd) < 0) {
-		zc_error("write fail, maybe cause by write, errno[%d]", errno);
+static int zlog_rule_write_stderr(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	if (zlog_rule_put_binlog_head(a_rule, &a_rule->binlog_seq, STDERR_FILENO) < 0) {
+		zc_error("zlog_binlog_put_head fail");
 		return -1;
 	}
-
-	if (len > a_rule->archive_max_size) {
-		zc_debug("one msg's len[%ld] > archive_max_size[%ld], no rotate",
-			 (long)len, (long) a_rule->archive_max_size);
-		return 0;
+	if (write(STDERR_FILENO, msg, msg_len) < 0) {
+		zc_error("write fail, errno[%d]", errno);
+		return -1;
 	}
 
-	if (stat(path, &info)) {
-		zc_warn("stat [%s] fail, errno[%d], maybe in rotating", path, errno);
-		return 0;
-	}
+	return 0;
+}
 
-	/* file not so big, return */
-	if (info.st_size + len < a_rule->archive_max_size) return 0;
+static int zlog_rule_write_batch(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	return zlog_batch_write(a_rule->batch, msg, msg_len, a_thread->event->level);
+}
 
-	if (zlog_rotater_rotate(zlog_env_conf->rotater, 
-		path, len,
-		zlog_rule_gen_archive_path(a_rule, a_thread),
-		a_rule->archive_max_size, a_rule->archive_max_count)
-		) {
-		zc_error("zlog_rotater_rotate fail");
-		return -1;
-	} /* success or no rotation do nothing */
+/* called with the batch lock held, or from the flusher thread */
+static int zlog_rule_batch_flush(void *arg, char *buf, size_t len)
+{
+	zlog_rule_t *a_rule = arg;
 
-	return 0;
+	return a_rule->direct_write(a_rule, NULL, NULL, buf, len);
 }
 
-static int zlog_rule_output_pipe(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+/* return path	success
+ * return NULL	fail
+ */
+#define zlog_rule_gen_path(a_rule, a_thread) do {    \
+	int i;    \
+	zlog_spec_t *a_spec;    \
+    \
+	zlog_buf_restart(a_thread->path_buf);    \
+    \
+	zc_arraylist_foreach(a_rule->dynamic_specs, i, a_spec) {    \
+		if (zlog_spec_gen_path(a_spec, a_thread)) {    \
+			zc_error("zlog_spec_gen_path fail");    \
+			return -1;    \
+		}    \
+	}    \
+    \
+	zlog_buf_seal(a_thread->path_buf);    \
+} while(0)
+
+/* output of file, pipe, stdout and stderr,
+ * msg is made here and written by a_rule->write(),
+ * now or later in the async writer thread
+ */
+static int zlog_rule_output_write(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
 {
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+	char *path = NULL;
+
+	if (a_rule->dynamic_specs) {
+		zlog_rule_gen_path(a_rule, a_thread);
+		path = zlog_buf_str(a_thread->path_buf);
+	}
+
+	if (a_rule->binlog) {
+		if (zlog_binlog_gen_msg(a_rule->binlog, a_thread, a_thread->msg_buf)) {
+			zc_error("zlog_binlog_gen_msg fail");
+			return -1;
+		}
+	} else if (zlog_format_gen_msg(a_rule->format, a_thread)) {
 		zc_error("zlog_format_gen_msg fail");
 		return -1;
 	}
 
-	if (write(a_rule->pipe_fd,
-			zlog_buf_str(a_thread->msg_buf),
-			zlog_buf_len(a_thread->msg_buf)) < 0) {
-		zc_error("write fail, errno[%d]", errno);
-		return -1;
+	if (a_rule->async && a_thread->async_ring) {
+		return zlog_async_push(a_thread->async_ring, a_rule, a_thread, path);
 	}
 
-	return 0;
+	return zlog_rule_write(a_rule, a_thread, path,
+			zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf));
 }
 
 static int zlog_rule_output_syslog(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
@@ -446,41 +590,6 @@ static int zlog_rule_output_dynamic_record(zlog_rule_t * a_rule, zlog_thread_t *
 	return 0;
 }
 
-static int zlog_rule_output_stdout(zlog_rule_t * a_rule,
-				   zlog_thread_t * a_thread)
-{
-
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_gen_msg fail");
-		return -1;
-	}
-
-	if (write(STDOUT_FILENO,
-		zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
-		zc_error("write fail, errno[%d]", errno);
-		return -1;
-	}
-
-	return 0;
-}
-
-static int zlog_rule_output_stderr(zlog_rule_t * a_rule,
-				   zlog_thread_t * a_thread)
-{
-
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_gen_msg fail");
-		return -1;
-	}
-
-	if (write(STDERR_FILENO,
-		zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
-		zc_error("write fail, errno[%d]", errno);
-		return -1;
-	}
-
-	return 0;
-}
 /*******************************************************************************/
 static int syslog_facility_atoi(char *facility)
 {
@@ -516,8 +625,7 @@ static int syslog_facility_atoi(char *facility)
 }
 
 static int zlog_rule_parse_path(char *path_start, /* start with a " */
-		char *path_str, size_t path_size, zc_arraylist_t **path_specs,
-		int *time_cache_count)
+		char *path_str, size_t path_size, zc_arraylist_t **path_specs)
 {
 	char *p, *q;
 	size_t len;
@@ -556,7 +664,7 @@ static int zlog_rule_parse_path(char *path_start, /* start with a " */
 	}
 
 	for (p = path_str; *p != '\0'; p = q) {
-		a_spec = zlog_spec_new(p, &q, time_cache_count);
+		a_spec = zlog_spec_new(p, &q);
 		if (!a_spec) {
 			zc_error("zlog_spec_new fail");
 			goto err;
@@ -576,13 +684,112 @@ err:
 	return -1;
 }
 
+/* size like 10MB, and or time like daily, hourly or 600s */
+static int zlog_rule_parse_file_limit(zlog_rule_t * a_rule, char *limit)
+{
+	char *token;
+	char *saveptr = NULL;
+	char *end;
+	long n;
+
+	for (token = strtok_r(limit, " \t", &saveptr); token;
+		token = strtok_r(NULL, " \t", &saveptr)) {
+		n = strtol(token, &end, 10);
+		if (STRICMP(token, ==, "daily")) {
+			a_rule->archive_interval = 86400;
+		} else if (STRICMP(token, ==, "hourly")) {
+			a_rule->archive_interval = 3600;
+		} else if (end != token && STRCMP(end, ==, "s")) {
+			if (n <= 0) {
+				zc_error("rotate interval[%s] must be > 0", token);
+				return -1;
+			}
+			/* counted from midnight, so no more than a day unless whole days */
+			if (n > 86400 && n % 86400) {
+				zc_error("rotate interval[%s] over a day must be whole days, like 172800s", token);
+				return -1;
+			}
+			a_rule->archive_interval = n;
+		} else if (strspn(token, "0123456789GgMmKkBb") == strlen(token)) {
+			a_rule->archive_max_size = zc_parse_byte_size(token);
+		} else {
+			zc_error("file limit[%s] is not a size like 10MB, daily, hourly or seconds like 600s", token);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* options    [async] [sync] [binary] */
+static int zlog_rule_parse_options(zlog_rule_t * a_rule, char *options)
+{
+	char *p;
+	char option[MAXLEN_CFG_LINE + 1];
+	int nread;
+
+	for (p = options; sscanf(p, " %[^, \t]%n", option, &nread) == 1; p += nread) {
+		if (STRICMP(option, ==, "async")) {
+			a_rule->async = 1;
+		} else if (STRICMP(option, ==, "sync")) {
+			a_rule->async = 0;
+		} else if (STRICMP(option, ==, "binary")) {
+			if (!a_rule->binlog) a_rule->binlog = zlog_binlog_new();
+			if (!a_rule->binlog) {
+				zc_error("zlog_binlog_new fail");
+				return -1;
+			}
+		} else {
+			zc_error("unknown rule option[%s]", option);
+			return -1;
+		}
+		while (*(p + nread) == ',' || isspace(*(p + nread))) nread++;
+	}
+
+	return 0;
+}
+
+/* several rules of one static file write through one fd,
+ * the fd stays with the rule opened it till all of them are gone
+ * return 0: shared, 1: no peer has it
+ */
+static int zlog_rule_share_static_fd(zlog_rule_t * a_rule, zc_arraylist_t * peers)
+{
+	int i;
+	zlog_rule_t *a_peer;
+
+	/* what a file has got of a binlog is kept by its own rule */
+	if (!peers || a_rule->binlog) return 1;
+
+	zc_arraylist_foreach(peers, i, a_peer) {
+		if (a_peer->static_fd <= 0 || a_peer->dynamic_specs || a_peer->binlog
+			|| a_peer->archive_max_size > 0
+			|| a_peer->file_open_flags != a_rule->file_open_flags
+			|| a_peer->file_perms != a_rule->file_perms
+			|| STRCMP(a_peer->file_path, !=, a_rule->file_path)) {
+			continue;
+		}
+		if (a_peer->fd_rule) a_peer = a_peer->fd_rule;
+		a_peer->refs++;
+		a_rule->fd_rule = a_peer;
+		a_rule->static_fd = a_peer->static_fd;
+		a_rule->static_dev = a_peer->static_dev;
+		a_rule->static_ino = a_peer->static_ino;
+		zc_debug("rule[%s] shares fd[%d] of [%s]", a_rule->line, a_rule->static_fd, a_peer->line);
+		return 0;
+	}
+	return 1;
+}
+
 zlog_rule_t *zlog_rule_new(char *line,
 		zc_arraylist_t *levels,
 		zlog_format_t * default_format,
 		zc_arraylist_t * formats,
 		unsigned int file_perms,
 		size_t fsync_period,
-		int * time_cache_count)
+		size_t file_cache_size,
+		long file_cache_timeout,
+		int async,
+		zc_arraylist_t * peers)
 {
 	int rc = 0;
 	int nscan = 0;
@@ -614,6 +821,14 @@ zlog_rule_t *zlog_rule_new(char *line,
 		return NULL;
 	}
 
+	a_rule->refs = 1;
+	if (strlen(line) > sizeof(a_rule->line) - 1) {
+		zc_error("line[%s] too long", line);
+		goto err;
+	}
+	strcpy(a_rule->line, line);
+	zlog_stats_id_new(&a_rule->stats_id, ZLOG_STATS_RULE);
+
 	a_rule->file_perms = file_perms;
 	a_rule->fsync_period = fsync_period;
 
@@ -704,9 +919,10 @@ zlog_rule_t *zlog_rule_new(char *line,
 		break;
 	}
 
-	/* action               ["%H/log/aa.log", 20MB * 12 ; MyTemplate]
+	/* action               ["%H/log/aa.log", 20MB * 12 ; MyTemplate ; async]
 	 * output               ["%H/log/aa.log", 20MB * 12]
 	 * format               [MyTemplate]
+	 * options              [async]
 	 */
 	memset(output, 0x00, sizeof(output));
 	memset(format_name, 0x00, sizeof(format_name));
@@ -716,6 +932,17 @@ zlog_rule_t *zlog_rule_new(char *line,
 		goto err;
 	}
 
+	a_rule->async = async;
+	p = strchr(format_name, ';');
+	if (p) *p = '\0';
+	p = strchr(action, ';');
+	if (p && (p = strchr(p + 1, ';'))) {
+		if (zlog_rule_parse_options(a_rule, p + 1)) {
+			zc_error("zlog_rule_parse_options fail");
+			goto err;
+		}
+	}
+
 	/* check and get format */
 	if (STRCMP(format_name, ==, "")) {
 		zc_debug("no format specified, use default");
@@ -779,7 +1006,7 @@ zlog_rule_t *zlog_rule_new(char *line,
 		if (!p) p = file_path;
 
 		rc = zlog_rule_parse_path(p, a_rule->file_path, sizeof(a_rule->file_path),
-				&(a_rule->dynamic_specs), time_cache_count);
+				&(a_rule->dynamic_specs));
 		if (rc) {
 			zc_error("zlog_rule_parse_path fail");
 			goto err;
@@ -787,16 +1014,17 @@ zlog_rule_t *zlog_rule_new(char *line,
 
 		if (file_limit) {
 			memset(archive_max_size, 0x00, sizeof(archive_max_size));
-			nscan = sscanf(file_limit, " %[0-9GgMmKkBb] * %d ~",
+			nscan = sscanf(file_limit, " %[^*~\"] * %d ~",
 					archive_max_size, &(a_rule->archive_max_count));
-			if (nscan) {
-				a_rule->archive_max_size = zc_parse_byte_size(archive_max_size);
+			if (nscan && zlog_rule_parse_file_limit(a_rule, archive_max_size)) {
+				zc_error("zlog_rule_parse_file_limit fail");
+				goto err;
 			}
 			p = strchr(file_limit, '"');
 			if (p) { /* archive file path exist */
 				rc = zlog_rule_parse_path(p,
 					a_rule->archive_path, sizeof(a_rule->file_path),
-					&(a_rule->archive_specs), time_cache_count);
+					&(a_rule->archive_specs));
 				if (rc) {
 					zc_error("zlog_rule_parse_path fail");
 					goto err;
@@ -810,44 +1038,74 @@ zlog_rule_t *zlog_rule_new(char *line,
 			}
 		}
 
+		if (a_rule->archive_interval && a_rule->dynamic_specs) {
+			zc_error("rotate by time needs a static file path, [%s] is not", file_path);
+			goto err;
+		}
+
 		/* try to figure out if the log file path is dynamic or static */
 		if (a_rule->dynamic_specs) {
 			if (a_rule->archive_max_size <= 0) {
-				a_rule->output = zlog_rule_output_dynamic_file_single;
+				a_rule->write = zlog_rule_write_dynamic_file_single;
 			} else {
-				a_rule->output = zlog_rule_output_dynamic_file_rotate;
+				a_rule->write = zlog_rule_write_dynamic_file_rotate;
 			}
 		} else {
 			struct stat stb;
 
-			if (a_rule->archive_max_size <= 0) {
-				a_rule->output = zlog_rule_output_static_file_single;
+			if (a_rule->archive_max_size <= 0 && !a_rule->archive_interval) {
+				a_rule->write = zlog_rule_write_static_file_single;
 			} else {
-				/* as rotate, so need to reopen everytime */
-				a_rule->output = zlog_rule_output_static_file_rotate;
+				/* as rotate, keep the fd in file_table, which knows when to reopen */
+				a_rule->write = zlog_rule_write_static_file_rotate;
 			}
 
-			a_rule->static_fd = open(a_rule->file_path,
-				O_WRONLY | O_APPEND | O_CREAT | a_rule->file_open_flags,
-				a_rule->file_perms);
-			if (a_rule->static_fd < 0) {
-				zc_error("open file[%s] fail, errno[%d]", a_rule->file_path, errno);
-				goto err;
-			}
+			if (a_rule->archive_max_size > 0 || a_rule->archive_interval
+				|| zlog_rule_share_static_fd(a_rule, peers)) {
+				a_rule->static_fd = open(a_rule->file_path,
+					O_WRONLY | O_APPEND | O_CREAT | a_rule->file_open_flags,
+					a_rule->file_perms);
+				ZLOG_TRACE2(file_open, a_rule->file_path, a_rule->static_fd);
+				if (a_rule->static_fd < 0) {
+					zc_error("open file[%s] fail, errno[%d]", a_rule->file_path, errno);
+					goto err;
+				}
 
-			/* save off the inode information for checking for a changed file later on */
-			if (fstat(a_rule->static_fd, &stb)) {
-				zc_error("stat [%s] fail, errno[%d], failing to open static_fd", a_rule->file_path, errno);
-				goto err;
-			}
+				/* save off the inode information for checking for a changed file later on */
+				if (fstat(a_rule->static_fd, &stb)) {
+					zc_error("stat [%s] fail, errno[%d], failing to open static_fd", a_rule->file_path, errno);
+					goto err;
+				}
+
+				if (a_rule->archive_interval) {
+					/* what is left of an earlier period goes at the 1st msg */
+					a_rule->archive_next = zlog_rule_next_boundary(a_rule->archive_interval,
+						stb.st_size ? stb.st_mtime : time(NULL));
+				}
+
+				if (a_rule->archive_max_size > 0 || a_rule->archive_interval) {
+					close(a_rule->static_fd);
+					a_rule->static_fd = -1;
+				}
 
-			if (a_rule->archive_max_size > 0) {
-				close(a_rule->static_fd);
-				a_rule->static_fd = -1;
+				a_rule->static_dev = stb.st_dev;
+				a_rule->static_ino = stb.st_ino;
 			}
+		}
 
-			a_rule->static_dev = stb.st_dev;
-			a_rule->static_ino = stb.st_ino;
+		/* zero size means open and close for every msg,
+		 * but a binary rule keeps what each file has got in the table
+		 */
+		if ((file_cache_size || a_rule->binlog) && (a_rule->dynamic_specs
+			|| a_rule->archive_max_size > 0 || a_rule->archive_interval)) {
+			a_rule->file_table = zlog_file_table_new(
+					a_rule->dynamic_specs && file_cache_size ? file_cache_size : 1,
+					a_rule->dynamic_specs ? file_cache_timeout : 0,
+					a_rule->file_open_flags, a_rule->file_perms);
+			if (!a_rule->file_table) {
+				zc_error("zlog_file_table_new fail");
+				goto err;
+			}
 		}
 		break;
 	case '|' :
@@ -861,7 +1119,7 @@ zlog_rule_t *zlog_rule_new(char *line,
 			zc_error("fileno fail, errno[%d]", errno);
 			goto err;
 		}
-		a_rule->output = zlog_rule_output_pipe;
+		a_rule->write = zlog_rule_write_pipe;
 		break;
 	case '>' :
 		if (STRNCMP(file_path + 1, ==, "syslog", 6)) {
@@ -877,9 +1135,9 @@ zlog_rule_t *zlog_rule_new(char *line,
 			openlog(NULL, LOG_NDELAY | LOG_NOWAIT | LOG_PID, LOG_USER);
 #endif
 		} else if (STRNCMP(file_path + 1, ==, "stdout", 6)) {
-			a_rule->output = zlog_rule_output_stdout;
+			a_rule->write = zlog_rule_write_stdout;
 		} else if (STRNCMP(file_path + 1, ==, "stderr", 6)) {
-			a_rule->output = zlog_rule_output_stderr;
+			a_rule->write = zlog_rule_write_stderr;
 		} else {
 			zc_error
 			    ("[%s]the string after is not syslog, stdout or stderr", output);
@@ -933,7 +1191,7 @@ zlog_rule_t *zlog_rule_new(char *line,
 				goto err;
 			}
 			for (p = a_rule->record_path; *p != '\0'; p = q) {
-				a_spec = zlog_spec_new(p, &q, time_cache_count);
+				a_spec = zlog_spec_new(p, &q);
 				if (!a_spec) {
 					zc_error("zlog_spec_new fail");
 					goto err;
@@ -954,6 +1212,16 @@ zlog_rule_t *zlog_rule_new(char *line,
 		goto err;
 	}
 
+	if (a_rule->write) {
+		a_rule->output = zlog_rule_output_write;
+	} else if (a_rule->binlog) {
+		zc_error("option binary only works with files, pipes, stdout and stderr");
+		goto err;
+	} else {
+		/* syslog and record are called in place */
+		a_rule->async = 0;
+	}
+
 	return a_rule;
 err:
 	zlog_rule_del(a_rule);
@@ -963,11 +1231,25 @@ err:
 void zlog_rule_del(zlog_rule_t * a_rule)
 {
 	zc_assert(a_rule,);
+	/* still kept by another conf, or its static_fd still shared */
+	if (--a_rule->refs > 0) return;
+	zlog_stats_id_del(&a_rule->stats_id, ZLOG_STATS_RULE);
+	/* write out what is left before fds are closed */
+	if (a_rule->batch) {
+		zlog_batch_del(a_rule->batch);
+		a_rule->batch = NULL;
+	}
 	if (a_rule->dynamic_specs) {
 		zc_arraylist_del(a_rule->dynamic_specs);
 		a_rule->dynamic_specs = NULL;
 	}
-	if (a_rule->static_fd > 0) {
+	if (a_rule->file_table) {
+		zlog_file_table_del(a_rule->file_table);
+		a_rule->file_table = NULL;
+	}
+	if (a_rule->fd_rule) {
+		zlog_rule_del(a_rule->fd_rule);
+	} else if (a_rule->static_fd > 0) {
 		if (close(a_rule->static_fd)) {
 			zc_error("close fail, maybe cause by write, errno[%d]", errno);
 		}
@@ -983,12 +1265,43 @@ void zlog_rule_del(zlog_rule_t * a_rule)
 		zc_arraylist_del(a_rule->archive_specs);
 		a_rule->archive_specs = NULL;
 	}
+	if (a_rule->binlog) {
+		zlog_binlog_del(a_rule->binlog);
+		a_rule->binlog = NULL;
+	}
 	zc_debug("zlog_rule_del[%p]", a_rule);
     free(a_rule);
 	return;
 }
 
 /*******************************************************************************/
+int zlog_rule_write(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len)
+{
+	int rc;
+	unsigned long long start = 0;
+	zlog_stats_rule_counter_t *a_counter;
+
+	ZLOG_TRACE2(write_entry, path ? path : a_rule->file_path, msg_len);
+	if (zlog_stats_enabled) start = zlog_stats_now();
+	rc = a_rule->write(a_rule, a_thread, path, msg, msg_len);
+	ZLOG_TRACE1(write_return, rc);
+	if (!start) return rc;
+
+	a_counter = zlog_stats_rule(&a_thread->stats, &a_rule->stats_id);
+	if (!a_counter) return rc;
+
+	zlog_stats_latency(a_counter, zlog_stats_now() - start);
+	zlog_stats_add(&a_counter->writes, 1);
+	if (rc) {
+		zlog_stats_add(&a_counter->errors, 1);
+		zlog_stats_add(&a_thread->stats.write_errors, 1);
+	} else {
+		zlog_stats_add(&a_counter->bytes, msg_len);
+	}
+	return rc;
+}
+
 int zlog_rule_output(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
 {
 	switch (a_rule->compare_char) {
@@ -1081,3 +1394,27 @@ int zlog_rule_set_record(zlog_rule_t * a_rule, zc_hashtable_t *records)
 	}
 	return 0;
 }
+
+/* only outputs with one fixed fd, others need the path of each msg */
+int zlog_rule_set_batch(zlog_rule_t * a_rule, size_t size, size_t max_count, int level)
+{
+	/* kept from the last conf, which had the same buffer setting */
+	if (a_rule->batch) return 0;
+
+	if (a_rule->write != zlog_rule_write_static_file_single
+	&&  a_rule->write != zlog_rule_write_pipe
+	&&  a_rule->write != zlog_rule_write_stdout
+	&&  a_rule->write != zlog_rule_write_stderr) {
+		return 0;
+	}
+
+	a_rule->batch = zlog_batch_new(size, max_count, level,
+				zlog_rule_batch_flush, a_rule);
+	if (!a_rule->batch) {
+		zc_error("zlog_batch_new fail");
+		return -1;
+	}
+	a_rule->direct_write = a_rule->write;
+	a_rule->write = zlog_rule_write_batch;
+	return 0;
+}
@@ -23,18 +23,29 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "zc_defs.h"
 #include "format.h"
 #include "thread.h"
 #include "rotater.h"
 #include "record.h"
+#include "file_table.h"
+#include "batch.h"
+#include "binlog.h"
 
 typedef struct zlog_rule_s zlog_rule_t;
 
 typedef int (*zlog_rule_output_fn) (zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+/* path is NULL for static file, pipe, stdout and stderr */
+typedef int (*zlog_rule_write_fn) (zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len);
 
 struct zlog_rule_s {
+	char line[MAXLEN_CFG_LINE + 1]; /* as in conf, to find it on reload */
+	int refs; /* confs keeping it and rules sharing its static_fd */
+	zlog_stats_id_t stats_id;
+
 	char category[MAXLEN_CFG_LINE + 1];
 	char compare_char;
 	/* 
@@ -54,8 +65,14 @@ struct zlog_rule_s {
 	int static_fd;
 	dev_t static_dev;
 	ino_t static_ino;
+	int file_check;     /* ZLOG_FILE_CHECK_*, set by watcher */
+	int static_changed; /* raised by watcher, cleared by writer */
+	zlog_rule_t *fd_rule; /* the rule static_fd belongs to, if not this */
+	zlog_file_table_t *file_table; /* fds of dynamic paths */
 
 	long archive_max_size;
+	long archive_interval; /* seconds, rotate at its boundaries in local time */
+	time_t archive_next;   /* next boundary, moved on by the 1st writer past it */
 	int archive_max_count;
 	char archive_path[MAXLEN_PATH + 1];
 	zc_arraylist_t *archive_specs;
@@ -71,6 +88,12 @@ struct zlog_rule_s {
 
 	zlog_format_t *format;
 	zlog_rule_output_fn output;
+	zlog_rule_write_fn write;
+	int async;
+	zlog_batch_t *batch;
+	zlog_rule_write_fn direct_write; /* write behind the batch */
+	zlog_binlog_t *binlog; /* option binary, records instead of format */
+	size_t binlog_seq;     /* of binlog, what static_fd or the stream has got */
 
 	char record_name[MAXLEN_PATH + 1];
 	char record_path[MAXLEN_PATH + 1];
@@ -83,13 +106,20 @@ zlog_rule_t *zlog_rule_new(char * line,
 		zc_arraylist_t * formats,
 		unsigned int file_perms,
 		size_t fsync_period,
-		int * time_cache_count);
+		size_t file_cache_size,
+		long file_cache_timeout,
+		int async,
+		zc_arraylist_t * peers);
 
 void zlog_rule_del(zlog_rule_t * a_rule);
 void zlog_rule_profile(zlog_rule_t * a_rule, int flag);
 int zlog_rule_match_category(zlog_rule_t * a_rule, char *category);
 int zlog_rule_is_wastebin(zlog_rule_t * a_rule);
 int zlog_rule_set_record(zlog_rule_t * a_rule, zc_hashtable_t *records);
+int zlog_rule_set_batch(zlog_rule_t * a_rule, size_t size, size_t max_count, int level);
 int zlog_rule_output(zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+/* a_rule->write(), counted and timed if stats is on */
+int zlog_rule_write(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		char *path, char *msg, size_t msg_len);
 
 #endif
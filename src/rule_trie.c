@@ -0,0 +1,262 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "rule_trie.h"
+#include "zc_defs.h"
+
+/* most categories fit few rules, more goes to the heap */
+#define ZLOG_RULE_TRIE_FOUND_STACK 64
+
+void zlog_rule_trie_profile(zlog_rule_trie_t * a_trie, int flag)
+{
+	zc_assert(a_trie,);
+	zc_profile(flag, "--rule_trie[%p][%d rules][%d nodes][%d matches][wastebin:%p]--",
+		a_trie,
+		zc_arraylist_len(a_trie->rules),
+		zc_arraylist_len(a_trie->nodes),
+		zc_arraylist_len(a_trie->matches),
+		a_trie->wastebin_rule);
+	return;
+}
+
+/*******************************************************************************/
+void zlog_rule_trie_del(zlog_rule_trie_t * a_trie)
+{
+	zc_assert(a_trie,);
+	if (a_trie->nodes) zc_arraylist_del(a_trie->nodes);
+	if (a_trie->matches) zc_arraylist_del(a_trie->matches);
+	zc_debug("zlog_rule_trie_del[%p]", a_trie);
+	free(a_trie);
+	return;
+}
+
+static zlog_rule_trie_node_t *zlog_rule_trie_node_new(zlog_rule_trie_t * a_trie, char c)
+{
+	zlog_rule_trie_node_t *a_node;
+
+	a_node = calloc(1, sizeof(*a_node));
+	if (!a_node) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_node->c = c;
+	if (zc_arraylist_add(a_trie->nodes, a_node)) {
+		zc_error("zc_arraylist_add fail");
+		free(a_node);
+		return NULL;
+	}
+	return a_node;
+}
+
+/* the node of str[0, len), made on the way if not there */
+static zlog_rule_trie_node_t *zlog_rule_trie_node_get(zlog_rule_trie_t * a_trie,
+		const char *str, size_t len)
+{
+	size_t i;
+	zlog_rule_trie_node_t *a_node = a_trie->root;
+	zlog_rule_trie_node_t *a_child;
+
+	for (i = 0; i < len; i++) {
+		for (a_child = a_node->child; a_child; a_child = a_child->sibling) {
+			if (a_child->c == str[i]) break;
+		}
+		if (!a_child) {
+			a_child = zlog_rule_trie_node_new(a_trie, str[i]);
+			if (!a_child) return NULL;
+			a_child->sibling = a_node->child;
+			a_node->child = a_child;
+		}
+		a_node = a_child;
+	}
+	return a_node;
+}
+
+static int zlog_rule_trie_add(zlog_rule_trie_t * a_trie, const char *str, size_t len,
+		int index, int prefix)
+{
+	zlog_rule_trie_node_t *a_node;
+	zlog_rule_trie_match_t *a_match;
+
+	a_node = zlog_rule_trie_node_get(a_trie, str, len);
+	if (!a_node) {
+		zc_error("zlog_rule_trie_node_get fail");
+		return -1;
+	}
+
+	a_match = calloc(1, sizeof(*a_match));
+	if (!a_match) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return -1;
+	}
+	a_match->index = index;
+	a_match->prefix = prefix;
+	if (zc_arraylist_add(a_trie->matches, a_match)) {
+		zc_error("zc_arraylist_add fail");
+		free(a_match);
+		return -1;
+	}
+	a_match->next = a_node->matches;
+	a_node->matches = a_match;
+	return 0;
+}
+
+/* the same as zlog_rule_match_category() says */
+zlog_rule_trie_t *zlog_rule_trie_new(zc_arraylist_t * rules)
+{
+	int i;
+	size_t len;
+	zlog_rule_t *a_rule;
+	zlog_rule_trie_t *a_trie;
+
+	zc_assert(rules, NULL);
+
+	a_trie = calloc(1, sizeof(*a_trie));
+	if (!a_trie) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_trie->rules = rules;
+
+	a_trie->nodes = zc_arraylist_new(free);
+	a_trie->matches = zc_arraylist_new(free);
+	if (!a_trie->nodes || !a_trie->matches) {
+		zc_error("zc_arraylist_new fail");
+		goto err;
+	}
+
+	a_trie->root = zlog_rule_trie_node_new(a_trie, '\0');
+	if (!a_trie->root) {
+		zc_error("zlog_rule_trie_node_new fail");
+		goto err;
+	}
+
+	zc_arraylist_foreach(rules, i, a_rule) {
+		if (zlog_rule_is_wastebin(a_rule)) a_trie->wastebin_rule = a_rule;
+
+		len = strlen(a_rule->category);
+		if (STRCMP(a_rule->category, ==, "*")) {
+			/* every walk starts at the root */
+			if (zlog_rule_trie_add(a_trie, "", 0, i, 1)) goto err;
+		} else if (len && a_rule->category[len - 1] == '_') {
+			/* aa_ match aa_xx & aa, but not match aa1_xx */
+			if (zlog_rule_trie_add(a_trie, a_rule->category, len, i, 1)
+				|| zlog_rule_trie_add(a_trie, a_rule->category, len - 1, i, 0)) {
+				goto err;
+			}
+		} else {
+			if (zlog_rule_trie_add(a_trie, a_rule->category, len, i, 0)) goto err;
+		}
+	}
+
+	zlog_rule_trie_profile(a_trie, ZC_DEBUG);
+	return a_trie;
+err:
+	zc_error("zlog_rule_trie_new fail");
+	zlog_rule_trie_del(a_trie);
+	return NULL;
+}
+
+/*******************************************************************************/
+/* one rule is at most at one node on a walk, so no index comes twice */
+static int zlog_rule_trie_found(int **found, int *count, int *size, int *stack, int index)
+{
+	int *more;
+
+	if (*count == *size) {
+		more = malloc(sizeof(int) * (*size) * 2);
+		if (!more) {
+			zc_error("malloc fail, errno[%d]", errno);
+			return -1;
+		}
+		memcpy(more, *found, sizeof(int) * (*count));
+		if (*found != stack) free(*found);
+		*found = more;
+		*size *= 2;
+	}
+	(*found)[(*count)++] = index;
+	return 0;
+}
+
+int zlog_rule_trie_match(zlog_rule_trie_t * a_trie, const char *category,
+		zc_arraylist_t * fit_rules)
+{
+	int i;
+	int j;
+	int tmp;
+	int stack[ZLOG_RULE_TRIE_FOUND_STACK];
+	int *found = stack;
+	int count = 0;
+	int size = ZLOG_RULE_TRIE_FOUND_STACK;
+	const char *p = category;
+	zlog_rule_trie_node_t *a_node = a_trie->root;
+	zlog_rule_trie_match_t *a_match;
+
+	zc_assert(a_trie, -1);
+	zc_assert(category, -1);
+
+	while (a_node) {
+		for (a_match = a_node->matches; a_match; a_match = a_match->next) {
+			if (a_match->prefix || *p == '\0') {
+				if (zlog_rule_trie_found(&found, &count, &size, stack, a_match->index)) {
+					goto err;
+				}
+			}
+		}
+		if (*p == '\0') break;
+
+		for (a_node = a_node->child; a_node; a_node = a_node->sibling) {
+			if (a_node->c == *p) break;
+		}
+		p++;
+	}
+
+	/* few found, insertion sort back to conf order */
+	for (i = 1; i < count; i++) {
+		tmp = found[i];
+		for (j = i; j > 0 && found[j - 1] > tmp; j--) found[j] = found[j - 1];
+		found[j] = tmp;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (zc_arraylist_add(fit_rules, zc_arraylist_get(a_trie->rules, found[i]))) {
+			zc_error("zc_arraylist_add fail");
+			goto err;
+		}
+	}
+
+	if (count == 0) {
+		if (a_trie->wastebin_rule) {
+			zc_debug("category[%s], no match rules, use wastebin_rule", category);
+			if (zc_arraylist_add(fit_rules, a_trie->wastebin_rule)) {
+				zc_error("zc_arraylist_add fail");
+				goto err;
+			}
+		} else {
+			zc_debug("category[%s], no match rules & no wastebin_rule", category);
+		}
+	}
+
+	if (found != stack) free(found);
+	return 0;
+err:
+	if (found != stack) free(found);
+	return -1;
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file rule_trie.h
+ * @brief rules of a conf indexed by their category, char by char
+ *
+ * A rule "aa" is kept at node "aa" for a category just "aa", a rule
+ * "aa_" at node "aa_" for every category under it and at node "aa"
+ * too, and a rule "*" at the root. So the rules of a category are
+ * found by one walk down its name, not by matching every rule, which
+ * is what zlog_category_obtain_rules did for each category on reload.
+ */
+
+#ifndef __zlog_rule_trie_h
+#define __zlog_rule_trie_h
+
+#include "zc_defs.h"
+#include "rule.h"
+
+typedef struct zlog_rule_trie_match_s {
+	int index;  /* in rules, to keep the conf order */
+	int prefix; /* 1: any category below the node, 0: the node itself */
+	struct zlog_rule_trie_match_s *next;
+} zlog_rule_trie_match_t;
+
+typedef struct zlog_rule_trie_node_s {
+	char c;
+	struct zlog_rule_trie_node_s *child;
+	struct zlog_rule_trie_node_s *sibling;
+	zlog_rule_trie_match_t *matches;
+} zlog_rule_trie_node_t;
+
+typedef struct {
+	zc_arraylist_t *rules; /* not owned, the conf's */
+	zlog_rule_trie_node_t *root;
+	zc_arraylist_t *nodes;
+	zc_arraylist_t *matches;
+	zlog_rule_t *wastebin_rule; /* the last "!" rule */
+} zlog_rule_trie_t;
+
+zlog_rule_trie_t *zlog_rule_trie_new(zc_arraylist_t * rules);
+void zlog_rule_trie_del(zlog_rule_trie_t * a_trie);
+void zlog_rule_trie_profile(zlog_rule_trie_t * a_trie, int flag);
+
+/* add rules fit the category to fit_rules in conf order,
+ * the wastebin rule if none fits
+ */
+int zlog_rule_trie_match(zlog_rule_trie_t * a_trie, const char *category,
+			zc_arraylist_t * fit_rules);
+
+#endif
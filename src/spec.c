@@ -24,9 +24,12 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "conf.h"
 #include "spec.h"
+#include "clock.h"
+#include "hex.h"
 #include "level_list.h"
 #include "zc_defs.h"
 
@@ -36,18 +39,15 @@
 #define ZLOG_DEFAULT_TIME_FMT "%F %T"
 #endif
 
-#define	ZLOG_HEX_HEAD  \
-	"\n             0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F    0123456789ABCDEF"
-
 /*******************************************************************************/
 void zlog_spec_profile(zlog_spec_t * a_spec, int flag)
 {
 	zc_assert(a_spec,);
-	zc_profile(flag, "----spec[%p][%.*s][%s|%d][%s,%ld,%ld,%s][%s]----",
+	zc_profile(flag, "----spec[%p][%.*s][%s|%p][%s,%ld,%ld,%s][%s]----",
 		a_spec,
 		a_spec->len, a_spec->str,
 		a_spec->time_fmt,
-		a_spec->time_cache_index,
+		a_spec->time_cache,
 		a_spec->print_fmt, (long)a_spec->max_width, (long)a_spec->min_width, a_spec->left_fill_zeros ? "true" : "false",
 		a_spec->mdc_key);
 	return;
@@ -56,60 +56,228 @@ void zlog_spec_profile(zlog_spec_t * a_spec, int flag)
 /*******************************************************************************/
 /* implementation of write function */
 
-static int zlog_spec_write_time_internal(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf, short use_utc)
+/*******************************************************************************/
+/* time caches are shared by all specs and threads with the same time_fmt,
+ * found at conf time under the lock, and read under their seq
+ */
+static pthread_mutex_t zlog_time_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+static zlog_time_cache_t *zlog_time_caches;
+
+/* split time_fmt into strftime parts, each followed by %ms, %us, %ns or nothing */
+static void zlog_time_cache_split(zlog_time_cache_t * a_cache)
 {
-	zlog_time_cache_t * a_cache = a_thread->event->time_caches + a_spec->time_cache_index;
-	time_t now_sec = a_thread->event->time_stamp.tv_sec;
-	struct tm *time;
-	time_t *time_sec;
-	typedef struct tm *(*zlog_spec_time_fn) (const time_t*, struct tm *);
-	zlog_spec_time_fn time_stamp_convert_function;
-	if( use_utc ) {
-		time = &(a_thread->event->time_utc);
-		time_sec =  &(a_thread->event->time_utc_sec);
-		time_stamp_convert_function = gmtime_r;
-	} else {
-		time = &(a_thread->event->time_local);
-		time_sec =  &(a_thread->event->time_local_sec);
-		time_stamp_convert_function = localtime_r;
+	char *p;
+	char *q;
+
+	strcpy(a_cache->fmt_parts, a_cache->time_fmt);
+	a_cache->part_count = 1;
+	a_cache->parts[0].fmt = a_cache->fmt_parts;
+	a_cache->parts[0].width = 0;
+
+	for (p = q = a_cache->fmt_parts; *p; ) {
+		if (*p == '%' && *(p + 1) == '%') {
+			*q++ = *p++;
+			*q++ = *p++;
+			continue;
+		}
+		if (*p == '%' && (STRNCMP(p + 1, ==, "ms", 2) || STRNCMP(p + 1, ==, "us", 2)
+				|| STRNCMP(p + 1, ==, "ns", 2))
+			&& a_cache->part_count < ZLOG_TIME_CACHE_PARTS) {
+			a_cache->parts[a_cache->part_count - 1].width =
+				*(p + 1) == 'm' ? 3 : *(p + 1) == 'u' ? 6 : 9;
+			*q++ = '\0';
+			p += 3;
+			a_cache->parts[a_cache->part_count].fmt = q;
+			a_cache->parts[a_cache->part_count].width = 0;
+			a_cache->part_count++;
+			continue;
+		}
+		*q++ = *p++;
 	}
+	*q = '\0';
+	return;
+}
 
-	/* the event meet the 1st time_spec in his life cycle */
-	if (!now_sec) {
-		gettimeofday(&(a_thread->event->time_stamp), NULL);
-		now_sec = a_thread->event->time_stamp.tv_sec;
-	}
+static zlog_time_cache_t *zlog_time_cache_get(const char *time_fmt, int use_utc)
+{
+	zlog_time_cache_t *a_cache;
 
-	/* When this event's last cached time_local is not now */
-	if (*time_sec != now_sec) {
-		time_stamp_convert_function(&(now_sec), time);
-		*time_sec = now_sec;
+	pthread_mutex_lock(&zlog_time_caches_lock);
+	for (a_cache = zlog_time_caches; a_cache; a_cache = a_cache->next) {
+		if (a_cache->use_utc == use_utc && STRCMP(a_cache->time_fmt, ==, time_fmt)) {
+			a_cache->refs++;
+			pthread_mutex_unlock(&zlog_time_caches_lock);
+			return a_cache;
+		}
 	}
 
-	/* When this spec's last cache time string is not now */
-	if (a_cache->sec != now_sec) {
-		a_cache->len = strftime(a_cache->str, sizeof(a_cache->str), a_spec->time_fmt, time);
-		a_cache->sec = now_sec;
+	a_cache = calloc(1, sizeof(zlog_time_cache_t));
+	if (!a_cache) {
+		zc_error("calloc fail, errno[%d]", errno);
+		pthread_mutex_unlock(&zlog_time_caches_lock);
+		return NULL;
 	}
+	strcpy(a_cache->time_fmt, time_fmt);
+	a_cache->use_utc = use_utc;
+	a_cache->refs = 1;
+	zlog_time_cache_split(a_cache);
 
-	return zlog_buf_append(a_buf, a_cache->str, a_cache->len);
+	a_cache->next = zlog_time_caches;
+	zlog_time_caches = a_cache;
+	pthread_mutex_unlock(&zlog_time_caches_lock);
+	return a_cache;
 }
 
-static int zlog_spec_write_time_UTC(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+static void zlog_time_cache_put(zlog_time_cache_t * a_cache)
 {
-	return zlog_spec_write_time_internal(a_spec, a_thread, a_buf, 1);
+	zlog_time_cache_t **pp;
+
+	pthread_mutex_lock(&zlog_time_caches_lock);
+	if (--a_cache->refs == 0) {
+		for (pp = &zlog_time_caches; *pp; pp = &(*pp)->next) {
+			if (*pp == a_cache) {
+				*pp = a_cache->next;
+				break;
+			}
+		}
+		free(a_cache);
+	}
+	pthread_mutex_unlock(&zlog_time_caches_lock);
+	return;
 }
 
-static int zlog_spec_write_time_local(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+/* strftime every part into str, with zeros in place of %ms %us %ns,
+ * whose places go to offsets, return the length
+ */
+static size_t zlog_time_cache_build(zlog_time_cache_t * a_cache, struct tm *time,
+		char *str, size_t size, size_t *offsets)
 {
-	return zlog_spec_write_time_internal(a_spec, a_thread, a_buf, 0);
+	int i;
+	size_t len = 0;
+	zlog_time_cache_part_t *a_part;
+
+	for (i = 0; i < a_cache->part_count; i++) {
+		a_part = a_cache->parts + i;
+		if (*a_part->fmt) {
+			len += strftime(str + len, size - len, a_part->fmt, time);
+		}
+		if (a_part->width && len + a_part->width < size) {
+			offsets[i] = len;
+			memset(str + len, '0', a_part->width);
+			len += a_part->width;
+		} else {
+			offsets[i] = (size_t)-1;
+		}
+	}
+	return len;
+}
+
+static void zlog_time_cache_patch(zlog_time_cache_t * a_cache, char *str,
+		size_t *offsets, long nsec)
+{
+	int i;
+	zlog_time_cache_part_t *a_part;
+
+	for (i = 0; i < a_cache->part_count; i++) {
+		a_part = a_cache->parts + i;
+		if (offsets[i] == (size_t)-1) continue;
+		switch (a_part->width) {
+		case 3:
+			zlog_buf_dec_fixed(str + offsets[i], nsec / 1000000, 3);
+			break;
+		case 6:
+			zlog_buf_dec_fixed(str + offsets[i], nsec / 1000, 6);
+			break;
+		default:
+			zlog_buf_dec_fixed(str + offsets[i], nsec, 9);
+			break;
+		}
+	}
+	return;
+}
+
+/* the 1st thread seeing a new second formats it for all others,
+ * if another thread is on it, or the msg is older than the cache,
+ * format it alone
+ */
+static int zlog_spec_write_time(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	zlog_time_cache_t *a_cache = a_spec->time_cache;
+	zlog_event_t *a_event = a_thread->event;
+	time_t now_sec = a_event->time_stamp.tv_sec;
+	size_t seq;
+	time_t sec;
+	size_t len;
+	size_t start;
+	size_t offsets[ZLOG_TIME_CACHE_PARTS];
+	char str[MAXLEN_CFG_LINE + 1];
+	struct tm tm;
+	struct tm *time;
+	time_t *time_sec;
+	int rc;
+
+	/* the event meet the 1st time_spec in his life cycle */
+	if (!now_sec) {
+		zlog_clock_now(&(a_event->time_stamp));
+		now_sec = a_event->time_stamp.tv_sec;
+	}
+
+	while (1) {
+		seq = zc_atomic_load(&a_cache->seq);
+		if (seq & 1) break;
+
+		sec = zc_atomic_load(&a_cache->sec);
+		if (sec != now_sec) {
+			if (now_sec < sec) break;
+			if (!zc_atomic_cas(&a_cache->seq, &seq, seq + 1)) break;
+
+			if (a_cache->use_utc) gmtime_r(&now_sec, &tm);
+			else localtime_r(&now_sec, &tm);
+			a_cache->len = zlog_time_cache_build(a_cache, &tm,
+				a_cache->str, sizeof(a_cache->str), a_cache->offsets);
+			zc_atomic_store(&a_cache->sec, now_sec);
+			zc_atomic_store(&a_cache->seq, seq + 2);
+			continue;
+		}
+
+		start = zlog_buf_len(a_buf);
+		len = a_cache->len;
+		memcpy(offsets, a_cache->offsets, sizeof(offsets));
+		rc = zlog_buf_append(a_buf, a_cache->str, len);
+		zc_atomic_fence();
+		if (zc_atomic_load(&a_cache->seq) != seq) {
+			/* refreshed under us, read it again */
+			a_buf->tail = a_buf->start + start;
+			continue;
+		}
+		if (rc) return rc;
+
+		zlog_time_cache_patch(a_cache, a_buf->start + start, offsets,
+			a_event->time_stamp.tv_nsec);
+		return 0;
+	}
+
+	if (a_cache->use_utc) {
+		time = &(a_event->time_utc);
+		time_sec = &(a_event->time_utc_sec);
+		if (*time_sec != now_sec) gmtime_r(&now_sec, time);
+	} else {
+		time = &(a_event->time_local);
+		time_sec = &(a_event->time_local_sec);
+		if (*time_sec != now_sec) localtime_r(&now_sec, time);
+	}
+	*time_sec = now_sec;
+
+	len = zlog_time_cache_build(a_cache, time, str, sizeof(str), offsets);
+	zlog_time_cache_patch(a_cache, str, offsets, a_event->time_stamp.tv_nsec);
+	return zlog_buf_append(a_buf, str, len);
 }
 
 #if 0
 static int zlog_spec_write_time_D(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
 	if (!a_thread->event->time_stamp.tv_sec) {
-		gettimeofday(&(a_thread->event->time_stamp), NULL);
+		zlog_clock_now(&(a_thread->event->time_stamp));
 	}
 
 	/*
@@ -133,31 +301,49 @@ static int zlog_spec_write_time_D(zlog_spec_t * a_spec, zlog_thread_t * a_thread
 
 static int zlog_spec_write_ms(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
+	char str[3];
+
 	if (!a_thread->event->time_stamp.tv_sec) {
-		gettimeofday(&(a_thread->event->time_stamp), NULL);
+		zlog_clock_now(&(a_thread->event->time_stamp));
 	}
-	return zlog_buf_printf_dec32(a_buf, (a_thread->event->time_stamp.tv_usec / 1000), 3);
+	zlog_buf_dec_fixed(str, a_thread->event->time_stamp.tv_nsec / 1000000, 3);
+	return zlog_buf_append(a_buf, str, 3);
 }
 
 static int zlog_spec_write_us(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
+	char str[6];
+
+	if (!a_thread->event->time_stamp.tv_sec) {
+		zlog_clock_now(&(a_thread->event->time_stamp));
+	}
+	zlog_buf_dec_fixed(str, a_thread->event->time_stamp.tv_nsec / 1000, 6);
+	return zlog_buf_append(a_buf, str, 6);
+}
+
+static int zlog_spec_write_ns(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	char str[9];
+
 	if (!a_thread->event->time_stamp.tv_sec) {
-		gettimeofday(&(a_thread->event->time_stamp), NULL);
+		zlog_clock_now(&(a_thread->event->time_stamp));
 	}
-	return zlog_buf_printf_dec32(a_buf, a_thread->event->time_stamp.tv_usec, 6);
+	zlog_buf_dec_fixed(str, a_thread->event->time_stamp.tv_nsec, 9);
+	return zlog_buf_append(a_buf, str, 9);
 }
 
 static int zlog_spec_write_mdc(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
-	zlog_mdc_kv_t *a_mdc_kv;
+	char *value;
+	size_t len;
 
-	a_mdc_kv = zlog_mdc_get_kv(a_thread->mdc, a_spec->mdc_key);
-	if (!a_mdc_kv) {
-		zc_error("zlog_mdc_get_kv key[%s] fail", a_spec->mdc_key);
+	value = zlog_mdc_get_at(a_thread->mdc, a_spec->mdc_index, &len);
+	if (!value) {
+		zc_error("mdc key[%s] not put", a_spec->mdc_key);
 		return 0;
 	}
 
-	return zlog_buf_append(a_buf, a_mdc_kv->value, a_mdc_kv->value_len);
+	return zlog_buf_append(a_buf, value, len);
 }
 
 static int zlog_spec_write_str(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
@@ -233,19 +419,8 @@ static int zlog_spec_write_percent(zlog_spec_t * a_spec, zlog_thread_t * a_threa
 
 static int zlog_spec_write_pid(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
-	/* 1st in event lifecycle */
-	if (!a_thread->event->pid) {
-		a_thread->event->pid = getpid();
-
-		/* compare with previous event */
-		if (a_thread->event->pid != a_thread->event->last_pid) {
-			a_thread->event->last_pid = a_thread->event->pid;
-			a_thread->event->pid_str_len
-				= sprintf(a_thread->event->pid_str, "%u", a_thread->event->pid);
-		}
-	}
-
-	return zlog_buf_append(a_buf, a_thread->event->pid_str, a_thread->event->pid_str_len);
+	/* kept by zlog_event_pid_refresh, also in a child after fork */
+	return zlog_buf_append(a_buf, zlog_event_pid_str, zlog_event_pid_str_len);
 }
 
 static int zlog_spec_write_tid_hex(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
@@ -300,8 +475,6 @@ static int zlog_spec_write_usrmsg(zlog_spec_t * a_spec, zlog_thread_t * a_thread
 		}
 	} else if (a_thread->event->generate_cmd == ZLOG_HEX) {
 		int rc;
-		long line_offset;
-		long byte_offset;
 
 		/* thread buf start == null or len <= 0 */
 		if (a_thread->event->hex_buf == NULL) {
@@ -309,65 +482,8 @@ static int zlog_spec_write_usrmsg(zlog_spec_t * a_spec, zlog_thread_t * a_thread
 			goto zlog_hex_exit;
 		}
 
-		rc = zlog_buf_append(a_buf, ZLOG_HEX_HEAD, sizeof(ZLOG_HEX_HEAD)-1);
-		if (rc) {
-			goto zlog_hex_exit;
-		}
-
-		line_offset = 0;
-		//byte_offset = 0;
-
-		while (1) {
-			unsigned char c;
-
-			rc = zlog_buf_append(a_buf, "\n", 1);
-			if (rc)  goto zlog_hex_exit;
-
-			rc = zlog_buf_printf_dec64(a_buf, line_offset + 1, 10);
-			if (rc)  goto zlog_hex_exit;
-			rc = zlog_buf_append(a_buf, "   ", 3);
-			if (rc)  goto zlog_hex_exit;
-
-			for (byte_offset = 0; byte_offset < 16; byte_offset++) {
-				if (line_offset * 16 + byte_offset < a_thread->event->hex_buf_len) {
-					c = *((unsigned char *)a_thread->event->hex_buf
-						+ line_offset * 16 + byte_offset);
-					rc = zlog_buf_printf_hex(a_buf, c, 2);
-					if (rc) goto zlog_hex_exit;
-					rc = zlog_buf_append(a_buf, " ", 1);
-					if (rc) goto zlog_hex_exit;
-				} else {
-					rc = zlog_buf_append(a_buf, "   ", 3);
-					if (rc)  goto zlog_hex_exit;
-				}
-			}
-
-			rc = zlog_buf_append(a_buf, "  ", 2);
-			if (rc) goto zlog_hex_exit;
-
-			for (byte_offset = 0; byte_offset < 16; byte_offset++) {
-				if (line_offset * 16 + byte_offset < a_thread->event->hex_buf_len) {
-					c = *((unsigned char *)a_thread->event->hex_buf
-						+ line_offset * 16 + byte_offset);
-					if (c >= 32 && c <= 126) {
-						rc = zlog_buf_append(a_buf,(char*)&c, 1);
-						if (rc)  goto zlog_hex_exit;
-					} else {
-						rc = zlog_buf_append(a_buf, ".", 1);
-						if (rc)  goto zlog_hex_exit;
-					}
-				} else {
-					rc = zlog_buf_append(a_buf, " ", 1);
-					if (rc)  goto zlog_hex_exit;
-				}
-			}
-
-			if (line_offset * 16 + byte_offset >= a_thread->event->hex_buf_len) {
-				break;
-			}
-
-			line_offset++;
-		}
+		rc = zlog_hex_write(a_buf, a_thread->event->hex_buf, a_thread->event->hex_buf_len,
+			zlog_env_conf->hex_width, zlog_env_conf->hex_group);
 
 	      zlog_hex_exit:
 		if (rc < 0) {
@@ -496,6 +612,7 @@ static int zlog_spec_parse_print_fmt(zlog_spec_t * a_spec)
 void zlog_spec_del(zlog_spec_t * a_spec)
 {
 	zc_assert(a_spec,);
+	if (a_spec->time_cache) zlog_time_cache_put(a_spec->time_cache);
 	zc_debug("zlog_spec_del[%p]", a_spec);
     free(a_spec);
 }
@@ -504,7 +621,7 @@ void zlog_spec_del(zlog_spec_t * a_spec)
  * a const string: /home/bb
  * a string begin with %: %12.35d(%F %X,%l)
  */
-zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_cache_count)
+zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next)
 {
 	char *p;
 	int nscan = 0;
@@ -571,13 +688,12 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 				}
 			}
 
-			a_spec->time_cache_index = *time_cache_count;
-			(*time_cache_count)++;
-			if (use_utc) {
-				a_spec->write_buf = zlog_spec_write_time_UTC;
-			} else {
-				a_spec->write_buf = zlog_spec_write_time_local;
+			a_spec->time_cache = zlog_time_cache_get(a_spec->time_fmt, use_utc);
+			if (!a_spec->time_cache) {
+				zc_error("zlog_time_cache_get fail");
+				goto err;
 			}
+			a_spec->write_buf = zlog_spec_write_time;
 
 			*pattern_next = p;
 			a_spec->len = p - a_spec->str;
@@ -599,6 +715,13 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 				goto err;
 			}
 
+			/* looked up by index when writing */
+			a_spec->mdc_index = zlog_mdc_key_index(a_spec->mdc_key);
+			if (a_spec->mdc_index < 0) {
+				zc_error("zlog_mdc_key_index[%s] fail", a_spec->mdc_key);
+				goto err;
+			}
+
 			*pattern_next = p;
 			a_spec->len = p - a_spec->str;
 			a_spec->write_buf = zlog_spec_write_mdc;
@@ -617,6 +740,12 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 			a_spec->len = p - a_spec->str;
 			a_spec->write_buf = zlog_spec_write_us;
 			break;
+		} else if (STRNCMP(p, ==, "ns", 2)) {
+			p += 2;
+			*pattern_next = p;
+			a_spec->len = p - a_spec->str;
+			a_spec->write_buf = zlog_spec_write_ns;
+			break;
 		}
 
 		*pattern_next = p + 1;
@@ -624,15 +753,20 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 
 		switch (*p) {
 		case 'c':
+			a_spec->type = ZLOG_SPEC_CATEGORY;
 			a_spec->write_buf = zlog_spec_write_category;
 			break;
 		case 'D':
 			strcpy(a_spec->time_fmt, ZLOG_DEFAULT_TIME_FMT);
-			a_spec->time_cache_index = *time_cache_count;
-			(*time_cache_count)++;
-			a_spec->write_buf = zlog_spec_write_time_local;
+			a_spec->time_cache = zlog_time_cache_get(a_spec->time_fmt, 0);
+			if (!a_spec->time_cache) {
+				zc_error("zlog_time_cache_get fail");
+				goto err;
+			}
+			a_spec->write_buf = zlog_spec_write_time;
 			break;
 		case 'F':
+			a_spec->type = ZLOG_SPEC_SRCFILE;
 			a_spec->write_buf = zlog_spec_write_srcfile;
 			break;
 		case 'f':
@@ -640,47 +774,63 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 			break;
 		case 'G':
 			strcpy(a_spec->time_fmt, ZLOG_DEFAULT_TIME_FMT);
-			a_spec->time_cache_index = *time_cache_count;
-			(*time_cache_count)++;
-			a_spec->write_buf = zlog_spec_write_time_UTC;
+			a_spec->time_cache = zlog_time_cache_get(a_spec->time_fmt, 1);
+			if (!a_spec->time_cache) {
+				zc_error("zlog_time_cache_get fail");
+				goto err;
+			}
+			a_spec->write_buf = zlog_spec_write_time;
 			break;
 		case 'H':
+			a_spec->type = ZLOG_SPEC_HOSTNAME;
 			a_spec->write_buf = zlog_spec_write_hostname;
 			break;
 		case 'k':
+			a_spec->type = ZLOG_SPEC_KTID;
 			a_spec->write_buf = zlog_spec_write_ktid;
 			break;
 		case 'L':
+			a_spec->type = ZLOG_SPEC_SRCLINE;
 			a_spec->write_buf = zlog_spec_write_srcline;
 			break;
 		case 'm':
+			a_spec->type = ZLOG_SPEC_USRMSG;
 			a_spec->write_buf = zlog_spec_write_usrmsg;
 			break;
 		case 'n':
+			a_spec->type = ZLOG_SPEC_NEWLINE;
 			a_spec->write_buf = zlog_spec_write_newline;
 			break;
 		case 'r':
+			a_spec->type = ZLOG_SPEC_CR;
 			a_spec->write_buf = zlog_spec_write_cr;
 			break;
 		case 'p':
+			a_spec->type = ZLOG_SPEC_PID;
 			a_spec->write_buf = zlog_spec_write_pid;
 			break;
 		case 'U':
+			a_spec->type = ZLOG_SPEC_SRCFUNC;
 			a_spec->write_buf = zlog_spec_write_srcfunc;
 			break;
 		case 'v':
+			a_spec->type = ZLOG_SPEC_LEVEL_LOWERCASE;
 			a_spec->write_buf = zlog_spec_write_level_lowercase;
 			break;
 		case 'V':
+			a_spec->type = ZLOG_SPEC_LEVEL_UPPERCASE;
 			a_spec->write_buf = zlog_spec_write_level_uppercase;
 			break;
 		case 't':
+			a_spec->type = ZLOG_SPEC_TID_HEX;
 			a_spec->write_buf = zlog_spec_write_tid_hex;
 			break;
 		case 'T':
+			a_spec->type = ZLOG_SPEC_TID_LONG;
 			a_spec->write_buf = zlog_spec_write_tid_long;
 			break;
 		case '%':
+			a_spec->type = ZLOG_SPEC_PERCENT;
 			a_spec->write_buf = zlog_spec_write_percent;
 			break;
 		default:
@@ -697,6 +847,7 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 			a_spec->len = strlen(p);
 			*pattern_next = p + a_spec->len;
 		}
+		a_spec->type = ZLOG_SPEC_STR;
 		a_spec->write_buf = zlog_spec_write_str;
 		a_spec->gen_msg = zlog_spec_gen_msg_direct;
 		a_spec->gen_path = zlog_spec_gen_path_direct;
@@ -22,6 +22,54 @@
 
 typedef struct zlog_spec_s zlog_spec_t;
 
+/* what a spec writes, format compiles the plain ones into its own ops,
+ * others still go through write_buf */
+#define ZLOG_SPEC_OTHER 0
+#define ZLOG_SPEC_STR 1
+#define ZLOG_SPEC_CATEGORY 2
+#define ZLOG_SPEC_SRCFILE 3
+#define ZLOG_SPEC_SRCLINE 4
+#define ZLOG_SPEC_SRCFUNC 5
+#define ZLOG_SPEC_HOSTNAME 6
+#define ZLOG_SPEC_LEVEL_LOWERCASE 7
+#define ZLOG_SPEC_LEVEL_UPPERCASE 8
+#define ZLOG_SPEC_TID_HEX 9
+#define ZLOG_SPEC_TID_LONG 10
+#define ZLOG_SPEC_KTID 11
+#define ZLOG_SPEC_USRMSG 12
+#define ZLOG_SPEC_NEWLINE 13
+#define ZLOG_SPEC_CR 14
+#define ZLOG_SPEC_PERCENT 15
+#define ZLOG_SPEC_PID 16
+
+/* strftime parts of a time_fmt, %ms, %us and %ns are cut out of it */
+#define ZLOG_TIME_CACHE_PARTS 8
+
+typedef struct {
+	char *fmt;
+	int width; /* of the %ms(3), %us(6) or %ns(9) after fmt, 0 for none */
+} zlog_time_cache_part_t;
+
+/* one formatted second of a time_fmt, shared by all threads,
+ * digits of %ms, %us and %ns are zeros at offsets, patched by each reader
+ */
+typedef struct zlog_time_cache_s {
+	char time_fmt[MAXLEN_CFG_LINE + 1];
+	int use_utc;
+	int refs;
+	struct zlog_time_cache_s *next;
+
+	char fmt_parts[MAXLEN_CFG_LINE + 1];
+	zlog_time_cache_part_t parts[ZLOG_TIME_CACHE_PARTS];
+	int part_count;
+
+	size_t seq; /* odd while one thread rewrites what is below */
+	time_t sec;
+	char str[MAXLEN_CFG_LINE + 1];
+	size_t len;
+	size_t offsets[ZLOG_TIME_CACHE_PARTS];
+} zlog_time_cache_t;
+
 /* write buf, according to each spec's Conversion Characters */
 typedef int (*zlog_spec_write_fn) (zlog_spec_t * a_spec,
 			 	zlog_thread_t * a_thread,
@@ -34,10 +82,12 @@ typedef int (*zlog_spec_gen_fn) (zlog_spec_t * a_spec,
 struct zlog_spec_s {
 	char *str;
 	int len;
+	int type;
 
 	char time_fmt[MAXLEN_CFG_LINE + 1];
-	int time_cache_index;
+	zlog_time_cache_t *time_cache;
 	char mdc_key[MAXLEN_PATH + 1];
+	int mdc_index; /* slot of mdc_key in every thread's mdc */
 
 	char print_fmt[MAXLEN_CFG_LINE + 1];
 	int left_adjust;
@@ -51,7 +101,7 @@ struct zlog_spec_s {
 	zlog_spec_gen_fn gen_archive_path;
 };
 
-zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_end, int * time_cache_count);
+zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_end);
 void zlog_spec_del(zlog_spec_t * a_spec);
 void zlog_spec_profile(zlog_spec_t * a_spec, int flag);
 
@@ -0,0 +1,500 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "stats.h"
+#include "zc_defs.h"
+
+int zlog_stats_enabled = 0;
+
+/* guards slots, counter arrays of threads growing, and counts of gone ones */
+static pthread_mutex_t zlog_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static zlog_stats_counter_t zlog_stats_retired;
+static unsigned long zlog_stats_serial;
+
+typedef struct {
+	int next;      /* never used slots start here */
+	int *free;
+	int nfree;
+	int free_size;
+} zlog_stats_slots_t;
+
+static zlog_stats_slots_t zlog_stats_slots[2];
+
+/*******************************************************************************/
+int zlog_stats_id_new(zlog_stats_id_t * a_id, int kind)
+{
+	zlog_stats_slots_t *a_slots = &zlog_stats_slots[kind];
+
+	pthread_mutex_lock(&zlog_stats_lock);
+	if (a_slots->nfree) {
+		a_id->slot = a_slots->free[--a_slots->nfree];
+	} else {
+		a_id->slot = a_slots->next++;
+	}
+	a_id->serial = ++zlog_stats_serial;
+	pthread_mutex_unlock(&zlog_stats_lock);
+	return 0;
+}
+
+void zlog_stats_id_del(zlog_stats_id_t * a_id, int kind)
+{
+	int *a_free;
+	zlog_stats_slots_t *a_slots = &zlog_stats_slots[kind];
+
+	if (!a_id->serial) return;
+
+	pthread_mutex_lock(&zlog_stats_lock);
+	if (a_slots->nfree == a_slots->free_size) {
+		a_free = realloc(a_slots->free, sizeof(int) * (a_slots->free_size + 64));
+		if (!a_free) {
+			/* the slot is just never reused */
+			zc_error("realloc fail, errno[%d]", errno);
+			goto exit;
+		}
+		a_slots->free = a_free;
+		a_slots->free_size += 64;
+	}
+	a_slots->free[a_slots->nfree++] = a_id->slot;
+exit:
+	pthread_mutex_unlock(&zlog_stats_lock);
+	a_id->serial = 0;
+	return;
+}
+
+/*******************************************************************************/
+/* the old array may be read by a summer, so the caller holds the lock */
+static void *zlog_stats_expand(void *array, int *n, int slot, int kind, size_t size)
+{
+	int new_n;
+	char *new_array;
+
+	new_n = zlog_stats_slots[kind].next;
+	if (new_n < *n * 2) new_n = *n * 2;
+	if (new_n <= slot) new_n = slot + 1;
+
+	new_array = calloc(new_n, size);
+	if (!new_array) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	if (array) {
+		memcpy(new_array, array, *n * size);
+		free(array);
+	}
+	*n = new_n;
+	return new_array;
+}
+
+zlog_stats_category_counter_t *zlog_stats_category(zlog_stats_counter_t * a_counter,
+			zlog_stats_id_t * a_id)
+{
+	zlog_stats_category_counter_t *categories;
+	zlog_stats_category_counter_t *a_category;
+
+	if (a_id->slot >= a_counter->ncategories) {
+		pthread_mutex_lock(&zlog_stats_lock);
+		categories = zlog_stats_expand(a_counter->categories, &a_counter->ncategories,
+				a_id->slot, ZLOG_STATS_CATEGORY, sizeof(*categories));
+		if (categories) a_counter->categories = categories;
+		pthread_mutex_unlock(&zlog_stats_lock);
+		if (!categories) return NULL;
+	}
+
+	a_category = &a_counter->categories[a_id->slot];
+	if (a_category->serial != a_id->serial) {
+		/* left by a category gone */
+		__atomic_store_n(&a_category->msgs, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_category->filtered, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_category->output_ns, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_category->serial, a_id->serial, __ATOMIC_RELEASE);
+	}
+	return a_category;
+}
+
+zlog_stats_rule_counter_t *zlog_stats_rule(zlog_stats_counter_t * a_counter,
+			zlog_stats_id_t * a_id)
+{
+	int i;
+	zlog_stats_rule_counter_t *rules;
+	zlog_stats_rule_counter_t *a_rule;
+
+	if (a_id->slot >= a_counter->nrules) {
+		pthread_mutex_lock(&zlog_stats_lock);
+		rules = zlog_stats_expand(a_counter->rules, &a_counter->nrules,
+				a_id->slot, ZLOG_STATS_RULE, sizeof(*rules));
+		if (rules) a_counter->rules = rules;
+		pthread_mutex_unlock(&zlog_stats_lock);
+		if (!rules) return NULL;
+	}
+
+	a_rule = &a_counter->rules[a_id->slot];
+	if (a_rule->serial != a_id->serial) {
+		/* left by a rule gone */
+		__atomic_store_n(&a_rule->writes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_rule->bytes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_rule->errors, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a_rule->rotate_requests, 0, __ATOMIC_RELAXED);
+		for (i = 0; i < ZLOG_STATS_LATENCY_BUCKETS; i++) {
+			__atomic_store_n(&a_rule->latency[i], 0, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&a_rule->serial, a_id->serial, __ATOMIC_RELEASE);
+	}
+	return a_rule;
+}
+
+void zlog_stats_latency(zlog_stats_rule_counter_t * a_rule_counter, unsigned long long ns)
+{
+	int i = 0;
+
+	if (ns > 1) i = 63 - __builtin_clzll(ns);
+	if (i >= ZLOG_STATS_LATENCY_BUCKETS) i = ZLOG_STATS_LATENCY_BUCKETS - 1;
+	zlog_stats_add(&a_rule_counter->latency[i], 1);
+	return;
+}
+
+unsigned long long zlog_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*******************************************************************************/
+/* caller holds the lock, a_sum belongs to the caller */
+static int zlog_stats_fold(zlog_stats_counter_t * a_sum, zlog_stats_counter_t * a_counter)
+{
+	int i;
+	int j;
+	unsigned long serial;
+	void *array;
+	zlog_stats_category_counter_t *a_category;
+	zlog_stats_category_counter_t *a_sum_category;
+	zlog_stats_rule_counter_t *a_rule;
+	zlog_stats_rule_counter_t *a_sum_rule;
+
+	for (i = 0; i < ZLOG_STATS_LEVELS; i++) {
+		a_sum->emitted[i] += zlog_stats_get(&a_counter->emitted[i]);
+		a_sum->filtered[i] += zlog_stats_get(&a_counter->filtered[i]);
+	}
+	a_sum->truncations += zlog_stats_get(&a_counter->truncations);
+	a_sum->write_errors += zlog_stats_get(&a_counter->write_errors);
+	a_sum->rotate_requests += zlog_stats_get(&a_counter->rotate_requests);
+	a_sum->output_ns += zlog_stats_get(&a_counter->output_ns);
+
+	if (a_counter->ncategories > a_sum->ncategories) {
+		array = zlog_stats_expand(a_sum->categories, &a_sum->ncategories,
+			a_counter->ncategories - 1, ZLOG_STATS_CATEGORY, sizeof(*a_category));
+		if (!array) return -1;
+		a_sum->categories = array;
+	}
+	for (i = 0; i < a_counter->ncategories; i++) {
+		a_category = &a_counter->categories[i];
+		serial = __atomic_load_n(&a_category->serial, __ATOMIC_ACQUIRE);
+		if (!serial) continue;
+		a_sum_category = &a_sum->categories[i];
+		/* serials only grow, a lower one is left by a category gone */
+		if (serial < a_sum_category->serial) continue;
+		if (serial > a_sum_category->serial) {
+			memset(a_sum_category, 0x00, sizeof(*a_sum_category));
+			a_sum_category->serial = serial;
+		}
+		a_sum_category->msgs += zlog_stats_get(&a_category->msgs);
+		a_sum_category->filtered += zlog_stats_get(&a_category->filtered);
+		a_sum_category->output_ns += zlog_stats_get(&a_category->output_ns);
+	}
+
+	if (a_counter->nrules > a_sum->nrules) {
+		array = zlog_stats_expand(a_sum->rules, &a_sum->nrules,
+			a_counter->nrules - 1, ZLOG_STATS_RULE, sizeof(*a_rule));
+		if (!array) return -1;
+		a_sum->rules = array;
+	}
+	for (i = 0; i < a_counter->nrules; i++) {
+		a_rule = &a_counter->rules[i];
+		serial = __atomic_load_n(&a_rule->serial, __ATOMIC_ACQUIRE);
+		if (!serial) continue;
+		a_sum_rule = &a_sum->rules[i];
+		/* serials only grow, a lower one is left by a rule gone */
+		if (serial < a_sum_rule->serial) continue;
+		if (serial > a_sum_rule->serial) {
+			memset(a_sum_rule, 0x00, sizeof(*a_sum_rule));
+			a_sum_rule->serial = serial;
+		}
+		a_sum_rule->writes += zlog_stats_get(&a_rule->writes);
+		a_sum_rule->bytes += zlog_stats_get(&a_rule->bytes);
+		a_sum_rule->errors += zlog_stats_get(&a_rule->errors);
+		a_sum_rule->rotate_requests += zlog_stats_get(&a_rule->rotate_requests);
+		for (j = 0; j < ZLOG_STATS_LATENCY_BUCKETS; j++) {
+			a_sum_rule->latency[j] += zlog_stats_get(&a_rule->latency[j]);
+		}
+	}
+	return 0;
+}
+
+void zlog_stats_counter_fini(zlog_stats_counter_t * a_counter)
+{
+	pthread_mutex_lock(&zlog_stats_lock);
+	if (zlog_stats_fold(&zlog_stats_retired, a_counter)) {
+		zc_error("zlog_stats_fold fail, counts of a thread lost");
+	}
+	pthread_mutex_unlock(&zlog_stats_lock);
+
+	if (a_counter->categories) free(a_counter->categories);
+	if (a_counter->rules) free(a_counter->rules);
+	memset(a_counter, 0x00, sizeof(*a_counter));
+	return;
+}
+
+/* gone threads count too */
+void zlog_stats_sum_begin(zlog_stats_counter_t * a_sum)
+{
+	pthread_mutex_lock(&zlog_stats_lock);
+	zlog_stats_sum(a_sum, &zlog_stats_retired);
+	return;
+}
+
+void zlog_stats_sum(zlog_stats_counter_t * a_sum, zlog_stats_counter_t * a_counter)
+{
+	if (zlog_stats_fold(a_sum, a_counter)) {
+		zc_error("zlog_stats_fold fail, some counts lost");
+	}
+	return;
+}
+
+void zlog_stats_sum_end(void)
+{
+	pthread_mutex_unlock(&zlog_stats_lock);
+	return;
+}
+
+void zlog_stats_sum_fini(zlog_stats_counter_t * a_sum)
+{
+	if (a_sum->categories) free(a_sum->categories);
+	if (a_sum->rules) free(a_sum->rules);
+	memset(a_sum, 0x00, sizeof(*a_sum));
+	return;
+}
+
+void zlog_stats_sum_category(zlog_stats_counter_t * a_sum, zlog_stats_id_t * a_id,
+			zlog_stats_category_t * a_category)
+{
+	zlog_stats_category_counter_t *a_counter;
+
+	if (a_id->slot >= a_sum->ncategories) return;
+	a_counter = &a_sum->categories[a_id->slot];
+	if (a_counter->serial != a_id->serial) return;
+	a_category->msgs = a_counter->msgs;
+	a_category->filtered = a_counter->filtered;
+	a_category->output_ns = a_counter->output_ns;
+	return;
+}
+
+void zlog_stats_sum_rule(zlog_stats_counter_t * a_sum, zlog_stats_id_t * a_id,
+			zlog_stats_rule_t * a_rule)
+{
+	zlog_stats_rule_counter_t *a_counter;
+
+	if (a_id->slot >= a_sum->nrules) return;
+	a_counter = &a_sum->rules[a_id->slot];
+	if (a_counter->serial != a_id->serial) return;
+	a_rule->writes = a_counter->writes;
+	a_rule->bytes = a_counter->bytes;
+	a_rule->errors = a_counter->errors;
+	a_rule->rotate_requests = a_counter->rotate_requests;
+	memcpy(a_rule->latency, a_counter->latency, sizeof(a_rule->latency));
+	return;
+}
+
+/*******************************************************************************/
+void zlog_stats_exporter_profile(zlog_stats_exporter_t * a_exporter, int flag)
+{
+	zc_assert(a_exporter,);
+	zc_profile(flag, "---stats exporter[%p][%s][period:%ld][size:%ld]---",
+		a_exporter,
+		a_exporter->name,
+		a_exporter->period,
+		(long)a_exporter->shm_size);
+	return;
+}
+
+#ifndef _WIN32
+/* seq is odd while copying, a reader retries then */
+static int zlog_stats_exporter_write(zlog_stats_exporter_t * a_exporter, zlog_stats_t * a_stats)
+{
+	size_t size;
+	void *shm;
+
+	size = sizeof(zlog_stats_shm_t) + a_stats->size;
+	if (size > a_exporter->shm_size) {
+		if (ftruncate(a_exporter->fd, size)) {
+			zc_error("ftruncate[%s] fail, errno[%d]", a_exporter->name, errno);
+			return -1;
+		}
+		shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, a_exporter->fd, 0);
+		if (shm == MAP_FAILED) {
+			zc_error("mmap[%s] fail, errno[%d]", a_exporter->name, errno);
+			return -1;
+		}
+		if (a_exporter->shm) {
+			munmap(a_exporter->shm, a_exporter->shm_size);
+		} else {
+			((zlog_stats_shm_t *)shm)->magic = ZLOG_STATS_SHM_MAGIC;
+		}
+		a_exporter->shm = shm;
+		a_exporter->shm_size = size;
+	}
+
+	zc_atomic_store(&a_exporter->shm->seq, a_exporter->shm->seq + 1);
+	zc_atomic_fence();
+	a_exporter->shm->size = a_stats->size;
+	memcpy(a_exporter->shm + 1, a_stats, a_stats->size);
+	zc_atomic_store(&a_exporter->shm->seq, a_exporter->shm->seq + 1);
+	return 0;
+}
+
+static void *zlog_stats_exporter_work(void *arg)
+{
+	zlog_stats_exporter_t *a_exporter = arg;
+	zlog_stats_t *a_stats;
+	struct timeval now;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&a_exporter->lock);
+	while (!a_exporter->stop) {
+		pthread_mutex_unlock(&a_exporter->lock);
+		a_stats = a_exporter->snapshot();
+		if (a_stats) {
+			zlog_stats_exporter_write(a_exporter, a_stats);
+			free(a_stats);
+		}
+		pthread_mutex_lock(&a_exporter->lock);
+
+		gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + a_exporter->period / 1000;
+		deadline.tv_nsec = now.tv_usec * 1000 + (a_exporter->period % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		while (!a_exporter->stop) {
+			if (pthread_cond_timedwait(&a_exporter->cond, &a_exporter->lock,
+					&deadline) == ETIMEDOUT) break;
+		}
+	}
+	pthread_mutex_unlock(&a_exporter->lock);
+	return NULL;
+}
+#endif
+
+zlog_stats_exporter_t *zlog_stats_exporter_new(const char *name, long period,
+			zlog_stats_snapshot_fn snapshot)
+{
+#ifdef _WIN32
+	zc_error("stats shm is not supported on windows");
+	return NULL;
+#else
+	int rc;
+	zlog_stats_exporter_t *a_exporter;
+
+	zc_assert(name, NULL);
+	zc_assert(snapshot, NULL);
+
+	if (strlen(name) > sizeof(a_exporter->name) - 1) {
+		zc_error("name[%s] too long", name);
+		return NULL;
+	}
+
+	a_exporter = calloc(1, sizeof(zlog_stats_exporter_t));
+	if (!a_exporter) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	strcpy(a_exporter->name, name);
+	a_exporter->period = period > 0 ? period : 1000;
+	a_exporter->snapshot = snapshot;
+
+	a_exporter->fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if (a_exporter->fd < 0) {
+		zc_error("shm_open[%s] fail, errno[%d]", name, errno);
+		free(a_exporter);
+		return NULL;
+	}
+
+	pthread_mutex_init(&a_exporter->lock, NULL);
+	pthread_cond_init(&a_exporter->cond, NULL);
+	rc = pthread_create(&a_exporter->tid, NULL, zlog_stats_exporter_work, a_exporter);
+	if (rc) {
+		zc_error("pthread_create fail, rc[%d]", rc);
+		pthread_cond_destroy(&a_exporter->cond);
+		pthread_mutex_destroy(&a_exporter->lock);
+		close(a_exporter->fd);
+		shm_unlink(name);
+		free(a_exporter);
+		return NULL;
+	}
+
+	zlog_stats_exporter_profile(a_exporter, ZC_DEBUG);
+	return a_exporter;
+#endif
+}
+
+void zlog_stats_exporter_set(zlog_stats_exporter_t * a_exporter, long period)
+{
+	zc_assert(a_exporter,);
+
+	pthread_mutex_lock(&a_exporter->lock);
+	a_exporter->period = period > 0 ? period : 1000;
+	pthread_mutex_unlock(&a_exporter->lock);
+	return;
+}
+
+void zlog_stats_exporter_del(zlog_stats_exporter_t * a_exporter)
+{
+#ifndef _WIN32
+	zc_assert(a_exporter,);
+
+	pthread_mutex_lock(&a_exporter->lock);
+	a_exporter->stop = 1;
+	pthread_cond_signal(&a_exporter->cond);
+	pthread_mutex_unlock(&a_exporter->lock);
+	pthread_join(a_exporter->tid, NULL);
+
+	if (a_exporter->shm) munmap(a_exporter->shm, a_exporter->shm_size);
+	close(a_exporter->fd);
+	shm_unlink(a_exporter->name);
+	pthread_cond_destroy(&a_exporter->cond);
+	pthread_mutex_destroy(&a_exporter->lock);
+	zc_debug("zlog_stats_exporter_del[%p]", a_exporter);
+	free(a_exporter);
+#endif
+	return;
+}
@@ -0,0 +1,134 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file stats.h
+ * @brief counters of every thread, summed on demand
+ *
+ * A thread only writes its own counters, so nothing is shared on the
+ * hot path. Categories and rules get a slot in every thread's arrays,
+ * slots are reused, and a counter whose serial is not its owner's
+ * is old and counts from zero again.
+ */
+
+#ifndef __zlog_stats_h_inner
+#define __zlog_stats_h_inner
+
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "zlog_stats.h"
+
+/* only the owner thread writes, readers may see it any time */
+#define zlog_stats_add(p, v) \
+	__atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + (v), __ATOMIC_RELAXED)
+#define zlog_stats_get(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+
+typedef struct zlog_stats_id_s {
+	int slot;
+	unsigned long serial;
+} zlog_stats_id_t;
+
+typedef struct zlog_stats_category_counter_s {
+	unsigned long serial;
+	unsigned long long msgs;
+	unsigned long long filtered;
+	unsigned long long output_ns;
+} zlog_stats_category_counter_t;
+
+typedef struct zlog_stats_rule_counter_s {
+	unsigned long serial;
+	unsigned long long writes;
+	unsigned long long bytes;
+	unsigned long long errors;
+	unsigned long long rotate_requests;
+	unsigned long long latency[ZLOG_STATS_LATENCY_BUCKETS];
+} zlog_stats_rule_counter_t;
+
+typedef struct zlog_stats_counter_s {
+	unsigned long long emitted[ZLOG_STATS_LEVELS];
+	unsigned long long filtered[ZLOG_STATS_LEVELS];
+	unsigned long long truncations;
+	unsigned long long write_errors;
+	unsigned long long rotate_requests;
+	unsigned long long output_ns;
+
+	zlog_stats_category_counter_t *categories;
+	int ncategories;
+	zlog_stats_rule_counter_t *rules;
+	int nrules;
+} zlog_stats_counter_t;
+
+/* set by conf, nothing is counted or timed while 0 */
+extern int zlog_stats_enabled;
+
+#define ZLOG_STATS_CATEGORY 0
+#define ZLOG_STATS_RULE 1
+
+int zlog_stats_id_new(zlog_stats_id_t * a_id, int kind);
+void zlog_stats_id_del(zlog_stats_id_t * a_id, int kind);
+
+/* the counter of a_id in a_counter, NULL if no memory */
+zlog_stats_category_counter_t *zlog_stats_category(zlog_stats_counter_t * a_counter,
+			zlog_stats_id_t * a_id);
+zlog_stats_rule_counter_t *zlog_stats_rule(zlog_stats_counter_t * a_counter,
+			zlog_stats_id_t * a_id);
+void zlog_stats_latency(zlog_stats_rule_counter_t * a_rule_counter, unsigned long long ns);
+unsigned long long zlog_stats_now(void);
+
+/* counts of a gone thread are kept */
+void zlog_stats_counter_fini(zlog_stats_counter_t * a_counter);
+
+/* summing up, counts of gone threads come in at begin,
+ * and no counter array moves till end
+ */
+void zlog_stats_sum_begin(zlog_stats_counter_t * a_sum);
+void zlog_stats_sum(zlog_stats_counter_t * a_sum, zlog_stats_counter_t * a_counter);
+void zlog_stats_sum_end(void);
+void zlog_stats_sum_fini(zlog_stats_counter_t * a_sum);
+
+/* copy sums of one category or rule out, by its id */
+void zlog_stats_sum_category(zlog_stats_counter_t * a_sum, zlog_stats_id_t * a_id,
+			zlog_stats_category_t * a_category);
+void zlog_stats_sum_rule(zlog_stats_counter_t * a_sum, zlog_stats_id_t * a_id,
+			zlog_stats_rule_t * a_rule);
+
+/* keep a shm segment up to date by snapshot every period ms */
+typedef zlog_stats_t *(*zlog_stats_snapshot_fn) (void);
+
+typedef struct zlog_stats_exporter_s {
+	char name[MAXLEN_PATH + 1];
+	long period;
+	zlog_stats_snapshot_fn snapshot;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+	pthread_t tid;
+
+	int fd;
+	zlog_stats_shm_t *shm;
+	size_t shm_size;
+} zlog_stats_exporter_t;
+
+zlog_stats_exporter_t *zlog_stats_exporter_new(const char *name, long period,
+			zlog_stats_snapshot_fn snapshot);
+/* wait for the thread, which may be in snapshot, so not under zlog_env_lock */
+void zlog_stats_exporter_del(zlog_stats_exporter_t * a_exporter);
+void zlog_stats_exporter_profile(zlog_stats_exporter_t * a_exporter, int flag);
+/* from the next export on */
+void zlog_stats_exporter_set(zlog_stats_exporter_t * a_exporter, long period);
+
+#endif
@@ -21,6 +21,7 @@
 #include "buf.h"
 #include "thread.h"
 #include "mdc.h"
+#include "async.h"
 
 void zlog_thread_profile(zlog_thread_t * a_thread, int flag)
 {
@@ -62,13 +63,16 @@ void zlog_thread_del(zlog_thread_t * a_thread)
 		zlog_buf_del(a_thread->pre_msg_buf);
 	if (a_thread->msg_buf)
 		zlog_buf_del(a_thread->msg_buf);
+	if (a_thread->async_ring)
+		zlog_async_ring_del(a_thread->async_ring);
+	zlog_stats_counter_fini(&a_thread->stats);
 
 	zc_debug("zlog_thread_del[%p]", a_thread);
     free(a_thread);
 	return;
 }
 
-zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf_size_max, int time_cache_count)
+zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf_size_max)
 {
 	zlog_thread_t *a_thread;
 
@@ -86,7 +90,7 @@ zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf
 		goto err;
 	}
 
-	a_thread->event = zlog_event_new(time_cache_count);
+	a_thread->event = zlog_event_new();
 	if (!a_thread->event) {
 		zc_error("zlog_event_new fail");
 		goto err;
@@ -121,6 +125,7 @@ zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf
 		zc_error("zlog_buf_new fail");
 		goto err;
 	}
+	a_thread->msg_buf->truncations = &a_thread->stats.truncations;
 
 
 	//zlog_thread_profile(a_thread, ZC_DEBUG);
@@ -160,6 +165,7 @@ int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, size_t buf_size_min, s
 
 	zlog_buf_del(a_thread->msg_buf);
 	a_thread->msg_buf = msg_buf_new;
+	a_thread->msg_buf->truncations = &a_thread->stats.truncations;
 
 	return 0;
 err:
@@ -168,24 +174,5 @@ err:
 	return -1;
 }
 
-int zlog_thread_rebuild_event(zlog_thread_t * a_thread, int time_cache_count)
-{
-	zlog_event_t *event_new = NULL;
-	zc_assert(a_thread, -1);
-
-	event_new = zlog_event_new(time_cache_count);
-	if (!event_new) {
-		zc_error("zlog_event_new fail");
-		goto err;
-	}
-
-	zlog_event_del(a_thread->event);
-	a_thread->event = event_new;
-	return 0;
-err:
-	if (event_new) zlog_event_del(event_new);
-	return -1;
-}
-
 
 /*******************************************************************************/
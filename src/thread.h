@@ -20,8 +20,11 @@
 #include "event.h"
 #include "buf.h"
 #include "mdc.h"
+#include "stats.h"
 
-typedef struct {
+typedef struct zlog_async_ring_s zlog_async_ring_t;
+
+typedef struct zlog_thread_s {
 	int init_version;
 	zlog_mdc_t *mdc;
 	zlog_event_t *event;
@@ -31,15 +34,25 @@ typedef struct {
 	zlog_buf_t *archive_path_buf;
 	zlog_buf_t *pre_msg_buf;
 	zlog_buf_t *msg_buf;
+
+	zlog_async_ring_t *async_ring;
+
+	/* odd while the thread reads the env, only moved by itself */
+	size_t epoch;
+	int depth; /* of nested reads, only the outermost moves epoch */
+	struct zlog_thread_s *prev;
+	struct zlog_thread_s *next;
+
+	/* only counted by the thread itself */
+	zlog_stats_counter_t stats;
 } zlog_thread_t;
 
 
 void zlog_thread_del(zlog_thread_t * a_thread);
 void zlog_thread_profile(zlog_thread_t * a_thread, int flag);
 zlog_thread_t *zlog_thread_new(int init_version,
-			size_t buf_size_min, size_t buf_size_max, int time_cache_count);
+			size_t buf_size_min, size_t buf_size_max);
 
 int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, size_t buf_size_min, size_t buf_size_max);
-int zlog_thread_rebuild_event(zlog_thread_t * a_thread, int time_cache_count);
 
 #endif
@@ -0,0 +1,62 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file trace.h
+ * @brief USDT probes of provider zlog, for perf and bpftrace
+ *
+ * Built in only with ZLOG_USDT defined (make USDT=1, cmake -DUSDT=ON),
+ * which needs <sys/sdt.h> of systemtap. A probe is then a nop in the
+ * code and a note in the ELF, nothing happens until a tracer attaches.
+ * Without ZLOG_USDT the macros are empty and their arguments are not
+ * even evaluated. tools/zlog-stages.sh makes histograms of them.
+ *
+ * log_entry(category, level)		msg passed the level check
+ * log_pinned()				env pinned, thread fetched
+ * log_return(category, level)
+ * rule_entry(category, file_path)	one fit rule
+ * rule_return(rc)
+ * format_entry(format)			zlog_format_gen_msg
+ * format_return(rc)
+ * write_entry(file_path, len)		rule's write(), maybe in async thread
+ * write_return(rc)
+ * file_open(path, fd)			fd open to a log file
+ * file_reopen(path, fd)		static file moved away and opened again
+ * rotate_entry(path, len)		in the rotater's thread
+ * rotate_return(path, rc)
+ * reload_entry(conf)
+ * reload_return(rc)
+ */
+
+#ifndef __zlog_trace_h
+#define __zlog_trace_h
+
+#ifdef ZLOG_USDT
+
+#include <sys/sdt.h>
+
+#define ZLOG_TRACE0(name) DTRACE_PROBE(zlog, name)
+#define ZLOG_TRACE1(name, a) DTRACE_PROBE1(zlog, name, a)
+#define ZLOG_TRACE2(name, a, b) DTRACE_PROBE2(zlog, name, a, b)
+
+#else
+
+#define ZLOG_TRACE0(name) do {} while (0)
+#define ZLOG_TRACE1(name, a) do {} while (0)
+#define ZLOG_TRACE2(name, a, b) do {} while (0)
+
+#endif
+
+#endif
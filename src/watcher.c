@@ -0,0 +1,297 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "watcher.h"
+#include "rule.h"
+#include "zc_defs.h"
+
+typedef struct {
+	zlog_rule_t *rule;
+	int wd;                        /* watch of the directory */
+	char name[MAXLEN_PATH + 1];    /* file name inside the directory */
+} zlog_watcher_item_t;
+
+void zlog_watcher_profile(zlog_watcher_t * a_watcher, int flag)
+{
+	int i;
+	zlog_watcher_item_t *a_item;
+
+	zc_assert(a_watcher,);
+	zc_profile(flag, "---watcher[%p][mode:%d][period:%ld][inotify:%d][started:%d]---",
+		a_watcher,
+		a_watcher->mode,
+		a_watcher->period,
+		a_watcher->inotify_fd,
+		a_watcher->started);
+	zc_arraylist_foreach(a_watcher->items, i, a_item) {
+		zc_profile(flag, "----watch[%s][%d]----", a_item->rule->file_path, a_item->wd);
+	}
+	return;
+}
+
+/*******************************************************************************/
+/* the write path restats and reopens when it sees the flag */
+static void zlog_watcher_raise(zlog_rule_t * a_rule)
+{
+	zc_atomic_store(&a_rule->static_changed, 1);
+	return;
+}
+
+static void zlog_watcher_check_period(zlog_watcher_t * a_watcher)
+{
+	int i;
+	struct stat stb;
+	zlog_watcher_item_t *a_item;
+
+	zc_arraylist_foreach(a_watcher->items, i, a_item) {
+		if (stat(a_item->rule->file_path, &stb)
+			|| stb.st_ino != a_item->rule->static_ino
+			|| stb.st_dev != a_item->rule->static_dev) {
+			zlog_watcher_raise(a_item->rule);
+		}
+	}
+	return;
+}
+
+#ifdef __linux__
+static void zlog_watcher_check_inotify(zlog_watcher_t * a_watcher)
+{
+	int i;
+	ssize_t len;
+	char *p;
+	struct inotify_event *event;
+	zlog_watcher_item_t *a_item;
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	while ((len = read(a_watcher->inotify_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *) p;
+			zc_arraylist_foreach(a_watcher->items, i, a_item) {
+				if (event->mask & IN_Q_OVERFLOW) {
+					/* events lost, let everyone take a look */
+					zlog_watcher_raise(a_item->rule);
+				} else if (event->wd == a_item->wd && event->len
+					&& STRCMP(event->name, ==, a_item->name)) {
+					zlog_watcher_raise(a_item->rule);
+				}
+			}
+		}
+	}
+	return;
+}
+#endif
+
+static void *zlog_watcher_work(void *arg)
+{
+	int rc;
+	char c;
+	struct pollfd fds[2];
+	zlog_watcher_t *a_watcher = arg;
+
+	fds[0].fd = a_watcher->pipe_fd[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = a_watcher->inotify_fd;
+	fds[1].events = POLLIN;
+
+	while (1) {
+		rc = poll(fds, 2, a_watcher->mode == ZLOG_FILE_CHECK_PERIOD ? (int)a_watcher->period : -1);
+		if (rc < 0) {
+			if (errno == EINTR) continue;
+			zc_error("poll fail, errno[%d]", errno);
+			break;
+		}
+
+		if (fds[0].revents) {
+			if (read(a_watcher->pipe_fd[0], &c, 1) < 0) {
+				zc_error("read fail, errno[%d]", errno);
+			}
+			break;
+		}
+
+		if (rc == 0) {
+			zlog_watcher_check_period(a_watcher);
+		}
+#ifdef __linux__
+		else if (fds[1].revents) {
+			zlog_watcher_check_inotify(a_watcher);
+		}
+#endif
+	}
+
+	return NULL;
+}
+
+/*******************************************************************************/
+static int zlog_watcher_add(zlog_watcher_t * a_watcher, zlog_rule_t * a_rule)
+{
+	zlog_watcher_item_t *a_item;
+
+	a_item = calloc(1, sizeof(zlog_watcher_item_t));
+	if (!a_item) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return -1;
+	}
+	a_item->rule = a_rule;
+	a_item->wd = -1;
+
+#ifdef __linux__
+	if (a_watcher->mode == ZLOG_FILE_CHECK_INOTIFY) {
+		char dir[MAXLEN_PATH + 1];
+		char *p;
+
+		strcpy(dir, a_rule->file_path);
+		p = strrchr(dir, '/');
+		if (!p) {
+			strcpy(a_item->name, dir);
+			strcpy(dir, ".");
+		} else {
+			strcpy(a_item->name, p + 1);
+			if (p == dir) p++;
+			*p = '\0';
+		}
+
+		/* the file itself never sees IN_DELETE_SELF while we keep it open,
+		 * so watch its name in the directory */
+		a_item->wd = inotify_add_watch(a_watcher->inotify_fd, dir,
+				IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_CREATE);
+		if (a_item->wd < 0) {
+			zc_error("inotify_add_watch[%s] fail, errno[%d]", dir, errno);
+			free(a_item);
+			return -1;
+		}
+	}
+#endif
+
+	if (zc_arraylist_add(a_watcher->items, a_item)) {
+		zc_error("zc_arraylist_add fail");
+		free(a_item);
+		return -1;
+	}
+
+	a_rule->file_check = a_watcher->mode;
+	return 0;
+}
+
+zlog_watcher_t *zlog_watcher_new(int mode, long period, zc_arraylist_t * a_rules)
+{
+	int i;
+	int rc;
+	zlog_rule_t *a_rule;
+	zlog_watcher_t *a_watcher;
+
+	zc_assert(a_rules, NULL);
+
+	a_watcher = calloc(1, sizeof(zlog_watcher_t));
+	if (!a_watcher) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_watcher->inotify_fd = -1;
+	a_watcher->pipe_fd[0] = -1;
+	a_watcher->pipe_fd[1] = -1;
+
+#ifndef __linux__
+	if (mode == ZLOG_FILE_CHECK_INOTIFY) {
+		zc_warn("no inotify here, check files every [%ld] ms instead", period);
+		mode = ZLOG_FILE_CHECK_PERIOD;
+	}
+#endif
+	a_watcher->mode = mode;
+	a_watcher->period = period > 0 ? period : 1;
+
+	a_watcher->items = zc_arraylist_new(free);
+	if (!a_watcher->items) {
+		zc_error("zc_arraylist_new fail");
+		goto err;
+	}
+
+#ifdef __linux__
+	if (a_watcher->mode == ZLOG_FILE_CHECK_INOTIFY) {
+		a_watcher->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (a_watcher->inotify_fd < 0) {
+			zc_error("inotify_init1 fail, errno[%d]", errno);
+			goto err;
+		}
+	}
+#endif
+
+	/* only static single files, rotating and dynamic ones are in file_table */
+	zc_arraylist_foreach(a_rules, i, a_rule) {
+		if (a_rule->static_fd <= 0 || a_rule->dynamic_specs
+			|| a_rule->archive_max_size > 0) continue;
+		if (zlog_watcher_add(a_watcher, a_rule)) {
+			zc_error("zlog_watcher_add fail");
+			goto err;
+		}
+	}
+
+	if (zc_arraylist_len(a_watcher->items) == 0) {
+		zlog_watcher_profile(a_watcher, ZC_DEBUG);
+		return a_watcher;
+	}
+
+	if (pipe(a_watcher->pipe_fd)) {
+		zc_error("pipe fail, errno[%d]", errno);
+		goto err;
+	}
+
+	rc = pthread_create(&a_watcher->tid, NULL, zlog_watcher_work, a_watcher);
+	if (rc) {
+		zc_error("pthread_create fail, rc[%d]", rc);
+		goto err;
+	}
+	a_watcher->started = 1;
+
+	zlog_watcher_profile(a_watcher, ZC_DEBUG);
+	return a_watcher;
+err:
+	zlog_watcher_del(a_watcher);
+	return NULL;
+}
+
+void zlog_watcher_del(zlog_watcher_t * a_watcher)
+{
+	zc_assert(a_watcher,);
+
+	if (a_watcher->started) {
+		if (write(a_watcher->pipe_fd[1], "q", 1) < 0) {
+			zc_error("write fail, errno[%d]", errno);
+		}
+		pthread_join(a_watcher->tid, NULL);
+	}
+
+	if (a_watcher->items) zc_arraylist_del(a_watcher->items);
+	if (a_watcher->pipe_fd[0] >= 0) close(a_watcher->pipe_fd[0]);
+	if (a_watcher->pipe_fd[1] >= 0) close(a_watcher->pipe_fd[1]);
+	if (a_watcher->inotify_fd >= 0) close(a_watcher->inotify_fd);
+	zc_debug("zlog_watcher_del[%p]", a_watcher);
+	free(a_watcher);
+	return;
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file watcher.h
+ * @brief find out static log files moved or removed by others
+ *
+ * In strict mode every write stat()s the file, as zlog always did.
+ * In the other modes one watcher thread per conf does the checking,
+ * either stat() every period ms or inotify on the file's directory,
+ * and only raises rule->static_changed, so the write path just tests
+ * a flag and stat()s when it is up.
+ */
+
+#ifndef __zlog_watcher_h
+#define __zlog_watcher_h
+
+#include <pthread.h>
+
+#include "zc_defs.h"
+
+#define ZLOG_FILE_CHECK_STRICT 0
+#define ZLOG_FILE_CHECK_PERIOD 1
+#define ZLOG_FILE_CHECK_INOTIFY 2
+
+typedef struct zlog_watcher_s {
+	int mode;
+	long period; /* ms */
+	zc_arraylist_t *items;
+
+	int inotify_fd;
+	int pipe_fd[2]; /* tell the thread to quit */
+	pthread_t tid;
+	int started;
+} zlog_watcher_t;
+
+/* pick static single file rules of a_rules, start the thread if any */
+zlog_watcher_t *zlog_watcher_new(int mode, long period, zc_arraylist_t * a_rules);
+void zlog_watcher_del(zlog_watcher_t * a_watcher);
+void zlog_watcher_profile(zlog_watcher_t * a_watcher, int flag);
+
+#endif
@@ -67,6 +67,14 @@
 #define zlog_fsync fsync
 #endif
 
+/* Define zc_atomic_* on the gcc/clang builtins, plain C99 has none */
+#define zc_atomic_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define zc_atomic_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define zc_atomic_add(p, v) __atomic_add_fetch(p, v, __ATOMIC_RELAXED)
+#define zc_atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define zc_atomic_cas(p, oldp, v) \
+	__atomic_compare_exchange_n(p, oldp, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
 
 
 #endif
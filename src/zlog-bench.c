@@ -0,0 +1,740 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * zlog-bench: throughput and per-call latency of zlog() over a sweep of
+ * outputs, formats, threads, processes and msg sizes.
+ *
+ * Every case runs in freshly forked processes with its own conf, so no
+ * case sees what an earlier one left. Threads log warmup msgs, wait at a
+ * gate, then time each of count calls into a log-linear histogram. The
+ * clock stops after zlog_fini(), so msgs held by async or buffering are
+ * paid for. Results can go out as JSON and be compared with an older run.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+#include "version.h"
+
+#define BENCH_LIST_MAX 32
+#define BENCH_GLOBAL_MAX 16
+
+/* 32 buckets in each power of 2, so a percentile is within 1/32 */
+#define BENCH_SUB_BITS 5
+#define BENCH_SUBS (1 << BENCH_SUB_BITS)
+#define BENCH_BUCKETS (64 * BENCH_SUBS)
+
+typedef struct {
+	unsigned long long count[BENCH_BUCKETS];
+	unsigned long long n;
+	unsigned long long max;
+	unsigned long long start; /* ns, CLOCK_MONOTONIC, shared by processes */
+	unsigned long long end;
+} bench_hist_t;
+
+typedef struct {
+	char name[128];
+	double msgs_per_sec;
+	unsigned long long p99;
+} bench_base_t;
+
+static const char *bench_outputs[] = {
+	"static", "dynamic", "rotate", "pipe", "record", "null", NULL
+};
+
+static const struct {
+	const char *name;
+	const char *pattern;
+} bench_formats[] = {
+	{ "minimal", "%m%n" },
+	{ "default", "%D %V [%p:%F:%L] %m%n" },
+	{ "heavy", "%d(%F %T.%us) %-6V [%p:%t] (%c:%F:%L %U) [%M(req)] [%M(user)] %m%n" },
+	{ NULL, NULL }
+};
+
+/* the sweep */
+static const char *outputs[BENCH_LIST_MAX];
+static const char *formats[BENCH_LIST_MAX];
+static long threads[BENCH_LIST_MAX];
+static long procs[BENCH_LIST_MAX];
+static long sizes[BENCH_LIST_MAX];
+static const char *globals[BENCH_GLOBAL_MAX];
+static int nglobal;
+static long count = 100000;
+static long warmup = 1000;
+static const char *dir = "zlog-bench.d";
+
+/* what the threads of one process share */
+static zlog_category_t *bench_zc;
+static char *bench_msg;
+static int bench_mdc;
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_cond = PTHREAD_COND_INITIALIZER;
+static long bench_ready;
+static int bench_go;
+
+/*******************************************************************************/
+static unsigned long long bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_bucket(unsigned long long v)
+{
+	int e = 0;
+
+	if (v < BENCH_SUBS) return (int)v;
+	while (v >> (e + 1)) e++;
+	return (e - BENCH_SUB_BITS + 1) * BENCH_SUBS
+		+ (int)((v >> (e - BENCH_SUB_BITS)) & (BENCH_SUBS - 1));
+}
+
+/* the lowest value of a bucket */
+static unsigned long long bench_bucket_value(int i)
+{
+	int e;
+
+	if (i < BENCH_SUBS) return i;
+	e = i / BENCH_SUBS + BENCH_SUB_BITS - 1;
+	return (unsigned long long)(BENCH_SUBS + i % BENCH_SUBS) << (e - BENCH_SUB_BITS);
+}
+
+static void bench_hist_add(bench_hist_t * a_hist, unsigned long long v)
+{
+	a_hist->count[bench_bucket(v)]++;
+	a_hist->n++;
+	if (v > a_hist->max) a_hist->max = v;
+}
+
+static void bench_hist_merge(bench_hist_t * a_hist, bench_hist_t * b_hist)
+{
+	int i;
+
+	for (i = 0; i < BENCH_BUCKETS; i++) a_hist->count[i] += b_hist->count[i];
+	a_hist->n += b_hist->n;
+	if (b_hist->max > a_hist->max) a_hist->max = b_hist->max;
+	if (!a_hist->start || b_hist->start < a_hist->start) a_hist->start = b_hist->start;
+	if (b_hist->end > a_hist->end) a_hist->end = b_hist->end;
+}
+
+static unsigned long long bench_hist_percentile(bench_hist_t * a_hist, double q)
+{
+	int i;
+	unsigned long long want;
+	unsigned long long sum = 0;
+
+	want = (unsigned long long)(q * a_hist->n);
+	if (want < 1) want = 1;
+	for (i = 0; i < BENCH_BUCKETS; i++) {
+		sum += a_hist->count[i];
+		if (sum >= want) return bench_bucket_value(i);
+	}
+	return a_hist->max;
+}
+
+/* what a clock_gettime() pair around each call adds */
+static unsigned long long bench_clock_cost(void)
+{
+	int i;
+	unsigned long long t0;
+	unsigned long long t;
+	unsigned long long min = ~0ULL;
+
+	for (i = 0; i < 10000; i++) {
+		t0 = bench_now();
+		t = bench_now() - t0;
+		if (t < min) min = t;
+	}
+	return min;
+}
+
+/*******************************************************************************/
+static int bench_record(zlog_msg_t *msg)
+{
+	return 0;
+}
+
+static int bench_rule(const char *output, char *rule, size_t len)
+{
+	if (!strcmp(output, "static")) {
+		snprintf(rule, len, "\"%s/bench.log\"", dir);
+	} else if (!strcmp(output, "dynamic")) {
+		snprintf(rule, len, "\"%s/bench.%%c.%%p.log\"", dir);
+	} else if (!strcmp(output, "rotate")) {
+		snprintf(rule, len, "\"%s/bench.log\", 16MB * 4 ~ \"%s/bench.#r.log\"", dir, dir);
+	} else if (!strcmp(output, "pipe")) {
+		snprintf(rule, len, "| cat > /dev/null");
+	} else if (!strcmp(output, "record")) {
+		snprintf(rule, len, "$bench");
+	} else if (!strcmp(output, "null")) {
+		snprintf(rule, len, ">stdout");
+	} else {
+		fprintf(stderr, "unknown output[%s]\n", output);
+		return -1;
+	}
+	return 0;
+}
+
+static const char *bench_pattern(const char *format)
+{
+	int i;
+
+	for (i = 0; bench_formats[i].name; i++) {
+		if (!strcmp(format, bench_formats[i].name)) return bench_formats[i].pattern;
+	}
+	fprintf(stderr, "unknown format[%s]\n", format);
+	return NULL;
+}
+
+static int bench_write_conf(const char *path, const char *output, const char *format)
+{
+	FILE *fp;
+	int i;
+	char rule[1024];
+	const char *pattern;
+
+	if (bench_rule(output, rule, sizeof(rule))) return -1;
+	pattern = bench_pattern(format);
+	if (!pattern) return -1;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "fopen[%s] fail, errno[%d]\n", path, errno);
+		return -1;
+	}
+	fprintf(fp, "[global]\n");
+	for (i = 0; i < nglobal; i++) fprintf(fp, "%s\n", globals[i]);
+	fprintf(fp, "[formats]\nbench = \"%s\"\n[rules]\nbench.*\t%s; bench\n", pattern, rule);
+	fclose(fp);
+	return 0;
+}
+
+/* what a case left in dir */
+static void bench_clean(void)
+{
+	DIR *dp;
+	struct dirent *entry;
+	char path[1024];
+
+	dp = opendir(dir);
+	if (!dp) return;
+	while ((entry = readdir(dp))) {
+		if (strncmp(entry->d_name, "bench", 5)) continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		remove(path);
+	}
+	closedir(dp);
+}
+
+/*******************************************************************************/
+static void *bench_work(void *arg)
+{
+	bench_hist_t *a_hist = arg;
+	long i;
+	unsigned long long t0;
+	unsigned long long t1;
+
+	if (bench_mdc) {
+		zlog_put_mdc("req", "3f2a9c1e-0001");
+		zlog_put_mdc("user", "bench");
+	}
+	for (i = 0; i < warmup; i++) zlog_info(bench_zc, "%s", bench_msg);
+
+	pthread_mutex_lock(&bench_lock);
+	bench_ready++;
+	pthread_cond_broadcast(&bench_cond);
+	while (!bench_go) pthread_cond_wait(&bench_cond, &bench_lock);
+	pthread_mutex_unlock(&bench_lock);
+
+	for (i = 0; i < count; i++) {
+		t0 = bench_now();
+		zlog_info(bench_zc, "%s", bench_msg);
+		t1 = bench_now();
+		bench_hist_add(a_hist, t1 - t0);
+	}
+	return NULL;
+}
+
+/* one process of a case, tells it is ready, waits for go, writes its hist out */
+static int bench_child(const char *conf, const char *output, const char *format,
+		long nthread, long size, int go_fd, int result_fd)
+{
+	long i;
+	char c;
+	pthread_t *tids = NULL;
+	bench_hist_t *hists = NULL;
+	bench_hist_t *all = NULL;
+	unsigned long long start;
+
+	if (!strcmp(output, "null")) {
+		int fd = open("/dev/null", O_WRONLY);
+		if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) return -1;
+		close(fd);
+	}
+
+	bench_msg = malloc(size + 1);
+	tids = calloc(nthread, sizeof(pthread_t));
+	hists = calloc(nthread, sizeof(bench_hist_t));
+	all = calloc(1, sizeof(bench_hist_t));
+	if (!bench_msg || !tids || !hists || !all) return -1;
+	memset(bench_msg, 'x', size);
+	bench_msg[size] = '\0';
+	bench_mdc = !strcmp(format, "heavy");
+
+	if (zlog_init(conf)) {
+		fprintf(stderr, "zlog_init[%s] fail\n", conf);
+		return -1;
+	}
+	zlog_set_record("bench", bench_record);
+	bench_zc = zlog_get_category("bench");
+	if (!bench_zc) {
+		fprintf(stderr, "zlog_get_category fail\n");
+		return -1;
+	}
+
+	for (i = 0; i < nthread; i++) {
+		if (pthread_create(&tids[i], NULL, bench_work, &hists[i])) {
+			fprintf(stderr, "pthread_create fail\n");
+			return -1;
+		}
+	}
+
+	pthread_mutex_lock(&bench_lock);
+	while (bench_ready < nthread) pthread_cond_wait(&bench_cond, &bench_lock);
+	pthread_mutex_unlock(&bench_lock);
+
+	/* all processes start together */
+	if (write(result_fd, "r", 1) != 1) return -1;
+	if (read(go_fd, &c, 1) != 1) return -1;
+
+	start = bench_now();
+	pthread_mutex_lock(&bench_lock);
+	bench_go = 1;
+	pthread_cond_broadcast(&bench_cond);
+	pthread_mutex_unlock(&bench_lock);
+
+	for (i = 0; i < nthread; i++) {
+		pthread_join(tids[i], NULL);
+		bench_hist_merge(all, &hists[i]);
+	}
+	zlog_fini();
+	all->start = start;
+	all->end = bench_now();
+
+	if (write(result_fd, all, sizeof(*all)) != sizeof(*all)) return -1;
+	return 0;
+}
+
+static ssize_t bench_read_full(int fd, void *buf, size_t len)
+{
+	size_t got = 0;
+	ssize_t n;
+
+	while (got < len) {
+		n = read(fd, (char *)buf + got, len - got);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		got += n;
+	}
+	return got;
+}
+
+/* fork nproc processes of nthread threads, merge their hists into a_hist */
+static int bench_run(const char *output, const char *format,
+		long nthread, long nproc, long size, bench_hist_t * a_hist)
+{
+	long i;
+	int rc = 0;
+	char c;
+	pid_t pid;
+	int status;
+	int go_fd[2];
+	int *result_fd;
+	bench_hist_t *one;
+	char conf[1024];
+
+	snprintf(conf, sizeof(conf), "%s/zlog-bench.conf", dir);
+	if (bench_write_conf(conf, output, format)) return -1;
+
+	result_fd = calloc(nproc, sizeof(int));
+	one = calloc(1, sizeof(bench_hist_t));
+	if (!result_fd || !one) {
+		fprintf(stderr, "calloc fail\n");
+		exit(1);
+	}
+	if (pipe(go_fd)) {
+		fprintf(stderr, "pipe fail, errno[%d]\n", errno);
+		exit(1);
+	}
+
+	fflush(stdout);
+	for (i = 0; i < nproc; i++) {
+		int fds[2];
+
+		if (pipe(fds)) {
+			fprintf(stderr, "pipe fail, errno[%d]\n", errno);
+			exit(1);
+		}
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "fork fail, errno[%d]\n", errno);
+			exit(1);
+		} else if (pid == 0) {
+			close(fds[0]);
+			close(go_fd[1]);
+			_exit(bench_child(conf, output, format, nthread, size,
+				go_fd[0], fds[1]) ? 1 : 0);
+		}
+		close(fds[1]);
+		result_fd[i] = fds[0];
+	}
+	close(go_fd[0]);
+
+	/* a process that fails closes its pipe, so this does not hang,
+	 * and the others see go closed without a byte and give up */
+	for (i = 0; i < nproc; i++) {
+		if (read(result_fd[i], &c, 1) != 1) {
+			rc = -1;
+			break;
+		}
+	}
+	if (rc == 0) {
+		for (i = 0; i < nproc; i++) {
+			if (write(go_fd[1], "g", 1) != 1) rc = -1;
+		}
+	}
+	close(go_fd[1]);
+
+	memset(a_hist, 0x00, sizeof(*a_hist));
+	for (i = 0; i < nproc; i++) {
+		if (bench_read_full(result_fd[i], one, sizeof(*one)) == sizeof(*one)) {
+			bench_hist_merge(a_hist, one);
+		} else {
+			rc = -1;
+		}
+		close(result_fd[i]);
+	}
+	for (i = 0; i < nproc; i++) {
+		if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) rc = -1;
+	}
+
+	free(one);
+	free(result_fd);
+	bench_clean();
+	remove(conf);
+	return rc;
+}
+
+/*******************************************************************************/
+static void bench_json_string(FILE * fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') fputc('\\', fp);
+		fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+/* what an older run of -j wrote, one result a line */
+static bench_base_t *bench_load_base(const char *path, int *nbase)
+{
+	FILE *fp;
+	char line[4096];
+	char *p;
+	bench_base_t *bases = NULL;
+	bench_base_t *a_base;
+	int n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "fopen[%s] fail, errno[%d]\n", path, errno);
+		return NULL;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strstr(line, "\"case\": \"")) continue;
+		a_base = realloc(bases, (n + 1) * sizeof(bench_base_t));
+		if (!a_base) break;
+		bases = a_base;
+		a_base = &bases[n];
+		memset(a_base, 0x00, sizeof(*a_base));
+		if (sscanf(strstr(line, "\"case\": \"") + 9, "%127[^\"]", a_base->name) != 1) continue;
+		p = strstr(line, "\"msgs_per_sec\": ");
+		if (p) a_base->msgs_per_sec = atof(p + 16);
+		p = strstr(line, "\"p99_ns\": ");
+		if (p) a_base->p99 = strtoull(p + 10, NULL, 10);
+		n++;
+	}
+	fclose(fp);
+	*nbase = n;
+	return bases;
+}
+
+static bench_base_t *bench_find_base(bench_base_t *bases, int nbase, const char *name)
+{
+	int i;
+
+	for (i = 0; i < nbase; i++) {
+		if (!strcmp(bases[i].name, name)) return &bases[i];
+	}
+	return NULL;
+}
+
+static int bench_split(char *str, const char **list)
+{
+	int n = 0;
+	char *p;
+
+	for (p = strtok(str, ","); p && n < BENCH_LIST_MAX - 1; p = strtok(NULL, ",")) {
+		list[n++] = p;
+	}
+	list[n] = NULL;
+	return n;
+}
+
+static int bench_split_long(char *str, long *list)
+{
+	int i;
+	int n;
+	const char *strs[BENCH_LIST_MAX];
+
+	n = bench_split(str, strs);
+	for (i = 0; i < n; i++) {
+		list[i] = atol(strs[i]);
+		if (list[i] <= 0) return -1;
+	}
+	list[n] = 0;
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	int op;
+	int io;
+	int ifm;
+	int it;
+	int ip;
+	int is;
+	int rc = 0;
+	int first = 1;
+	int nbase = 0;
+	double tolerance = 10;
+	double seconds;
+	double msgs;
+	double msgs_per_sec;
+	double change;
+	const char *json_path = NULL;
+	const char *base_path = NULL;
+	bench_base_t *bases = NULL;
+	bench_base_t *a_base;
+	bench_hist_t *a_hist;
+	unsigned long long p50, p99, p999;
+	unsigned long long clock_cost;
+	char name[128];
+	FILE *json = NULL;
+	static char default_threads[] = "1,4";
+	static char default_procs[] = "1";
+	static char default_sizes[] = "16,128,1024";
+	static const char *help =
+		"usage: zlog-bench [options]\n"
+		"\t-o list,\toutputs, static,dynamic,rotate,pipe,record,null (all)\n"
+		"\t-f list,\tformats, minimal,default,heavy (all)\n"
+		"\t-t list,\tthreads per process (1,4)\n"
+		"\t-p list,\tprocesses (1)\n"
+		"\t-s list,\tmsg sizes in bytes (16,128,1024)\n"
+		"\t-n count,\ttimed msgs per thread (100000)\n"
+		"\t-w count,\tuntimed msgs per thread before (1000)\n"
+		"\t-g line,\tadd a [global] line, e.g. -g \"async = true\", repeatable\n"
+		"\t-d dir,\tfor logs, emptied of bench* after each case (zlog-bench.d)\n"
+		"\t-j file,\twrite results as JSON\n"
+		"\t-b file,\tcompare with the JSON of an older run\n"
+		"\t-r pct,\tfail when msgs/s drops or p99 grows by more than pct (10)\n"
+		"\t-h,\tshow help message\n"
+		"zlog version: " ZLOG_VERSION "\n";
+
+	memcpy(outputs, bench_outputs, sizeof(bench_outputs));
+	for (ifm = 0; bench_formats[ifm].name; ifm++) formats[ifm] = bench_formats[ifm].name;
+	formats[ifm] = NULL;
+	bench_split_long(default_threads, threads);
+	bench_split_long(default_procs, procs);
+	bench_split_long(default_sizes, sizes);
+
+	while ((op = getopt(argc, argv, "o:f:t:p:s:n:w:g:d:j:b:r:h")) > 0) {
+		switch (op) {
+		case 'o':
+			bench_split(optarg, outputs);
+			break;
+		case 'f':
+			bench_split(optarg, formats);
+			break;
+		case 't':
+			if (bench_split_long(optarg, threads) <= 0) goto usage;
+			break;
+		case 'p':
+			if (bench_split_long(optarg, procs) <= 0) goto usage;
+			break;
+		case 's':
+			if (bench_split_long(optarg, sizes) <= 0) goto usage;
+			break;
+		case 'n':
+			count = atol(optarg);
+			if (count <= 0) goto usage;
+			break;
+		case 'w':
+			warmup = atol(optarg);
+			break;
+		case 'g':
+			if (nglobal >= BENCH_GLOBAL_MAX) goto usage;
+			globals[nglobal++] = optarg;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'j':
+			json_path = optarg;
+			break;
+		case 'b':
+			base_path = optarg;
+			break;
+		case 'r':
+			tolerance = atof(optarg);
+			break;
+		case 'h':
+			fputs(help, stdout);
+			return 0;
+		default:
+			goto usage;
+		}
+	}
+
+	for (io = 0; outputs[io]; io++) {
+		if (bench_rule(outputs[io], name, sizeof(name))) goto usage;
+	}
+	for (ifm = 0; formats[ifm]; ifm++) {
+		if (!bench_pattern(formats[ifm])) goto usage;
+	}
+
+	if (mkdir(dir, 0755) && errno != EEXIST) {
+		fprintf(stderr, "mkdir[%s] fail, errno[%d]\n", dir, errno);
+		return 1;
+	}
+	if (base_path) {
+		bases = bench_load_base(base_path, &nbase);
+		if (!bases) return 1;
+	}
+	if (json_path) {
+		json = fopen(json_path, "w");
+		if (!json) {
+			fprintf(stderr, "fopen[%s] fail, errno[%d]\n", json_path, errno);
+			return 1;
+		}
+	}
+	a_hist = calloc(1, sizeof(bench_hist_t));
+	if (!a_hist) return 1;
+
+	clock_cost = bench_clock_cost();
+	printf("zlog %s, %ld msgs a thread, clock pair %llu ns in every latency\n",
+		ZLOG_VERSION, count, clock_cost);
+	if (json) {
+		fprintf(json, "{\n\"zlog_bench\": 1,\n\"version\": \"%s\",\n"
+			"\"count\": %ld,\n\"warmup\": %ld,\n\"clock_ns\": %llu,\n\"globals\": [",
+			ZLOG_VERSION, count, warmup, clock_cost);
+		for (it = 0; it < nglobal; it++) {
+			if (it) fputs(", ", json);
+			bench_json_string(json, globals[it]);
+		}
+		fprintf(json, "],\n\"results\": [\n");
+	}
+
+	for (io = 0; outputs[io]; io++)
+	for (ifm = 0; formats[ifm]; ifm++)
+	for (it = 0; threads[it]; it++)
+	for (ip = 0; procs[ip]; ip++)
+	for (is = 0; sizes[is]; is++) {
+		snprintf(name, sizeof(name), "%s/%s/t%ld/p%ld/s%ld",
+			outputs[io], formats[ifm], threads[it], procs[ip], sizes[is]);
+
+		if (bench_run(outputs[io], formats[ifm], threads[it], procs[ip], sizes[is], a_hist)) {
+			printf("%-32s fail\n", name);
+			rc = 1;
+			continue;
+		}
+
+		msgs = (double)a_hist->n;
+		seconds = (a_hist->end - a_hist->start) / 1e9;
+		msgs_per_sec = seconds > 0 ? msgs / seconds : 0;
+		p50 = bench_hist_percentile(a_hist, 0.50);
+		p99 = bench_hist_percentile(a_hist, 0.99);
+		p999 = bench_hist_percentile(a_hist, 0.999);
+
+		printf("%-32s %12.0f msg/s %8.1f MB/s  p50 %6llu  p99 %6llu  p99.9 %7llu  max %9llu ns",
+			name, msgs_per_sec, msgs_per_sec * sizes[is] / 1e6, p50, p99, p999, a_hist->max);
+
+		a_base = bases ? bench_find_base(bases, nbase, name) : NULL;
+		if (a_base && a_base->msgs_per_sec > 0 && a_base->p99 > 0) {
+			change = (msgs_per_sec / a_base->msgs_per_sec - 1) * 100;
+			printf("  msg/s %+6.1f%%", change);
+			if (change < -tolerance) rc = 1;
+			change = ((double)p99 / a_base->p99 - 1) * 100;
+			printf(" p99 %+6.1f%%", change);
+			if (change > tolerance) rc = 1;
+		}
+		printf("\n");
+
+		if (json) {
+			fprintf(json, "%s{\"case\": \"%s\", \"output\": \"%s\", \"format\": \"%s\", "
+				"\"threads\": %ld, \"procs\": %ld, \"size\": %ld, \"msgs\": %.0f, "
+				"\"seconds\": %.6f, \"msgs_per_sec\": %.1f, \"mb_per_sec\": %.3f, "
+				"\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+				first ? "" : ",\n", name, outputs[io], formats[ifm],
+				threads[it], procs[ip], sizes[is], msgs,
+				seconds, msgs_per_sec, msgs_per_sec * sizes[is] / 1e6,
+				p50, p99, p999, a_hist->max);
+			first = 0;
+		}
+	}
+
+	if (json) {
+		fprintf(json, "\n]\n}\n");
+		fclose(json);
+	}
+	if (bases && rc) printf("slower than [%s] by more than %.1f%%, or a case failed\n",
+		base_path, tolerance);
+	rmdir(dir);
+	free(a_hist);
+	free(bases);
+	return rc;
+
+usage:
+	fputs(help, stderr);
+	return 2;
+}
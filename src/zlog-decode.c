@@ -0,0 +1,558 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#include "binlog.h"
+#include "version.h"
+
+/* decode the records written by rules with option binary, see binlog.h */
+
+typedef struct {
+	char *data;
+	size_t len;
+	const char *path;
+} decode_file_t;
+
+typedef struct {
+	uint64_t ptr;
+	size_t seq;      /* place of the F record in all records */
+	const char *str;
+	uint32_t len;
+} decode_fmt_t;
+
+typedef struct {
+	const char *p;
+	const char *end;
+	int bad;
+} decode_args_t;
+
+static decode_fmt_t *fmts;
+static size_t fmt_count;
+static size_t fmt_size;
+
+/* ptr -> latest F seen so far in pass 2, open addressing */
+static size_t *seen;
+static size_t seen_size;
+
+static const char *level_name(int level)
+{
+	switch (level) {
+	case 20: return "DEBUG";
+	case 40: return "INFO";
+	case 60: return "NOTICE";
+	case 80: return "WARN";
+	case 100: return "ERROR";
+	case 120: return "FATAL";
+	}
+	return NULL;
+}
+
+static int read_file(decode_file_t *a_file)
+{
+	FILE *fp;
+	size_t nread;
+	size_t size = 1024 * 1024;
+
+	fp = fopen(a_file->path, "rb");
+	if (!fp) {
+		perror(a_file->path);
+		return -1;
+	}
+
+	a_file->len = 0;
+	a_file->data = malloc(size);
+	while (a_file->data) {
+		nread = fread(a_file->data + a_file->len, 1, size - a_file->len, fp);
+		a_file->len += nread;
+		if (a_file->len < size) break;
+		size *= 2;
+		a_file->data = realloc(a_file->data, size);
+	}
+	fclose(fp);
+
+	if (!a_file->data) {
+		fprintf(stderr, "out of memory reading %s\n", a_file->path);
+		return -1;
+	}
+	return 0;
+}
+
+/* the next record of a_file at *offset, 0 at the end */
+static int next_record(decode_file_t *a_file, size_t *offset,
+		char *type, const char **body, uint32_t *body_len)
+{
+	uint32_t len;
+
+	if (*offset >= a_file->len) return 0;
+	if (a_file->len - *offset < ZLOG_BINLOG_HEAD_LEN) goto cut;
+
+	*type = a_file->data[*offset];
+	memcpy(&len, a_file->data + *offset + 1, sizeof(len));
+	if (len < ZLOG_BINLOG_HEAD_LEN || len > a_file->len - *offset) goto cut;
+
+	*body = a_file->data + *offset + ZLOG_BINLOG_HEAD_LEN;
+	*body_len = len - ZLOG_BINLOG_HEAD_LEN;
+	*offset += len;
+	return 1;
+cut:
+	fprintf(stderr, "%s: record cut at offset %ld, rest skipped\n",
+		a_file->path, (long)*offset);
+	*offset = a_file->len;
+	return 0;
+}
+
+/*******************************************************************************/
+static void add_fmt(uint64_t ptr, size_t seq, const char *str, uint32_t len)
+{
+	if (fmt_count == fmt_size) {
+		fmt_size = fmt_size ? fmt_size * 2 : 256;
+		fmts = realloc(fmts, fmt_size * sizeof(decode_fmt_t));
+		if (!fmts) {
+			fputs("out of memory\n", stderr);
+			exit(1);
+		}
+	}
+	fmts[fmt_count].ptr = ptr;
+	fmts[fmt_count].seq = seq;
+	fmts[fmt_count].str = str;
+	fmts[fmt_count].len = len;
+	fmt_count++;
+}
+
+static size_t *seen_slot(uint64_t ptr)
+{
+	size_t i;
+
+	i = (size_t)((ptr >> 3) * 2654435761u);
+	for (;; i++) {
+		size_t *slot = seen + (i & (seen_size - 1));
+		if (*slot == (size_t)-1 || fmts[*slot].ptr == ptr) return slot;
+	}
+}
+
+/* the latest F of ptr before seq, or else the first after it,
+ * as threads may get their L out before the F of another thread
+ */
+static decode_fmt_t *find_fmt(uint64_t ptr, size_t seq)
+{
+	size_t i;
+	size_t *slot;
+
+	slot = seen_slot(ptr);
+	if (*slot != (size_t)-1) return fmts + *slot;
+
+	for (i = 0; i < fmt_count; i++) {
+		if (fmts[i].ptr == ptr && fmts[i].seq > seq) return fmts + i;
+	}
+	return NULL;
+}
+
+/*******************************************************************************/
+static int next_arg(decode_args_t *a_args, char tag, void *value, size_t size)
+{
+	if (a_args->bad || a_args->p + 1 + size > a_args->end || *a_args->p != tag) {
+		a_args->bad = 1;
+		return -1;
+	}
+	memcpy(value, a_args->p + 1, size);
+	a_args->p += 1 + size;
+	return 0;
+}
+
+static int next_str(decode_args_t *a_args, char **str)
+{
+	uint32_t len;
+
+	if (next_arg(a_args, ZLOG_BINLOG_TAG_STR, &len, sizeof(len))) return -1;
+	if (len > (size_t)(a_args->end - a_args->p)) {
+		a_args->bad = 1;
+		return -1;
+	}
+	*str = malloc(len + 1);
+	if (!*str) {
+		a_args->bad = 1;
+		return -1;
+	}
+	memcpy(*str, a_args->p, len);
+	(*str)[len] = '\0';
+	a_args->p += len;
+	return 0;
+}
+
+/* printf fmt again, one conversion at a time, on the kept args */
+static void print_msg(FILE *fp, const char *fmt, size_t fmt_len, decode_args_t *a_args)
+{
+	const char *p;
+	const char *end = fmt + fmt_len;
+	char spec[64];
+	size_t n;
+	int star;
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	char *str;
+
+#define spec_add(c) do { if (n < sizeof(spec) - 8) spec[n++] = (c); } while (0)
+
+	for (p = fmt; p < end; p++) {
+		if (*p != '%' || p + 1 >= end) {
+			fputc(*p, fp);
+			continue;
+		}
+		p++;
+		if (*p == '%') {
+			fputc('%', fp);
+			continue;
+		}
+
+		n = 0;
+		spec_add('%');
+		while (p < end && strchr("-+ #0'", *p)) spec_add(*p++);
+
+		if (p < end && *p == '*') {
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_INT, &i64, sizeof(i64))) break;
+			n += snprintf(spec + n, sizeof(spec) - n, "%d", (int)i64);
+			p++;
+		} else {
+			while (p < end && *p >= '0' && *p <= '9') spec_add(*p++);
+		}
+
+		if (p < end && *p == '.') {
+			p++;
+			if (p < end && *p == '*') {
+				if (next_arg(a_args, ZLOG_BINLOG_TAG_INT, &i64, sizeof(i64))) break;
+				star = (int)i64;
+				/* negative is as if there were none */
+				if (star >= 0) n += snprintf(spec + n, sizeof(spec) - n, ".%d", star);
+				p++;
+			} else {
+				spec_add('.');
+				while (p < end && *p >= '0' && *p <= '9') spec_add(*p++);
+			}
+		}
+
+		while (p < end && strchr("hlqLjzZt", *p)) p++;
+		if (p >= end) break;
+
+		switch (*p) {
+		case 'd':
+		case 'i':
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_INT, &i64, sizeof(i64))) break;
+			spec_add('l'); spec_add('l'); spec_add(*p); spec[n] = '\0';
+			fprintf(fp, spec, (long long)i64);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_UINT, &u64, sizeof(u64))) break;
+			spec_add('l'); spec_add('l'); spec_add(*p); spec[n] = '\0';
+			fprintf(fp, spec, (unsigned long long)u64);
+			break;
+		case 'c':
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_INT, &i64, sizeof(i64))) break;
+			spec_add('c'); spec[n] = '\0';
+			fprintf(fp, spec, (int)i64);
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_DOUBLE, &d, sizeof(d))) break;
+			spec_add(*p); spec[n] = '\0';
+			fprintf(fp, spec, d);
+			break;
+		case 'p':
+			if (next_arg(a_args, ZLOG_BINLOG_TAG_PTR, &u64, sizeof(u64))) break;
+			spec_add('p'); spec[n] = '\0';
+			fprintf(fp, spec, (void *)(uintptr_t)u64);
+			break;
+		case 's':
+		case 'm':
+			if (next_str(a_args, &str)) break;
+			spec_add('s'); spec[n] = '\0';
+			fprintf(fp, spec, str);
+			free(str);
+			break;
+		case 'n':
+			break;
+		default:
+			a_args->bad = 1;
+			break;
+		}
+		if (a_args->bad) break;
+	}
+#undef spec_add
+
+	if (a_args->bad) fputs("<bad args>", fp);
+	return;
+}
+
+/* args of a format we have not got, as they are */
+static void print_raw_args(FILE *fp, decode_args_t *a_args)
+{
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	char *str;
+
+	while (a_args->p < a_args->end && !a_args->bad) {
+		switch (*a_args->p) {
+		case ZLOG_BINLOG_TAG_INT:
+			if (!next_arg(a_args, ZLOG_BINLOG_TAG_INT, &i64, sizeof(i64)))
+				fprintf(fp, " %lld", (long long)i64);
+			break;
+		case ZLOG_BINLOG_TAG_UINT:
+			if (!next_arg(a_args, ZLOG_BINLOG_TAG_UINT, &u64, sizeof(u64)))
+				fprintf(fp, " %llu", (unsigned long long)u64);
+			break;
+		case ZLOG_BINLOG_TAG_DOUBLE:
+			if (!next_arg(a_args, ZLOG_BINLOG_TAG_DOUBLE, &d, sizeof(d)))
+				fprintf(fp, " %g", d);
+			break;
+		case ZLOG_BINLOG_TAG_PTR:
+			if (!next_arg(a_args, ZLOG_BINLOG_TAG_PTR, &u64, sizeof(u64)))
+				fprintf(fp, " 0x%llx", (unsigned long long)u64);
+			break;
+		case ZLOG_BINLOG_TAG_STR:
+			if (!next_str(a_args, &str)) {
+				fprintf(fp, " \"%s\"", str);
+				free(str);
+			}
+			break;
+		default:
+			a_args->bad = 1;
+			break;
+		}
+	}
+	if (a_args->bad) fputs(" <bad args>", fp);
+	return;
+}
+
+/* level, time and category of L and H, return bytes eaten */
+static size_t print_head(FILE *fp, const char *body, uint32_t body_len)
+{
+	int32_t level;
+	int64_t sec;
+	int32_t usec;
+	uint16_t len;
+	time_t t;
+	struct tm tm;
+	char date[64];
+	const char *name;
+	size_t need = sizeof(level) + sizeof(sec) + sizeof(usec) + sizeof(len);
+
+	if (body_len < need) return 0;
+	memcpy(&level, body, sizeof(level));
+	memcpy(&sec, body + 4, sizeof(sec));
+	memcpy(&usec, body + 12, sizeof(usec));
+	memcpy(&len, body + 16, sizeof(len));
+	if (body_len < need + len) return 0;
+
+	t = (time_t)sec;
+	localtime_r(&t, &tm);
+	strftime(date, sizeof(date), "%F %T", &tm);
+	fprintf(fp, "%s.%06d ", date, (int)usec);
+
+	name = level_name(level);
+	if (name) fprintf(fp, "%-6s ", name);
+	else fprintf(fp, "%-6d ", (int)level);
+
+	fprintf(fp, "[%.*s] ", (int)len, body + need);
+	return need + len;
+}
+
+static void print_log(FILE *fp, const char *body, uint32_t body_len, size_t seq)
+{
+	uint64_t ptr;
+	size_t used;
+	decode_fmt_t *a_fmt;
+	decode_args_t args;
+
+	if (body_len < sizeof(ptr)) goto bad;
+	memcpy(&ptr, body, sizeof(ptr));
+	used = print_head(fp, body + sizeof(ptr), body_len - sizeof(ptr));
+	if (!used) goto bad;
+
+	args.p = body + sizeof(ptr) + used;
+	args.end = body + body_len;
+	args.bad = 0;
+
+	if (ptr == 0) {
+		print_msg(fp, "%s", 2, &args);
+	} else if ((a_fmt = find_fmt(ptr, seq))) {
+		print_msg(fp, a_fmt->str, a_fmt->len, &args);
+	} else {
+		fprintf(fp, "<format 0x%llx not found>", (unsigned long long)ptr);
+		print_raw_args(fp, &args);
+	}
+	fputc('\n', fp);
+	return;
+bad:
+	fputs("<bad record>\n", fp);
+	return;
+}
+
+static void print_hex(FILE *fp, const char *body, uint32_t body_len)
+{
+	size_t used;
+	uint32_t len;
+	uint32_t i;
+	uint32_t j;
+	const unsigned char *hex;
+
+	used = print_head(fp, body, body_len);
+	if (!used || body_len - used < sizeof(len)) goto bad;
+	memcpy(&len, body + used, sizeof(len));
+	used += sizeof(len);
+	if (body_len - used < len) goto bad;
+	hex = (const unsigned char *)body + used;
+
+	fprintf(fp, "hex_buf_len=[%lu]\n", (unsigned long)len);
+	for (i = 0; i < len; i += 16) {
+		fprintf(fp, "%010lu   ", (unsigned long)(i / 16 + 1));
+		for (j = i; j < i + 16; j++) {
+			if (j < len) fprintf(fp, "%02x ", hex[j]);
+			else fputs("   ", fp);
+		}
+		fputs("  ", fp);
+		for (j = i; j < i + 16 && j < len; j++) {
+			fputc(hex[j] >= 0x20 && hex[j] < 0x7f ? hex[j] : '.', fp);
+		}
+		fputc('\n', fp);
+	}
+	return;
+bad:
+	fputs("<bad record>\n", fp);
+	return;
+}
+
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+	int i;
+	int op;
+	size_t seq;
+	size_t next;
+	size_t offset;
+	char type;
+	const char *body;
+	uint32_t body_len;
+	uint64_t ptr;
+	uint32_t len;
+	decode_file_t *files;
+	static const char *help =
+		"usage: zlog-decode [binary log files]...\n"
+		"\tfiles of one log, oldest first, as the archives and then the log itself\n"
+		"\t-h,\tshow help message\n"
+		"zlog version: " ZLOG_VERSION "\n";
+
+	while((op = getopt(argc, argv, "h")) > 0) {
+		if (op == 'h') {
+			fputs(help, stdout);
+			return 0;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc == 0) {
+		fputs(help, stdout);
+		return -1;
+	}
+
+	files = calloc(argc, sizeof(decode_file_t));
+	if (!files) {
+		fputs("out of memory\n", stderr);
+		exit(1);
+	}
+	for (i = 0; i < argc; i++) {
+		files[i].path = argv[i];
+		if (read_file(files + i)) exit(2);
+	}
+
+	/* 1st pass, all formats, some may come after their 1st use */
+	seq = 0;
+	for (i = 0; i < argc; i++) {
+		offset = 0;
+		while (next_record(files + i, &offset, &type, &body, &body_len)) {
+			seq++;
+			if (type != ZLOG_BINLOG_FORMAT) continue;
+			if (body_len < sizeof(ptr) + sizeof(len)) continue;
+			memcpy(&ptr, body, sizeof(ptr));
+			memcpy(&len, body + sizeof(ptr), sizeof(len));
+			if (len > body_len - sizeof(ptr) - sizeof(len)) continue;
+			add_fmt(ptr, seq, body + sizeof(ptr) + sizeof(len), len);
+		}
+	}
+
+	for (seen_size = 256; seen_size < fmt_count * 2; seen_size *= 2);
+	seen = malloc(seen_size * sizeof(size_t));
+	if (!seen) {
+		fputs("out of memory\n", stderr);
+		exit(1);
+	}
+	memset(seen, 0xff, seen_size * sizeof(size_t));
+
+	/* 2nd pass, msgs */
+	seq = 0;
+	next = 0;
+	for (i = 0; i < argc; i++) {
+		offset = 0;
+		while (next_record(files + i, &offset, &type, &body, &body_len)) {
+			seq++;
+			switch (type) {
+			case ZLOG_BINLOG_START:
+				if (body_len < 4 || memcmp(body, ZLOG_BINLOG_MAGIC, 4)) {
+					fprintf(stderr, "%s: not a zlog binary log\n", files[i].path);
+					exit(2);
+				}
+				break;
+			case ZLOG_BINLOG_FORMAT:
+				/* formats of a new process or reload take over the same ptr */
+				if (next < fmt_count && fmts[next].seq == seq) {
+					*seen_slot(fmts[next].ptr) = next;
+					next++;
+				}
+				break;
+			case ZLOG_BINLOG_LOG:
+				print_log(stdout, body, body_len, seq);
+				break;
+			case ZLOG_BINLOG_HEX:
+				print_hex(stdout, body, body_len);
+				break;
+			default:
+				fprintf(stderr, "%s: unknown record [%c], skipped\n", files[i].path, type);
+				break;
+			}
+		}
+	}
+
+	exit(0);
+}
@@ -0,0 +1,491 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * zlog-microbench: ns and instructions per call of the layers under
+ * zlog(), driven one by one on a thread of our own, without zlog_init.
+ *
+ * Inputs come from a xorshift generator with a fixed seed, so two runs of
+ * one build see the same strings and names. Each bench runs repeat times
+ * and the fastest run is kept. Instructions are counted in user space by
+ * perf_event_open on linux, and shown as - where it is not allowed.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "zc_defs.h"
+#include "conf.h"
+#include "thread.h"
+#include "event.h"
+#include "buf.h"
+#include "spec.h"
+#include "format.h"
+#include "rule.h"
+#include "rule_trie.h"
+#include "mdc.h"
+#include "version.h"
+
+#define BENCH_WORDS 1024
+#define BENCH_NAMES 256
+
+typedef void (*bench_fn) (long n);
+
+static const char *bench_conf_string =
+	"[formats]\n"
+	"minimal = \"%m%n\"\n"
+	"default = \"%D %V [%p:%F:%L] %m%n\"\n"
+	"heavy = \"%d(%F %T.%us) %-6V [%p:%t] (%c:%F:%L %U) [%M(req)] [%M(user)] %m%n\"\n"
+	"[rules]\n"
+	"*.*			>stdout; minimal\n"
+	"mod_1_.*		>stdout; minimal\n"
+	"mod_2_sub_3.info	>stdout; minimal\n"
+	"mod_3_sub_.debug	>stdout; minimal\n"
+	"mod_4.*		>stdout; minimal\n"
+	"mod_5_sub_9.=error	>stdout; minimal\n"
+	"!.*			>stdout; minimal\n";
+
+/* each alone, so one that regresses shows by its name */
+static const char *bench_specs[] = {
+	"%d", "%d(%F %T.%us)", "%ms", "%us", "%ns", "%m", "%c", "%-12c", "%F", "%f",
+	"%L", "%U", "%V", "%v", "%-6V", "%p", "%t", "%T", "%k", "%H", "%M(req)",
+	"%n", "%%", NULL
+};
+
+static long count = 1000000;
+static int repeat = 5;
+static unsigned long long seed = 1;
+static const char *filter;
+static FILE *json;
+static int first = 1;
+
+static unsigned long long rand_state;
+static char *words[BENCH_WORDS];
+static size_t word_lens[BENCH_WORDS];
+static char *names[BENCH_NAMES];
+static int numbers[BENCH_WORDS];
+
+static zlog_thread_t *thread;
+static zlog_buf_t *buf;
+static zlog_spec_t *spec;
+static zlog_format_t *format;
+static zc_hashtable_t *table;
+static zc_arraylist_t *fit_rules;
+
+static int perf_fd = -1;
+
+/*******************************************************************************/
+static unsigned long long bench_rand(void)
+{
+	rand_state ^= rand_state >> 12;
+	rand_state ^= rand_state << 25;
+	rand_state ^= rand_state >> 27;
+	return rand_state * 2685821657736338717ULL;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#ifdef __linux__
+static int bench_perf_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0x00, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+static void bench_perf_start(void)
+{
+#ifdef __linux__
+	if (perf_fd < 0) return;
+	ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+/* -1 if not counted */
+static long long bench_perf_stop(void)
+{
+#ifdef __linux__
+	long long insns;
+
+	if (perf_fd < 0) return -1;
+	ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(perf_fd, &insns, sizeof(insns)) != sizeof(insns)) return -1;
+	return insns;
+#else
+	return -1;
+#endif
+}
+
+/* the fastest of repeat runs, and its instructions */
+static void bench_run(const char *name, bench_fn fn)
+{
+	int r;
+	double t0;
+	double ns;
+	double best_ns = 0;
+	long long insns;
+	long long best_insns = -1;
+
+	if (filter && !strstr(name, filter)) return;
+
+	fn(count / 10 + 1);
+	for (r = 0; r < repeat; r++) {
+		bench_perf_start();
+		t0 = bench_now();
+		fn(count);
+		ns = bench_now() - t0;
+		insns = bench_perf_stop();
+		if (r == 0 || ns < best_ns) {
+			best_ns = ns;
+			best_insns = insns;
+		}
+	}
+
+	if (best_insns >= 0) {
+		printf("%-36s %10.2f ns/op %10.1f insn/op\n", name,
+			best_ns / count, (double)best_insns / count);
+	} else {
+		printf("%-36s %10.2f ns/op %10s insn/op\n", name, best_ns / count, "-");
+	}
+	if (json) {
+		fprintf(json, "%s{\"case\": \"", first ? "" : ",\n");
+		for (; *name; name++) {
+			if (*name == '"' || *name == '\\') fputc('\\', json);
+			fputc(*name, json);
+		}
+		fprintf(json, "\", \"ns_per_op\": %.3f, \"insn_per_op\": %.1f}",
+			best_ns / count, best_insns >= 0 ? (double)best_insns / count : -1.0);
+		first = 0;
+	}
+}
+
+/*******************************************************************************/
+static int bench_buf_printf(zlog_buf_t * a_buf, const char *fmt, ...)
+{
+	int rc;
+	va_list args;
+
+	va_start(args, fmt);
+	rc = zlog_buf_vprintf(a_buf, fmt, args);
+	va_end(args);
+	return rc;
+}
+
+static void bench_buf_vprintf(long n)
+{
+	long i;
+	int j;
+
+	for (i = 0; i < n; i++) {
+		j = i & (BENCH_WORDS - 1);
+		zlog_buf_restart(buf);
+		bench_buf_printf(buf, "user[%s] id[%d]", words[j], numbers[j]);
+	}
+}
+
+static void bench_buf_adjust_append(long n)
+{
+	long i;
+	int j;
+
+	for (i = 0; i < n; i++) {
+		j = i & (BENCH_WORDS - 1);
+		zlog_buf_restart(buf);
+		zlog_buf_adjust_append(buf, words[j], word_lens[j], 1, 0, 24, 32);
+	}
+}
+
+static void bench_spec_write(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		/* a new event gets the clock again */
+		thread->event->time_stamp.tv_sec = 0;
+		zlog_buf_restart(buf);
+		spec->write_buf(spec, thread, buf);
+	}
+}
+
+static void bench_format_gen_msg(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		thread->event->time_stamp.tv_sec = 0;
+		zlog_format_gen_msg(format, thread);
+	}
+}
+
+static void bench_set_fmt(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	zlog_event_set_fmt(thread->event, "mod_2_sub_3", sizeof("mod_2_sub_3") - 1,
+		__FILE__, sizeof(__FILE__) - 1, __func__, sizeof(__func__) - 1,
+		__LINE__, 40, fmt, args);
+	va_end(args);
+}
+
+static void bench_event_set_fmt(long n)
+{
+	long i;
+	int j;
+
+	for (i = 0; i < n; i++) {
+		j = i & (BENCH_WORDS - 1);
+		bench_set_fmt("user[%s] id[%d]", words[j], numbers[j]);
+	}
+}
+
+static void bench_hashtable_get(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		if (!zc_hashtable_get(table, names[i & (BENCH_NAMES - 1)])) abort();
+	}
+}
+
+static void bench_hashtable_miss(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		if (zc_hashtable_get(table, words[i & (BENCH_WORDS - 1)])) abort();
+	}
+}
+
+static void bench_rule_match_category(long n)
+{
+	long i;
+	zlog_rule_t *a_rule;
+	int nrule = zc_arraylist_len(zlog_env_conf->rules);
+
+	for (i = 0; i < n; i++) {
+		a_rule = zc_arraylist_get(zlog_env_conf->rules, i % nrule);
+		zlog_rule_match_category(a_rule, names[i & (BENCH_NAMES - 1)]);
+	}
+}
+
+static void bench_rule_trie_match(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		fit_rules->len = 0;
+		zlog_rule_trie_match(zlog_env_conf->rule_trie, names[i & (BENCH_NAMES - 1)], fit_rules);
+	}
+}
+
+/* %m and gen_msg read the va_list of the event, which lives only in here */
+static void bench_in_event(const char *fmt, ...)
+{
+	int i;
+	char name[128];
+	char *end;
+	va_list args;
+
+	va_start(args, fmt);
+	zlog_event_set_fmt(thread->event, "mod_2_sub_3", sizeof("mod_2_sub_3") - 1,
+		__FILE__, sizeof(__FILE__) - 1, __func__, sizeof(__func__) - 1,
+		__LINE__, 40, fmt, args);
+
+	for (i = 0; bench_specs[i]; i++) {
+		spec = zlog_spec_new((char *)bench_specs[i], &end);
+		if (!spec) {
+			fprintf(stderr, "zlog_spec_new[%s] fail\n", bench_specs[i]);
+			exit(1);
+		}
+		snprintf(name, sizeof(name), "zlog_spec_write %s", bench_specs[i]);
+		bench_run(name, bench_spec_write);
+		zlog_spec_del(spec);
+	}
+
+	zc_arraylist_foreach(zlog_env_conf->formats, i, format) {
+		snprintf(name, sizeof(name), "zlog_format_gen_msg %.64s", format->name);
+		bench_run(name, bench_format_gen_msg);
+	}
+	va_end(args);
+}
+
+/*******************************************************************************/
+static void bench_prepare(void)
+{
+	int i;
+	int j;
+	size_t len;
+
+	rand_state = seed ? seed : 1;
+	for (i = 0; i < BENCH_WORDS; i++) {
+		len = 1 + bench_rand() % 64;
+		words[i] = malloc(len + 1);
+		if (!words[i]) exit(1);
+		for (j = 0; j < (int)len; j++) words[i][j] = 'a' + bench_rand() % 26;
+		words[i][len] = '\0';
+		word_lens[i] = len;
+		numbers[i] = (int)(bench_rand() % 1000000);
+	}
+	for (i = 0; i < BENCH_NAMES; i++) {
+		names[i] = malloc(32);
+		if (!names[i]) exit(1);
+		snprintf(names[i], 32, "mod_%d_sub_%d",
+			(int)(bench_rand() % 8), (int)(bench_rand() % 16));
+	}
+
+	zlog_env_conf = zlog_conf_new_from_string(bench_conf_string, NULL);
+	if (!zlog_env_conf) {
+		fprintf(stderr, "zlog_conf_new_from_string fail\n");
+		exit(1);
+	}
+	thread = zlog_thread_new(0, 1024, 2 * 1024 * 1024);
+	buf = zlog_buf_new(1024, 2 * 1024 * 1024, "..." FILE_NEWLINE);
+	fit_rules = zc_arraylist_new(NULL);
+	table = zc_hashtable_new(BENCH_NAMES * 2, zc_hashtable_str_hash,
+		zc_hashtable_str_equal, NULL, NULL);
+	if (!thread || !buf || !fit_rules || !table) {
+		fprintf(stderr, "new fail\n");
+		exit(1);
+	}
+	zlog_mdc_put(thread->mdc, "req", "3f2a9c1e-0001");
+	zlog_mdc_put(thread->mdc, "user", "bench");
+	for (i = 0; i < BENCH_NAMES; i++) {
+		if (zc_hashtable_put(table, names[i], names[i])) exit(1);
+	}
+}
+
+static void bench_finish(void)
+{
+	int i;
+
+	zc_hashtable_del(table);
+	zc_arraylist_del(fit_rules);
+	zlog_buf_del(buf);
+	zlog_thread_del(thread);
+	zlog_conf_del(zlog_env_conf);
+	zlog_env_conf = NULL;
+	for (i = 0; i < BENCH_WORDS; i++) free(words[i]);
+	for (i = 0; i < BENCH_NAMES; i++) free(names[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	int op;
+	const char *json_path = NULL;
+	static const char *help =
+		"usage: zlog-microbench [options]\n"
+		"\t-n count,\tcalls in a run (1000000)\n"
+		"\t-r repeat,\truns of each, the fastest is shown (5)\n"
+		"\t-s seed,\tof the inputs (1)\n"
+		"\t-f str,\tonly benches with str in the name\n"
+		"\t-j file,\twrite results as JSON\n"
+		"\t-h,\tshow help message\n"
+		"zlog version: " ZLOG_VERSION "\n";
+
+	while ((op = getopt(argc, argv, "n:r:s:f:j:h")) > 0) {
+		switch (op) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'r':
+			repeat = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 10);
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case 'j':
+			json_path = optarg;
+			break;
+		case 'h':
+			fputs(help, stdout);
+			return 0;
+		default:
+			fputs(help, stderr);
+			return 2;
+		}
+	}
+	if (count <= 0 || repeat <= 0) {
+		fputs(help, stderr);
+		return 2;
+	}
+
+#ifdef __linux__
+	perf_fd = bench_perf_open();
+#endif
+	printf("zlog %s, %ld calls a run, best of %d, seed %llu, instructions %s\n",
+		ZLOG_VERSION, count, repeat, seed,
+		perf_fd >= 0 ? "by perf_event_open" : "not counted");
+
+	if (json_path) {
+		json = fopen(json_path, "w");
+		if (!json) {
+			fprintf(stderr, "fopen[%s] fail, errno[%d]\n", json_path, errno);
+			return 1;
+		}
+		fprintf(json, "{\n\"zlog_microbench\": 1,\n\"version\": \"%s\",\n"
+			"\"count\": %ld,\n\"repeat\": %d,\n\"seed\": %llu,\n\"results\": [\n",
+			ZLOG_VERSION, count, repeat, seed);
+	}
+
+	bench_prepare();
+
+	bench_run("zlog_buf_vprintf", bench_buf_vprintf);
+	bench_run("zlog_buf_adjust_append", bench_buf_adjust_append);
+	bench_run("zlog_event_set_fmt", bench_event_set_fmt);
+	bench_in_event("user[%s] id[%d]", words[0], numbers[0]);
+	bench_run("zc_hashtable_get", bench_hashtable_get);
+	bench_run("zc_hashtable_get miss", bench_hashtable_miss);
+	bench_run("zlog_rule_match_category", bench_rule_match_category);
+	bench_run("zlog_rule_trie_match", bench_rule_trie_match);
+
+	bench_finish();
+	if (json) {
+		fprintf(json, "\n]\n}\n");
+		fclose(json);
+	}
+	if (perf_fd >= 0) close(perf_fd);
+	return 0;
+}
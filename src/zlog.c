@@ -19,7 +19,9 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include "conf.h"
 #include "category_table.h"
@@ -27,20 +29,33 @@
 #include "mdc.h"
 #include "zc_defs.h"
 #include "rule.h"
+#include "async.h"
+#include "reloader.h"
+#include "stats.h"
+#include "trace.h"
 #include "version.h"
 
 /*******************************************************************************/
 extern char *zlog_git_sha1;
 /*******************************************************************************/
+/* Writers (init, reload, fini...) hold zlog_env_lock as wrlock.
+ * Loggers do not touch it, they mark their own zlog_thread_t.epoch
+ * and writers wait in zlog_synchronize() before freeing what was replaced.
+ * A thread takes the rdlock only to be born or to die.
+ */
 static pthread_rwlock_t zlog_env_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t zlog_env_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static zlog_thread_t *zlog_env_threads;
 zlog_conf_t *zlog_env_conf;
 static pthread_key_t zlog_thread_key;
-static zc_hashtable_t *zlog_env_categories;
+static zlog_category_table_t *zlog_env_categories;
 static zc_hashtable_t *zlog_env_records;
 static zlog_category_t *zlog_default_category;
-static size_t zlog_env_reload_conf_count;
 static int zlog_env_is_init = 0;
 static int zlog_env_init_version = 0;
+static zlog_async_t *zlog_env_async;
+static zlog_reloader_t *zlog_env_reloader;
+static zlog_stats_exporter_t *zlog_env_stats_exporter;
 /*******************************************************************************/
 /* inner no need thread-safe */
 static void zlog_fini_inner(void)
@@ -51,7 +66,10 @@ static void zlog_fini_inner(void)
 	 * after one thread call pthread_key_delete
 	 * also key not init will cause a core dump
 	 */
-	
+
+	/* rings still refer to rules, so stop the writer first */
+	if (zlog_env_async) zlog_async_del(zlog_env_async);
+	zlog_env_async = NULL;
 	if (zlog_env_categories) zlog_category_table_del(zlog_env_categories);
 	zlog_env_categories = NULL;
 	zlog_default_category = NULL;
@@ -62,15 +80,171 @@ static void zlog_fini_inner(void)
 	return;
 }
 
-static void zlog_clean_rest_thread(void)
+static int zlog_reload_on_change(void);
+zlog_stats_t *zlog_stats_snapshot(void);
+
+/* start, move or stop watching the conf file, caller holds the wrlock.
+ * a conf from string has no file, so nothing to watch.
+ * zlog goes on working without it, so only tell when fail
+ */
+static void zlog_watch_conf(zlog_conf_t *a_conf)
+{
+	int mode = a_conf->file[0] ? a_conf->reload_check : ZLOG_RELOAD_CHECK_OFF;
+
+	if (!zlog_env_reloader) {
+		if (mode == ZLOG_RELOAD_CHECK_OFF) return;
+		zlog_env_reloader = zlog_reloader_new(zlog_reload_on_change);
+		if (!zlog_env_reloader) {
+			zc_error("zlog_reloader_new fail, conf[%s] will not be reloaded on change", a_conf->file);
+			return;
+		}
+	}
+	if (zlog_reloader_set(zlog_env_reloader, a_conf->file, mode,
+			a_conf->reload_check_period, a_conf->reload_delay)) {
+		zc_error("zlog_reloader_set fail");
+	}
+	return;
+}
+
+/* turn counting on or off, and start, keep or replace the shm exporter,
+ * caller holds the wrlock, and deletes what is returned after unlock
+ */
+static zlog_stats_exporter_t *zlog_apply_stats(zlog_conf_t *a_conf)
+{
+	zlog_stats_exporter_t *old_exporter = NULL;
+
+	zc_atomic_store(&zlog_stats_enabled, a_conf->stats);
+
+	if (zlog_env_stats_exporter) {
+		if (a_conf->stats && STRCMP(zlog_env_stats_exporter->name, ==, a_conf->stats_shm)) {
+			zlog_stats_exporter_set(zlog_env_stats_exporter, a_conf->stats_period);
+			return NULL;
+		}
+		old_exporter = zlog_env_stats_exporter;
+		zlog_env_stats_exporter = NULL;
+	}
+
+	if (a_conf->stats && a_conf->stats_shm[0]) {
+		zlog_env_stats_exporter = zlog_stats_exporter_new(a_conf->stats_shm,
+				a_conf->stats_period, zlog_stats_snapshot);
+		if (!zlog_env_stats_exporter) {
+			zc_error("zlog_stats_exporter_new fail, no stats in shm[%s]", a_conf->stats_shm);
+		}
+	}
+	return old_exporter;
+}
+
+/* a msg dropped by level, counted if the thread has logged before */
+static void zlog_count_filtered(zlog_category_t *a_category, int level)
 {
 	zlog_thread_t *a_thread;
+	zlog_stats_category_counter_t *a_counter;
+
 	a_thread = pthread_getspecific(zlog_thread_key);
 	if (!a_thread) return;
+
+	zlog_stats_add(&a_thread->stats.filtered[level & 0xff], 1);
+	a_counter = zlog_stats_category(&a_thread->stats, &a_category->stats_id);
+	if (a_counter) zlog_stats_add(&a_counter->filtered, 1);
+	return;
+}
+
+/* wait until every thread which may see the old env has left it,
+ * caller holds the wrlock, so no thread is born meanwhile
+ */
+static void zlog_synchronize(void)
+{
+	size_t epoch;
+	zlog_thread_t *a_thread;
+
+	/* pairs with the fence in zlog_read_begin(),
+	 * either the reader sees what we published or we see it reading
+	 */
+	zc_atomic_fence();
+
+	pthread_mutex_lock(&zlog_env_threads_lock);
+	for (a_thread = zlog_env_threads; a_thread; a_thread = a_thread->next) {
+		epoch = zc_atomic_load(&a_thread->epoch);
+		if (!(epoch & 1)) continue;
+		while (zc_atomic_load(&a_thread->epoch) == epoch) sched_yield();
+	}
+	pthread_mutex_unlock(&zlog_env_threads_lock);
+	return;
+}
+
+static void zlog_thread_exit(void *arg)
+{
+	zlog_thread_t *a_thread = arg;
+
+	/* msg left in the ring must be written before it goes */
+	if (a_thread->async_ring) {
+		pthread_rwlock_rdlock(&zlog_env_lock);
+		if (a_thread->async_ring->async) {
+			zlog_async_detach(a_thread->async_ring->async, a_thread);
+		}
+		pthread_rwlock_unlock(&zlog_env_lock);
+	}
+
+	pthread_mutex_lock(&zlog_env_threads_lock);
+	if (a_thread->prev) a_thread->prev->next = a_thread->next;
+	else zlog_env_threads = a_thread->next;
+	if (a_thread->next) a_thread->next->prev = a_thread->prev;
+	pthread_mutex_unlock(&zlog_env_threads_lock);
+
 	zlog_thread_del(a_thread);
 	return;
 }
 
+static void zlog_clean_rest_thread(void)
+{
+	int i;
+	zlog_rule_t *a_rule;
+	zlog_thread_t *a_thread;
+
+	/* zlog_fini() may never be called, other threads' msg go first,
+	 * and then all kept in batches, rings write into them too
+	 */
+	pthread_rwlock_rdlock(&zlog_env_lock);
+	if (zlog_env_async) zlog_async_flush(zlog_env_async);
+	if (zlog_env_conf) {
+		zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+			if (a_rule->batch) zlog_batch_flush(a_rule->batch);
+		}
+	}
+	pthread_rwlock_unlock(&zlog_env_lock);
+
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (!a_thread) return;
+	pthread_setspecific(zlog_thread_key, NULL);
+	zlog_thread_exit(a_thread);
+	return;
+}
+
+/* start the async writer once any rule asks for it,
+ * it keeps running until zlog_fini()
+ */
+static int zlog_start_async(zlog_conf_t * a_conf)
+{
+	int i;
+	int async = 0;
+	zlog_rule_t *a_rule;
+
+	if (zlog_env_async) return 0;
+
+	zc_arraylist_foreach(a_conf->rules, i, a_rule) {
+		if (a_rule->async) async = 1;
+	}
+	if (!async) return 0;
+
+	zlog_env_async = zlog_async_new(a_conf->async_buf_size,
+				a_conf->async_overflow);
+	if (!zlog_env_async) {
+		zc_error("zlog_async_new fail");
+		return -1;
+	}
+	return 0;
+}
+
 static int zlog_init_inner_from_string(const char *config_string)
 {
     int rc = 0;
@@ -78,7 +252,7 @@ static int zlog_init_inner_from_string(const char *config_string)
     /* the 1st time in the whole process do init */
     if (zlog_env_init_version == 0) {
         /* clean up is done by OS when a thread call pthread_exit */
-        rc = pthread_key_create(&zlog_thread_key, (void (*) (void *)) zlog_thread_del);
+        rc = pthread_key_create(&zlog_thread_key, zlog_thread_exit);
         if (rc) {
             zc_error("pthread_key_create fail, rc[%d]", rc);
             goto err;
@@ -95,7 +269,7 @@ static int zlog_init_inner_from_string(const char *config_string)
         zlog_env_init_version++;
     } /* else maybe after zlog_fini() and need not create pthread_key */
 
-    zlog_env_conf = zlog_conf_new_from_string(config_string);
+    zlog_env_conf = zlog_conf_new_from_string(config_string, NULL);
     if (!zlog_env_conf) {
         zc_error("zlog_conf_new[%s] fail", config_string);
         goto err;
@@ -113,6 +287,12 @@ static int zlog_init_inner_from_string(const char *config_string)
         goto err;
     }
 
+    if (zlog_start_async(zlog_env_conf)) {
+        zc_error("zlog_start_async fail");
+        goto err;
+    }
+    zlog_clock_set(zlog_env_conf->clock);
+
     return 0;
 err:
     zlog_fini_inner();
@@ -125,7 +305,7 @@ static int zlog_init_inner(const char *config)
 	/* the 1st time in the whole process do init */
 	if (zlog_env_init_version == 0) {
 		/* clean up is done by OS when a thread call pthread_exit */
-		rc = pthread_key_create(&zlog_thread_key, (void (*) (void *)) zlog_thread_del);
+		rc = pthread_key_create(&zlog_thread_key, zlog_thread_exit);
 		if (rc) {
 			zc_error("pthread_key_create fail, rc[%d]", rc);
 			goto err;
@@ -142,7 +322,7 @@ static int zlog_init_inner(const char *config)
 		zlog_env_init_version++;
 	} /* else maybe after zlog_fini() and need not create pthread_key */
 
-	zlog_env_conf = zlog_conf_new(config);
+	zlog_env_conf = zlog_conf_new(config, NULL);
 	if (!zlog_env_conf) {
 		zc_error("zlog_conf_new[%s] fail", config);
 		goto err;
@@ -160,6 +340,12 @@ static int zlog_init_inner(const char *config)
 		goto err;
 	}
 
+	if (zlog_start_async(zlog_env_conf)) {
+		zc_error("zlog_start_async fail");
+		goto err;
+	}
+	zlog_clock_set(zlog_env_conf->clock);
+
 	return 0;
 err:
 	zlog_fini_inner();
@@ -190,8 +376,11 @@ int zlog_init(const char *config)
 		goto err;
 	}
 
-	zlog_env_is_init = 1;
 	zlog_env_init_version++;
+	zlog_watch_conf(zlog_env_conf);
+	zlog_apply_stats(zlog_env_conf);
+	/* loggers start to read env from now on */
+	zc_atomic_store(&zlog_env_is_init, 1);
 
 	zc_debug("------zlog_init success end------");
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
@@ -233,8 +422,10 @@ int zlog_init_from_string(const char *config_string)
         goto err;
     }
 
-    zlog_env_is_init = 1;
     zlog_env_init_version++;
+    zlog_apply_stats(zlog_env_conf);
+    /* loggers start to read env from now on */
+    zc_atomic_store(&zlog_env_is_init, 1);
 
     zc_debug("------zlog_init success end------");
     rc = pthread_rwlock_unlock(&zlog_env_lock);
@@ -278,14 +469,17 @@ int dzlog_init(const char *config, const char *cname)
 	zlog_default_category = zlog_category_table_fetch_category(
 				zlog_env_categories,
 				cname,
-				zlog_env_conf->rules);
+				zlog_env_conf->rule_trie);
 	if (!zlog_default_category) {
 		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
 	}
 
-	zlog_env_is_init = 1;
 	zlog_env_init_version++;
+	zlog_watch_conf(zlog_env_conf);
+	zlog_apply_stats(zlog_env_conf);
+	/* loggers start to read env from now on */
+	zc_atomic_store(&zlog_env_is_init, 1);
 
 	zc_debug("------dzlog_init success end------");
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
@@ -304,15 +498,30 @@ err:
 	return -1;
 }
 /*******************************************************************************/
+/* a new init version makes every thread rebuild its bufs and attach to
+ * async at its next log, only worth it when one of them changes
+ */
+static int zlog_need_rebuild(zlog_conf_t * old_conf, zlog_conf_t * new_conf,
+		zlog_async_t * old_async)
+{
+	return new_conf->buf_size_min != old_conf->buf_size_min
+		|| new_conf->buf_size_max != old_conf->buf_size_max
+		|| zlog_env_async != old_async;
+}
+/*******************************************************************************/
 int zlog_reload(const char *config)
 {
 	int rc = 0;
+	zlog_stats_exporter_t *old_exporter;
 	int i = 0;
 	zlog_conf_t *new_conf = NULL;
+	zlog_conf_t *old_conf;
 	zlog_rule_t *a_rule;
+	zlog_async_t *old_async = zlog_env_async;
 	int c_up = 0;
 
 	zc_debug("------zlog_reload start------");
+	ZLOG_TRACE1(reload_entry, config ? config : "");
 	rc = pthread_rwlock_wrlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_wrlock fail, rc[%d]", rc);
@@ -327,21 +536,7 @@ int zlog_reload(const char *config)
 	/* use last conf file */
 	if (config == NULL) config = zlog_env_conf->file;
 
-	/* reach reload period */
-	if (config == (char*)-1) {
-		/* test again, avoid other threads already reloaded */
-		if (zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period) {
-			config = zlog_env_conf->file;
-		} else {
-			/* do nothing, already done */
-			goto quit;
-		}
-	}
-
-	/* reset counter, whether automaticlly or mannually */
-	zlog_env_reload_conf_count = 0;
-
-	new_conf = zlog_conf_new(config);
+	new_conf = zlog_conf_new(config, zlog_env_conf);
 	if (!new_conf) {
 		zc_error("zlog_conf_new fail");
 		goto err;
@@ -351,37 +546,71 @@ int zlog_reload(const char *config)
 		zlog_rule_set_record(a_rule, zlog_env_records);
 	}
 
-	if (zlog_category_table_update_rules(zlog_env_categories, new_conf->rules)) {
-		c_up = 0;
+	if (zlog_start_async(new_conf)) {
+		zc_error("zlog_start_async fail");
+		goto err;
+	}
+
+	/* some categories may see new rules from now on */
+	c_up = 1;
+	if (zlog_category_table_update_rules(zlog_env_categories, new_conf->rule_trie)) {
 		zc_error("zlog_category_table_update fail");
 		goto err;
-	} else {
-		c_up = 1;
 	}
 
-	zlog_env_init_version++;
+	old_conf = zlog_env_conf;
+	zc_atomic_store(&zlog_env_conf, new_conf);
+	zlog_clock_set(new_conf->clock);
+	if (zlog_need_rebuild(old_conf, new_conf, old_async)) {
+		zc_atomic_store(&zlog_env_init_version, zlog_env_init_version + 1);
+	}
+
+	/* nobody reads old conf and old fit rules after this */
+	zlog_synchronize();
 
-	if (c_up) zlog_category_table_commit_rules(zlog_env_categories);
-	zlog_conf_del(zlog_env_conf);
-	zlog_env_conf = new_conf;
+	zlog_category_table_commit_rules(zlog_env_categories);
+	if (zlog_env_async) {
+		/* msg of old rules may still wait in rings */
+		zlog_async_flush(zlog_env_async);
+		if (zlog_async_update(zlog_env_async, new_conf->async_buf_size,
+				new_conf->async_overflow)) {
+			zc_error("zlog_async_update fail");
+		}
+	}
+	/* rotations asked by old rules may still wait, their file tables go next */
+	zlog_rotater_flush(new_conf->rotater);
+	zlog_conf_del(old_conf);
+	zlog_watch_conf(new_conf);
+	old_exporter = zlog_apply_stats(new_conf);
 	zc_debug("------zlog_reload success, total init verison[%d] ------", zlog_env_init_version);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	/* its thread may wait for the lock in zlog_stats_snapshot() */
+	if (old_exporter) zlog_stats_exporter_del(old_exporter);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
 		return -1;
 	}
+	ZLOG_TRACE1(reload_return, 0);
 	return 0;
 err:
 	/* fail, roll back everything */
 	zc_warn("zlog_reload fail, use old conf file, still working");
+	if (c_up) {
+		zlog_category_table_rollback_rules(zlog_env_categories);
+		/* new rules may have been used already */
+		zlog_synchronize();
+		zlog_category_table_commit_rules(zlog_env_categories);
+		if (zlog_env_async) zlog_async_flush(zlog_env_async);
+		zlog_rotater_flush(zlog_env_conf->rotater);
+	}
 	if (new_conf) zlog_conf_del(new_conf);
-	if (c_up) zlog_category_table_rollback_rules(zlog_env_categories);
 	zc_error("------zlog_reload fail, total init version[%d] ------", zlog_env_init_version);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
 		return -1;
 	}
+	ZLOG_TRACE1(reload_return, -1);
 	return -1;
 quit:
 	zc_debug("------zlog_reload do nothing------");
@@ -393,12 +622,21 @@ quit:
 	return 0;
 }
 /*******************************************************************************/
+/* reload by the watcher thread, when the conf file changed */
+static int zlog_reload_on_change(void)
+{
+	return zlog_reload(NULL);
+}
+/*******************************************************************************/
 int zlog_reload_from_string(const char *conf_string)
 {
     int rc = 0;
+    zlog_stats_exporter_t *old_exporter;
     int i = 0;
     zlog_conf_t *new_conf = NULL;
+    zlog_conf_t *old_conf;
     zlog_rule_t *a_rule;
+    zlog_async_t *old_async = zlog_env_async;
     int c_up = 0;
 
     zc_debug("------zlog_reload start------");
@@ -415,7 +653,7 @@ int zlog_reload_from_string(const char *conf_string)
 
     if (conf_string == NULL) goto quit;
 
-    new_conf = zlog_conf_new_from_string(conf_string);
+    new_conf = zlog_conf_new_from_string(conf_string, zlog_env_conf);
     if (!new_conf) {
         zc_error("zlog_conf_new fail");
         goto err;
@@ -425,21 +663,46 @@ int zlog_reload_from_string(const char *conf_string)
         zlog_rule_set_record(a_rule, zlog_env_records);
     }
 
-    if (zlog_category_table_update_rules(zlog_env_categories, new_conf->rules)) {
-        c_up = 0;
+    if (zlog_start_async(new_conf)) {
+        zc_error("zlog_start_async fail");
+        goto err;
+    }
+
+    /* some categories may see new rules from now on */
+    c_up = 1;
+    if (zlog_category_table_update_rules(zlog_env_categories, new_conf->rule_trie)) {
         zc_error("zlog_category_table_update fail");
         goto err;
-    } else {
-        c_up = 1;
     }
 
-    zlog_env_init_version++;
+    old_conf = zlog_env_conf;
+    zc_atomic_store(&zlog_env_conf, new_conf);
+    zlog_clock_set(new_conf->clock);
+    if (zlog_need_rebuild(old_conf, new_conf, old_async)) {
+        zc_atomic_store(&zlog_env_init_version, zlog_env_init_version + 1);
+    }
+
+    /* nobody reads old conf and old fit rules after this */
+    zlog_synchronize();
 
-    if (c_up) zlog_category_table_commit_rules(zlog_env_categories);
-    zlog_conf_del(zlog_env_conf);
-    zlog_env_conf = new_conf;
+    zlog_category_table_commit_rules(zlog_env_categories);
+    if (zlog_env_async) {
+        /* msg of old rules may still wait in rings */
+        zlog_async_flush(zlog_env_async);
+        if (zlog_async_update(zlog_env_async, new_conf->async_buf_size,
+                new_conf->async_overflow)) {
+            zc_error("zlog_async_update fail");
+        }
+    }
+    /* rotations asked by old rules may still wait, their file tables go next */
+    zlog_rotater_flush(new_conf->rotater);
+    zlog_conf_del(old_conf);
+    zlog_watch_conf(new_conf);
+    old_exporter = zlog_apply_stats(new_conf);
     zc_debug("------zlog_reload success, total init verison[%d] ------", zlog_env_init_version);
     rc = pthread_rwlock_unlock(&zlog_env_lock);
+    /* its thread may wait for the lock in zlog_stats_snapshot() */
+    if (old_exporter) zlog_stats_exporter_del(old_exporter);
     if (rc) {
         zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
         return -1;
@@ -448,8 +711,15 @@ int zlog_reload_from_string(const char *conf_string)
 err:
     /* fail, roll back everything */
     zc_warn("zlog_reload fail, use old conf file, still working");
+    if (c_up) {
+        zlog_category_table_rollback_rules(zlog_env_categories);
+        /* new rules may have been used already */
+        zlog_synchronize();
+        zlog_category_table_commit_rules(zlog_env_categories);
+        if (zlog_env_async) zlog_async_flush(zlog_env_async);
+        zlog_rotater_flush(zlog_env_conf->rotater);
+    }
     if (new_conf) zlog_conf_del(new_conf);
-    if (c_up) zlog_category_table_rollback_rules(zlog_env_categories);
     zc_error("------zlog_reload fail, total init version[%d] ------", zlog_env_init_version);
     rc = pthread_rwlock_unlock(&zlog_env_lock);
     if (rc) {
@@ -470,6 +740,8 @@ quit:
 void zlog_fini(void)
 {
 	int rc = 0;
+	zlog_reloader_t *a_reloader = NULL;
+	zlog_stats_exporter_t *a_exporter = NULL;
 
 	zc_debug("------zlog_fini start------");
 	rc = pthread_rwlock_wrlock(&zlog_env_lock);
@@ -483,8 +755,16 @@ void zlog_fini(void)
 		goto exit;
 	}
 
+	/* wait for loggers to leave before pulling env down */
+	zc_atomic_store(&zlog_env_is_init, 0);
+	zlog_synchronize();
 	zlog_fini_inner();
-	zlog_env_is_init = 0;
+	zlog_mdc_keys_fini();
+	a_reloader = zlog_env_reloader;
+	zlog_env_reloader = NULL;
+	a_exporter = zlog_env_stats_exporter;
+	zlog_env_stats_exporter = NULL;
+	zc_atomic_store(&zlog_stats_enabled, 0);
 
 exit:
 	zc_debug("------zlog_fini end------");
@@ -493,54 +773,12 @@ exit:
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
 		return;
 	}
+	/* its thread may wait for the lock in zlog_reload(), and then find nothing */
+	if (a_reloader) zlog_reloader_del(a_reloader);
+	if (a_exporter) zlog_stats_exporter_del(a_exporter);
 	return;
 }
 /*******************************************************************************/
-zlog_category_t *zlog_get_category(const char *cname)
-{
-	int rc = 0;
-	zlog_category_t *a_category = NULL;
-
-	zc_assert(cname, NULL);
-	zc_debug("------zlog_get_category[%s] start------", cname);
-	rc = pthread_rwlock_wrlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_wrlock fail, rc[%d]", rc);
-		return NULL;
-	}
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		a_category = NULL;
-		goto err;
-	}
-
-	a_category = zlog_category_table_fetch_category(
-				zlog_env_categories,
-				cname,
-				zlog_env_conf->rules);
-	if (!a_category) {
-		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
-		goto err;
-	}
-
-	zc_debug("------zlog_get_category[%s] success, end------ ", cname);
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return NULL;
-	}
-	return a_category;
-err:
-	zc_error("------zlog_get_category[%s] fail, end------ ", cname);
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return NULL;
-	}
-	return NULL;
-}
-
 int dzlog_set_category(const char *cname)
 {
 	int rc = 0;
@@ -561,7 +799,7 @@ int dzlog_set_category(const char *cname)
 	zlog_default_category = zlog_category_table_fetch_category(
 				zlog_env_categories,
 				cname,
-				zlog_env_conf->rules);
+				zlog_env_conf->rule_trie);
 	if (!zlog_default_category) {
 		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
@@ -584,58 +822,25 @@ err:
 	return -1;
 }
 /*******************************************************************************/
-#define zlog_fetch_thread(a_thread, fail_goto) do {  \
-	int rd = 0;  \
-	a_thread = pthread_getspecific(zlog_thread_key);  \
-	if (!a_thread) {  \
-		a_thread = zlog_thread_new(zlog_env_init_version,  \
-				zlog_env_conf->buf_size_min, zlog_env_conf->buf_size_max, \
-				zlog_env_conf->time_cache_count); \
-		if (!a_thread) {  \
-			zc_error("zlog_thread_new fail");  \
-			goto fail_goto;  \
-		}  \
-  \
-		rd = pthread_setspecific(zlog_thread_key, a_thread);  \
-		if (rd) {  \
-			zlog_thread_del(a_thread);  \
-			zc_error("pthread_setspecific fail, rd[%d]", rd);  \
-			goto fail_goto;  \
-		}  \
-	}  \
-  \
-	if (a_thread->init_version != zlog_env_init_version) {  \
-		/* as mdc is still here, so can not easily del and new */ \
-		rd = zlog_thread_rebuild_msg_buf(a_thread, \
-				zlog_env_conf->buf_size_min, \
-				zlog_env_conf->buf_size_max);  \
-		if (rd) {  \
-			zc_error("zlog_thread_resize_msg_buf fail, rd[%d]", rd);  \
-			goto fail_goto;  \
-		}  \
-  \
-		rd = zlog_thread_rebuild_event(a_thread, zlog_env_conf->time_cache_count);  \
-		if (rd) {  \
-			zc_error("zlog_thread_resize_msg_buf fail, rd[%d]", rd);  \
-			goto fail_goto;  \
-		}  \
-		a_thread->init_version = zlog_env_init_version;  \
+/* no ring just means the thread writes by itself */
+#define zlog_attach_async(a_thread) do {  \
+	if (zlog_env_async  \
+		&& !(a_thread->async_ring && a_thread->async_ring->async)  \
+		&& zlog_async_attach(zlog_env_async, a_thread)) {  \
+		zc_error("zlog_async_attach fail, write in place");  \
 	}  \
 } while (0)
 
-/*******************************************************************************/
-int zlog_put_mdc(const char *key, const char *value)
+/* the 1st log of a thread, rdlock keeps writers out while it is born */
+static zlog_thread_t *zlog_create_thread(void)
 {
 	int rc = 0;
 	zlog_thread_t *a_thread;
 
-	zc_assert(key, -1);
-	zc_assert(value, -1);
-
 	rc = pthread_rwlock_rdlock(&zlog_env_lock);
 	if (rc) {
-		zc_error("pthread_rwlock_wrlock fail, rc[%d]", rc);
-		return -1;
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return NULL;
 	}
 
 	if (!zlog_env_is_init) {
@@ -643,66 +848,138 @@ int zlog_put_mdc(const char *key, const char *value)
 		goto err;
 	}
 
-	zlog_fetch_thread(a_thread, err);
-
-	if (zlog_mdc_put(a_thread->mdc, key, value)) {
-		zc_error("zlog_mdc_put fail, key[%s], value[%s]", key, value);
+	a_thread = zlog_thread_new(zlog_env_init_version,
+			zlog_env_conf->buf_size_min, zlog_env_conf->buf_size_max);
+	if (!a_thread) {
+		zc_error("zlog_thread_new fail");
 		goto err;
 	}
 
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	rc = pthread_setspecific(zlog_thread_key, a_thread);
 	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return -1;
+		zlog_thread_del(a_thread);
+		zc_error("pthread_setspecific fail, rc[%d]", rc);
+		goto err;
 	}
-	return 0;
+	zlog_attach_async(a_thread);
+
+	pthread_mutex_lock(&zlog_env_threads_lock);
+	a_thread->next = zlog_env_threads;
+	if (zlog_env_threads) zlog_env_threads->prev = a_thread;
+	zlog_env_threads = a_thread;
+	pthread_mutex_unlock(&zlog_env_threads_lock);
+
+	pthread_rwlock_unlock(&zlog_env_lock);
+	return a_thread;
 err:
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return -1;
-	}
-	return -1;
+	pthread_rwlock_unlock(&zlog_env_lock);
+	return NULL;
 }
 
-char *zlog_get_mdc(char *key)
+#define zlog_read_end(a_thread) do { \
+	if (--(a_thread)->depth == 0) \
+		zc_atomic_store(&(a_thread)->epoch, (a_thread)->epoch + 1); \
+} while (0)
+
+/* pin env for the calling thread until zlog_read_end(),
+ * only the thread's own cache line is written
+ */
+static zlog_thread_t *zlog_read_begin(void)
 {
 	int rc = 0;
-	char *value = NULL;
 	zlog_thread_t *a_thread;
 
-	zc_assert(key, NULL);
-
-	rc = pthread_rwlock_rdlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+	/* pthread key does not exist before the 1st init */
+	if (!zc_atomic_load(&zlog_env_is_init)) {
+		zc_error("never call zlog_init() or dzlog_init() before");
 		return NULL;
 	}
 
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (!a_thread) {
+		a_thread = zlog_create_thread();
+		if (!a_thread) return NULL;
+	}
+
+	/* a callback logging inside a read, env is pinned by the outer one */
+	if (a_thread->depth++) return a_thread;
+
+	/* pairs with the fence in zlog_synchronize() */
+	zc_atomic_store(&a_thread->epoch, a_thread->epoch + 1);
+	zc_atomic_fence();
+
+	/* zlog_fini() may get in before the epoch is seen */
 	if (!zlog_env_is_init) {
 		zc_error("never call zlog_init() or dzlog_init() before");
 		goto err;
 	}
 
-	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) {
-		zc_error("thread not found, maybe not use zlog_put_mdc before");
+	if (a_thread->init_version != zc_atomic_load(&zlog_env_init_version)) {
+		/* as mdc is still here, so can not easily del and new */
+		rc = zlog_thread_rebuild_msg_buf(a_thread,
+				zlog_env_conf->buf_size_min,
+				zlog_env_conf->buf_size_max);
+		if (rc) {
+			zc_error("zlog_thread_resize_msg_buf fail, rc[%d]", rc);
+			goto err;
+		}
+		zlog_attach_async(a_thread);
+		a_thread->init_version = zlog_env_init_version;
+	}
+	return a_thread;
+err:
+	zlog_read_end(a_thread);
+	return NULL;
+}
+
+/*******************************************************************************/
+zlog_category_t *zlog_get_category(const char *cname)
+{
+	int rc = 0;
+	zlog_category_t *a_category = NULL;
+	zlog_thread_t *a_thread;
+
+	zc_assert(cname, NULL);
+	zc_debug("------zlog_get_category[%s] start------", cname);
+
+	/* most calls find one made before, pinned by epoch, no lock */
+	a_thread = zlog_read_begin();
+	if (a_thread) {
+		a_category = zlog_category_table_get(zlog_env_categories, cname);
+		zlog_read_end(a_thread);
+		if (a_category) return a_category;
+	}
+
+	rc = pthread_rwlock_wrlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_wrlock fail, rc[%d]", rc);
+		return NULL;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		a_category = NULL;
 		goto err;
 	}
 
-	value = zlog_mdc_get(a_thread->mdc, key);
-	if (!value) {
-		zc_error("key[%s] not found in mdc", key);
+	a_category = zlog_category_table_fetch_category(
+				zlog_env_categories,
+				cname,
+				zlog_env_conf->rule_trie);
+	if (!a_category) {
+		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
 	}
 
+	zc_debug("------zlog_get_category[%s] success, end------ ", cname);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
 		return NULL;
 	}
-	return value;
+	return a_category;
 err:
+	zc_error("------zlog_get_category[%s] fail, end------ ", cname);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
@@ -711,71 +988,77 @@ err:
 	return NULL;
 }
 
-void zlog_remove_mdc(char *key)
+/*******************************************************************************/
+int zlog_put_mdc(const char *key, const char *value)
 {
 	int rc = 0;
 	zlog_thread_t *a_thread;
 
-	zc_assert(key, );
+	zc_assert(key, -1);
+	zc_assert(value, -1);
 
-	rc = pthread_rwlock_rdlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
-		return;
-	}
+	a_thread = zlog_read_begin();
+	if (!a_thread) return -1;
 
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (zlog_mdc_put(a_thread->mdc, key, value)) {
+		zc_error("zlog_mdc_put fail, key[%s], value[%s]", key, value);
+		rc = -1;
 	}
 
-	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) {
-		zc_error("thread not found, maybe not use zlog_put_mdc before");
-		goto exit;
-	}
+	zlog_read_end(a_thread);
+	return rc;
+}
 
-	zlog_mdc_remove(a_thread->mdc, key);
+/* the values belong to the calling thread, but keys are shared and go at fini */
+char *zlog_get_mdc(char *key)
+{
+	char *value = NULL;
+	zlog_thread_t *a_thread;
 
-exit:
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return;
+	zc_assert(key, NULL);
+
+	a_thread = zlog_read_begin();
+	if (!a_thread) return NULL;
+
+	value = zlog_mdc_get(a_thread->mdc, key);
+	zlog_read_end(a_thread);
+	if (!value) {
+		zc_error("key[%s] not found in mdc", key);
+		return NULL;
 	}
+	return value;
+}
+
+void zlog_remove_mdc(char *key)
+{
+	zlog_thread_t *a_thread;
+
+	zc_assert(key, );
+
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+
+	zlog_mdc_remove(a_thread->mdc, key);
+	zlog_read_end(a_thread);
 	return;
 }
 
 void zlog_clean_mdc(void)
 {
-	int rc = 0;
 	zlog_thread_t *a_thread;
 
-	rc = pthread_rwlock_rdlock(&zlog_env_lock);
-	if (rc) {;
-		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
-		return;
-	}
-
-	if (!zlog_env_is_init) {
+	if (!zc_atomic_load(&zlog_env_is_init)) {
 		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+		return;
 	}
 
 	a_thread = pthread_getspecific(zlog_thread_key);
 	if (!a_thread) {
 		zc_error("thread not found, maybe not use zlog_put_mdc before");
-		goto exit;
+		return;
 	}
 
 	zlog_mdc_clean(a_thread->mdc);
-
-exit:
-	rc = pthread_rwlock_unlock(&zlog_env_lock);
-	if (rc) {
-		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
-		return;
-	}
 	return;
 }
 
@@ -799,7 +1082,7 @@ void vzlog(zlog_category_t * category,
 {
 	zlog_thread_t *a_thread;
 
-	/* The bitmap determination here is not under the protection of rdlock.
+	/* The bitmap determination here is not under the protection of epoch.
 	 * It may be changed by other CPU by zlog_reload() halfway.
 	 *
 	 * Old or strange value may be read here,
@@ -807,18 +1090,17 @@ void vzlog(zlog_category_t * category,
 	 * And will be the right value after zlog_reload()
 	 *
 	 * For speed up, if one log will not be output,
-	 * There is no need to aquire rdlock.
+	 * There is no need to pin env.
 	 */
-	if (zlog_category_needless_level(category, level)) return;
-
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (zlog_category_needless_level(category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(category, level);
+		return;
 	}
 
-	zlog_fetch_thread(a_thread, exit);
+	ZLOG_TRACE2(log_entry, category->name, level);
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+	ZLOG_TRACE0(log_pinned);
 
 	zlog_event_set_fmt(a_thread->event,
 		category->name, category->name_len,
@@ -830,21 +1112,9 @@ void vzlog(zlog_category_t * category,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, category->name, level);
 	return;
 }
 
@@ -856,16 +1126,15 @@ void hzlog(zlog_category_t *category,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(category, level)) return;
-
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (zlog_category_needless_level(category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(category, level);
+		return;
 	}
 
-	zlog_fetch_thread(a_thread, exit);
+	ZLOG_TRACE2(log_entry, category->name, level);
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+	ZLOG_TRACE0(log_pinned);
 
 	zlog_event_set_hex(a_thread->event,
 		category->name, category->name_len,
@@ -877,21 +1146,9 @@ void hzlog(zlog_category_t *category,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, category->name, level);
 	return;
 }
 
@@ -904,24 +1161,23 @@ void vdzlog(const char *file, size_t filelen,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(zlog_default_category, level)) return;
-
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (zlog_category_needless_level(zlog_default_category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(zlog_default_category, level);
+		return;
 	}
 
-	/* that's the differnce, must judge default_category in lock */
+	ZLOG_TRACE2(log_entry, zlog_default_category ? zlog_default_category->name : "", level);
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+	ZLOG_TRACE0(log_pinned);
+
+	/* that's the differnce, must judge default_category after pin */
 	if (!zlog_default_category) {
 		zc_error("zlog_default_category is null,"
 			"dzlog_init() or dzlog_set_cateogry() is not called above");
 		goto exit;
 	}
 
-	zlog_fetch_thread(a_thread, exit);
-
 	zlog_event_set_fmt(a_thread->event,
 		zlog_default_category->name, zlog_default_category->name_len,
 		file, filelen, func, funclen, line, level,
@@ -932,21 +1188,9 @@ void vdzlog(const char *file, size_t filelen,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, zlog_default_category ? zlog_default_category->name : "", level);
 	return;
 }
 
@@ -957,24 +1201,23 @@ void hdzlog(const char *file, size_t filelen,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(zlog_default_category, level)) return;
-
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (zlog_category_needless_level(zlog_default_category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(zlog_default_category, level);
+		return;
 	}
 
-	/* that's the differnce, must judge default_category in lock */
+	ZLOG_TRACE2(log_entry, zlog_default_category ? zlog_default_category->name : "", level);
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+	ZLOG_TRACE0(log_pinned);
+
+	/* that's the differnce, must judge default_category after pin */
 	if (!zlog_default_category) {
 		zc_error("zlog_default_category is null,"
 			"dzlog_init() or dzlog_set_cateogry() is not called above");
 		goto exit;
 	}
 
-	zlog_fetch_thread(a_thread, exit);
-
 	zlog_event_set_hex(a_thread->event,
 		zlog_default_category->name, zlog_default_category->name_len,
 		file, filelen, func, funclen, line, level,
@@ -985,21 +1228,9 @@ void hdzlog(const char *file, size_t filelen,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, zlog_default_category ? zlog_default_category->name : "", level);
 	return;
 }
 
@@ -1012,16 +1243,15 @@ void zlog(zlog_category_t * category,
 	zlog_thread_t *a_thread;
 	va_list args;
 
-	if (category && zlog_category_needless_level(category, level)) return;
-
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
+	if (category && zlog_category_needless_level(category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(category, level);
+		return;
 	}
 
-	zlog_fetch_thread(a_thread, exit);
+	ZLOG_TRACE2(log_entry, category->name, level);
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
+	ZLOG_TRACE0(log_pinned);
 
 	va_start(args, format);
 	zlog_event_set_fmt(a_thread->event, category->name, category->name_len,
@@ -1034,21 +1264,9 @@ void zlog(zlog_category_t * category,
 	}
 	va_end(args);
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, category->name, level);
 	return;
 }
 
@@ -1060,23 +1278,23 @@ void dzlog(const char *file, size_t filelen, const char *func, size_t funclen, l
 	va_list args;
 
 
-	pthread_rwlock_rdlock(&zlog_env_lock);
-
-	if (!zlog_env_is_init) {
-		zc_error("never call zlog_init() or dzlog_init() before");
-		goto exit;
-	}
+	a_thread = zlog_read_begin();
+	if (!a_thread) return;
 
-	/* that's the differnce, must judge default_category in lock */
+	/* that's the differnce, must judge default_category after pin */
 	if (!zlog_default_category) {
 		zc_error("zlog_default_category is null,"
 			"dzlog_init() or dzlog_set_cateogry() is not called above");
 		goto exit;
 	}
 
-	if (zlog_category_needless_level(zlog_default_category, level)) goto exit;
-
-	zlog_fetch_thread(a_thread, exit);
+	if (zlog_category_needless_level(zlog_default_category, level)) {
+		if (zlog_stats_enabled) zlog_count_filtered(zlog_default_category, level);
+		goto exit;
+	}
+	/* pinned already to see the default category */
+	ZLOG_TRACE2(log_entry, zlog_default_category->name, level);
+	ZLOG_TRACE0(log_pinned);
 
 	va_start(args, format);
 	zlog_event_set_fmt(a_thread->event,
@@ -1091,21 +1309,9 @@ void dzlog(const char *file, size_t filelen, const char *func, size_t funclen, l
 	}
 	va_end(args);
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
-		goto reload;
-	}
-
 exit:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	return;
-reload:
-	pthread_rwlock_unlock(&zlog_env_lock);
-	/* will be wrlock, so after unlock */
-	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
-	}
+	zlog_read_end(a_thread);
+	ZLOG_TRACE2(log_return, zlog_default_category ? zlog_default_category->name : "", level);
 	return;
 }
 
@@ -1122,6 +1328,9 @@ void zlog_profile(void)
 	zc_warn("is init:[%d]", zlog_env_is_init);
 	zc_warn("init version:[%d]", zlog_env_init_version);
 	zlog_conf_profile(zlog_env_conf, ZC_WARN);
+	if (zlog_env_async) zlog_async_profile(zlog_env_async, ZC_WARN);
+	if (zlog_env_reloader) zlog_reloader_profile(zlog_env_reloader, ZC_WARN);
+	if (zlog_env_stats_exporter) zlog_stats_exporter_profile(zlog_env_stats_exporter, ZC_WARN);
 	zlog_record_table_profile(zlog_env_records, ZC_WARN);
 	zlog_category_table_profile(zlog_env_categories, ZC_WARN);
 	if (zlog_default_category) {
@@ -1137,6 +1346,89 @@ void zlog_profile(void)
 	return;
 }
 /*******************************************************************************/
+/* sum counters of all threads up, for the current categories and rules */
+zlog_stats_t *zlog_stats_snapshot(void)
+{
+	int rc = 0;
+	int i;
+	size_t j;
+	size_t size;
+	zlog_stats_t *a_stats = NULL;
+	zlog_stats_counter_t sum;
+	zlog_stats_category_t *a_stats_category;
+	zlog_stats_rule_t *a_stats_rule;
+	zlog_category_t *a_category;
+	zlog_rule_t *a_rule;
+	zlog_thread_t *a_thread;
+
+	rc = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return NULL;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		goto exit;
+	}
+
+	size = sizeof(zlog_stats_t)
+		+ sizeof(zlog_stats_category_t) * zlog_env_categories->count
+		+ sizeof(zlog_stats_rule_t) * zc_arraylist_len(zlog_env_conf->rules);
+	a_stats = calloc(1, size);
+	if (!a_stats) {
+		zc_error("calloc fail, errno[%d]", errno);
+		goto exit;
+	}
+	a_stats->size = size;
+
+	memset(&sum, 0x00, sizeof(sum));
+	zlog_stats_sum_begin(&sum);
+	pthread_mutex_lock(&zlog_env_threads_lock);
+	for (a_thread = zlog_env_threads; a_thread; a_thread = a_thread->next) {
+		zlog_stats_sum(&sum, &a_thread->stats);
+		a_stats->nthreads++;
+	}
+	pthread_mutex_unlock(&zlog_env_threads_lock);
+	if (zlog_env_async) zlog_stats_sum(&sum, &zlog_env_async->writer->stats);
+	zlog_stats_sum_end();
+
+	memcpy(a_stats->emitted, sum.emitted, sizeof(a_stats->emitted));
+	memcpy(a_stats->filtered, sum.filtered, sizeof(a_stats->filtered));
+	a_stats->truncations = sum.truncations;
+	a_stats->write_errors = sum.write_errors;
+	a_stats->rotate_requests = sum.rotate_requests;
+	a_stats->output_ns = sum.output_ns;
+
+	a_stats->ncategories = zlog_env_categories->count;
+	a_stats_category = zlog_stats_categories(a_stats);
+	for (j = 0; j <= zlog_env_categories->slots->mask; j++) {
+		a_category = zlog_env_categories->slots->slot[j].category;
+		if (!a_category) continue;
+		snprintf(a_stats_category->name, sizeof(a_stats_category->name), "%.*s",
+			(int)sizeof(a_stats_category->name) - 1, a_category->name);
+		zlog_stats_sum_category(&sum, &a_category->stats_id, a_stats_category);
+		a_stats_category++;
+	}
+
+	a_stats->nrules = zc_arraylist_len(zlog_env_conf->rules);
+	a_stats_rule = zlog_stats_rules(a_stats);
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		snprintf(a_stats_rule->name, sizeof(a_stats_rule->name), "%.*s",
+			(int)sizeof(a_stats_rule->name) - 1, a_rule->line);
+		zlog_stats_sum_rule(&sum, &a_rule->stats_id, a_stats_rule);
+		a_stats_rule++;
+	}
+	zlog_stats_sum_fini(&sum);
+
+exit:
+	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
+	}
+	return a_stats;
+}
+/*******************************************************************************/
 int zlog_set_record(const char *rname, zlog_record_fn record_output)
 {
 	int rc = 0;
@@ -23,6 +23,8 @@ extern "C" {
 #include <stdarg.h> /* for va_list */
 #include <stdio.h> /* for size_t */
 
+#include "zlog_stats.h"
+
 # if defined __GNUC__
 #   define ZLOG_CHECK_PRINTF(m,n) __attribute__((format(printf,m,n)))
 # else 
@@ -39,9 +41,16 @@ void zlog_fini(void);
 
 void zlog_profile(void);
 
+/* counts of all threads by now, NULL if fail, free() it after use */
+zlog_stats_t *zlog_stats_snapshot(void);
+
 zlog_category_t *zlog_get_category(const char *cname);
 int zlog_level_enabled(zlog_category_t *category, const int level);
 
+/* at most 1024 different keys in the process, counting the %M(key) of
+ * conf, a put of one more fails. zlog_fini() forgets the keys, and with
+ * them what every thread has put.
+ */
 int zlog_put_mdc(const char *key, const char *value);
 char *zlog_get_mdc(const char *key);
 void zlog_remove_mdc(const char *key);
@@ -0,0 +1,86 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file zlog_stats.h
+ * @brief what zlog_stats_snapshot() returns and "stats shm" holds
+ *
+ * A zlog_stats_t is followed by ncategories zlog_stats_category_t
+ * and then nrules zlog_stats_rule_t, size counts them all.
+ * In the shm segment a zlog_stats_shm_t goes first, a reader copies
+ * the stats while seq is even and unchanged.
+ */
+
+#ifndef __zlog_stats_h
+#define __zlog_stats_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* for size_t */
+
+#define ZLOG_STATS_LEVELS 256
+/* latency[i] counts writes took [2^i, 2^(i+1)) ns, latency[0] also less */
+#define ZLOG_STATS_LATENCY_BUCKETS 32
+#define ZLOG_STATS_NAME_LEN 128
+
+typedef struct zlog_stats_category_s {
+	char name[ZLOG_STATS_NAME_LEN];
+	unsigned long long msgs;       /* passed the level, went to rules */
+	unsigned long long filtered;   /* dropped by the level */
+	unsigned long long output_ns;  /* spent in formatting and writing */
+} zlog_stats_category_t;
+
+typedef struct zlog_stats_rule_s {
+	char name[ZLOG_STATS_NAME_LEN]; /* the rule line in conf */
+	unsigned long long writes;
+	unsigned long long bytes;
+	unsigned long long errors;
+	unsigned long long rotate_requests; /* handed to the rotater, done later */
+	unsigned long long latency[ZLOG_STATS_LATENCY_BUCKETS];
+} zlog_stats_rule_t;
+
+typedef struct zlog_stats_s {
+	size_t size;
+	int nthreads;
+	int ncategories;
+	int nrules;
+	/* of all threads ever logged, also gone categories and rules */
+	unsigned long long emitted[ZLOG_STATS_LEVELS];
+	unsigned long long filtered[ZLOG_STATS_LEVELS];
+	unsigned long long truncations;
+	unsigned long long write_errors;
+	unsigned long long rotate_requests; /* handed to the rotater, done later */
+	unsigned long long output_ns;
+} zlog_stats_t;
+
+#define zlog_stats_categories(s) ((zlog_stats_category_t *)((s) + 1))
+#define zlog_stats_rules(s) \
+	((zlog_stats_rule_t *)(zlog_stats_categories(s) + (s)->ncategories))
+
+#define ZLOG_STATS_SHM_MAGIC 0x7a6c6f67 /* "zlog" */
+
+typedef struct zlog_stats_shm_s {
+	unsigned int magic;
+	unsigned int seq;  /* odd while being written */
+	size_t size;       /* of the stats behind */
+} zlog_stats_shm_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
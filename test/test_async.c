@@ -0,0 +1,105 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define NTHREAD 4
+#define NLOOP 5000
+
+static zlog_category_t *zc;
+
+static void *work(void *ptr)
+{
+	long id = (long)ptr;
+	long i;
+
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%ld %ld", id, i);
+	}
+	return NULL;
+}
+
+/* every thread's msg must be there, in its own order */
+static int check(const char *path)
+{
+	FILE *fp;
+	long id;
+	long i;
+	long n = 0;
+	long next[NTHREAD] = { 0 };
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		printf("open %s fail\n", path);
+		return -1;
+	}
+	while (fscanf(fp, "%ld %ld", &id, &i) == 2) {
+		if (id < 0 || id >= NTHREAD || next[id] != i) {
+			printf("%s: thread[%ld] expect[%ld] got[%ld]\n", path, id, next[id], i);
+			fclose(fp);
+			return -1;
+		}
+		next[id]++;
+		n++;
+	}
+	fclose(fp);
+
+	if (n != NTHREAD * NLOOP) {
+		printf("%s: expect [%d] msg, got [%ld]\n", path, NTHREAD * NLOOP, n);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long i;
+	pthread_t tid[NTHREAD];
+
+	unlink("test_async.log");
+	unlink("test_async.sync.log");
+
+	rc = zlog_init("test_async.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < NTHREAD; i++) {
+		pthread_create(&tid[i], NULL, work, (void *)i);
+	}
+	for (i = 0; i < NTHREAD; i++) {
+		pthread_join(tid[i], NULL);
+	}
+
+	zlog_fini();
+
+	if (check("test_async.log") || check("test_async.sync.log")) return -3;
+
+	printf("test_async ok\n");
+	return 0;
+}
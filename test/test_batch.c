@@ -0,0 +1,128 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+
+#define NLOOP 1000
+
+static long count_lines(const char *path)
+{
+	FILE *fp;
+	int c;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '\n') n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+static int expect(long lines, const char *when)
+{
+	long n;
+
+	n = count_lines("test_batch.log");
+	if (n != lines) {
+		printf("%s: test_batch.log has [%ld] lines, not %ld\n", when, n, lines);
+		return -1;
+	}
+	return 0;
+}
+
+/* a process leaving without zlog_fini() still writes its batch */
+static int exit_without_fini(void)
+{
+	int i;
+	int status;
+	pid_t pid;
+	zlog_category_t *zc;
+
+	pid = fork();
+	if (pid < 0) return -1;
+	if (pid == 0) {
+		if (zlog_init("test_batch.conf")) exit(1);
+		zc = zlog_get_category("my_cat");
+		if (!zc) exit(2);
+		for (i = 0; i < 5; i++) {
+			zlog_info(zc, "info %d", i);
+		}
+		exit(0);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		printf("child fail\n");
+		return -1;
+	}
+	return expect(5, "exit");
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	zlog_category_t *zc;
+
+	unlink("test_batch.log");
+	if (exit_without_fini()) return -4;
+	unlink("test_batch.log");
+
+	rc = zlog_init("test_batch.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* kept in the batch */
+	for (i = 0; i < 10; i++) {
+		zlog_info(zc, "info %d", i);
+	}
+	if (expect(0, "buffered")) goto err;
+
+	/* error flushes at once */
+	zlog_error(zc, "error");
+	if (expect(11, "flush level")) goto err;
+
+	/* the flusher writes it out after the delay */
+	zlog_info(zc, "info");
+	usleep(600 * 1000);
+	if (expect(12, "flush delay")) goto err;
+
+	/* size flushes on the way, fini writes the rest */
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%04d 0123456789012345678901234567890123456789", i);
+	}
+	zlog_fini();
+	if (expect(12 + NLOOP, "fini")) return -3;
+
+	printf("test_batch ok\n");
+	return 0;
+err:
+	zlog_fini();
+	return -3;
+}
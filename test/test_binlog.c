@@ -0,0 +1,328 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "zlog.h"
+#include "binlog.h"
+
+static const char *fmt = "int[%d] ll[%lld] f[%.2f] s[%.2s] c[%c]";
+
+static char *data;
+static long data_len;
+static long offset;
+
+static int read_all(const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (!fp) return -1;
+	data = malloc(1024 * 1024);
+	data_len = fread(data, 1, 1024 * 1024, fp);
+	fclose(fp);
+	return 0;
+}
+
+/* the body of the next record, which should be of type */
+static char *next_record(char type)
+{
+	uint32_t len;
+	char *body;
+
+	if (offset + ZLOG_BINLOG_HEAD_LEN > data_len) {
+		printf("no record [%c] at %ld\n", type, offset);
+		return NULL;
+	}
+	memcpy(&len, data + offset + 1, sizeof(len));
+	if (data[offset] != type || offset + len > data_len) {
+		printf("record [%c][%u] at %ld, not [%c]\n", data[offset], len, offset, type);
+		return NULL;
+	}
+	body = data + offset + ZLOG_BINLOG_HEAD_LEN;
+	offset += len;
+	return body;
+}
+
+/* skip fmt, level, time and category */
+static char *log_args(char *body, uint64_t ptr)
+{
+	uint64_t fmt_ptr;
+	uint16_t len;
+
+	memcpy(&fmt_ptr, body, sizeof(fmt_ptr));
+	if (fmt_ptr != ptr) {
+		printf("fmt [%llx] not [%llx]\n", (unsigned long long)fmt_ptr, (unsigned long long)ptr);
+		return NULL;
+	}
+	memcpy(&len, body + 24, sizeof(len));
+	if (len != 6 || memcmp(body + 26, "my_cat", 6)) {
+		printf("category wrong\n");
+		return NULL;
+	}
+	return body + 32;
+}
+
+/* the next record is F of str, its fmt goes to *ptr */
+static int check_format(const char *str, uint64_t *ptr)
+{
+	char *body;
+	uint32_t len;
+
+	if (!(body = next_record(ZLOG_BINLOG_FORMAT))) return -1;
+	memcpy(ptr, body, sizeof(*ptr));
+	memcpy(&len, body + 8, sizeof(len));
+	if (len != strlen(str) || memcmp(body + 12, str, len)) {
+		printf("bad format record of [%s]\n", str);
+		return -1;
+	}
+	return 0;
+}
+
+static int check_int(char *p, int64_t value)
+{
+	int64_t i64;
+
+	if (!p || *p != ZLOG_BINLOG_TAG_INT) return -1;
+	memcpy(&i64, p + 1, 8);
+	return i64 == value ? 0 : -1;
+}
+
+static int check_args(char *p)
+{
+	int64_t i64;
+	double d;
+	uint32_t len;
+
+	if (*p != ZLOG_BINLOG_TAG_INT) return -1;
+	memcpy(&i64, p + 1, 8); p += 9;
+	if (i64 != 42) return -1;
+	if (*p != ZLOG_BINLOG_TAG_INT) return -1;
+	memcpy(&i64, p + 1, 8); p += 9;
+	if (i64 != -7) return -1;
+	if (*p != ZLOG_BINLOG_TAG_DOUBLE) return -1;
+	memcpy(&d, p + 1, 8); p += 9;
+	if (d != 3.5) return -1;
+	if (*p != ZLOG_BINLOG_TAG_STR) return -1;
+	memcpy(&len, p + 1, 4); p += 5;
+	if (len != 2 || memcmp(p, "ab", 2)) return -1;
+	p += 2;
+	if (*p != ZLOG_BINLOG_TAG_INT) return -1;
+	memcpy(&i64, p + 1, 8);
+	if (i64 != 'x') return -1;
+	return 0;
+}
+
+/* a file left after rotations is read alone: S first,
+ * and the F of every L before it, return the count of L
+ */
+static int check_alone(const char *path)
+{
+	uint32_t len;
+	uint64_t ptr;
+	uint64_t known[16];
+	int nknown = 0;
+	int nlogs = 0;
+	int i;
+
+	if (read_all(path)) {
+		printf("no %s\n", path);
+		return -1;
+	}
+	for (offset = 0; offset + ZLOG_BINLOG_HEAD_LEN <= data_len; offset += len) {
+		memcpy(&len, data + offset + 1, sizeof(len));
+		if (len < ZLOG_BINLOG_HEAD_LEN || offset + len > data_len) break;
+		if (offset == 0 && data[offset] != ZLOG_BINLOG_START) break;
+		if (data[offset] == ZLOG_BINLOG_FORMAT && nknown < 16) {
+			memcpy(&known[nknown++], data + offset + ZLOG_BINLOG_HEAD_LEN, sizeof(ptr));
+		} else if (data[offset] == ZLOG_BINLOG_LOG) {
+			memcpy(&ptr, data + offset + ZLOG_BINLOG_HEAD_LEN, sizeof(ptr));
+			for (i = 0; i < nknown && known[i] != ptr; i++);
+			if (i == nknown) break;
+			nlogs++;
+		}
+	}
+	if (offset != data_len || !nlogs) {
+		printf("%s can't be read alone at %ld of %ld\n", path, offset, data_len);
+		nlogs = -1;
+	}
+	free(data);
+	return nlogs;
+}
+
+static int test_rotate(void)
+{
+	int i;
+	zlog_category_t *zc;
+
+	unlink("test_binlog_rotate.bin");
+	unlink("test_binlog_rotate.0.bin");
+	unlink("test_binlog_rotate.1.bin");
+
+	if (zlog_init("test_binlog.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("rot_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -1;
+	}
+
+	/* formats 1st used in files rotated away and removed */
+	zlog_info(zc, "early %d", 1);
+	for (i = 0; i < 600; i++) {
+		zlog_info(zc, "line %d of %s", i, "rotate");
+		/* let the rotater keep up */
+		if (i % 50 == 0) usleep(20000);
+	}
+	zlog_info(zc, "early %d", 2);
+	zlog_fini();
+
+	/* the last msg may have rotated the file away too */
+	if (!access("test_binlog_rotate.bin", F_OK)
+		&& check_alone("test_binlog_rotate.bin") < 0) return -1;
+	if (check_alone("test_binlog_rotate.0.bin") < 0) return -1;
+	if (check_alone("test_binlog_rotate.1.bin") < 0) return -1;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	char *body;
+	char *p;
+	uint32_t len;
+	uint64_t ptr;
+	char reused[32];
+	zlog_category_t *zc;
+
+	unlink("test_binlog.bin");
+
+	rc = zlog_init("test_binlog.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_info(zc, fmt, 42, -7LL, 3.5, "abc", 'x');
+	zlog_info(zc, fmt, 42, -7LL, 3.5, "abc", 'x');
+	/* one buffer, other formats, not taken for the 1st one */
+	strcpy(reused, "num %d");
+	zlog_info(zc, reused, 42);
+	strcpy(reused, "str %s");
+	zlog_info(zc, reused, "hello");
+	strcpy(reused, "num %d");
+	zlog_info(zc, reused, 43);
+	/* can't be walked, kept as text */
+	zlog_info(zc, "%ls", L"5");
+	hzlog_info(zc, "hex", 3);
+	zlog_fini();
+
+	if (read_all("test_binlog.bin")) {
+		printf("no test_binlog.bin\n");
+		return -3;
+	}
+
+	if (!(body = next_record(ZLOG_BINLOG_START))) return -3;
+	if (memcmp(body, ZLOG_BINLOG_MAGIC, 4)) {
+		printf("bad magic\n");
+		return -3;
+	}
+
+	/* the format goes once, before its 1st use */
+	if (!(body = next_record(ZLOG_BINLOG_FORMAT))) return -3;
+	memcpy(&len, body + 8, sizeof(len));
+	if (len != strlen(fmt) || memcmp(body + 12, fmt, len)) {
+		printf("bad format record\n");
+		return -3;
+	}
+
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (!(p = log_args(body, (uintptr_t)fmt)) || check_args(p)) {
+		printf("bad 1st log record\n");
+		return -3;
+	}
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (!(p = log_args(body, (uintptr_t)fmt)) || check_args(p)) {
+		printf("bad 2nd log record\n");
+		return -3;
+	}
+
+	if (check_format("num %d", &ptr)) return -3;
+	if (ptr != (uintptr_t)reused) {
+		printf("fmt of the 1st format in a buffer is not its pointer\n");
+		return -3;
+	}
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (check_int(log_args(body, ptr), 42)) {
+		printf("bad log record of num\n");
+		return -3;
+	}
+	if (check_format("str %s", &ptr)) return -3;
+	if (!(ptr & ZLOG_BINLOG_FMT_LOCAL)) {
+		printf("fmt of another format in the buffer is not a new one\n");
+		return -3;
+	}
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (!(p = log_args(body, ptr)) || *p != ZLOG_BINLOG_TAG_STR
+		|| memcmp(p + 5, "hello", 5)) {
+		printf("bad log record of str\n");
+		return -3;
+	}
+	/* the cached one again */
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (check_int(log_args(body, (uintptr_t)reused), 43)) {
+		printf("bad 2nd log record of num\n");
+		return -3;
+	}
+
+	if (!(body = next_record(ZLOG_BINLOG_LOG))) return -3;
+	if (!(p = log_args(body, 0)) || *p != ZLOG_BINLOG_TAG_STR || memcmp(p + 5, "5", 1)) {
+		printf("bad text log record\n");
+		return -3;
+	}
+
+	if (!(body = next_record(ZLOG_BINLOG_HEX))) return -3;
+	memcpy(&len, body + 24, sizeof(len));
+	if (memcmp(body + 18, "my_cat", 6) || len != 3 || memcmp(body + 28, "hex", 3)) {
+		printf("bad hex record\n");
+		return -3;
+	}
+
+	if (offset != data_len) {
+		printf("[%ld] bytes left\n", data_len - offset);
+		return -3;
+	}
+
+	free(data);
+
+	if (test_rotate()) return -4;
+
+	printf("test_binlog ok\n");
+	return 0;
+}
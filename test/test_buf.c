@@ -106,5 +106,42 @@ int main(int argc, char** argv)
 
 	zlog_buf_del(a_buf);
 
+	/* the digit pair table must give what printf gives */
+	a_buf = zlog_buf_new(64, 0, "");
+	if (!a_buf) {
+		zc_error("zlog_buf_new fail");
+		return -1;
+	}
+
+	uint64_t ui64;
+	char str[64];
+	for (i = 0, ui64 = 0; i < 200; i++, ui64 = ui64 * 3 + i) {
+		for (j = 0; j <= 22; j += 11) {
+			zlog_buf_restart(a_buf);
+			zlog_buf_printf_dec64(a_buf, ui64, j);
+			snprintf(str, sizeof(str), "%0*llu", j, (unsigned long long)ui64);
+			if (zlog_buf_len(a_buf) != strlen(str) || memcmp(a_buf->start, str, strlen(str))) {
+				zc_error("dec64 [%llu] width[%d] wrong", (unsigned long long)ui64, j);
+				return -1;
+			}
+
+			zlog_buf_restart(a_buf);
+			zlog_buf_printf_dec32(a_buf, (uint32_t)ui64, j);
+			snprintf(str, sizeof(str), "%0*lu", j, (unsigned long)(uint32_t)ui64);
+			if (zlog_buf_len(a_buf) != strlen(str) || memcmp(a_buf->start, str, strlen(str))) {
+				zc_error("dec32 [%lu] width[%d] wrong", (unsigned long)(uint32_t)ui64, j);
+				return -1;
+			}
+		}
+	}
+
+	zlog_buf_dec_fixed(str, 1234567, 6);
+	if (memcmp(str, "234567", 6)) {
+		zc_error("dec fixed wrong");
+		return -1;
+	}
+
+	zlog_buf_del(a_buf);
+
 	return 0;
 }
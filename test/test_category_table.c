@@ -0,0 +1,86 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define NTHREAD 8
+#define NCAT 1000
+
+static zlog_category_t *cats[NTHREAD][NCAT];
+
+/* every thread asks for the same names, in its own order,
+ * while the table grows under them
+ */
+static void *work(void *arg)
+{
+	long n = (long)arg;
+	int i;
+	int j;
+	char name[64];
+
+	for (i = 0; i < NCAT; i++) {
+		j = (i * 7 + n * 131) % NCAT;
+		snprintf(name, sizeof(name), "cat_%d", j);
+		cats[n][j] = zlog_get_category(name);
+		if (cats[n][j]) zlog_info(cats[n][j], "%d", j);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long n;
+	int i;
+	pthread_t tid[NTHREAD];
+
+	rc = zlog_init("test_category_table.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	for (n = 0; n < NTHREAD; n++) {
+		pthread_create(&tid[n], NULL, work, (void *)n);
+	}
+	for (n = 0; n < NTHREAD; n++) {
+		pthread_join(tid[n], NULL);
+	}
+
+	for (i = 0; i < NCAT; i++) {
+		for (n = 0; n < NTHREAD; n++) {
+			if (!cats[n][i] || cats[n][i] != cats[0][i]) {
+				printf("cat_%d of thread %ld is [%p], not [%p]\n",
+					i, n, (void *)cats[n][i], (void *)cats[0][i]);
+				zlog_fini();
+				return -1;
+			}
+		}
+	}
+
+	/* and the table stays the same across reload */
+	if (zlog_reload(NULL) || zlog_get_category("cat_7") != cats[0][7]) {
+		printf("cat_7 changed after reload\n");
+		zlog_fini();
+		return -1;
+	}
+
+	zlog_fini();
+	printf("category table ok\n");
+	return 0;
+}
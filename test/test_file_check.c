@@ -0,0 +1,86 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+static long count_lines(const char *path)
+{
+	FILE *fp;
+	int c;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '\n') n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+/* move the file away like logrotate, the next msg should go to a new file */
+static int check(const char *conf)
+{
+	int rc;
+	long n;
+	zlog_category_t *zc;
+
+	unlink("test_file_check.log");
+	unlink("test_file_check.old.log");
+
+	rc = zlog_init(conf);
+	if (rc) {
+		printf("init %s failed\n", conf);
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_info(zc, "before");
+	rename("test_file_check.log", "test_file_check.old.log");
+	/* give the watcher time to notice */
+	usleep(500 * 1000);
+	zlog_info(zc, "after");
+	zlog_fini();
+
+	n = count_lines("test_file_check.old.log");
+	if (n != 1) {
+		printf("%s: test_file_check.old.log has [%ld] lines, not 1\n", conf, n);
+		return -3;
+	}
+	n = count_lines("test_file_check.log");
+	if (n != 1) {
+		printf("%s: test_file_check.log has [%ld] lines, not 1\n", conf, n);
+		return -4;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (check("test_file_check.conf")) return -1;
+	if (check("test_file_check.2.conf")) return -2;
+
+	printf("test_file_check ok\n");
+	return 0;
+}
@@ -0,0 +1,95 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+#define NCAT 3
+#define NLOOP 100
+
+static const char *names[NCAT] = { "aa", "bb", "cc" };
+
+static long count_lines(const char *path)
+{
+	FILE *fp;
+	int c;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '\n') n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	int j;
+	long n;
+	char path[64];
+	zlog_category_t *zc[NCAT];
+
+	for (i = 0; i < NCAT; i++) {
+		sprintf(path, "test_file_table.%s.log", names[i]);
+		unlink(path);
+	}
+
+	rc = zlog_init("test_file_table.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	for (i = 0; i < NCAT; i++) {
+		zc[i] = zlog_get_category(names[i]);
+		if (!zc[i]) {
+			printf("get cat fail\n");
+			zlog_fini();
+			return -2;
+		}
+	}
+
+	/* 3 paths on a table of 2, so fds are evicted all the time */
+	for (j = 0; j < NLOOP; j++) {
+		for (i = 0; i < NCAT; i++) {
+			zlog_info(zc[i], "%d", j);
+		}
+	}
+
+	/* removed by someone else, must come back within a second */
+	unlink("test_file_table.aa.log");
+	sleep(2);
+	zlog_info(zc[0], "again");
+
+	zlog_fini();
+
+	for (i = 0; i < NCAT; i++) {
+		sprintf(path, "test_file_table.%s.log", names[i]);
+		n = count_lines(path);
+		if (n != (i == 0 ? 1 : NLOOP)) {
+			printf("%s: got [%ld] lines\n", path, n);
+			return -3;
+		}
+	}
+
+	printf("test_file_table ok\n");
+	return 0;
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "zc_defs.h"
+#include "buf.h"
+#include "hex.h"
+
+#define NDATA 300
+
+/* the dump hzlog wrote before, row by row */
+static const char *golden =
+	"\n             0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F    0123456789ABCDEF"
+	"\n0000000001   68 65 6c 6c 6f 2c 20 7a 6c 6f 67 00 01 7f 80 ff   hello, zlog....."
+	"\n0000000002   41 42                                             AB              ";
+
+static int dump(zlog_buf_t *a_buf, int impl, const unsigned char *data, size_t len,
+		int width, int group)
+{
+	zlog_hex_set_impl(impl);
+	zlog_buf_restart(a_buf);
+	return zlog_hex_write(a_buf, data, len, width, group);
+}
+
+int main(int argc, char** argv)
+{
+	zlog_buf_t *a_buf;
+	zlog_buf_t *b_buf;
+	unsigned char data[NDATA];
+	size_t len;
+	int impl;
+	int width;
+	int group;
+	int rc;
+	int i;
+
+	a_buf = zlog_buf_new(64, 0, "");
+	b_buf = zlog_buf_new(64, 0, "");
+	if (!a_buf || !b_buf) {
+		printf("zlog_buf_new fail\n");
+		return -1;
+	}
+
+	memcpy(data, "hello, zlog\0\x01\x7f\x80\xff" "AB", 18);
+	dump(a_buf, ZLOG_HEX_SCALAR, data, 18, 16, 0);
+	if (zlog_buf_len(a_buf) != strlen(golden)
+		|| memcmp(zlog_buf_str(a_buf), golden, strlen(golden))) {
+		zlog_buf_seal(a_buf);
+		printf("dump is not as before [%s]\n", zlog_buf_str(a_buf));
+		return -1;
+	}
+
+	for (i = 0; i < NDATA; i++) data[i] = (unsigned char)(i * 7 + 3);
+
+	/* every impl the cpu has must give what the scalar one gives */
+	for (impl = ZLOG_HEX_SSE2; impl <= ZLOG_HEX_AVX2; impl++) {
+		if (zlog_hex_set_impl(impl) != impl) continue;
+		for (width = 1; width <= ZLOG_HEX_WIDTH_MAX; width += 7) {
+			for (group = 0; group < width; group += 3) {
+				for (len = 0; len < NDATA; len += 13) {
+					dump(a_buf, ZLOG_HEX_SCALAR, data, len, width, group);
+					dump(b_buf, impl, data, len, width, group);
+					if (zlog_buf_len(a_buf) != zlog_buf_len(b_buf)
+						|| memcmp(zlog_buf_str(a_buf), zlog_buf_str(b_buf), zlog_buf_len(a_buf))) {
+						printf("impl[%d] width[%d] group[%d] len[%ld] differs\n",
+							impl, width, group, (long)len);
+						return -1;
+					}
+				}
+			}
+		}
+	}
+
+	/* a limited buf is filled up and truncated */
+	zlog_buf_del(a_buf);
+	a_buf = zlog_buf_new(64, 300, "...");
+	rc = dump(a_buf, ZLOG_HEX_AUTO, data, NDATA, 16, 8);
+	if (rc <= 0 || zlog_buf_len(a_buf) != 299
+		|| memcmp(zlog_buf_str(a_buf) + 296, "...", 3)) {
+		printf("truncate fail, rc[%d] len[%ld]\n", rc, (long)zlog_buf_len(a_buf));
+		return -1;
+	}
+
+	zlog_buf_del(a_buf);
+	zlog_buf_del(b_buf);
+	printf("hex dump ok\n");
+	return 0;
+}
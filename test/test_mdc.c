@@ -50,6 +50,41 @@ int main(int argc, char** argv)
 
 	zlog_info(zc, "3.hello, zlog");
 
+	/* grows out of its slot, and back */
+	zlog_put_mdc("myname", "Zhang San Feng of Wudang Mountain");
+	zlog_put_mdc("other", "x");
+	zlog_info(zc, "4.hello, zlog");
+	zlog_put_mdc("myname", "Wang");
+	if (strcmp(zlog_get_mdc("myname"), "Wang") || strcmp(zlog_get_mdc("other"), "x")) {
+		printf("get mdc fail\n");
+		zlog_fini();
+		return -3;
+	}
+
+	zlog_remove_mdc("myname");
+	zlog_info(zc, "5.hello, zlog");
+
+	zlog_put_mdc("myname", "Zhao");
+	zlog_clean_mdc();
+	zlog_info(zc, "6.hello, zlog");
+
+	/* keys and values are forgotten at fini, a new init starts clean */
+	zlog_put_mdc("other", "y");
+	zlog_fini();
+	rc = zlog_init("test_mdc.conf");
+	if (rc) {
+		printf("init again failed\n");
+		return -4;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc || zlog_get_mdc("other")) {
+		printf("mdc kept over fini\n");
+		zlog_fini();
+		return -5;
+	}
+	zlog_put_mdc("myname", "Sun");
+	zlog_info(zc, "7.hello, zlog");
+
 	zlog_fini();
 	
 	return 0;
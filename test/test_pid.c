@@ -0,0 +1,76 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+
+int main(int argc, char** argv)
+{
+	int rc;
+	pid_t child;
+	int status;
+	long pid[2];
+	FILE *fp;
+	zlog_category_t *zc;
+
+	unlink("test_pid.log");
+
+	rc = zlog_init("test_pid.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_info(zc, "parent");
+
+	/* %p is cached, the child must still log its own pid */
+	child = fork();
+	if (child < 0) {
+		printf("fork fail\n");
+		zlog_fini();
+		return -1;
+	} else if (child == 0) {
+		zlog_info(zc, "child");
+		_exit(0);
+	}
+	waitpid(child, &status, 0);
+	zlog_fini();
+
+	fp = fopen("test_pid.log", "r");
+	if (!fp || fscanf(fp, "%ld %ld", &pid[0], &pid[1]) != 2) {
+		printf("test_pid.log has not 2 pids\n");
+		return -1;
+	}
+	fclose(fp);
+
+	if (pid[0] != (long)getpid() || pid[1] != (long)child) {
+		printf("pids [%ld,%ld], not [%ld,%ld]\n", pid[0], pid[1], (long)getpid(), (long)child);
+		return -1;
+	}
+
+	printf("pid ok\n");
+	return 0;
+}
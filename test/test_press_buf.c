@@ -0,0 +1,91 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "zc_defs.h"
+#include "buf.h"
+
+/* how zlog_buf_printf_dec64 made digits before, one per division */
+static size_t dec_one_by_one(char *str, uint64_t ui64)
+{
+	char tmp[ZLOG_INT64_LEN + 1];
+	char *p = tmp + sizeof(tmp);
+	size_t len;
+	uint32_t ui32;
+
+	if (ui64 <= ZLOG_MAX_UINT32_VALUE) {
+		ui32 = (uint32_t) ui64;
+		do {
+			*--p = (char) (ui32 % 10 + '0');
+		} while (ui32 /= 10);
+	} else {
+		do {
+			*--p = (char) (ui64 % 10 + '0');
+		} while (ui64 /= 10);
+	}
+	len = tmp + sizeof(tmp) - p;
+	memcpy(str, p, len);
+	return len;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define PRESS(name, expr) do { \
+	double t0 = now(); \
+	for (i = 0; i < loop; i++) { v = base + i; expr; } \
+	printf("%-24s %8.2f ns/op\n", name, (now() - t0) / loop); \
+} while (0)
+
+int main(int argc, char** argv)
+{
+	zlog_buf_t *a_buf;
+	long loop;
+	long i;
+	uint64_t v;
+	uint64_t base;
+	char str[64];
+	volatile size_t sink = 0;
+
+	if (argc != 3) {
+		printf("test_press_buf [loop] [first value]\n");
+		return -1;
+	}
+	loop = atol(argv[1]);
+	base = strtoull(argv[2], NULL, 10);
+
+	a_buf = zlog_buf_new(1024, 0, "");
+	if (!a_buf) {
+		printf("zlog_buf_new fail\n");
+		return -1;
+	}
+
+	PRESS("snprintf", sink += snprintf(str, sizeof(str), "%llu", (unsigned long long)v));
+	PRESS("one digit a time", sink += dec_one_by_one(str, v));
+	PRESS("zlog_buf_dec_str", sink += zlog_buf_dec_str(str, v));
+	PRESS("zlog_buf_printf_dec64", zlog_buf_restart(a_buf); zlog_buf_printf_dec64(a_buf, v, 0));
+	PRESS("zlog_buf_dec_fixed(6)", zlog_buf_dec_fixed(str, (uint32_t)v, 6); sink += str[0]);
+
+	zlog_buf_del(a_buf);
+	return 0;
+}
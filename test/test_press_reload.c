@@ -0,0 +1,107 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "zlog.h"
+
+#define CONF_FILE "test_press_reload.conf"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* nrule rules on "mod_<n>_" and "mod_<n>.sub_<n>", all to /dev/null */
+static int write_conf(int nrule)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(CONF_FILE, "w");
+	if (!fp) {
+		printf("fopen %s fail\n", CONF_FILE);
+		return -1;
+	}
+	fprintf(fp, "[global]\nfile check = strict\n[rules]\n");
+	for (i = 0; i < nrule; i++) {
+		if (i % 2) {
+			fprintf(fp, "mod_%d_.*\t\"/dev/null\";\n", i);
+		} else {
+			fprintf(fp, "mod_%d_sub_%d.info\t\"/dev/null\";\n", i, i);
+		}
+	}
+	fprintf(fp, "!.*\t\"/dev/null\";\n");
+	fclose(fp);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int nrule;
+	int ncat;
+	int loop;
+	int i;
+	double t0;
+	char name[64];
+
+	if (argc != 4) {
+		printf("test_press_reload [rules] [categories] [reload times]\n");
+		return -1;
+	}
+	nrule = atoi(argv[1]);
+	ncat = atoi(argv[2]);
+	loop = atoi(argv[3]);
+
+	if (write_conf(nrule)) return -1;
+
+	t0 = now();
+	if (zlog_init(CONF_FILE)) {
+		printf("init fail\n");
+		return -1;
+	}
+	printf("init      %10.3f ms\n", (now() - t0) / 1e6);
+
+	t0 = now();
+	for (i = 0; i < ncat; i++) {
+		snprintf(name, sizeof(name), "mod_%d_sub_%d", i % (nrule + 1), i);
+		if (!zlog_get_category(name)) {
+			printf("zlog_get_category fail\n");
+			zlog_fini();
+			return -1;
+		}
+	}
+	printf("get       %10.3f us/category\n", (now() - t0) / 1e3 / ncat);
+
+	t0 = now();
+	for (i = 0; i < loop; i++) {
+		if (zlog_reload(NULL)) {
+			printf("reload fail\n");
+			zlog_fini();
+			return -1;
+		}
+	}
+	printf("reload    %10.3f ms, %d rules %d categories\n",
+		(now() - t0) / 1e6 / loop, nrule, ncat);
+
+	zlog_fini();
+	remove(CONF_FILE);
+	return 0;
+}
@@ -14,11 +14,35 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "zlog.h"
 
+static zlog_category_t *inner;
+static volatile int reloaded;
+static int reentered;
+
+static void *reload(void *arg)
+{
+	zlog_reload(NULL);
+	reloaded = 1;
+	return NULL;
+}
+
 int output(zlog_msg_t *msg)
 {
+	pthread_t tid;
+
 	printf("[mystd]:[%s][%s][%ld]\n", msg->path, msg->buf, (long)msg->len);
+
+	/* the reload waits for this log call, logging in here must not let it go */
+	pthread_create(&tid, NULL, reload, NULL);
+	usleep(100000);
+	zlog_info(inner, "logged from the record");
+	usleep(100000);
+	if (reloaded) printf("reload went on inside a log call\n");
+	else reentered = 1;
+	pthread_detach(tid);
 	return 0;
 }
 
@@ -42,7 +66,15 @@ int main(int argc, char** argv)
 		return -2;
 	}
 
+	inner = zlog_get_category("inner");
+	if (!inner) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
 	zlog_info(zc, "hello, zlog");
+	while (!reloaded) usleep(1000);
 	zlog_fini();
-	return 0;
+	return reentered ? 0 : -3;
 }
@@ -0,0 +1,88 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zc_defs.h"
+#include "conf.h"
+#include "rule.h"
+
+/* zlog.h and record.h both define zlog_msg_t, so by hand */
+int zlog_init(const char *config);
+void zlog_fini(void);
+
+#define CONF_FILE "test_reload_check.conf"
+#define TMP_FILE "test_reload_check.conf.tmp"
+
+/* write aside and rename over, as editors do */
+static int write_conf(const char *check, const char *log)
+{
+	FILE *fp;
+
+	fp = fopen(TMP_FILE, "w");
+	if (!fp) {
+		printf("fopen %s fail\n", TMP_FILE);
+		return -1;
+	}
+	fprintf(fp, "[global]\nreload check = %s\nreload check period = 20\n"
+		"reload delay = 50\n[rules]\ncheck.*\t\"%s\"\n", check, log);
+	fclose(fp);
+	return rename(TMP_FILE, CONF_FILE);
+}
+
+static int wait_output(const char *file)
+{
+	int i;
+	zlog_conf_t *a_conf;
+
+	for (i = 0; i < 200; i++) {
+		usleep(10000);
+		/* the watcher thread swaps it */
+		a_conf = zc_atomic_load(&zlog_env_conf);
+		if (STRCMP(((zlog_rule_t *)zc_arraylist_get(a_conf->rules, 0))->file_path, ==, file)) return 0;
+	}
+	printf("conf not reloaded in 2s\n");
+	return -1;
+}
+
+static int check(const char *mode)
+{
+	if (write_conf(mode, "test_reload_check_a.log")) return -1;
+	if (zlog_init(CONF_FILE)) {
+		printf("init fail\n");
+		return -1;
+	}
+	if (write_conf(mode, "test_reload_check_b.log") || wait_output("test_reload_check_b.log")) goto err;
+	if (write_conf(mode, "test_reload_check_a.log") || wait_output("test_reload_check_a.log")) goto err;
+	zlog_fini();
+	printf("reload check %s ok\n", mode);
+	return 0;
+err:
+	zlog_fini();
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+
+	rc = check("inotify") || check("period");
+	remove(CONF_FILE);
+	remove("test_reload_check_a.log");
+	remove("test_reload_check_b.log");
+	return rc ? -1 : 0;
+}
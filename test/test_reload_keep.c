@@ -0,0 +1,119 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "zc_defs.h"
+#include "conf.h"
+#include "rule.h"
+#include "category.h"
+
+/* zlog.h and record.h both define zlog_msg_t, so by hand */
+int zlog_init(const char *config);
+int zlog_reload(const char *config);
+void zlog_fini(void);
+zlog_category_t *zlog_get_category(const char *cname);
+void zlog(zlog_category_t * category,
+	const char *file, size_t filelen,
+	const char *func, size_t funclen,
+	long line, int level,
+	const char *format, ...);
+
+#define zlog_info(cat, msg) \
+	zlog(cat, __FILE__, sizeof(__FILE__) - 1, __func__, sizeof(__func__) - 1, __LINE__, 40, msg)
+
+#define CONF_FILE "test_reload_keep.conf"
+
+static int write_conf(const char *perms, const char *pattern, const char *other)
+{
+	FILE *fp;
+
+	fp = fopen(CONF_FILE, "w");
+	if (!fp) {
+		printf("fopen %s fail\n", CONF_FILE);
+		return -1;
+	}
+	fprintf(fp, "[global]\nfile perms = %s\n"
+		"[formats]\nsimple = \"%s\"\n"
+		"[rules]\n"
+		"keep.INFO\t\"test_reload_keep.log\"; simple\n"
+		"keep.=DEBUG\t\"test_reload_keep.log\"; simple\n"
+		"other.*\t%s\n",
+		perms, pattern, other);
+	fclose(fp);
+	return 0;
+}
+
+#define RULE(i) ((zlog_rule_t *)zc_arraylist_get(zlog_env_conf->rules, i))
+
+int main(int argc, char** argv)
+{
+	zlog_category_t *zc;
+	zlog_rule_t *r0;
+	zlog_rule_t *r1;
+	zlog_rule_t *r2;
+
+	if (write_conf("644", "%m%n", ">stdout")) return -1;
+	if (zlog_init(CONF_FILE)) {
+		printf("init fail\n");
+		return -1;
+	}
+	zc = zlog_get_category("keep");
+	zlog_info(zc, "before reload");
+
+	/* two rules of one file write through one fd */
+	r0 = RULE(0);
+	r1 = RULE(1);
+	r2 = RULE(2);
+	if (r0->static_fd <= 0 || r1->static_fd != r0->static_fd) {
+		printf("fd not shared, [%d] [%d]\n", r0->static_fd, r1->static_fd);
+		goto err;
+	}
+
+	/* only the changed rule is made again */
+	if (write_conf("644", "%m%n", ">stderr")) goto err;
+	if (zlog_reload(NULL)) {
+		printf("reload fail\n");
+		goto err;
+	}
+	if (RULE(0) != r0 || RULE(1) != r1 || RULE(2) == r2) {
+		printf("rules not kept\n");
+		goto err;
+	}
+	zlog_info(zc, "after reload");
+
+	/* a changed format or global option makes them all again */
+	if (write_conf("644", "%c %m%n", ">stderr")) goto err;
+	if (zlog_reload(NULL) || RULE(0) == r0) {
+		printf("rule kept with a new format\n");
+		goto err;
+	}
+	r0 = RULE(0);
+	if (write_conf("600", "%c %m%n", ">stderr")) goto err;
+	if (zlog_reload(NULL) || RULE(0) == r0) {
+		printf("rule kept with new file perms\n");
+		goto err;
+	}
+	zlog_info(zc, "after new rules");
+
+	zlog_fini();
+	remove(CONF_FILE);
+	remove("test_reload_keep.log");
+	printf("reload keep ok\n");
+	return 0;
+err:
+	zlog_fini();
+	return -1;
+}
@@ -0,0 +1,87 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "zlog.h"
+
+#define NLOOP 1000
+#define NCHUNK 10
+#define MAX_SIZE (10 * 1024)
+/* msgs of a chunk may still go to the old file while it is rotated */
+#define SLACK (NCHUNK * 46)
+
+/* rotation is driven by the size counted in memory, not stat() */
+static int check(const char *path)
+{
+	struct stat stb;
+
+	if (stat(path, &stb)) {
+		printf("%s: not found\n", path);
+		return -1;
+	}
+	if (stb.st_size > MAX_SIZE + SLACK) {
+		printf("%s: size[%ld] > [%d]\n", path, (long)stb.st_size, MAX_SIZE + SLACK);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	zlog_category_t *zc;
+
+	unlink("test_rotate.log");
+	unlink("test_rotate.0.log");
+	unlink("test_rotate.1.log");
+	unlink("test_rotate.2.log");
+
+	rc = zlog_init("test_rotate.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%04d 0123456789012345678901234567890123456789", i);
+		/* give the rotater's thread time to catch up */
+		if (i % NCHUNK == NCHUNK - 1) usleep(1000);
+	}
+
+	zlog_fini();
+
+	if (check("test_rotate.log") || check("test_rotate.0.log")
+		|| check("test_rotate.1.log") || check("test_rotate.2.log")) {
+		return -3;
+	}
+	if (access("test_rotate.3.log", F_OK) == 0) {
+		printf("test_rotate.3.log should not be kept\n");
+		return -4;
+	}
+
+	printf("test_rotate ok\n");
+	return 0;
+}
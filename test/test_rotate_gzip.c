@@ -0,0 +1,109 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+#define NLOOP 100
+
+#ifdef ZLOG_ZLIB
+/* a gzip member begins with 1f 8b */
+static int is_gzip(const char *path)
+{
+	FILE *fp;
+	int a, b;
+
+	fp = fopen(path, "rb");
+	if (!fp) return 0;
+	a = fgetc(fp);
+	b = fgetc(fp);
+	fclose(fp);
+	return a == 0x1f && b == 0x8b;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+#ifdef ZLOG_ZLIB
+	int rc;
+	int i;
+	zlog_category_t *zc;
+
+	unlink("test_rotate_gzip.log");
+	unlink("test_rotate_gzip.0.log");
+	unlink("test_rotate_gzip.0.log.gz");
+	unlink("test_rotate_gzip.1.log.gz");
+
+	rc = zlog_init("test_rotate_gzip.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* 100 msgs of 20 bytes over 1K, the 1st past asks for rotation */
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%019d", i);
+	}
+
+	/* the archive is left alone for 2 seconds after its last write */
+	for (i = 0; i < 1000 && access("test_rotate_gzip.0.log.gz", F_OK); i++) {
+		usleep(10000);
+	}
+
+	/* again, the compressed archive rolls to .1 by the index it left */
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%019d", i);
+	}
+	for (i = 0; i < 1000 && access("test_rotate_gzip.1.log.gz", F_OK); i++) {
+		usleep(10000);
+	}
+	for (i = 0; i < 1000 && access("test_rotate_gzip.0.log.gz", F_OK); i++) {
+		usleep(10000);
+	}
+	zlog_fini();
+
+	if (!is_gzip("test_rotate_gzip.1.log.gz")) {
+		printf("test_rotate_gzip.1.log.gz is not there or not gzip\n");
+		return -6;
+	}
+
+	if (!is_gzip("test_rotate_gzip.0.log.gz")) {
+		printf("test_rotate_gzip.0.log.gz is not there or not gzip\n");
+		return -3;
+	}
+	if (access("test_rotate_gzip.0.log", F_OK) == 0) {
+		printf("test_rotate_gzip.0.log should be gone\n");
+		return -4;
+	}
+	if (access("test_rotate_gzip.0.log.gz.tmp", F_OK) == 0) {
+		printf("test_rotate_gzip.0.log.gz.tmp should be gone\n");
+		return -5;
+	}
+
+	printf("test_rotate_gzip ok\n");
+#else
+	printf("test_rotate_gzip skipped, zlog built without zlib\n");
+#endif
+	return 0;
+}
@@ -0,0 +1,123 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+#define NLOOP 60	/* 20 bytes each, past 1K once a round */
+
+/* write past the size, then wait for the rotater's thread to move it to path */
+static int round_to(zlog_category_t *zc, const char *path)
+{
+	int i;
+
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%019d", i);
+	}
+	for (i = 0; i < 500 && access(path, F_OK); i++) {
+		usleep(10000);
+	}
+	if (access(path, F_OK)) {
+		printf("%s: not found\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static int touch(const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp) return -1;
+	fprintf(fp, "not by zlog\n");
+	fclose(fp);
+	return 0;
+}
+
+static void clean(const char *name)
+{
+	int i;
+	char path[64];
+
+	snprintf(path, sizeof(path), "%s.log", name);
+	unlink(path);
+	for (i = 0; i < 16; i++) {
+		snprintf(path, sizeof(path), "%s.%d.log", name, i);
+		unlink(path);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	zlog_category_t *seq;
+	zlog_category_t *roll;
+
+	clean("test_rotate_index_s");
+	clean("test_rotate_index_r");
+
+	rc = zlog_init("test_rotate_index.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	seq = zlog_get_category("seq_cat");
+	roll = zlog_get_category("roll_cat");
+	if (!seq || !roll) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* an archive put by others is seen, though the rotater knows the list */
+	if (round_to(seq, "test_rotate_index_s.0.log")
+		|| round_to(seq, "test_rotate_index_s.1.log")
+		|| touch("test_rotate_index_s.9.log")
+		|| round_to(seq, "test_rotate_index_s.10.log")) {
+		zlog_fini();
+		return -3;
+	}
+	if (access("test_rotate_index_s.2.log", F_OK) == 0) {
+		printf("test_rotate_index_s.2.log should not be there\n");
+		zlog_fini();
+		return -4;
+	}
+
+	/* and one past the count is removed as if zlog made it */
+	if (round_to(roll, "test_rotate_index_r.0.log")
+		|| round_to(roll, "test_rotate_index_r.1.log")
+		|| touch("test_rotate_index_r.5.log")
+		|| round_to(roll, "test_rotate_index_r.2.log")) {
+		zlog_fini();
+		return -5;
+	}
+	zlog_fini();
+
+	if (access("test_rotate_index_r.5.log", F_OK) == 0) {
+		printf("test_rotate_index_r.5.log should be removed\n");
+		return -6;
+	}
+	if (access("test_rotate_index_r.3.log", F_OK) == 0) {
+		printf("test_rotate_index_r.3.log should not be kept\n");
+		return -7;
+	}
+
+	printf("test_rotate_index ok\n");
+	return 0;
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "zlog.h"
+
+#define NLOOP 100
+
+static long count_lines(const char *path)
+{
+	FILE *fp;
+	int c;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '\n') n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	long n;
+	zlog_category_t *zc;
+
+	unlink("test_rotate_time.log");
+	unlink("test_rotate_time.0.log");
+	unlink("test_rotate_time.1.log");
+
+	/* a second to go before the boundary, so the 1st msgs are not split */
+	while (time(NULL) % 2 == 0) usleep(10000);
+
+	rc = zlog_init("test_rotate_time.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "%d", i);
+	}
+
+	/* past the next even second, the 1st msg after asks for rotation */
+	sleep(3);
+	zlog_info(zc, "boundary");
+	for (i = 0; i < 100 && access("test_rotate_time.0.log", F_OK); i++) {
+		usleep(10000);
+	}
+	zlog_info(zc, "new period");
+
+	zlog_fini();
+
+	/* the asking msg still goes to the old fd */
+	n = count_lines("test_rotate_time.0.log");
+	if (n != NLOOP + 1) {
+		printf("test_rotate_time.0.log: got [%ld] lines\n", n);
+		return -3;
+	}
+	n = count_lines("test_rotate_time.log");
+	if (n != 1) {
+		printf("test_rotate_time.log: got [%ld] lines\n", n);
+		return -4;
+	}
+	if (access("test_rotate_time.1.log", F_OK) == 0) {
+		printf("test_rotate_time.1.log should not be there\n");
+		return -5;
+	}
+
+	printf("test_rotate_time ok\n");
+	return 0;
+}
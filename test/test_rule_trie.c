@@ -0,0 +1,106 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "zc_defs.h"
+#include "conf.h"
+#include "rule.h"
+#include "rule_trie.h"
+
+static const char *conf_string =
+	"[rules]\n"
+	"aa.*		>stdout;\n"
+	"aa_.*		>stdout;\n"
+	"aa_bb_.*	>stdout;\n"
+	"*.*		>stdout;\n"
+	"aa.*		>stderr;\n"
+	"a_.*		>stdout;\n"
+	"!.*		>stdout;\n"
+	"_.*		>stdout;\n"
+	"cc_dd.*	>stdout;\n"
+	"!.*		>stderr;\n";
+
+static const char *names[] = {
+	"", "a", "aa", "aa_", "aa_b", "aa_bb", "aa_bb_", "aa_bb_cc",
+	"aa1_bb", "a_", "a_a", "_", "_x", "cc", "cc_", "cc_dd", "cc_dd_e",
+	"!", "x", NULL
+};
+
+/* the rules of every name must be what matching them one by one gives */
+static int check(zlog_conf_t *a_conf, const char *name)
+{
+	int i;
+	zlog_rule_t *a_rule;
+	zlog_rule_t *wastebin_rule = NULL;
+	zc_arraylist_t *fit_rules;
+	zc_arraylist_t *want_rules;
+	int rc = -1;
+
+	fit_rules = zc_arraylist_new(NULL);
+	want_rules = zc_arraylist_new(NULL);
+	if (!fit_rules || !want_rules) goto exit;
+
+	zc_arraylist_foreach(a_conf->rules, i, a_rule) {
+		if (zlog_rule_match_category(a_rule, (char *)name)) zc_arraylist_add(want_rules, a_rule);
+		if (zlog_rule_is_wastebin(a_rule)) wastebin_rule = a_rule;
+	}
+	if (zc_arraylist_len(want_rules) == 0 && wastebin_rule) {
+		zc_arraylist_add(want_rules, wastebin_rule);
+	}
+
+	if (zlog_rule_trie_match(a_conf->rule_trie, name, fit_rules)) goto exit;
+
+	if (zc_arraylist_len(fit_rules) != zc_arraylist_len(want_rules)) {
+		printf("category[%s] fits %d rules, not %d\n", name,
+			zc_arraylist_len(fit_rules), zc_arraylist_len(want_rules));
+		goto exit;
+	}
+	zc_arraylist_foreach(want_rules, i, a_rule) {
+		if (zc_arraylist_get(fit_rules, i) != a_rule) {
+			printf("category[%s] rule %d is not [%s]\n", name, i, a_rule->category);
+			goto exit;
+		}
+	}
+	rc = 0;
+exit:
+	if (fit_rules) zc_arraylist_del(fit_rules);
+	if (want_rules) zc_arraylist_del(want_rules);
+	return rc;
+}
+
+int main(int argc, char** argv)
+{
+	int i;
+	zlog_conf_t *a_conf;
+
+	a_conf = zlog_conf_new_from_string(conf_string, NULL);
+	if (!a_conf) {
+		printf("zlog_conf_new_from_string fail\n");
+		return -1;
+	}
+
+	for (i = 0; names[i]; i++) {
+		if (check(a_conf, names[i])) {
+			zlog_conf_del(a_conf);
+			return -1;
+		}
+	}
+
+	zlog_conf_del(a_conf);
+	printf("rule trie ok\n");
+	return 0;
+}
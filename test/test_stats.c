@@ -0,0 +1,212 @@
+/* Copyright (c) Hardy Simpson
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "zlog.h"
+
+#define LOOP 100
+
+static zlog_category_t *zc;
+
+static void *work(void *arg)
+{
+	int i;
+
+	for (i = 0; i < LOOP; i++) {
+		zlog_info(zc, "info %d", i);
+		zlog_notice(zc, "notice %d", i);
+		zlog_debug(zc, "debug %d", i);
+	}
+	/* longer than buffer max */
+	zlog_warn(zc, "%0300d", 0);
+	return NULL;
+}
+
+static int check_rule(zlog_stats_rule_t *a_rule, unsigned long long writes)
+{
+	int i;
+	unsigned long long n = 0;
+
+	for (i = 0; i < ZLOG_STATS_LATENCY_BUCKETS; i++) n += a_rule->latency[i];
+	printf("rule[%s] writes[%llu] bytes[%llu] errors[%llu] rotate_requests[%llu]\n",
+		a_rule->name, a_rule->writes, a_rule->bytes, a_rule->errors, a_rule->rotate_requests);
+	if (a_rule->writes != writes || n != writes || !a_rule->bytes) {
+		printf("rule[%s] wants %llu writes, histogram has %llu\n", a_rule->name, writes, n);
+		return -1;
+	}
+	return 0;
+}
+
+/* what an outside tool sees */
+static int check_shm(void)
+{
+	int fd;
+	zlog_stats_shm_t *shm;
+	zlog_stats_t *a_stats;
+	unsigned int seq;
+	int rc = -1;
+
+	usleep(100000);
+	fd = shm_open("/zlog_test_stats", O_RDONLY, 0);
+	if (fd < 0) {
+		printf("shm_open fail\n");
+		return -1;
+	}
+	shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) goto exit;
+	a_stats = malloc(shm->size);
+	if (!a_stats) goto exit;
+
+	do {
+		seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+		zlog_stats_t *all = mmap(NULL, sizeof(*shm) + shm->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (all == MAP_FAILED) break;
+		memcpy(a_stats, (zlog_stats_shm_t *)all + 1, shm->size);
+		munmap(all, sizeof(*shm) + shm->size);
+	} while (__atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE) != seq);
+
+	if (shm->magic != ZLOG_STATS_SHM_MAGIC || a_stats->emitted[ZLOG_LEVEL_INFO] != 2 * LOOP) {
+		printf("shm magic[%x] info[%llu]\n", shm->magic, a_stats->emitted[ZLOG_LEVEL_INFO]);
+	} else {
+		rc = 0;
+	}
+	free(a_stats);
+exit:
+	if (shm != MAP_FAILED) munmap(shm, sizeof(*shm));
+	close(fd);
+	return rc;
+}
+
+static void *work_s3(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) zlog_info(zc, "s3 %d", i);
+	return NULL;
+}
+
+/* a slot reused after reloads must not be wiped by a thread still
+ * holding the count of the rule gone
+ */
+static int check_reload(void)
+{
+	int i;
+	int rc = -1;
+	pthread_t tid;
+	zlog_stats_t *a_stats;
+	zlog_stats_rule_t *a_rule;
+
+	if (zlog_reload_from_string("[global]\nstats = true\n[rules]\n"
+			"stats.INFO \"test_stats.s2.log\"\nstats.=NOTICE \"/dev/null\"\n")
+		|| zlog_reload_from_string("[global]\nstats = true\n[rules]\n"
+			"stats.INFO \"test_stats.s3.log\"\nstats.=NOTICE \"/dev/null\"\n")) {
+		printf("reload fail\n");
+		return -1;
+	}
+	pthread_create(&tid, NULL, work_s3, NULL);
+	pthread_join(tid, NULL);
+
+	a_stats = zlog_stats_snapshot();
+	if (!a_stats) {
+		printf("zlog_stats_snapshot fail\n");
+		return -1;
+	}
+	for (i = 0; i < a_stats->nrules; i++) {
+		a_rule = &zlog_stats_rules(a_stats)[i];
+		if (!strstr(a_rule->name, "test_stats.s3.log")) continue;
+		printf("rule[%s] writes[%llu]\n", a_rule->name, a_rule->writes);
+		if (a_rule->writes == 10) rc = 0;
+	}
+	if (rc) printf("rule of test_stats.s3.log lost its counts\n");
+	free(a_stats);
+	return rc;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = -1;
+	pthread_t tid;
+	zlog_stats_t *a_stats = NULL;
+	zlog_stats_category_t *a_category;
+
+	if (zlog_init("test_stats.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("stats");
+
+	/* one thread gone before the snapshot, one still here */
+	pthread_create(&tid, NULL, work, NULL);
+	pthread_join(tid, NULL);
+	work(NULL);
+
+	a_stats = zlog_stats_snapshot();
+	if (!a_stats) {
+		printf("zlog_stats_snapshot fail\n");
+		goto exit;
+	}
+
+	printf("threads[%d] info[%llu] notice[%llu] debug filtered[%llu] truncations[%llu]\n",
+		a_stats->nthreads,
+		a_stats->emitted[ZLOG_LEVEL_INFO], a_stats->emitted[ZLOG_LEVEL_NOTICE],
+		a_stats->filtered[ZLOG_LEVEL_DEBUG], a_stats->truncations);
+	if (a_stats->emitted[ZLOG_LEVEL_INFO] != 2 * LOOP
+		|| a_stats->emitted[ZLOG_LEVEL_NOTICE] != 2 * LOOP
+		|| a_stats->filtered[ZLOG_LEVEL_DEBUG] != 2 * LOOP
+		|| a_stats->truncations != 2) {
+		printf("wrong level counts\n");
+		goto exit;
+	}
+
+	if (a_stats->ncategories != 1 || a_stats->nrules != 2) {
+		printf("categories[%d] rules[%d]\n", a_stats->ncategories, a_stats->nrules);
+		goto exit;
+	}
+	a_category = zlog_stats_categories(a_stats);
+	if (strcmp(a_category->name, "stats") || a_category->msgs != 4 * LOOP + 2 || a_category->filtered != 2 * LOOP || !a_category->output_ns) {
+		printf("category[%s] msgs[%llu]\n", a_category->name, a_category->msgs);
+		goto exit;
+	}
+	/* the truncated ones are not written */
+	if (check_rule(&zlog_stats_rules(a_stats)[0], 4 * LOOP)) goto exit;
+	if (check_rule(&zlog_stats_rules(a_stats)[1], 2 * LOOP)) goto exit;
+	if (!zlog_stats_rules(a_stats)[0].rotate_requests) {
+		printf("no rotation\n");
+		goto exit;
+	}
+
+	if (check_shm()) goto exit;
+	if (check_reload()) goto exit;
+
+	printf("stats ok\n");
+	rc = 0;
+exit:
+	if (a_stats) free(a_stats);
+	zlog_fini();
+	remove("test_stats.log");
+	remove("test_stats.0.log");
+	remove("test_stats.1.log");
+	remove("test_stats.s2.log");
+	remove("test_stats.s3.log");
+	return rc;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) Hardy Simpson
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define NTHREAD 4
+#define NLOOP 20000
+
+static zlog_category_t *zc;
+
+static void *work(void *arg)
+{
+	int i;
+
+	for (i = 0; i < NLOOP; i++) {
+		zlog_info(zc, "x");
+	}
+	return NULL;
+}
+
+/* the sec and ms patched into the cached second match the plain ones,
+ * and the clock is not far from time()
+ */
+static int check(const char *path, time_t begin, time_t end)
+{
+	FILE *fp;
+	char line[256];
+	long sec, sec2, ms, ms2, ns, ns2;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%ld.%ld %ld %ld %ld %ld", &sec, &ms, &ms2, &sec2, &ns, &ns2) != 6
+			|| sec != sec2 || ms != ms2 || ns != ns2 || ms != ns / 1000000
+			|| sec < begin - 1 || sec > end + 1) {
+			printf("bad line[%ld]: %s", n, line);
+			fclose(fp);
+			return -1;
+		}
+		n++;
+	}
+	fclose(fp);
+
+	if (n != NTHREAD * NLOOP) {
+		printf("%ld lines, not %d\n", n, NTHREAD * NLOOP);
+		return -1;
+	}
+	return 0;
+}
+
+static int test(const char *conf)
+{
+	int rc;
+	int i;
+	time_t begin;
+	pthread_t tid[NTHREAD];
+
+	unlink("test_time.log");
+	begin = time(NULL);
+
+	rc = zlog_init(conf);
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < NTHREAD; i++) {
+		pthread_create(&tid[i], NULL, work, NULL);
+	}
+	for (i = 0; i < NTHREAD; i++) {
+		pthread_join(tid[i], NULL);
+	}
+	zlog_fini();
+
+	if (check("test_time.log", begin, time(NULL))) {
+		printf("%s fail\n", conf);
+		return -3;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (test("test_time.conf")) return -1;
+	if (test("test_time.2.conf")) return -1;
+
+	printf("test_time ok\n");
+	return 0;
+}
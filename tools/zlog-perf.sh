@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Count the USDT probes of zlog with perf while a command runs.
+# zlog must be built with them: make USDT=1, or cmake -DUSDT=ON.
+# The probes stay added after, for perf record -e 'sdt_zlog:*' -g,
+# until removed by: perf probe -d 'sdt_zlog:*'
+
+if [ "$2" = "" ]
+then
+    echo "Usage: zlog-perf.sh <libzlog.so or a static binary> <command> [args]..."
+    echo "Example: zlog-perf.sh src/libzlog.so src/zlog-bench -o static -t 4"
+    exit 1
+fi
+
+LIB=$1
+shift
+
+EVENTS="log_entry log_pinned log_return rule_entry rule_return format_entry format_return
+write_entry write_return file_open file_reopen rotate_entry rotate_return reload_entry reload_return"
+
+perf buildid-cache --add "$LIB" || exit 2
+
+LIST=""
+for EVENT in $EVENTS
+do
+    perf probe -q -x "$LIB" -a "%sdt_zlog:$EVENT" 2>/dev/null
+    LIST="$LIST${LIST:+,}sdt_zlog:$EVENT"
+done
+
+perf stat -e "$LIST" -- "$@"
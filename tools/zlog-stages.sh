@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Latency histograms of each stage of zlog, by its USDT probes.
+# zlog must be built with them: make USDT=1, or cmake -DUSDT=ON.
+# Needs bpftrace and root, prints when stopped by Ctrl-C.
+#
+#   log      zlog()/vzlog()/hzlog()... once past the level check
+#   pin      from log_entry to the env pinned and thread fetched
+#   rule     each fit rule, by category of the rule
+#   format   zlog_format_gen_msg, by format name
+#   write    write() of a rule, by file, also in the async thread
+#   rotate   zlog_rotater_rotate, by file
+#   reload   zlog_reload
+# and counts of files opened and reopened, and of failed writes.
+
+if [ "$1" = "" ]
+then
+    echo "Usage: zlog-stages.sh <libzlog.so or a static binary> [pid]"
+    echo "Example: zlog-stages.sh /usr/local/lib/libzlog.so 1234"
+    exit 1
+fi
+
+LIB=$1
+PID_OPT=""
+if [ "$2" != "" ]
+then
+    PID_OPT="-p $2"
+fi
+
+SCRIPT=`mktemp /tmp/zlog-stages.XXXXXX`
+trap 'rm -f $SCRIPT' EXIT
+
+cat > $SCRIPT <<BT
+usdt:$LIB:zlog:log_entry { @log_start[tid] = nsecs; @pin_start[tid] = nsecs; }
+usdt:$LIB:zlog:log_pinned /@pin_start[tid]/ {
+	@pin_ns = hist(nsecs - @pin_start[tid]); delete(@pin_start[tid]);
+}
+usdt:$LIB:zlog:log_return /@log_start[tid]/ {
+	@log_ns = hist(nsecs - @log_start[tid]); delete(@log_start[tid]);
+}
+
+usdt:$LIB:zlog:rule_entry { @rule_start[tid] = nsecs; @rule_name[tid] = str(arg0); }
+usdt:$LIB:zlog:rule_return /@rule_start[tid]/ {
+	@rule_ns[@rule_name[tid]] = hist(nsecs - @rule_start[tid]);
+	delete(@rule_start[tid]); delete(@rule_name[tid]);
+}
+
+usdt:$LIB:zlog:format_entry { @format_start[tid] = nsecs; @format_name[tid] = str(arg0); }
+usdt:$LIB:zlog:format_return /@format_start[tid]/ {
+	@format_ns[@format_name[tid]] = hist(nsecs - @format_start[tid]);
+	delete(@format_start[tid]); delete(@format_name[tid]);
+}
+
+usdt:$LIB:zlog:write_entry { @write_start[tid] = nsecs; @write_file[tid] = str(arg0); }
+usdt:$LIB:zlog:write_return /@write_start[tid]/ {
+	@write_ns[@write_file[tid]] = hist(nsecs - @write_start[tid]);
+	if (arg0 != 0) { @write_errors[@write_file[tid]] = count(); }
+	delete(@write_start[tid]); delete(@write_file[tid]);
+}
+
+usdt:$LIB:zlog:rotate_entry { @rotate_start[tid] = nsecs; }
+usdt:$LIB:zlog:rotate_return /@rotate_start[tid]/ {
+	@rotate_ns[str(arg0)] = hist(nsecs - @rotate_start[tid]); delete(@rotate_start[tid]);
+}
+
+usdt:$LIB:zlog:reload_entry { @reload_start[tid] = nsecs; }
+usdt:$LIB:zlog:reload_return /@reload_start[tid]/ {
+	@reload_ns = hist(nsecs - @reload_start[tid]); delete(@reload_start[tid]);
+}
+
+usdt:$LIB:zlog:file_open { @file_opens[str(arg0)] = count(); }
+usdt:$LIB:zlog:file_reopen { @file_reopens[str(arg0)] = count(); }
+
+END {
+	clear(@log_start); clear(@pin_start); clear(@rule_start); clear(@rule_name);
+	clear(@format_start); clear(@format_name); clear(@write_start); clear(@write_file);
+	clear(@rotate_start); clear(@reload_start);
+}
+BT
+
+bpftrace $PID_OPT $SCRIPT